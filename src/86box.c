@@ -21,6 +21,7 @@
  *          Copyright 2021-2022 Jasmine Iwanek.
  */
 #include <inttypes.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -101,6 +102,7 @@
 #include <86box/version.h>
 #include <86box/gdbstub.h>
 #include <86box/machine_status.h>
+#include <86box/benchmark.h>
 #include <86box/apm.h>
 #include <86box/acpi.h>
 #include <86box/nv/vid_nv_rivatimer.h>
@@ -125,8 +127,10 @@ int tracing_on = 0;
 #endif
 
 /* Commandline options. */
-int dump_on_exit        = 0; /* (O) dump regs on exit */
-int start_in_fullscreen = 0; /* (O) start in fullscreen */
+int dump_on_exit        = 0;  /* (O) dump regs on exit */
+int start_in_fullscreen = 0;  /* (O) start in fullscreen */
+int turbo_mode          = 0;  /* (O) run unthrottled */
+int turbo_fps           = 10; /* (O) frames presented per second in turbo mode */
 #ifdef _WIN32
 int force_debug = 0; /* (O) force debug output */
 #endif
@@ -558,6 +562,8 @@ usage:
             printf("\nUsage: 86box [options] [cfg-file]\n\n");
             printf("Valid options are:\n\n");
             printf("-? or --help            - show this information\n");
+            printf("-A or --capture path    - record every presented frame to 'path' (.y4m, .raw or a PNG directory)\n");
+            printf("-B or --benchmark secs  - run headless for 'secs' emulated seconds and print statistics\n");
             printf("-C or --config path     - set 'path' to be config file\n");
 #ifdef _WIN32
             printf("-D or --debug           - force debug output logging\n");
@@ -579,10 +585,12 @@ usage:
             printf("-M or --missing         - dump missing machines and video cards\n");
             printf("-N or --noconfirm       - do not ask for confirmation on quit\n");
             printf("-P or --vmpath path     - set 'path' to be root for vm\n");
+            printf("-Q or --linecheck       - check the SVGA scanline converters against the C versions and exit\n");
             printf("-R or --rompath path    - set 'path' to be ROM path\n");
 #ifndef USE_SDL_UI
             printf("-S or --settings        - show only the settings dialog\n");
 #endif
+            printf("-U or --turbo [fps]     - run unthrottled, presenting 'fps' frames per second\n");
             printf("-V or --vmname name     - overrides the name of the running VM\n");
             printf("-W or --nohook          - disables keyboard hook (compatibility-only outside Windows)\n");
             printf("-X or --clear what      - clears the 'what' (cmos/flash/both)\n");
@@ -621,6 +629,11 @@ usage:
 
             rpath = argv[++c];
             rom_add_path(rpath);
+        } else if (!strcasecmp(argv[c], "--capture") || !strcasecmp(argv[c], "-A")) {
+            if ((c + 1) == argc)
+                goto usage;
+
+            snprintf(capture_path, sizeof(capture_path), "%s", argv[++c]);
         } else if (!strcasecmp(argv[c], "--config") || !strcasecmp(argv[c], "-C")) {
             if ((c + 1) == argc || plat_dir_check(argv[c + 1]))
                 goto usage;
@@ -654,6 +667,28 @@ usage:
         } else if (!strcasecmp(argv[c], "--settings") || !strcasecmp(argv[c], "-S")) {
             settings_only = 1;
 #endif
+        } else if (!strcasecmp(argv[c], "--benchmark") || !strcasecmp(argv[c], "-B")) {
+            char *end;
+            long  secs;
+
+            if ((c + 1) == argc)
+                goto usage;
+
+            /* The guest can still end the run early through the unit tester. */
+            secs = strtol(argv[++c], &end, 10);
+            if ((end == argv[c]) || (*end != '\0') || (secs <= 0) || (secs > (INT_MAX / 100)))
+                goto usage;
+
+            benchmark_mode = 1;
+            benchmark_secs = (int) secs;
+        } else if (!strcasecmp(argv[c], "--linecheck") || !strcasecmp(argv[c], "-Q")) {
+            benchmark_line_check = 1;
+        } else if (!strcasecmp(argv[c], "--turbo") || !strcasecmp(argv[c], "-U")) {
+            turbo_mode = 1;
+
+            /* The frame rate is optional, so only take the next argument if it is a number. */
+            if (((c + 1) < argc) && (argv[c + 1][0] != '\0') && (strspn(argv[c + 1], "0123456789") == strlen(argv[c + 1])))
+                turbo_fps = atoi(argv[++c]);
         } else if (!strcasecmp(argv[c], "--noconfirm") || !strcasecmp(argv[c], "-N")) {
             confirm_exit_cmdl = 0;
         } else if (!strcasecmp(argv[c], "--missing") || !strcasecmp(argv[c], "-M")) {
@@ -1150,6 +1185,8 @@ pc_reset_hard_close(void)
 
     scsi_disk_close();
 
+    sound_mix_thread_end();
+
     closeal();
 
     video_reset_close();
@@ -1405,6 +1442,8 @@ pc_close(UNUSED(thread_t *ptr))
 
     sound_cd_thread_end();
 
+    sound_mix_thread_end();
+
     cdrom_close();
 
     zip_close();
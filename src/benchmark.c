@@ -0,0 +1,262 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Headless benchmark runner.
+ *
+ *          Runs the configured machine without a renderer or audio output
+ *          for a fixed amount of emulated time, or until the guest asks
+ *          to exit through the unit tester device, then prints throughput
+ *          statistics.
+ *
+ *          Separately, checks the SVGA scanline converters against their
+ *          C versions and compares their throughput.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+#ifdef _WIN32
+#    include <windows.h>
+#endif
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/plat.h>
+#include <86box/plat_unused.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+#include <86box/benchmark.h>
+
+#define BENCHMARK_LINE_PIXELS 1280
+#define BENCHMARK_LINES       20000
+
+int          benchmark_mode       = 0;
+int          benchmark_line_check = 0;
+int          benchmark_secs       = 0;
+volatile int benchmark_stop       = 0;
+int          benchmark_exit_code  = 0;
+uint64_t     benchmark_timer_ns   = 0;
+
+static volatile uint64_t benchmark_frames = 0;
+
+uint64_t
+benchmark_clock_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq = { 0 };
+    LARGE_INTEGER        count;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+
+    return (uint64_t) ((double) count.QuadPart * 1000000000.0 / (double) freq.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+void
+benchmark_request_stop(int exit_code)
+{
+    benchmark_exit_code = exit_code;
+    benchmark_stop      = 1;
+}
+
+/* Nothing is presented, frames are only counted. */
+static void
+benchmark_blit(UNUSED(int x), UNUSED(int y), UNUSED(int w), UNUSED(int h), int monitor_index)
+{
+    benchmark_frames++;
+
+    video_blit_complete_monitor(monitor_index);
+}
+
+static const char *benchmark_line_formats[] = { "8bpp", "15bpp", "16bpp", "24bpp", "32bpp", "ABGR8888", "RGBA8888" };
+
+static void
+benchmark_line_conv_run(const svga_line_conv_t *conv, int format, uint32_t *dst, const uint8_t *src, const uint32_t *pal)
+{
+    switch (format) {
+        case 0:
+            conv->conv_8to32(dst, src, pal, 0xff, BENCHMARK_LINE_PIXELS);
+            break;
+        case 1:
+            conv->conv_15to32(dst, src, BENCHMARK_LINE_PIXELS);
+            break;
+        case 2:
+            conv->conv_16to32(dst, src, BENCHMARK_LINE_PIXELS);
+            break;
+        case 3:
+            conv->conv_24to32(dst, src, BENCHMARK_LINE_PIXELS);
+            break;
+        case 4:
+            conv->conv_32to32(dst, src, BENCHMARK_LINE_PIXELS);
+            break;
+        case 5:
+            conv->conv_abgr8888(dst, src, BENCHMARK_LINE_PIXELS);
+            break;
+        case 6:
+            conv->conv_rgba8888(dst, src, BENCHMARK_LINE_PIXELS);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static double
+benchmark_line_conv_time(const svga_line_conv_t *conv, int format, uint32_t *dst, const uint8_t *src, const uint32_t *pal)
+{
+    uint64_t start_ns = benchmark_clock_ns();
+
+    for (int i = 0; i < BENCHMARK_LINES; i++)
+        benchmark_line_conv_run(conv, format, dst, src, pal);
+
+    return (double) (benchmark_clock_ns() - start_ns) / 1000000000.0;
+}
+
+/* Runs every scanline converter the host selected against the C version on
+   random data, and reports whether they agree and how fast each one is.
+   Returns non-zero if any of them disagree. */
+int
+benchmark_line_conv_check(void)
+{
+    uint8_t  *src = malloc(BENCHMARK_LINE_PIXELS * 4);
+    uint32_t *ref = malloc(BENCHMARK_LINE_PIXELS * 4);
+    uint32_t *dst = malloc(BENCHMARK_LINE_PIXELS * 4);
+    uint32_t  pal[256];
+    double    ref_secs;
+    double    dst_secs;
+    int       mismatch;
+    int       mismatches = 0;
+
+    if ((src == NULL) || (ref == NULL) || (dst == NULL)) {
+        free(src);
+        free(ref);
+        free(dst);
+        return 1;
+    }
+
+    /* This runs before video_init(), so neither the conversion tables the
+       C versions use nor the converters themselves are set up yet. */
+    video_init_tables();
+    svga_line_conv_init();
+
+    srand(0x86);
+    for (int i = 0; i < (BENCHMARK_LINE_PIXELS * 4); i++)
+        src[i] = rand() & 0xff;
+    for (int i = 0; i < 256; i++)
+        pal[i] = ((rand() & 0xffff) << 16) | (rand() & 0xffff);
+
+    printf("Scanline converters (%s vs C, %i pixels per line):\n", svga_line_conv.name, BENCHMARK_LINE_PIXELS);
+    for (int f = 0; f < (int) (sizeof(benchmark_line_formats) / sizeof(benchmark_line_formats[0])); f++) {
+        benchmark_line_conv_run(&svga_line_conv_c, f, ref, src, pal);
+        benchmark_line_conv_run(&svga_line_conv, f, dst, src, pal);
+        mismatch = !!memcmp(ref, dst, BENCHMARK_LINE_PIXELS * 4);
+        mismatches += mismatch;
+
+        ref_secs = benchmark_line_conv_time(&svga_line_conv_c, f, ref, src, pal);
+        dst_secs = benchmark_line_conv_time(&svga_line_conv, f, dst, src, pal);
+        if (ref_secs <= 0.0)
+            ref_secs = 1.0e-9;
+        if (dst_secs <= 0.0)
+            dst_secs = 1.0e-9;
+
+        printf("  %-10s %8.1f Mpix/s vs %8.1f Mpix/s (%.2fx)%s\n", benchmark_line_formats[f],
+               ((double) BENCHMARK_LINES * BENCHMARK_LINE_PIXELS) / (dst_secs * 1000000.0),
+               ((double) BENCHMARK_LINES * BENCHMARK_LINE_PIXELS) / (ref_secs * 1000000.0),
+               ref_secs / dst_secs, mismatch ? " MISMATCH" : "");
+    }
+
+    free(src);
+    free(ref);
+    free(dst);
+    fflush(stdout);
+
+    return !!mismatches;
+}
+
+int
+benchmark_run(void)
+{
+    uint64_t slices     = 0;
+    uint64_t max_slices = (uint64_t) benchmark_secs * 100ULL;
+    uint64_t run_ns     = 0;
+    uint64_t start_ns;
+    uint64_t slice_ns;
+    uint64_t end_ns;
+    clock_t  start_clock;
+    double   wall_secs;
+    double   cpu_secs;
+    double   emu_secs;
+
+    /* Drop audio and present every frame to the counting blitter. */
+    turbo_mode = 1;
+    turbo_fps  = 0;
+    video_setblit(benchmark_blit);
+
+    pc_reset_hard_init();
+    do_pause(0);
+
+    cpu_ins_count      = 0;
+    cpu_recomp_count   = 0;
+    benchmark_frames   = 0;
+    benchmark_timer_ns = 0;
+
+    start_ns    = benchmark_clock_ns();
+    start_clock = clock();
+
+    while (!benchmark_stop && cpu_thread_run && (slices < max_slices)) {
+        slice_ns = benchmark_clock_ns();
+
+        /* Every slice is 10 ms of emulated time. */
+        pc_run();
+
+        run_ns += benchmark_clock_ns() - slice_ns;
+        slices++;
+    }
+
+    end_ns    = benchmark_clock_ns();
+    wall_secs = (double) (end_ns - start_ns) / 1000000000.0;
+    cpu_secs  = (double) (clock() - start_clock) / (double) CLOCKS_PER_SEC;
+    emu_secs  = (double) slices / 100.0;
+    if (wall_secs <= 0.0)
+        wall_secs = 1.0e-9;
+
+    printf("\nBenchmark results for %s:\n\n", cpu_s->name);
+    printf("Emulated time:          %.2f s\n", emu_secs);
+    printf("Host wall time:         %.2f s (%.1f%% of real time)\n", wall_secs, (emu_secs * 100.0) / wall_secs);
+    printf("Host CPU time:          %.2f s\n", cpu_secs);
+    printf("Instructions executed:  %" PRIu64 " (%.2f MIPS)\n", cpu_ins_count,
+           (double) cpu_ins_count / (wall_secs * 1000000.0));
+    printf("Dynarec compilations:   %" PRIu64 "\n", cpu_recomp_count);
+    printf("Frames rendered:        %" PRIu64 " (%.1f fps host, %.1f fps guest)\n", benchmark_frames,
+           (double) benchmark_frames / wall_secs, (emu_secs > 0.0) ? ((double) benchmark_frames / emu_secs) : 0.0);
+    printf("\nHost time per subsystem:\n");
+    printf("  CPU core:             %.3f s\n", (double) (run_ns - benchmark_timer_ns) / 1000000000.0);
+    printf("  Device timers:        %.3f s (includes video and audio rendering)\n", (double) benchmark_timer_ns / 1000000000.0);
+    if (benchmark_stop)
+        printf("\nStopped by the guest with exit code %02X.\n", benchmark_exit_code);
+    fflush(stdout);
+
+    pc_close(NULL);
+    endblit();
+
+    return benchmark_exit_code;
+}
@@ -35,16 +35,31 @@
 #include <86box/86box.h>
 #include <86box/path.h>
 #include <86box/plat.h>
+#include <86box/thread.h>
 #include <86box/cdrom_image_backend.h>
 
 #include <sndfile.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define CDROM_IMAGE_SSE2
+#    include <emmintrin.h>
+#endif
+
 #define CDROM_BCD(x)        (((x) % 10) | (((x) / 10) << 4))
 
 #define MAX_LINE_LENGTH     512
 #define MAX_FILENAME_LENGTH 256
 #define CROSS_LEN           512
 
+/* Binary files are read through a small cache of large blocks, so that a
+   run of sector reads costs one fread() per block rather than a seek and a
+   read per sector. A miss right after the previous one also pulls in the
+   blocks that follow it. */
+#define BIN_BLOCK_SIZE      32768
+#define BIN_BLOCKS          16
+#define BIN_READ_AHEAD      4
+#define BIN_NO_BLOCK        0xffffffffffffffffULL
+
 static char temp_keyword[1024];
 
 #ifdef ENABLE_CDROM_IMAGE_BACKEND_LOG
@@ -161,11 +176,120 @@ cleanup_error:
     return NULL;
 }
 
+typedef struct bin_cache_t {
+    /* The CD audio thread reads through here as well. */
+    mutex_t *lock;
+    uint64_t block[BIN_BLOCKS]; /* Number of the block in each slot. */
+    uint32_t valid[BIN_BLOCKS]; /* How much of it is in the file. */
+    uint32_t used[BIN_BLOCKS];
+    uint32_t clock;
+    uint64_t last_miss;
+    uint8_t *data[BIN_BLOCKS];  /* Allocated on first use. */
+} bin_cache_t;
+
+/* Swaps the bytes of every 16-bit word, for Motorola byte order images. */
+void
+cdi_swap_words(uint8_t *buffer, size_t count)
+{
+    size_t   i = 0;
+    uint64_t v;
+
+#ifdef CDROM_IMAGE_SSE2
+    for (; (i + 16) <= count; i += 16) {
+        __m128i w = _mm_loadu_si128((__m128i *) &buffer[i]);
+        _mm_storeu_si128((__m128i *) &buffer[i], _mm_or_si128(_mm_slli_epi16(w, 8), _mm_srli_epi16(w, 8)));
+    }
+#endif
+    for (; (i + 8) <= count; i += 8) {
+        memcpy(&v, &buffer[i], 8);
+        v = ((v & 0x00ff00ff00ff00ffULL) << 8) | ((v >> 8) & 0x00ff00ff00ff00ffULL);
+        memcpy(&buffer[i], &v, 8);
+    }
+    for (; (i + 1) < count; i += 2) {
+        uint8_t buffer0 = buffer[i];
+        buffer[i]       = buffer[i + 1];
+        buffer[i + 1]   = buffer0;
+    }
+}
+
+static int
+bin_cache_find(bin_cache_t *cache, uint64_t block)
+{
+    for (int i = 0; i < BIN_BLOCKS; i++) {
+        if (cache->block[i] == block)
+            return i;
+    }
+
+    return -1;
+}
+
+/* Returns the slot holding a block, reading it in first if needed. */
+static int
+bin_cache_get(track_file_t *tf, uint64_t block)
+{
+    bin_cache_t *cache = (bin_cache_t *) tf->priv;
+    int          slot  = bin_cache_find(cache, block);
+    int          ahead = (block == (cache->last_miss + 1)) ? BIN_READ_AHEAD : 1;
+    int          victim;
+    size_t       num_read;
+
+    if (slot >= 0) {
+        cache->used[slot] = ++cache->clock;
+        return slot;
+    }
+
+    if (fseeko64(tf->fp, block * BIN_BLOCK_SIZE, SEEK_SET) == -1) {
+        cdrom_image_backend_log("CDROM: binary_read failed during seek!\n");
+        return -1;
+    }
+
+    for (int n = 0; n < ahead; n++) {
+        if ((n > 0) && (bin_cache_find(cache, block + n) >= 0))
+            break;
+
+        victim = 0;
+        for (int i = 1; i < BIN_BLOCKS; i++) {
+            if (cache->used[i] < cache->used[victim])
+                victim = i;
+        }
+
+        if ((cache->data[victim] == NULL) && ((cache->data[victim] = (uint8_t *) malloc(BIN_BLOCK_SIZE)) == NULL))
+            break;
+
+        cache->block[victim] = BIN_NO_BLOCK;
+        num_read             = fread(cache->data[victim], 1, BIN_BLOCK_SIZE, tf->fp);
+        if (num_read == 0)
+            break;
+
+        cache->block[victim] = block + n;
+        cache->valid[victim] = (uint32_t) num_read;
+        cache->used[victim]  = ++cache->clock;
+        cache->last_miss     = block + n;
+        if (n == 0)
+            slot = victim;
+
+        if (num_read < BIN_BLOCK_SIZE)
+            break;
+    }
+
+    if (slot < 0)
+        cdrom_image_backend_log("CDROM: binary_read failed during read!\n");
+
+    return slot;
+}
+
 /* Binary file functions. */
 static int
 bin_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
 {
-    track_file_t *tf = NULL;
+    track_file_t *tf    = NULL;
+    bin_cache_t  *cache;
+    uint8_t      *p     = buffer;
+    size_t        left  = count;
+    uint32_t      offset;
+    uint32_t      len;
+    int           slot;
+    int           ret   = 1;
 
     if ((tf = (track_file_t *) priv)->fp == NULL)
         return 0;
@@ -173,28 +297,29 @@ bin_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
     cdrom_image_backend_log("CDROM: binary_read(%08lx, pos=%" PRIu64 " count=%lu)\n",
                             tf->fp, seek, count);
 
-    if (fseeko64(tf->fp, seek, SEEK_SET) == -1) {
-        cdrom_image_backend_log("CDROM: binary_read failed during seek!\n");
-
-        return -1;
-    }
+    cache = (bin_cache_t *) tf->priv;
 
-    if (fread(buffer, count, 1, tf->fp) != 1) {
-        cdrom_image_backend_log("CDROM: binary_read failed during read!\n");
+    thread_wait_mutex(cache->lock);
+    while (left > 0) {
+        slot   = bin_cache_get(tf, seek / BIN_BLOCK_SIZE);
+        offset = (uint32_t) (seek % BIN_BLOCK_SIZE);
+        if ((slot < 0) || (offset >= cache->valid[slot])) {
+            ret = -1;
+            break;
+        }
 
-        return -1;
+        len = MIN(left, cache->valid[slot] - offset);
+        memcpy(p, &cache->data[slot][offset], len);
+        p += len;
+        seek += len;
+        left -= len;
     }
+    thread_release_mutex(cache->lock);
 
-    if (UNLIKELY(tf->motorola)) {
-        for (uint64_t i = 0; i < count; i += 2) {
-            uint8_t buffer0 = buffer[i];
-            uint8_t buffer1 = buffer[i + 1];
-            buffer[i] = buffer1;
-            buffer[i + 1] = buffer0;
-        }
-    }
+    if ((ret > 0) && UNLIKELY(tf->motorola))
+        cdi_swap_words(buffer, count);
 
-    return 1;
+    return ret;
 }
 
 static uint64_t
@@ -216,6 +341,7 @@ static void
 bin_close(void *priv)
 {
     track_file_t *tf = (track_file_t *) priv;
+    bin_cache_t  *cache;
 
     if (tf == NULL)
         return;
@@ -225,6 +351,15 @@ bin_close(void *priv)
         tf->fp = NULL;
     }
 
+    if ((cache = (bin_cache_t *) tf->priv) != NULL) {
+        for (int i = 0; i < BIN_BLOCKS; i++)
+            free(cache->data[i]);
+        if (cache->lock != NULL)
+            thread_close_mutex(cache->lock);
+        free(cache);
+        tf->priv = NULL;
+    }
+
     memset(tf->fn, 0x00, sizeof(tf->fn));
 
     free(priv);
@@ -254,6 +389,19 @@ bin_init(const char *filename, int *error)
 
     /* Set the function pointers. */
     if (!*error) {
+        bin_cache_t *cache = (bin_cache_t *) calloc(1, sizeof(bin_cache_t));
+
+        if (cache == NULL) {
+            *error = 1;
+            bin_close(tf);
+            return NULL;
+        }
+        for (int i = 0; i < BIN_BLOCKS; i++)
+            cache->block[i] = BIN_NO_BLOCK;
+        cache->last_miss = BIN_NO_BLOCK - 1;
+        cache->lock      = thread_create_mutex();
+        tf->priv         = cache;
+
         tf->read       = bin_read;
         tf->get_length = bin_get_length;
         tf->close      = bin_close;
@@ -344,22 +492,87 @@ cdi_get_raw_track_info(cd_img_t *cdi, int *num, uint8_t *buffer)
 }
 
 static int
-cdi_get_track(cd_img_t *cdi, uint32_t sector)
+cdi_compare_u64(const void *a, const void *b)
 {
-    int ret = -1;
+    const uint64_t x = *(const uint64_t *) a;
+    const uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Splits the LBA space into ranges that each resolve to a single track and
+   index, so that lookups are a binary search instead of a scan of every
+   index of every track. Where indexes overlap, the last track and its first
+   matching index win, as with the scan. */
+static void
+cdi_build_ranges(cd_img_t *cdi)
+{
+    uint64_t *points;
+    int       points_num = 0;
+    int       n          = 0;
+
+    free(cdi->ranges);
+    cdi->ranges     = NULL;
+    cdi->ranges_num = 0;
+
+    if (cdi->tracks_num <= 0)
+        return;
+
+    points = (uint64_t *) malloc(cdi->tracks_num * 6 * sizeof(uint64_t));
+    if (points == NULL)
+        return;
 
     for (int i = 0; i < cdi->tracks_num; i++) {
-        track_t *ct = &(cdi->tracks[i]);
         for (int j = 0; j < 3; j++) {
-            track_index_t *ci = &(ct->idx[j]);
-            if (((sector + 150) >= ci->start) && ((sector + 150) <= (ci->start + ci->length - 1))) {
-                ret = i;
-                break;
+            const track_index_t *ci  = &(cdi->tracks[i].idx[j]);
+            const uint64_t       end = ci->start + ci->length - 1;
+
+            if (end >= ci->start) {
+                points[points_num++] = ci->start;
+                if (end != 0xffffffffffffffffULL)
+                    points[points_num++] = end + 1;
             }
         }
     }
 
-    return ret;
+    qsort(points, points_num, sizeof(uint64_t), cdi_compare_u64);
+
+    cdi->ranges = (track_range_t *) malloc(MAX(points_num, 1) * sizeof(track_range_t));
+    if (cdi->ranges == NULL) {
+        free(points);
+        return;
+    }
+
+    for (int k = 0; k < points_num; k++) {
+        const uint64_t pos   = points[k];
+        int            track = -1;
+        int            index = -1;
+
+        if ((k > 0) && (pos == points[k - 1]))
+            continue;
+
+        for (int i = 0; i < cdi->tracks_num; i++) {
+            for (int j = 0; j < 3; j++) {
+                const track_index_t *ci = &(cdi->tracks[i].idx[j]);
+                if ((pos >= ci->start) && (pos <= (ci->start + ci->length - 1))) {
+                    track = i;
+                    index = j;
+                    break;
+                }
+            }
+        }
+
+        if ((n > 0) && (cdi->ranges[n - 1].track == track) && (cdi->ranges[n - 1].index == index))
+            continue;
+
+        cdi->ranges[n].start = pos;
+        cdi->ranges[n].track = track;
+        cdi->ranges[n].index = index;
+        n++;
+    }
+
+    cdi->ranges_num = n;
+    free(points);
 }
 
 static void
@@ -368,6 +581,27 @@ cdi_get_track_and_index(cd_img_t *cdi, uint32_t sector, int *track, int *index)
     *track = -1;
     *index = -1;
 
+    if (cdi->ranges != NULL) {
+        const uint64_t pos = (uint32_t) (sector + 150);
+        int            lo  = 0;
+        int            hi  = cdi->ranges_num;
+
+        /* Find the last range that starts at or before pos. */
+        while (lo < hi) {
+            const int mid = (lo + hi) >> 1;
+            if (cdi->ranges[mid].start <= pos)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if (lo > 0) {
+            *track = cdi->ranges[lo - 1].track;
+            *index = cdi->ranges[lo - 1].index;
+        }
+        return;
+    }
+
     for (int i = 0; i < cdi->tracks_num; i++) {
         track_t *ct = &(cdi->tracks[i]);
         for (int j = 0; j < 3; j++) {
@@ -381,6 +615,17 @@ cdi_get_track_and_index(cd_img_t *cdi, uint32_t sector, int *track, int *index)
     }
 }
 
+static int
+cdi_get_track(cd_img_t *cdi, uint32_t sector)
+{
+    int track;
+    int index;
+
+    cdi_get_track_and_index(cdi, sector, &track, &index);
+
+    return track;
+}
+
 /* TODO: See if track start is adjusted by 150 or not. */
 int
 cdi_get_audio_sub(cd_img_t *cdi, uint32_t sector, uint8_t *attr, uint8_t *track, uint8_t *index, TMSF *rel_pos, TMSF *abs_pos)
@@ -763,6 +1008,24 @@ cdi_cue_get_flags(track_t *cur, char **line)
     return 1;
 }
 
+static void
+cdi_set_data_mode(track_t *ct, uint32_t mode, uint32_t sector_size)
+{
+    ct->attr        = DATA_TRACK;
+    ct->mode        = mode;
+    ct->sector_size = sector_size;
+    if (ct->mode == 2)  switch(ct->sector_size) {
+        case 2324: case 2328:
+            ct->form = 2;
+            break;
+        case 2048: case 2336: case 2352: case 2448:
+            ct->form = 1;
+            break;
+    }
+    if ((ct->sector_size == 2336) && (ct->mode == 2) && (ct->form == 1))
+        ct->skip        = 8;
+}
+
 static track_t *
 cdi_insert_track(cd_img_t *cdi, uint8_t session, uint8_t point)
 {
@@ -1151,6 +1414,7 @@ cdi_load_iso(cd_img_t *cdi, const char *filename)
         return 0;
 
     cdi_last_3_passes(cdi);
+    cdi_build_ranges(cdi);
 
     return success;
 }
@@ -1289,19 +1553,9 @@ cdi_load_cue(cd_img_t *cdi, const char *cuefile)
                 ct->attr        = AUDIO_TRACK;
             } else if (!memcmp(type, "MODE", 4)) {
                 uint32_t mode;
-                ct->attr        = DATA_TRACK;
-                sscanf(type, "MODE%" PRIu32 "/%" PRIu32, &mode, &(ct->sector_size));
-                ct->mode = mode;
-                if (ct->mode == 2)  switch(ct->sector_size) {
-                    case 2324: case 2328:
-                        ct->form = 2;
-                        break;
-                    case 2048: case 2336: case 2352: case 2448:
-                        ct->form = 1;
-                        break;
-                }
-                if ((ct->sector_size == 2336) && (ct->mode == 2) && (ct->form == 1))
-                    ct->skip        = 8;
+                uint32_t sector_size = 0;
+                sscanf(type, "MODE%" PRIu32 "/%" PRIu32, &mode, &sector_size);
+                cdi_set_data_mode(ct, mode, sector_size);
             } else if (!memcmp(type, "CD", 2)) {
                 ct->attr        = DATA_TRACK;
                 ct->mode        = 2;
@@ -1427,10 +1681,126 @@ cdi_load_cue(cd_img_t *cdi, const char *cuefile)
         return 0;
 
     cdi_last_3_passes(cdi);
+    cdi_build_ranges(cdi);
 
     return success;
 }
 
+#ifdef USE_LIBCHDR
+static const struct {
+    const char *type;
+    uint32_t    mode;
+    uint32_t    sector_size;
+} cdi_chd_types[] = {
+    { "MODE1",          1, COOKED_SECTOR_SIZE },
+    { "MODE1/2048",     1, COOKED_SECTOR_SIZE },
+    { "MODE1_RAW",      1, RAW_SECTOR_SIZE    },
+    { "MODE1/2352",     1, RAW_SECTOR_SIZE    },
+    { "MODE2",          2, 2336               },
+    { "MODE2/2336",     2, 2336               },
+    { "MODE2_FORM1",    2, COOKED_SECTOR_SIZE },
+    { "MODE2/2048",     2, COOKED_SECTOR_SIZE },
+    { "MODE2_FORM2",    2, 2324               },
+    { "MODE2/2324",     2, 2324               },
+    { "MODE2_FORM_MIX", 2, 2336               },
+    { "MODE2_RAW",      2, RAW_SECTOR_SIZE    },
+    { "MODE2/2352",     2, RAW_SECTOR_SIZE    },
+    { "AUDIO",          0, RAW_SECTOR_SIZE    }
+};
+
+/* Builds the track list from the track metadata of a CHD, the same way a
+   cue sheet with one file per track would describe it. */
+int
+cdi_load_chd(cd_img_t *cdi, const char *filename)
+{
+    track_t          *ct      = NULL;
+    track_file_t     *tf      = NULL;
+    void             *chd;
+    chd_track_info_t  info;
+    uint64_t          frame   = 0ULL;
+    uint32_t          pregap;
+    int               success = 1;
+    int               type;
+
+    cdi->tracks     = NULL;
+    cdi->tracks_num = 0;
+
+    chd = chd_image_open(filename);
+    if (chd == NULL)
+        return 0;
+
+    for (int i = 0; i < 3; i++)
+        (void *) cdi_insert_track(cdi, 1, 0xa0 + i);
+
+    for (int i = 0; success && chd_image_get_track(chd, i, &info); i++) {
+        for (type = 0; type < (int) (sizeof(cdi_chd_types) / sizeof(cdi_chd_types[0])); type++) {
+            if (!strcmp(info.type, cdi_chd_types[type].type))
+                break;
+        }
+        if ((type == (int) (sizeof(cdi_chd_types) / sizeof(cdi_chd_types[0]))) || (info.track < 1) || (info.track > 99)) {
+            cdrom_image_backend_log("CHD: unsupported track %i of type '%s'\n", info.track, info.type);
+            success = 0;
+            break;
+        }
+
+        ct = cdi_insert_track(cdi, 1, info.track);
+        if (cdi_chd_types[type].mode == 0) {
+            ct->sector_size = RAW_SECTOR_SIZE;
+            ct->attr        = AUDIO_TRACK;
+        } else
+            cdi_set_data_mode(ct, cdi_chd_types[type].mode, cdi_chd_types[type].sector_size);
+
+        /* Raw subchannel data is only of use next to raw sectors, otherwise
+           it is made up from the track layout as for any other image. */
+        if ((ct->sector_size == RAW_SECTOR_SIZE) && !strcmp(info.subtype, "RW_RAW"))
+            ct->sector_size = 2448;
+
+        tf = chd_image_track_init(chd, filename, frame, info.frames, ct->sector_size, ct->attr == AUDIO_TRACK);
+        if (tf == NULL) {
+            success = 0;
+            break;
+        }
+
+        /* A pre-gap of type V is stored in the file, ahead of index 1. */
+        pregap = 0;
+        if (info.pregap && (info.pgtype[0] == 'V')) {
+            pregap                = info.pregap;
+            ct->idx[0].type       = INDEX_NORMAL;
+            ct->idx[0].file       = tf;
+            ct->idx[0].file_start = 0;
+        } else if (info.pregap) {
+            ct->idx[0].type   = INDEX_ZERO;
+            ct->idx[0].file   = tf;
+            ct->idx[0].length = info.pregap;
+        }
+
+        ct->idx[1].type       = INDEX_NORMAL;
+        ct->idx[1].file       = tf;
+        ct->idx[1].file_start = pregap;
+
+        if (info.postgap) {
+            ct->idx[2].type   = INDEX_ZERO;
+            ct->idx[2].file   = tf;
+            ct->idx[2].length = info.postgap;
+        }
+
+        /* Every track starts on a multiple of four frames. */
+        frame += (info.frames + 3) & ~3;
+    }
+
+    /* The track files hold on to the CHD from here on. */
+    chd_image_release(chd);
+
+    if (!success || (ct == NULL))
+        return 0;
+
+    cdi_last_3_passes(cdi);
+    cdi_build_ranges(cdi);
+
+    return 1;
+}
+#endif
+
 /* Root functions. */
 static void
 cdi_clear_tracks(cd_img_t *cdi)
@@ -1439,6 +1809,10 @@ cdi_clear_tracks(cd_img_t *cdi)
     track_t            *cur  = NULL;
     track_index_t      *idx  = NULL;
 
+    free(cdi->ranges);
+    cdi->ranges     = NULL;
+    cdi->ranges_num = 0;
+
     if ((cdi->tracks == NULL) || (cdi->tracks_num == 0))
         return;
 
@@ -1490,6 +1864,15 @@ cdi_set_device(cd_img_t *cdi, const char *path)
         cdi_clear_tracks(cdi);
     }
 
+#ifdef USE_LIBCHDR
+    if ((ext == 4) && !stricmp(path + strlen(path) - ext + 1, "CHD")) {
+        if ((ret = cdi_load_chd(cdi, path)))
+            return ret;
+
+        cdi_clear_tracks(cdi);
+    }
+#endif
+
     if ((ret = cdi_load_iso(cdi, path)))
         return ret;
 
@@ -0,0 +1,408 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          CHD compressed CD-ROM image back-end.
+ *
+ *          A CHD stores every frame as 2352 bytes of data followed by 96
+ *          bytes of subchannel, in hunks of several frames which are
+ *          compressed one by one. Each track is presented to the image
+ *          code as a track file of its own with the sector size of that
+ *          track, read from a shared cache of decompressed hunks that a
+ *          thread keeps filled ahead of sequential reads.
+ */
+#ifndef _LARGEFILE_SOURCE
+#    define _LARGEFILE_SOURCE
+#endif
+#ifndef _LARGEFILE64_SOURCE
+#    define _LARGEFILE64_SOURCE
+#endif
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/thread.h>
+#include <86box/cdrom_image_backend.h>
+
+#include <libchdr/chd.h>
+
+#define CHD_FRAME_SIZE  2448
+#define CHD_CACHE_HUNKS 64
+#define CHD_READ_AHEAD  16
+#define CHD_NO_HUNK     0xffffffff
+
+typedef struct chd_image_t {
+    chd_file *chd;       /* Read from under lock. */
+    chd_file *ahead_chd; /* Only read from by the read-ahead thread. */
+    uint32_t  hunk_bytes;
+    uint32_t  total_hunks;
+    int       refs;
+
+    mutex_t  *lock;
+    uint32_t  hunk[CHD_CACHE_HUNKS];
+    uint32_t  used[CHD_CACHE_HUNKS];
+    uint32_t  clock;
+    uint8_t  *data[CHD_CACHE_HUNKS];
+    uint32_t  last_hunk;
+
+    thread_t *thread;
+    event_t  *wake;
+    event_t  *done;
+    uint8_t  *ahead_buf;
+    uint32_t  ahead_from;
+    uint32_t  ahead_to;
+    uint32_t  busy;
+    int       stop;
+} chd_image_t;
+
+typedef struct chd_track_t {
+    chd_image_t *img;
+    uint64_t     first_frame;
+    uint32_t     frames;
+    uint32_t     frame_size;
+} chd_track_t;
+
+#ifdef ENABLE_CDROM_IMAGE_CHD_LOG
+int cdrom_image_chd_do_log = ENABLE_CDROM_IMAGE_CHD_LOG;
+
+void
+cdrom_image_chd_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (cdrom_image_chd_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define cdrom_image_chd_log(fmt, ...)
+#endif
+
+static int
+chd_image_find(chd_image_t *img, uint32_t hunk)
+{
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++) {
+        if (img->hunk[i] == hunk)
+            return i;
+    }
+
+    return -1;
+}
+
+static int
+chd_image_victim(chd_image_t *img)
+{
+    int victim = 0;
+
+    for (int i = 1; i < CHD_CACHE_HUNKS; i++) {
+        if (img->used[i] < img->used[victim])
+            victim = i;
+    }
+
+    return victim;
+}
+
+/* Decompresses the hunks after the last sequential read into the cache. The
+   hunk being worked on is left out of the cache until it is done, readers
+   that want it wait for it instead of decompressing it a second time. */
+static void
+chd_image_thread(void *param)
+{
+    chd_image_t *img = (chd_image_t *) param;
+    uint8_t     *buf;
+    uint32_t     hunk;
+    int          slot;
+    int          ok;
+    int          stop;
+
+    while (1) {
+        thread_wait_event(img->wake, -1);
+        thread_reset_event(img->wake);
+
+        thread_wait_mutex(img->lock);
+        while (!img->stop) {
+            for (hunk = img->ahead_from; (hunk < img->ahead_to) && (chd_image_find(img, hunk) >= 0); hunk++)
+                ;
+            if (hunk >= img->ahead_to)
+                break;
+
+            img->ahead_from = hunk + 1;
+            img->busy       = hunk;
+            thread_release_mutex(img->lock);
+
+            ok = (chd_read(img->ahead_chd, hunk, img->ahead_buf) == CHDERR_NONE);
+
+            thread_wait_mutex(img->lock);
+            if (ok) {
+                slot            = chd_image_victim(img);
+                buf             = img->data[slot];
+                img->data[slot] = img->ahead_buf;
+                img->ahead_buf  = buf;
+                img->hunk[slot] = hunk;
+                img->used[slot] = ++img->clock;
+            }
+            img->busy = CHD_NO_HUNK;
+            thread_set_event(img->done);
+        }
+        stop = img->stop;
+        thread_release_mutex(img->lock);
+
+        if (stop)
+            break;
+    }
+}
+
+/* Returns the cache slot holding a hunk, decompressing it first if needed.
+   Must be called with the image locked. */
+static int
+chd_image_get_hunk(chd_image_t *img, uint32_t hunk)
+{
+    int slot;
+
+    while (((slot = chd_image_find(img, hunk)) < 0) && (img->busy == hunk)) {
+        thread_reset_event(img->done);
+        thread_release_mutex(img->lock);
+        thread_wait_event(img->done, 10);
+        thread_wait_mutex(img->lock);
+    }
+
+    if (slot < 0) {
+        slot            = chd_image_victim(img);
+        img->hunk[slot] = CHD_NO_HUNK;
+        if (chd_read(img->chd, hunk, img->data[slot]) != CHDERR_NONE) {
+            cdrom_image_chd_log("CHD: Error decompressing hunk %u\n", hunk);
+            return -1;
+        }
+        img->hunk[slot] = hunk;
+    }
+
+    img->used[slot] = ++img->clock;
+
+    return slot;
+}
+
+static int
+chd_track_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    track_file_t *tf    = (track_file_t *) priv;
+    chd_track_t  *track = (chd_track_t *) tf->priv;
+    chd_image_t  *img   = track->img;
+    uint64_t      frame = seek / track->frame_size;
+    uint32_t      byte  = seek % track->frame_size;
+    uint32_t      hunk  = CHD_NO_HUNK;
+    uint64_t      pos;
+    uint32_t      len;
+    int           slot;
+    int           ret   = 1;
+
+    if ((frame + ((byte + count + track->frame_size - 1) / track->frame_size)) > track->frames)
+        return -1;
+
+    thread_wait_mutex(img->lock);
+    while (count > 0) {
+        pos  = (track->first_frame + frame) * CHD_FRAME_SIZE + byte;
+        hunk = (uint32_t) (pos / img->hunk_bytes);
+        len  = MIN(count, track->frame_size - byte);
+
+        if ((slot = chd_image_get_hunk(img, hunk)) < 0) {
+            ret = -1;
+            break;
+        }
+
+        memcpy(buffer, &img->data[slot][pos % img->hunk_bytes], len);
+
+        /* Audio is stored big endian, the subchannel is left alone. */
+        if (tf->motorola && (byte < RAW_SECTOR_SIZE))
+            cdi_swap_words(buffer, MIN(len, RAW_SECTOR_SIZE - byte));
+
+        buffer += len;
+        count -= len;
+        byte = 0;
+        frame++;
+    }
+
+    /* Keep the hunks after a sequential read coming. */
+    if ((ret > 0) && img->thread) {
+        if (((hunk == img->last_hunk) || (hunk == (img->last_hunk + 1))) && ((hunk + 1) < img->total_hunks) &&
+            (img->ahead_to != MIN(hunk + 1 + CHD_READ_AHEAD, img->total_hunks))) {
+            img->ahead_from = hunk + 1;
+            img->ahead_to   = MIN(hunk + 1 + CHD_READ_AHEAD, img->total_hunks);
+            thread_set_event(img->wake);
+        }
+        img->last_hunk = hunk;
+    }
+    thread_release_mutex(img->lock);
+
+    return ret;
+}
+
+static uint64_t
+chd_track_get_length(void *priv)
+{
+    const track_file_t *tf    = (track_file_t *) priv;
+    const chd_track_t  *track = (chd_track_t *) tf->priv;
+
+    return (uint64_t) track->frames * track->frame_size;
+}
+
+static void
+chd_track_close(void *priv)
+{
+    track_file_t *tf    = (track_file_t *) priv;
+    chd_track_t  *track = (chd_track_t *) tf->priv;
+
+    if (track != NULL) {
+        chd_image_release(track->img);
+        free(track);
+    }
+
+    memset(tf->fn, 0x00, sizeof(tf->fn));
+    free(tf);
+}
+
+void *
+chd_image_open(const char *filename)
+{
+    chd_image_t      *img = (chd_image_t *) calloc(1, sizeof(chd_image_t));
+    const chd_header *header;
+
+    if (img == NULL)
+        return NULL;
+
+    if (chd_open(filename, CHD_OPEN_READ, NULL, &img->chd) != CHDERR_NONE) {
+        cdrom_image_chd_log("CHD: Unable to open '%s'\n", filename);
+        free(img);
+        return NULL;
+    }
+
+    header           = chd_get_header(img->chd);
+    img->hunk_bytes  = header->hunkbytes;
+    img->total_hunks = header->totalhunks;
+    if ((header->unitbytes != CHD_FRAME_SIZE) || !img->hunk_bytes || (img->hunk_bytes % CHD_FRAME_SIZE)) {
+        cdrom_image_chd_log("CHD: '%s' is not a CD image\n", filename);
+        chd_close(img->chd);
+        free(img);
+        return NULL;
+    }
+
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++) {
+        img->hunk[i] = CHD_NO_HUNK;
+        img->data[i] = (uint8_t *) malloc(img->hunk_bytes);
+        if (img->data[i] == NULL) {
+            img->refs = 1;
+            chd_image_release(img);
+            return NULL;
+        }
+    }
+
+    img->refs      = 1;
+    img->last_hunk = CHD_NO_HUNK - 1;
+    img->busy      = CHD_NO_HUNK;
+    img->lock      = thread_create_mutex();
+
+    /* The read-ahead thread decompresses through a handle of its own, so
+       that it never holds the lock while doing so. */
+    img->ahead_buf = (uint8_t *) malloc(img->hunk_bytes);
+    if ((img->ahead_buf != NULL) && (chd_open(filename, CHD_OPEN_READ, NULL, &img->ahead_chd) == CHDERR_NONE)) {
+        img->wake   = thread_create_event();
+        img->done   = thread_create_event();
+        img->thread = thread_create(chd_image_thread, img);
+    }
+
+    return img;
+}
+
+int
+chd_image_get_track(void *priv, int num, chd_track_info_t *info)
+{
+    chd_image_t *img = (chd_image_t *) priv;
+    char         meta[256];
+    char         pgsub[32];
+
+    memset(info, 0x00, sizeof(chd_track_info_t));
+    memset(meta, 0x00, sizeof(meta));
+
+    if (chd_get_metadata(img->chd, CDROM_TRACK_METADATA2_TAG, num, meta, sizeof(meta) - 1, NULL, NULL, NULL) == CHDERR_NONE)
+        return sscanf(meta, "TRACK:%d TYPE:%31s SUBTYPE:%31s FRAMES:%u PREGAP:%u PGTYPE:%31s PGSUB:%31s POSTGAP:%u",
+                      &info->track, info->type, info->subtype, &info->frames, &info->pregap,
+                      info->pgtype, pgsub, &info->postgap) == 8;
+
+    if (chd_get_metadata(img->chd, CDROM_TRACK_METADATA_TAG, num, meta, sizeof(meta) - 1, NULL, NULL, NULL) == CHDERR_NONE)
+        return sscanf(meta, "TRACK:%d TYPE:%31s SUBTYPE:%31s FRAMES:%u",
+                      &info->track, info->type, info->subtype, &info->frames) == 4;
+
+    return 0;
+}
+
+track_file_t *
+chd_image_track_init(void *priv, const char *filename, uint64_t first_frame, uint32_t frames, uint32_t frame_size, int motorola)
+{
+    chd_image_t  *img   = (chd_image_t *) priv;
+    track_file_t *tf    = (track_file_t *) calloc(1, sizeof(track_file_t));
+    chd_track_t  *track = (chd_track_t *) calloc(1, sizeof(chd_track_t));
+
+    if ((tf == NULL) || (track == NULL)) {
+        free(tf);
+        free(track);
+        return NULL;
+    }
+
+    track->img         = img;
+    track->first_frame = first_frame;
+    track->frames      = frames;
+    track->frame_size  = frame_size;
+    img->refs++;
+
+    strncpy(tf->fn, filename, sizeof(tf->fn) - 1);
+    tf->priv       = track;
+    tf->motorola   = motorola;
+    tf->read       = chd_track_read;
+    tf->get_length = chd_track_get_length;
+    tf->close      = chd_track_close;
+
+    return tf;
+}
+
+void
+chd_image_release(void *priv)
+{
+    chd_image_t *img = (chd_image_t *) priv;
+
+    if (--img->refs > 0)
+        return;
+
+    if (img->thread != NULL) {
+        thread_wait_mutex(img->lock);
+        img->stop = 1;
+        thread_release_mutex(img->lock);
+        thread_set_event(img->wake);
+        thread_wait(img->thread);
+    }
+    if (img->wake != NULL)
+        thread_destroy_event(img->wake);
+    if (img->done != NULL)
+        thread_destroy_event(img->done);
+
+    if (img->ahead_chd != NULL)
+        chd_close(img->ahead_chd);
+    chd_close(img->chd);
+
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++)
+        free(img->data[i]);
+    free(img->ahead_buf);
+
+    if (img->lock != NULL)
+        thread_close_mutex(img->lock);
+
+    free(img);
+}
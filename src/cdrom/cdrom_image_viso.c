@@ -77,6 +77,14 @@ typedef struct stat stat_t;
 
 #define VISO_SECTOR_SIZE COOKED_SECTOR_SIZE
 #define VISO_OPEN_FILES  32
+#define VISO_DIR_CACHE   8
+
+/* Listings of the host directories are kept across mounts in the NVR directory. */
+#define VISO_CACHE_MAGIC   "86BoxVSO"
+#define VISO_CACHE_VERSION 1
+/* Directory timestamps only have a resolution of a second or worse, so a listing
+   read this close to the last change may have missed another one in that window. */
+#define VISO_CACHE_RACY_SECS 2
 
 enum {
     VISO_CHARSET_D = 0,
@@ -101,14 +109,18 @@ enum {
 
 typedef struct _viso_entry_ {
     union { /* save some memory */
-        uint64_t pt_offsets[4];
-        FILE    *file;
-    };
-    union {
-        char     name_short[13];
-        uint64_t dr_offsets[2];
-        uint64_t data_offset;
+        struct { /* directories */
+            uint32_t dr_sectors[2];
+            uint32_t dr_sizes[2];
+        };
+        struct { /* files */
+            uint32_t data_sector;
+            FILE    *file;
+        };
     };
+    char     name_short[13];
+    uint8_t  listed : 1; /* directory listing is complete */
+    uint8_t  racy : 1;   /* listing too recent to be cached */
     uint16_t pt_idx;
 
     stat_t stats;
@@ -119,19 +131,45 @@ typedef struct _viso_entry_ {
 } viso_entry_t;
 
 typedef struct {
-    uint64_t vol_size_offsets[2];
-    uint64_t pt_meta_offsets[2];
+    viso_entry_t *dir;
+    int           set;
+    uint8_t      *data;
+} viso_dir_cache_t;
+
+typedef struct {
     int      format;
     uint8_t  use_version_suffix : 1;
-    size_t   metadata_sectors, all_sectors, entry_map_size, sector_size, file_fifo_pos;
-    uint8_t *metadata;
-
-    track_file_t   tf;
-    viso_entry_t  *root_dir;
-    viso_entry_t **entry_map;
-    viso_entry_t  *file_fifo[VISO_OPEN_FILES];
+    size_t   head_sectors, metadata_sectors, all_sectors, sector_size, file_fifo_pos;
+    size_t   dirs_num, files_num, dir_cache_pos;
+    uint32_t pt_sectors[4], pt_sizes[4];
+    uint8_t *head, *pt_data[4];
+
+    track_file_t     tf;
+    viso_entry_t    *root_dir, *eltorito_dir, *eltorito_entry;
+    viso_entry_t   **dirs, **files;
+    viso_entry_t    *file_fifo[VISO_OPEN_FILES];
+    viso_dir_cache_t dir_cache[VISO_DIR_CACHE];
 } viso_t;
 
+/* Short filenames taken in the directory being listed. */
+typedef struct {
+    const char **slots;
+    size_t       mask;
+} viso_names_t;
+
+/* Directory stats which change whenever an entry is added, removed or renamed. */
+typedef struct {
+    uint64_t size;
+    int64_t  mtime, ctime;
+    uint32_t mode, unused;
+} viso_cache_stamp_t;
+
+typedef struct {
+    uint8_t        *data;
+    size_t          dirs_num;
+    const uint8_t **dirs; /* sorted by path */
+} viso_cache_t;
+
 static const char rr_eid[]   = "RRIP_1991A"; /* identifiers used in ER field for Rock Ridge */
 static const char rr_edesc[] = "THE ROCK RIDGE INTERCHANGE PROTOCOL PROVIDES SUPPORT FOR POSIX FILE SYSTEM SEMANTICS.";
 static int8_t     tz_offset  = 0;
@@ -154,28 +192,6 @@ cdrom_image_viso_log(const char *fmt, ...)
 #    define cdrom_image_viso_log(fmt, ...)
 #endif
 
-static size_t
-viso_pread(void *ptr, uint64_t offset, size_t size, size_t count, FILE *fp)
-{
-    uint64_t cur_pos = ftello64(fp);
-    size_t   ret     = 0;
-    if (fseeko64(fp, offset, SEEK_SET) != -1)
-        ret = fread(ptr, size, count, fp);
-    fseeko64(fp, cur_pos, SEEK_SET);
-    return ret;
-}
-
-static size_t
-viso_pwrite(const void *ptr, uint64_t offset, size_t size, size_t count, FILE *fp)
-{
-    uint64_t cur_pos = ftello64(fp);
-    size_t   ret     = 0;
-    if (fseeko64(fp, offset, SEEK_SET) != -1)
-        ret = fwrite(ptr, size, count, fp);
-    fseeko64(fp, cur_pos, SEEK_SET);
-    return ret;
-}
-
 static size_t
 viso_convert_utf8(wchar_t *dest, const char *src, ssize_t buf_size)
 {
@@ -316,8 +332,34 @@ viso_convert_utf8(wchar_t *dest, const char *src, ssize_t buf_size)
 VISO_WRITE_STR_FUNC(viso_write_string, uint8_t, char, , 0)
 VISO_WRITE_STR_FUNC(viso_write_wstring, uint16_t, wchar_t, cpu_to_be16, c > 0xffff)
 
+static uint32_t
+viso_hash(const char *str)
+{
+    uint32_t hash = 0x811c9dc5; /* FNV-1a */
+
+    while (*str)
+        hash = (hash ^ (uint8_t) *str++) * 0x01000193;
+
+    return hash;
+}
+
+static int
+viso_names_add(viso_names_t *names, const char *name) /* returns 0 if the name is already taken */
+{
+    size_t i = viso_hash(name) & names->mask;
+
+    while (names->slots[i]) {
+        if (!strcmp(names->slots[i], name))
+            return 0;
+        i = (i + 1) & names->mask;
+    }
+    names->slots[i] = name;
+
+    return 1;
+}
+
 static int
-viso_fill_fn_short(char *data, const viso_entry_t *entry, viso_entry_t **entries)
+viso_fill_fn_short(char *data, const viso_entry_t *entry, viso_names_t *names)
 {
     /* Get name and extension length. */
     const char *ext_pos = strrchr(entry->basename, '.');
@@ -352,9 +394,8 @@ viso_fill_fn_short(char *data, const viso_entry_t *entry, viso_entry_t **entries
     char tail[16];
     for (int i = force_tail; i <= 999999; i++) {
         /* Add tail to the filename if this is not the first run. */
-        int tail_len = -1;
         if (i) {
-            tail_len = sprintf(tail, "~%d", i);
+            int tail_len = sprintf(tail, "~%d", i);
             strcpy(&data[MIN(name_copy_len, 8 - tail_len)], tail);
         }
 
@@ -362,17 +403,8 @@ viso_fill_fn_short(char *data, const viso_entry_t *entry, viso_entry_t **entries
         if (ext[0])
             strcat(data, ext);
 
-        /* Go through files in this directory to make sure this filename is unique. */
-        for (size_t j = 0; entries[j] != entry; j++) {
-            /* Flag and stop if this filename was seen. */
-            if (!strcmp(data, entries[j]->name_short)) {
-                tail_len = 0;
-                break;
-            }
-        }
-
-        /* Stop if this is an unique name. */
-        if (tail_len)
+        /* Stop if this filename is unique in this directory, claiming it. */
+        if (viso_names_add(names, data))
             return 0;
     }
     return 1;
@@ -557,7 +589,8 @@ viso_fill_dir_record(uint8_t *data, viso_entry_t *entry, viso_t *viso, int type)
                 *p++ = 5; /* length */
                 *p++ = 1; /* version */
 
-                q = p++; /* save Rock Ridge flags location for later */
+                q    = p; /* save Rock Ridge flags location for later */
+                *p++ = 0;
 
 #ifndef _WIN32              /* attributes reported by MinGW don't really make sense because it's Windows */
                 *q |= 0x01; /* PX = POSIX attributes */
@@ -663,6 +696,441 @@ viso_compare_entries(const void *a, const void *b)
     return strcmp((*((viso_entry_t **) a))->name_short, (*((viso_entry_t **) b))->name_short);
 }
 
+static size_t
+viso_sectors(const viso_t *viso, uint64_t size)
+{
+    return (size + viso->sector_size - 1) / viso->sector_size;
+}
+
+static size_t
+viso_fill_path_table(viso_t *viso, int table, uint8_t *data) /* returns the table size, only fills data if not NULL */
+{
+    uint8_t  entry[264];
+    uint8_t *p;
+    uint32_t pt_temp;
+    size_t   pos    = 0;
+    int      id_len = 5 * !(viso->format & VISO_FORMAT_ISO); /* directory ID length at offset 0 for ISO, 5 for HSF */
+
+    /* Go through directories, stopping where the path table index overflowed. */
+    for (size_t i = 0; (i < viso->dirs_num) && viso->dirs[i]->pt_idx; i++) {
+        const viso_entry_t *dir = viso->dirs[i];
+
+        cdrom_image_viso_log("[%08X] %s => %s\n", dir, dir->path, ((table & 2) || (dir == viso->root_dir)) ? dir->basename : dir->name_short);
+
+        /* Fill path table entry. */
+        pt_temp = (table & 1) ? cpu_to_be32(dir->dr_sectors[table >> 1]) : cpu_to_le32(dir->dr_sectors[table >> 1]);
+        p       = entry;
+        if (!(viso->format & VISO_FORMAT_ISO)) {
+            memcpy(p, &pt_temp, 4); /* extent location */
+            p += 4;
+            *p++ = 0; /* extended attribute length */
+            p++;      /* skip ID length for now */
+        } else {
+            p++;      /* skip ID length for now */
+            *p++ = 0; /* extended attribute length */
+            memcpy(p, &pt_temp, 4); /* extent location */
+            p += 4;
+        }
+
+        *((uint16_t *) p) = (table & 1) ? cpu_to_be16(dir->parent->pt_idx) : cpu_to_le16(dir->parent->pt_idx); /* parent directory number */
+        p += 2;
+
+        if (dir == viso->root_dir) { /* directory ID length then ID for root... */
+            entry[id_len] = 1;
+            *p            = 0x00;
+        } else if (table & 2) { /* ...or Joliet... */
+            entry[id_len] = viso_fill_fn_joliet(p, dir, 255);
+        } else { /* ...or short name */
+            entry[id_len] = strlen(dir->name_short);
+            memcpy(p, dir->name_short, entry[id_len]);
+        }
+        p += entry[id_len];
+
+        if ((p - entry) & 1) /* padding for odd directory ID lengths */
+            *p++ = 0x00;
+
+        if (data)
+            memcpy(data + pos, entry, p - entry);
+        pos += p - entry;
+    }
+
+    return pos;
+}
+
+static size_t
+viso_fill_dir_records(viso_t *viso, viso_entry_t *dir, int set, uint8_t *data) /* returns the record array size, only fills data if not NULL */
+{
+    uint8_t             record[512];
+    uint8_t            *p;
+    const viso_entry_t *target;
+    size_t              pos      = 0;
+    size_t              write;
+    int                 dir_type = (!set && (dir == viso->root_dir)) ? VISO_DIR_CURRENT_ROOT : VISO_DIR_CURRENT;
+
+    /* Go through entries in this directory. */
+    for (viso_entry_t *entry = dir->first_child; entry && (entry->parent == dir); entry = entry->next) {
+        /* Skip the El Torito boot code entry if present, or hide the
+           boot code directory if no other files are present in it. */
+        if ((entry == viso->eltorito_entry) || (entry == viso->eltorito_dir))
+            continue;
+
+        cdrom_image_viso_log("[%08X] %s => %s\n", entry, dir->path,
+                             ((dir_type == VISO_DIR_PARENT) ? ".." : ((dir_type < VISO_DIR_PARENT) ? "." : (set ? entry->basename : entry->name_short))));
+
+        /* Fill directory record. */
+        viso_fill_dir_record(record, entry, viso, dir_type);
+
+        /* Entries cannot cross sector boundaries, so pad to the next sector if needed. */
+        write = viso->sector_size - (pos % viso->sector_size);
+        if (write < record[0])
+            pos += write;
+
+        /* Point the . and .. pseudo-subdirectories to this directory
+           and its parent, while advancing the current directory type. */
+        if (dir_type < VISO_DIR_PARENT) {
+            target   = dir;
+            dir_type = VISO_DIR_PARENT;
+        } else if (dir_type == VISO_DIR_PARENT) {
+            target   = dir->parent;
+            dir_type = set ? VISO_DIR_JOLIET : VISO_DIR_REGULAR;
+        } else {
+            target = entry;
+        }
+
+        if (data) {
+            /* Write the sector offset, and the size on directories. */
+            p = record + 2;
+            if (S_ISDIR(target->stats.st_mode)) {
+                VISO_LBE_32(p, target->dr_sectors[set]);
+                VISO_LBE_32(p, target->dr_sizes[set]);
+            } else {
+                VISO_LBE_32(p, target->data_sector);
+            }
+
+            memcpy(data + pos, record, record[0]);
+        }
+        pos += record[0];
+    }
+
+    return pos;
+}
+
+static const uint8_t *
+viso_get_dir_records(viso_t *viso, viso_entry_t *dir, int set)
+{
+    viso_dir_cache_t *slot;
+
+    for (int i = 0; i < VISO_DIR_CACHE; i++) {
+        if ((viso->dir_cache[i].dir == dir) && (viso->dir_cache[i].set == set))
+            return viso->dir_cache[i].data;
+    }
+
+    /* Generate this directory's record array in place of the oldest one. */
+    cdrom_image_viso_log("VISO: Generating directory record set #%d for [%s]:\n", set, dir->path);
+    slot = &viso->dir_cache[viso->dir_cache_pos++];
+    viso->dir_cache_pos &= VISO_DIR_CACHE - 1;
+    if (slot->data)
+        free(slot->data);
+    slot->dir  = NULL;
+    slot->data = (uint8_t *) calloc(viso_sectors(viso, dir->dr_sizes[set]), viso->sector_size);
+    if (!slot->data)
+        return NULL;
+    viso_fill_dir_records(viso, dir, set, slot->data);
+    slot->dir = dir;
+    slot->set = set;
+
+    return slot->data;
+}
+
+static int
+viso_read_metadata(viso_t *viso, uint8_t *buffer, size_t sector, size_t sector_offset, size_t count)
+{
+    const uint8_t *data = NULL;
+    size_t         first;
+    size_t         last;
+    size_t         mid;
+
+    /* Generate path tables on their first read. */
+    for (int i = 0; i < (sizeof(viso->pt_sectors) / sizeof(viso->pt_sectors[0])); i++) {
+        if ((sector >= viso->pt_sectors[i]) && (sector < (viso->pt_sectors[i] + viso_sectors(viso, viso->pt_sizes[i])))) {
+            if (!viso->pt_data[i]) {
+                cdrom_image_viso_log("VISO: Generating path table #%d:\n", i);
+                viso->pt_data[i] = (uint8_t *) calloc(viso_sectors(viso, viso->pt_sizes[i]), viso->sector_size);
+                if (!viso->pt_data[i])
+                    return 0;
+                viso_fill_path_table(viso, i, viso->pt_data[i]);
+            }
+            data = viso->pt_data[i] + ((sector - viso->pt_sectors[i]) * viso->sector_size);
+            break;
+        }
+    }
+
+    /* Look for the directory whose record array contains this sector. */
+    for (int i = 0; !data && viso->dirs_num && (i <= !!(viso->format & VISO_FORMAT_JOLIET)); i++) {
+        if (sector < viso->dirs[0]->dr_sectors[i])
+            continue;
+
+        first = 0;
+        last  = viso->dirs_num - 1;
+        while (first < last) {
+            mid = (first + last + 1) >> 1;
+            if (viso->dirs[mid]->dr_sectors[i] <= sector)
+                first = mid;
+            else
+                last = mid - 1;
+        }
+
+        viso_entry_t *dir = viso->dirs[first];
+        if (sector < (dir->dr_sectors[i] + viso_sectors(viso, dir->dr_sizes[i]))) {
+            if (!(data = viso_get_dir_records(viso, dir, i)))
+                return 0;
+            data += (sector - dir->dr_sectors[i]) * viso->sector_size;
+        }
+    }
+
+    /* Anything else is padding. */
+    if (data)
+        memcpy(buffer, data + sector_offset, count);
+    else
+        memset(buffer, 0x00, count);
+
+    return 1;
+}
+
+static viso_entry_t *
+viso_find_file(const viso_t *viso, size_t sector)
+{
+    size_t first = 0;
+    size_t last;
+    size_t mid;
+
+    if (!viso->files_num || (sector < viso->files[0]->data_sector))
+        return NULL;
+
+    /* Find the last file starting at or before this sector. */
+    last = viso->files_num - 1;
+    while (first < last) {
+        mid = (first + last + 1) >> 1;
+        if (viso->files[mid]->data_sector <= sector)
+            first = mid;
+        else
+            last = mid - 1;
+    }
+
+    viso_entry_t *entry = viso->files[first];
+    if (sector >= (entry->data_sector + viso_sectors(viso, entry->stats.st_size)))
+        return NULL;
+
+    return entry;
+}
+
+static void
+viso_cache_stamp(viso_cache_stamp_t *stamp, const stat_t *stats)
+{
+    memset(stamp, 0x00, sizeof(viso_cache_stamp_t));
+    stamp->size  = stats->st_size;
+    stamp->mtime = stats->st_mtime;
+    stamp->ctime = stats->st_ctime;
+    stamp->mode  = stats->st_mode;
+}
+
+static const uint8_t *
+viso_cache_skip_string(const uint8_t *p, const uint8_t *end)
+{
+    uint16_t len;
+
+    /* Strings are stored with their terminator and preceded by their length. */
+    if ((end - p) < 2)
+        return NULL;
+    memcpy(&len, p, 2);
+    p += 2;
+    if (!len || ((end - p) < len) || p[len - 1])
+        return NULL;
+
+    return p + len;
+}
+
+static void
+viso_cache_write_string(const char *str, FILE *fp)
+{
+    uint16_t len = strlen(str) + 1;
+
+    fwrite(&len, 2, 1, fp);
+    fwrite(str, len, 1, fp);
+}
+
+static int
+viso_cache_compare(const void *a, const void *b)
+{
+    return strcmp((const char *) (*((const uint8_t **) a) + 2), (const char *) (*((const uint8_t **) b) + 2));
+}
+
+static int
+viso_cache_compare_path(const void *a, const void *b)
+{
+    return strcmp((const char *) a, (const char *) (*((const uint8_t **) b) + 2));
+}
+
+static void
+viso_cache_free(viso_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    if (cache->data)
+        free(cache->data);
+    if (cache->dirs)
+        free(cache->dirs);
+    free(cache);
+}
+
+static viso_cache_t *
+viso_cache_load(viso_t *viso, const char *dirname)
+{
+    viso_cache_t  *cache = NULL;
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t       count;
+    uint32_t       children;
+    int64_t        size;
+
+    FILE *fp = plat_fopen64(nvr_path(viso->tf.fn), "rb");
+    if (!fp)
+        return NULL;
+
+    /* Read the whole cache to memory. */
+    fseeko64(fp, 0, SEEK_END);
+    size = ftello64(fp);
+    fseeko64(fp, 0, SEEK_SET);
+    if ((size < 16) || !(cache = (viso_cache_t *) calloc(1, sizeof(viso_cache_t))) || !(cache->data = (uint8_t *) malloc(size)) ||
+        (fread(cache->data, 1, size, fp) != size))
+        goto fail;
+    fclose(fp);
+    fp = NULL;
+
+    /* Check the header, including the directory this cache was made for. */
+    p   = cache->data;
+    end = p + size;
+    memcpy(&children, p + 8, 4);
+    memcpy(&count, p + 12, 4);
+    if (memcmp(p, VISO_CACHE_MAGIC, 8) || (children != VISO_CACHE_VERSION) || !(p = viso_cache_skip_string(p + 16, end)) ||
+        strcmp((const char *) (cache->data + 18), dirname) ||
+        ((count > 0) && !(cache->dirs = (const uint8_t **) malloc(count * sizeof(uint8_t *)))))
+        goto fail;
+
+    /* Index the directories, making sure they are all within bounds. */
+    while (cache->dirs_num < count) {
+        cache->dirs[cache->dirs_num++] = p;
+        if (!(p = viso_cache_skip_string(p, end)) || ((end - p) < (sizeof(viso_cache_stamp_t) + 4)))
+            goto fail;
+        memcpy(&children, p + sizeof(viso_cache_stamp_t), 4);
+        p += sizeof(viso_cache_stamp_t) + 4;
+        while (children-- > 0) {
+            if (!(p = viso_cache_skip_string(p, end)) || ((end - p) < 13) || p[12])
+                goto fail;
+            p += 13;
+        }
+    }
+    qsort(cache->dirs, cache->dirs_num, sizeof(uint8_t *), viso_cache_compare);
+
+    cdrom_image_viso_log("VISO: Loaded metadata cache with %zu directories\n", cache->dirs_num);
+    return cache;
+
+fail:
+    cdrom_image_viso_log("VISO: Ignoring invalid metadata cache\n");
+    if (fp)
+        fclose(fp);
+    viso_cache_free(cache);
+    return NULL;
+}
+
+static const uint8_t *
+viso_cache_find(const viso_cache_t *cache, const viso_entry_t *dir) /* returns the cached children, or NULL if the directory changed */
+{
+    viso_cache_stamp_t stamp;
+    viso_cache_stamp_t dir_stamp;
+    const uint8_t   **rec;
+
+    if (!cache)
+        return NULL;
+
+    rec = (const uint8_t **) bsearch(dir->path, cache->dirs, cache->dirs_num, sizeof(uint8_t *), viso_cache_compare_path);
+    if (!rec)
+        return NULL;
+
+    const uint8_t *p = *rec + 2 + strlen(dir->path) + 1;
+    memcpy(&stamp, p, sizeof(viso_cache_stamp_t));
+    viso_cache_stamp(&dir_stamp, &dir->stats);
+    if (memcmp(&stamp, &dir_stamp, sizeof(viso_cache_stamp_t)))
+        return NULL;
+
+    return p + sizeof(viso_cache_stamp_t);
+}
+
+static void
+viso_cache_save(viso_t *viso)
+{
+    viso_cache_stamp_t  stamp;
+    const viso_entry_t *dir;
+    const viso_entry_t *entry;
+    uint32_t            count = 0;
+
+    FILE *fp = plat_fopen64(nvr_path(viso->tf.fn), "wb");
+    if (!fp)
+        return;
+
+    for (dir = viso->root_dir; dir; dir = dir->next_dir)
+        count += dir->listed && !dir->racy;
+
+    /* Write header. */
+    fwrite(VISO_CACHE_MAGIC, 8, 1, fp);
+    uint32_t version = VISO_CACHE_VERSION;
+    fwrite(&version, 4, 1, fp);
+    fwrite(&count, 4, 1, fp);
+    viso_cache_write_string(viso->root_dir->path, fp);
+
+    /* Write each directory that could be listed, followed by its children other than . and ..
+       Directories changed too recently are left out, so that they are listed again next time. */
+    for (dir = viso->root_dir; dir; dir = dir->next_dir) {
+        if (!dir->listed || dir->racy)
+            continue;
+
+        viso_cache_write_string(dir->path, fp);
+        viso_cache_stamp(&stamp, &dir->stats);
+        fwrite(&stamp, sizeof(viso_cache_stamp_t), 1, fp);
+
+        count = 0;
+        for (entry = dir->first_child->next->next; entry && (entry->parent == dir); entry = entry->next)
+            count++;
+        fwrite(&count, 4, 1, fp);
+
+        for (entry = dir->first_child->next->next; entry && (entry->parent == dir); entry = entry->next) {
+            viso_cache_write_string(entry->basename, fp);
+            fwrite(entry->name_short, 13, 1, fp);
+        }
+    }
+
+    if (fclose(fp))
+        remove(nvr_path(viso->tf.fn));
+}
+
+static viso_entry_t *
+viso_new_entry(viso_entry_t *dir, const char *name)
+{
+    size_t        dir_path_len = strlen(dir->path);
+    viso_entry_t *entry        = (viso_entry_t *) calloc(1, sizeof(viso_entry_t) + dir_path_len + strlen(name) + 2);
+    if (!entry)
+        return NULL;
+
+    entry->parent = dir;
+    strcpy(entry->path, dir->path);
+    path_slash(&entry->path[dir_path_len]);
+    entry->basename = &entry->path[dir_path_len + 1];
+    strcpy(entry->basename, name);
+
+    return entry;
+}
+
 int
 viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
 {
@@ -677,15 +1145,22 @@ viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
         size_t sector_remain = MIN(count, viso->sector_size - sector_offset);
 
         /* Handle sector. */
-        if (sector < viso->metadata_sectors) {
-            /* Copy metadata. */
-            memcpy(buffer, viso->metadata + seek, sector_remain);
+        if (sector < viso->head_sectors) {
+            /* Copy volume descriptors or boot catalog. */
+            memcpy(buffer, viso->head + seek, sector_remain);
+        } else if (sector < viso->metadata_sectors) {
+            /* Copy path tables or directory records. */
+            if (!viso_read_metadata(viso, buffer, sector, sector_offset, sector_remain))
+                return -1;
         } else {
             size_t read = 0;
 
             /* Get the file entry corresponding to this sector. */
-            viso_entry_t *entry = viso->entry_map[sector - viso->metadata_sectors];
+            viso_entry_t *entry = viso_find_file(viso, sector);
             if (entry) {
+                /* Read up to the end of this file's sectors at once. */
+                sector_remain = MIN(count, ((uint64_t) (entry->data_sector + viso_sectors(viso, entry->stats.st_size)) * viso->sector_size) - seek);
+
                 /* Open file if it's not already open. */
                 if (!entry->file) {
                     /* Close any existing FIFO entry's file. */
@@ -714,7 +1189,7 @@ viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
                 }
 
                 /* Read data. */
-                if (!entry->file || (fseeko64(entry->file, seek - entry->data_offset, SEEK_SET) == -1))
+                if (!entry->file || (fseeko64(entry->file, seek - ((uint64_t) entry->data_sector * viso->sector_size), SEEK_SET) == -1))
                     return -1;
                 read = fread(buffer, 1, sector_remain, entry->file);
                 if (sector_remain && !read)
@@ -756,26 +1231,30 @@ viso_close(void *priv)
     cdrom_image_viso_log("VISO: close()\n");
 
     /* De-allocate everything. */
-    if (tf->fp)
-        fclose(tf->fp);
-#ifndef ENABLE_CDROM_IMAGE_VISO_LOG
-    remove(nvr_path(viso->tf.fn));
-#endif
-
     viso_entry_t *entry = viso->root_dir;
     viso_entry_t *next_entry;
     while (entry) {
-        if (entry->file)
+        if (!S_ISDIR(entry->stats.st_mode) && entry->file)
             fclose(entry->file);
         next_entry = entry->next;
         free(entry);
         entry = next_entry;
     }
 
-    if (viso->metadata)
-        free(viso->metadata);
-    if (viso->entry_map)
-        free(viso->entry_map);
+    if (viso->head)
+        free(viso->head);
+    for (int i = 0; i < (sizeof(viso->pt_data) / sizeof(viso->pt_data[0])); i++) {
+        if (viso->pt_data[i])
+            free(viso->pt_data[i]);
+    }
+    for (int i = 0; i < VISO_DIR_CACHE; i++) {
+        if (viso->dir_cache[i].data)
+            free(viso->dir_cache[i].data);
+    }
+    if (viso->dirs)
+        free(viso->dirs);
+    if (viso->files)
+        free(viso->files);
 
     free(viso);
 }
@@ -786,30 +1265,20 @@ viso_init(const char *dirname, int *error)
     cdrom_image_viso_log("VISO: init()\n");
 
     /* Initialize our data structure. */
-    viso_t  *viso = (viso_t *) calloc(1, sizeof(viso_t));
-    uint8_t *data = NULL;
-    uint8_t *p;
-    *error        = 1;
+    viso_t       *viso  = (viso_t *) calloc(1, sizeof(viso_t));
+    viso_cache_t *cache = NULL;
+    uint8_t      *data;
+    uint8_t      *p;
+    *error              = 1;
     if (viso == NULL)
         goto end;
     viso->sector_size        = VISO_SECTOR_SIZE;
     viso->format             = VISO_FORMAT_ISO | VISO_FORMAT_JOLIET | VISO_FORMAT_RR;
     viso->use_version_suffix = (viso->format & VISO_FORMAT_ISO); /* cleared later if required */
 
-    /* Prepare temporary data buffers. */
-    data = calloc(2, viso->sector_size);
-    if (!data)
-        goto end;
-
-        /* Open temporary file. */
-#ifdef ENABLE_CDROM_IMAGE_VISO_LOG
-    strcpy(viso->tf.fn, "viso-debug.iso");
-#else
-    plat_tempfile(viso->tf.fn, "viso", ".tmp");
-#endif
-    viso->tf.fp = plat_fopen64(nvr_path(viso->tf.fn), "w+b");
-    if (!viso->tf.fp)
-        goto end;
+    /* Load the metadata cache left by a previous mount of this directory. */
+    sprintf(viso->tf.fn, "viso-%08X.cache", viso_hash(dirname));
+    cache = viso_cache_load(viso, dirname);
 
     /* Set up directory traversal. */
     cdrom_image_viso_log("VISO: Traversing directories:\n");
@@ -817,14 +1286,17 @@ viso_init(const char *dirname, int *error)
     viso_entry_t        *last_entry;
     viso_entry_t        *dir;
     viso_entry_t        *last_dir;
-    const viso_entry_t  *eltorito_dir = NULL;
-    const viso_entry_t  *eltorito_entry = NULL;
+    viso_entry_t        *eltorito_dir   = NULL;
+    viso_entry_t        *eltorito_entry = NULL;
     struct dirent       *readdir_entry;
+    const uint8_t       *cached;
     int                  len;
     int                  eltorito_others_present = 0;
+    int                  cache_dirty             = 0;
     size_t               dir_path_len;
-    uint64_t             eltorito_offset = 0;
-    uint8_t              eltorito_type   = 0;
+    uint32_t             cached_count;
+    uint16_t             cached_len;
+    uint8_t              eltorito_type = 0;
 
     /* Fill root directory entry. */
     dir_path_len = strlen(dirname);
@@ -844,13 +1316,24 @@ viso_init(const char *dirname, int *error)
     /* Traverse directories, starting with the root. */
     viso_entry_t **dir_entries     = NULL;
     size_t         dir_entries_len = 0;
+    viso_names_t   names           = { 0 };
     while (dir) {
-        /* Open directory for listing. */
-        DIR *dirp = opendir(dir->path);
+        /* Take this directory's listing from the metadata cache if
+           it was not modified since, or open it for listing otherwise. */
+        DIR *dirp    = NULL;
+        cached_count = 0;
+        if ((cached = viso_cache_find(cache, dir))) {
+            memcpy(&cached_count, cached, 4);
+            cached += 4;
+        } else {
+            cache_dirty = 1;
+            dirp        = opendir(dir->path);
+        }
+        int listed = cached || dirp;
 
         /* Iterate through this directory's children to determine the entry array size. */
-        size_t children_count = 3; /* include terminator, . and .. */
-        if (dirp) {                /* create empty directory if opendir failed */
+        size_t children_count = 3 + cached_count; /* include terminator, . and .. */
+        if (dirp) {                               /* create empty directory if opendir failed */
             while ((readdir_entry = readdir(dirp))) {
                 /* Ignore . and .. pseudo-directories. */
                 if ((readdir_entry->d_name[0] == '.') && ((readdir_entry->d_name[1] == '\0') || (*((uint16_t *) &readdir_entry->d_name[1]) == '.')))
@@ -859,7 +1342,7 @@ viso_init(const char *dirname, int *error)
             }
         }
 
-        /* Grow array if needed. */
+        /* Grow arrays if needed. */
         if (children_count > dir_entries_len) {
             viso_entry_t **new_dir_entries = (viso_entry_t **) realloc(dir_entries, children_count * sizeof(viso_entry_t *));
             if (new_dir_entries) {
@@ -869,9 +1352,22 @@ viso_init(const char *dirname, int *error)
                 goto next_dir;
             }
         }
+        if (dirp && (children_count > ((names.mask + 1) >> 1))) {
+            size_t names_len = names.mask + 1;
+            while (names_len < (children_count << 1))
+                names_len <<= 1;
+            const char **new_slots = (const char **) realloc(names.slots, names_len * sizeof(const char *));
+            if (new_slots) {
+                names.slots = new_slots;
+                names.mask  = names_len - 1;
+            } else {
+                goto next_dir;
+            }
+        }
+        if (dirp)
+            memset(names.slots, 0x00, (names.mask + 1) * sizeof(const char *));
 
         /* Add . and .. pseudo-directories. */
-        dir_path_len = strlen(dir->path);
         for (children_count = 0; children_count < 2; children_count++) {
             entry = dir_entries[children_count] = (viso_entry_t *) calloc(1, sizeof(viso_entry_t) + 1);
             if (!entry)
@@ -880,35 +1376,63 @@ viso_init(const char *dirname, int *error)
             if (!children_count)
                 dir->first_child = entry;
 
-            /* Stat the current directory or parent directory. */
-            if (stat(children_count ? dir->parent->path : dir->path, &entry->stats) != 0) {
-                /* Use a blank structure if stat failed. */
-                memset(&entry->stats, 0x00, sizeof(stat_t));
-            }
+            /* Copy the current directory's or parent directory's stats. */
+            entry->stats = children_count ? dir->parent->stats : dir->stats;
 
             /* Set basename. */
             strcpy(entry->name_short, children_count ? ".." : ".");
+            if (dirp)
+                viso_names_add(&names, entry->name_short);
 
             cdrom_image_viso_log("[%08X] %s => %s\n", entry, dir->path, entry->name_short);
         }
 
-        /* Iterate through this directory's children again, making the entries. */
-        if (dirp) {
+        /* Make the entries for this directory's children. */
+        if (cached) {
+            while (cached_count-- > 0) {
+                /* Add and fill entry. */
+                memcpy(&cached_len, cached, 2);
+                entry = viso_new_entry(dir, (const char *) &cached[2]);
+                cached += 2 + cached_len;
+                if (!entry) {
+                    listed = 0;
+                    break;
+                }
+                memcpy(entry->name_short, cached, 13);
+                cached += 13;
+
+                /* Stat this child. Files may have been changed in place, and the stats
+                   of subdirectories tell whether their own listings are still valid. */
+                if (stat(entry->path, &entry->stats) != 0)
+                    memset(&entry->stats, 0x00, sizeof(stat_t));
+
+                /* Clamp file size to 4 GB - 1 byte. */
+                if (!S_ISDIR(entry->stats.st_mode) && (entry->stats.st_size > ((uint32_t) -1)))
+                    entry->stats.st_size = (uint32_t) -1;
+
+                dir_entries[children_count++] = entry;
+
+                cdrom_image_viso_log("[%08X] %s => [%-12s] %s (cached)\n", entry, dir->path, entry->name_short, entry->basename);
+            }
+        } else if (dirp) {
             rewinddir(dirp);
             while ((readdir_entry = readdir(dirp))) {
                 /* Ignore . and .. pseudo-directories. */
                 if ((readdir_entry->d_name[0] == '.') && ((readdir_entry->d_name[1] == '\0') || (*((uint16_t *) &readdir_entry->d_name[1]) == '.')))
                     continue;
 
+                /* Stop if this directory gained entries since they were counted. */
+                if (children_count >= (dir_entries_len - 1)) {
+                    listed = 0;
+                    break;
+                }
+
                 /* Add and fill entry. */
-                entry = dir_entries[children_count++] = (viso_entry_t *) calloc(1, sizeof(viso_entry_t) + dir_path_len + strlen(readdir_entry->d_name) + 2);
-                if (!entry)
+                entry = dir_entries[children_count] = viso_new_entry(dir, readdir_entry->d_name);
+                if (!entry) {
+                    listed = 0;
                     break;
-                entry->parent = dir;
-                strcpy(entry->path, dir->path);
-                path_slash(&entry->path[dir_path_len]);
-                entry->basename = &entry->path[dir_path_len + 1];
-                strcpy(entry->basename, readdir_entry->d_name);
+                }
 
                 /* Stat this child. */
                 if (stat(entry->path, &entry->stats) != 0) {
@@ -916,61 +1440,16 @@ viso_init(const char *dirname, int *error)
                     memset(&entry->stats, 0x00, sizeof(stat_t));
                 }
 
-                /* Handle file size and El Torito boot code. */
-                if (!S_ISDIR(entry->stats.st_mode)) {
-                    /* Clamp file size to 4 GB - 1 byte. */
-                    if (entry->stats.st_size > ((uint32_t) -1))
-                        entry->stats.st_size = (uint32_t) -1;
-
-                    /* Increase entry map size. */
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
-
-                    /* Detect El Torito boot code file and set it accordingly. */
-                    if (dir == eltorito_dir) {
-                        if (!stricmp(readdir_entry->d_name, "Boot-NoEmul.img")) {
-                            eltorito_type = 0x00;
-have_eltorito_entry:
-                            if (eltorito_entry)
-                                eltorito_others_present = 1; /* flag that the boot code directory contains other files */
-                            eltorito_entry = entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-1.2M.img")) {
-                            eltorito_type = 0x01;
-                            goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-1.44M.img")) {
-                            eltorito_type = 0x02;
-                            goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-2.88M.img")) {
-                            eltorito_type = 0x03;
-                            goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-HardDisk.img")) {
-                            eltorito_type = 0x04;
-                            goto have_eltorito_entry;
-                        } else {
-                            eltorito_others_present = 1; /* flag that the boot code directory contains other files */
-                        }
-                    } else {
-                        /* Disable version suffixes if this structure appears to contain the Windows NT
-                           El Torito boot code, which is known not to tolerate suffixed file names. */
-                        if (eltorito_dir &&                                  /* El Torito directory present? */
-                            (eltorito_type == 0x00) &&                       /* El Torito directory not checked yet, or confirmed to contain non-emulation boot code? */
-                            (dir->parent == viso->root_dir) &&               /* one subdirectory deep? (I386 for instance) */
-                            !stricmp(readdir_entry->d_name, "SETUPLDR.BIN")) /* SETUPLDR.BIN present? */
-                            viso->use_version_suffix = 0;
-                    }
-                } else if ((dir == viso->root_dir) && !stricmp(readdir_entry->d_name, "[BOOT]")) {
-                    /* Set this as the directory containing El Torito boot code. */
-                    eltorito_dir            = entry;
-                    eltorito_others_present = 0;
-                }
+                /* Clamp file size to 4 GB - 1 byte. */
+                if (!S_ISDIR(entry->stats.st_mode) && (entry->stats.st_size > ((uint32_t) -1)))
+                    entry->stats.st_size = (uint32_t) -1;
 
                 /* Set short filename. */
-                if (viso_fill_fn_short(entry->name_short, entry, dir_entries)) {
+                if (viso_fill_fn_short(entry->name_short, entry, &names)) {
                     free(entry);
-                    children_count--;
                     continue;
                 }
+                children_count++;
 
                 cdrom_image_viso_log("[%08X] %s => [%-12s] %s\n", entry, dir->path, entry->name_short, entry->basename);
             }
@@ -994,6 +1473,11 @@ have_eltorito_entry:
                 last_dir           = dir_entries[i];
             }
         }
+        dir->listed = listed;
+        if (dirp) {
+            time_t now = time(NULL);
+            dir->racy  = (dir->stats.st_mtime >= (now - VISO_CACHE_RACY_SECS)) || (dir->stats.st_ctime >= (now - VISO_CACHE_RACY_SECS));
+        }
 
 next_dir:
         /* Move on to the next directory. */
@@ -1003,10 +1487,146 @@ next_dir:
     }
     if (dir_entries)
         free(dir_entries);
+    if (names.slots)
+        free(names.slots);
+
+    /* Save the listings for the next mount if anything had to be listed again. */
+    viso_cache_free(cache);
+    cache = NULL;
+    if (cache_dirty)
+        viso_cache_save(viso);
+
+    /* Go through files to find the El Torito boot code. */
+    for (entry = viso->root_dir->next; entry; entry = entry->next) {
+        if (!entry->basename) /* skip . and .. */
+            continue;
+        dir = entry->parent;
 
-    /* Write 16 blank sectors. */
-    for (int i = 0; i < 16; i++)
-        fwrite(data, viso->sector_size, 1, viso->tf.fp);
+        if (!S_ISDIR(entry->stats.st_mode)) {
+            /* Detect El Torito boot code file and set it accordingly. */
+            if (dir == eltorito_dir) {
+                if (!stricmp(entry->basename, "Boot-NoEmul.img")) {
+                    eltorito_type = 0x00;
+have_eltorito_entry:
+                    if (eltorito_entry)
+                        eltorito_others_present = 1; /* flag that the boot code directory contains other files */
+                    eltorito_entry = entry;
+                } else if (!stricmp(entry->basename, "Boot-1.2M.img")) {
+                    eltorito_type = 0x01;
+                    goto have_eltorito_entry;
+                } else if (!stricmp(entry->basename, "Boot-1.44M.img")) {
+                    eltorito_type = 0x02;
+                    goto have_eltorito_entry;
+                } else if (!stricmp(entry->basename, "Boot-2.88M.img")) {
+                    eltorito_type = 0x03;
+                    goto have_eltorito_entry;
+                } else if (!stricmp(entry->basename, "Boot-HardDisk.img")) {
+                    eltorito_type = 0x04;
+                    goto have_eltorito_entry;
+                } else {
+                    eltorito_others_present = 1; /* flag that the boot code directory contains other files */
+                }
+            } else {
+                /* Disable version suffixes if this structure appears to contain the Windows NT
+                   El Torito boot code, which is known not to tolerate suffixed file names. */
+                if (eltorito_dir &&                            /* El Torito directory present? */
+                    (eltorito_type == 0x00) &&                 /* El Torito directory not checked yet, or confirmed to contain non-emulation boot code? */
+                    (dir->parent == viso->root_dir) &&         /* one subdirectory deep? (I386 for instance) */
+                    !stricmp(entry->basename, "SETUPLDR.BIN")) /* SETUPLDR.BIN present? */
+                    viso->use_version_suffix = 0;
+            }
+        } else if ((dir == viso->root_dir) && !stricmp(entry->basename, "[BOOT]")) {
+            /* Set this as the directory containing El Torito boot code. */
+            eltorito_dir            = entry;
+            eltorito_others_present = 0;
+        }
+    }
+
+    /* Flag that we shouldn't hide the boot code directory if it contains other files. */
+    if (eltorito_entry && eltorito_others_present)
+        eltorito_dir = NULL;
+    viso->eltorito_dir   = eltorito_dir;
+    viso->eltorito_entry = eltorito_entry;
+
+    /* Collect the directories and files for sector lookups. */
+    for (dir = viso->root_dir; dir; dir = dir->next_dir)
+        viso->dirs_num += (dir != eltorito_dir);
+    for (entry = viso->root_dir->next; entry; entry = entry->next)
+        viso->files_num += (entry->basename && !S_ISDIR(entry->stats.st_mode));
+    viso->dirs  = (viso_entry_t **) malloc(viso->dirs_num * sizeof(viso_entry_t *));
+    viso->files = (viso_entry_t **) malloc(MAX(viso->files_num, 1) * sizeof(viso_entry_t *));
+    if (!viso->dirs || !viso->files)
+        goto end;
+    viso->dirs_num  = 0;
+    viso->files_num = 0;
+    for (dir = viso->root_dir; dir; dir = dir->next_dir) {
+        if (dir != eltorito_dir)
+            viso->dirs[viso->dirs_num++] = dir;
+    }
+
+    /* Determine whether or not we're working with 2 volume descriptors
+       (as well as 2 directory trees and 4 path tables) for Joliet. */
+    int max_vd = (viso->format & VISO_FORMAT_JOLIET) ? 1 : 0;
+
+    /* The system area, volume descriptors and El Torito boot catalog are kept
+       in memory. We start seeing a pattern of padding to even sectors here.
+       mkisofs does this, presumably for a very good reason... */
+    size_t eltorito_sector = (16 + 1 + !!eltorito_entry + max_vd + 1 + 1) & ~1;
+    viso->head_sectors     = eltorito_sector + (eltorito_entry ? 2 : 0);
+
+    /* Lay out the path tables, directory records and file data. Only their
+       locations and sizes are worked out here; path tables and directory
+       records are generated when the guest reads them. */
+    cdrom_image_viso_log("VISO: Laying out metadata:\n");
+    size_t   sector = viso->head_sectors;
+    uint16_t pt_idx = 1;
+    for (size_t i = 0; i < viso->dirs_num; i++) {
+        viso->dirs[i]->pt_idx = pt_idx;
+
+        /* Stop if the path table index overflows. */
+        if (++pt_idx == 0)
+            break;
+    }
+    for (int i = 0; i <= ((max_vd << 1) | 1); i++) {
+        viso->pt_sectors[i] = sector;
+        viso->pt_sizes[i]   = viso_fill_path_table(viso, i, NULL);
+        sector += (viso_sectors(viso, viso->pt_sizes[i]) + 1) & ~1;
+    }
+    for (int i = 0; i <= max_vd; i++) {
+        for (size_t j = 0; j < viso->dirs_num; j++) {
+            dir                = viso->dirs[j];
+            dir->dr_sectors[i] = sector;
+            dir->dr_sizes[i]   = viso_fill_dir_records(viso, dir, i, NULL);
+            sector += viso_sectors(viso, dir->dr_sizes[i]);
+        }
+        sector = (sector + 1) & ~1;
+    }
+    viso->metadata_sectors = sector;
+
+    /* Go through files, assigning sectors to them. */
+    cdrom_image_viso_log("VISO: Assigning sectors to files:\n");
+    for (entry = viso->root_dir->next; entry; entry = entry->next) {
+        /* Skip this entry if it corresponds to a directory. */
+        if (!entry->basename || S_ISDIR(entry->stats.st_mode))
+            continue;
+
+        /* Determine how many sectors this file will take. */
+        size_t size = viso_sectors(viso, entry->stats.st_size);
+        cdrom_image_viso_log("[%08X] %s => %zu + %zu sectors\n", entry, entry->path, sector, size);
+
+        /* Allocate sectors to this file. */
+        entry->data_sector = sector;
+        if (size)
+            viso->files[viso->files_num++] = entry;
+        sector += size;
+    }
+    viso->all_sectors = sector;
+
+    /* Prepare the system area, volume descriptors and boot catalog. */
+    viso->head = (uint8_t *) calloc(viso->head_sectors, viso->sector_size);
+    if (!viso->head)
+        goto end;
+    data = viso->head + (16 * viso->sector_size);
 
     /* Get current time for the volume descriptors, and calculate
        the timezone offset for descriptors and file times to use. */
@@ -1020,16 +1640,12 @@ next_dir:
     if (!basename || (basename[0] == '\0'))
         basename = EMU_NAME;
 
-    /* Determine whether or not we're working with 2 volume descriptors
-       (as well as 2 directory trees and 4 path tables) for Joliet. */
-    int max_vd = (viso->format & VISO_FORMAT_JOLIET) ? 1 : 0;
-
     /* Write volume descriptors. */
     for (int i = 0; i <= max_vd; i++) {
         /* Fill volume descriptor. */
         p = data;
         if (!(viso->format & VISO_FORMAT_ISO))
-            VISO_LBE_32(p, ftello64(viso->tf.fp) / viso->sector_size);    /* sector offset (HSF only) */
+            VISO_LBE_32(p, (data - viso->head) / viso->sector_size);      /* sector offset (HSF only) */
         *p++ = 1 + i;                                                       /* type */
         memcpy(p, (viso->format & VISO_FORMAT_ISO) ? "CD001" : "CDROM", 5); /* standard ID */
         p += 5;
@@ -1052,8 +1668,7 @@ next_dir:
 
         VISO_SKIP(p, 8); /* unused */
 
-        viso->vol_size_offsets[i] = ftello64(viso->tf.fp) + (p - data);
-        VISO_LBE_32(p, 0); /* volume space size (filled in later) */
+        VISO_LBE_32(p, viso->all_sectors); /* volume space size */
 
         if (i) {
             *p++ = 0x25; /* escape sequence (indicates our Joliet names are UCS-2 Level 3) */
@@ -1068,12 +1683,18 @@ next_dir:
         VISO_LBE_16(p, 1);                 /* volume sequence number */
         VISO_LBE_16(p, viso->sector_size); /* logical block size */
 
-        /* Path table metadata is filled in later. */
-        viso->pt_meta_offsets[i] = ftello64(viso->tf.fp) + (p - data);
-        VISO_SKIP(p, 24 + (16 * !(viso->format & VISO_FORMAT_ISO))); /* PT size, LE PT offset, optional LE PT offset (three on HSF), BE PT offset, optional BE PT offset (three on HSF) */
+        /* PT size, LE PT offset, optional LE PT offset (three on HSF), BE PT offset, optional BE PT offset (three on HSF) */
+        uint8_t *q = p;
+        VISO_SKIP(p, 24 + (16 * !(viso->format & VISO_FORMAT_ISO)));
+        VISO_LBE_32(q, viso->pt_sizes[i << 1]);
+        *((uint32_t *) q)       = cpu_to_le32(viso->pt_sectors[i << 1]);
+        *((uint32_t *) (q + 8)) = cpu_to_be32(viso->pt_sectors[(i << 1) | 1]);
 
-        viso->root_dir->dr_offsets[i] = ftello64(viso->tf.fp) + (p - data);
+        q = p;
         p += viso_fill_dir_record(p, viso->root_dir, viso, VISO_DIR_CURRENT); /* root directory */
+        q += 2;
+        VISO_LBE_32(q, viso->root_dir->dr_sectors[i]);
+        VISO_LBE_32(q, viso->root_dir->dr_sizes[i]);
 
         int copyright_abstract_len = (viso->format & VISO_FORMAT_ISO) ? 37 : 32;
         if (i) {
@@ -1120,11 +1741,8 @@ next_dir:
         *p++ = 1; /* file structure version */
         *p++ = 0; /* unused */
 
-        /* Blank the rest of the working sector. */
-        memset(p, 0x00, viso->sector_size - (p - data));
-
-        /* Write volume descriptor. */
-        fwrite(data, viso->sector_size, 1, viso->tf.fp);
+        /* Move on to the next sector; the rest of this one is already blank. */
+        data += viso->sector_size;
 
         /* Write El Torito boot descriptor. This is an awkward spot for
            that, but the spec requires it to be the second descriptor. */
@@ -1133,7 +1751,7 @@ next_dir:
 
             p = data;
             if (!(viso->format & VISO_FORMAT_ISO))
-                VISO_LBE_32(p, ftello64(viso->tf.fp) / viso->sector_size);    /* sector offset (HSF only) */
+                VISO_LBE_32(p, (data - viso->head) / viso->sector_size);      /* sector offset (HSF only) */
             *p++ = 0;                                                           /* type */
             memcpy(p, (viso->format & VISO_FORMAT_ISO) ? "CD001" : "CDROM", 5); /* standard ID */
             p += 5;
@@ -1143,53 +1761,29 @@ next_dir:
             p += 24;
             VISO_SKIP(p, 40);
 
-            /* Save the boot catalog pointer's offset for later. */
-            eltorito_offset = ftello64(viso->tf.fp) + (p - data);
+            *((uint32_t *) p) = cpu_to_le32(eltorito_sector); /* boot catalog pointer */
 
-            /* Blank the rest of the working sector. */
-            memset(p, 0x00, viso->sector_size - (p - data));
-
-            /* Write boot descriptor. */
-            fwrite(data, viso->sector_size, 1, viso->tf.fp);
+            data += viso->sector_size;
         }
     }
 
     /* Fill terminator. */
     p = data;
     if (!(viso->format & VISO_FORMAT_ISO))
-        VISO_LBE_32(p, ftello64(viso->tf.fp) / viso->sector_size);    /* sector offset (HSF only) */
+        VISO_LBE_32(p, (data - viso->head) / viso->sector_size);      /* sector offset (HSF only) */
     *p++ = 0xff;                                                        /* type */
     memcpy(p, (viso->format & VISO_FORMAT_ISO) ? "CD001" : "CDROM", 5); /* standard ID */
     p += 5;
     *p++ = 1; /* version */
 
-    /* Blank the rest of the working sector. */
-    memset(p, 0x00, viso->sector_size - (p - data));
-
-    /* Write terminator. */
-    fwrite(data, viso->sector_size, 1, viso->tf.fp);
-
-    /* We start seeing a pattern of padding to even sectors here.
-       mkisofs does this, presumably for a very good reason... */
-    int write = ftello64(viso->tf.fp) % (viso->sector_size * 2);
-    if (write) {
-        write = (viso->sector_size * 2) - write;
-        memset(data, 0x00, write);
-        fwrite(data, write, 1, viso->tf.fp);
-    }
-
     /* Handle El Torito boot catalog. */
     if (eltorito_entry) {
-        /* Write a pointer to this boot catalog to the boot descriptor. */
-        *((uint32_t *) data) = cpu_to_le32(ftello64(viso->tf.fp) / viso->sector_size);
-        viso_pwrite(data, eltorito_offset, 4, 1, viso->tf.fp);
-
         /* Fill boot catalog validation entry. */
-        p    = data;
-        *p++ = 0x01; /* header ID */
-        *p++ = 0x00; /* platform */
-        *p++ = 0x00; /* reserved */
-        *p++ = 0x00;
+        data = p = viso->head + (eltorito_sector * viso->sector_size);
+        *p++     = 0x01; /* header ID */
+        *p++     = 0x00; /* platform */
+        *p++     = 0x00; /* reserved */
+        *p++     = 0x00;
         VISO_SKIP(p, 24);
         strncpy((char *) (p - 24), EMU_NAME, 24); /* ID string */
         *p++ = 0x00;                              /* checksum */
@@ -1211,369 +1805,39 @@ next_dir:
         *p++ = 0x00; /* system type (is this even relevant?) */
         *p++ = 0x00; /* reserved */
 
-        /* Save offsets to the boot catalog entry's offset and size fields for later. */
-        eltorito_offset = ftello64(viso->tf.fp) + (p - data);
-
-        /* Blank the rest of the working sector. This includes the sector count,
-           ISO sector offset and 20-byte selection criteria fields at the end. */
-        memset(p, 0x00, viso->sector_size - (p - data));
-
-        /* Write boot catalog. */
-        fwrite(data, viso->sector_size, 1, viso->tf.fp);
-
-        /* Pad to the next even sector. */
-        write = ftello64(viso->tf.fp) % (viso->sector_size * 2);
-        if (write) {
-            write = (viso->sector_size * 2) - write;
-            memset(data, 0x00, write);
-            fwrite(data, write, 1, viso->tf.fp);
+        /* Load the entire file if not emulating, or just the first virtual
+           sector (which usually contains all the boot code) if emulating. */
+        if (eltorito_type == 0x00) { /* non-emulation */
+            uint32_t boot_size = eltorito_entry->stats.st_size;
+            if (boot_size % 512) /* round up */
+                boot_size += 512 - (boot_size % 512);
+            *((uint16_t *) &p[0]) = cpu_to_le16(boot_size / 512);
+        } else { /* emulation */
+            *((uint16_t *) &p[0]) = cpu_to_le16(1);
         }
+        *((uint32_t *) &p[2]) = cpu_to_le32(eltorito_entry->data_sector);
 
-        /* Flag that we shouldn't hide the boot code directory if it contains other files. */
-        if (eltorito_others_present)
-            eltorito_dir = NULL;
+        /* The rest of the sector, including the 20-byte
+           selection criteria fields at the end, is blank. */
     }
 
-    /* Write each path table. */
-    for (int i = 0; i <= ((max_vd << 1) | 1); i++) {
-        cdrom_image_viso_log("VISO: Generating path table #%d:\n", i);
-
-        /* Save this path table's start offset. */
-        uint64_t pt_start = ftello64(viso->tf.fp);
-
-        /* Write this table's sector offset to the corresponding volume descriptor. */
-        uint32_t pt_temp     = pt_start / viso->sector_size;
-        *((uint32_t *) data) = (i & 1) ? cpu_to_be32(pt_temp) : cpu_to_le32(pt_temp);
-        viso_pwrite(data, viso->pt_meta_offsets[i >> 1] + 8 + (8 * (i & 1)), 4, 1, viso->tf.fp);
-
-        /* Go through directories. */
-        dir             = viso->root_dir;
-        uint16_t pt_idx = 1;
-        while (dir) {
-            /* Ignore . and .. pseudo-directories, and hide the El Torito
-               boot code directory if no other files are present in it. */
-            if ((dir->name_short[0] == '.' && (dir->name_short[1] == '\0' || (dir->name_short[1] == '.' && dir->name_short[2] == '\0'))) || (dir == eltorito_dir)) {
-                dir = dir->next_dir;
-                continue;
-            }
-
-            cdrom_image_viso_log("[%08X] %s => %s\n", dir, dir->path, ((i & 2) || (dir == viso->root_dir)) ? dir->basename : dir->name_short);
-
-            /* Save this directory's path table index and offset. */
-            dir->pt_idx        = pt_idx;
-            dir->pt_offsets[i] = ftello64(viso->tf.fp);
-
-            /* Fill path table entry. */
-            p = data;
-            if (!(viso->format & VISO_FORMAT_ISO)) {
-                *((uint32_t *) p) = 0; /* extent location (filled in later) */
-                p += 4;
-                *p++ = 0; /* extended attribute length */
-                p++;      /* skip ID length for now */
-            } else {
-                p++;      /* skip ID length for now */
-                *p++ = 0; /* extended attribute length */
-                dir->pt_offsets[i] += p - data;
-                *((uint32_t *) p) = 0; /* extent location (filled in later) */
-                p += 4;
-            }
-
-            *((uint16_t *) p) = (i & 1) ? cpu_to_be16(dir->parent->pt_idx) : cpu_to_le16(dir->parent->pt_idx); /* parent directory number */
-            p += 2;
-
-            pt_temp = 5 * !(viso->format & VISO_FORMAT_ISO); /* directory ID length at offset 0 for ISO, 5 for HSF */
-            if (dir == viso->root_dir) {                     /* directory ID length then ID for root... */
-                data[pt_temp] = 1;
-                *p            = 0x00;
-            } else if (i & 2) { /* ...or Joliet... */
-                data[pt_temp] = viso_fill_fn_joliet(p, dir, 255);
-            } else { /* ...or short name */
-                data[pt_temp] = strlen(dir->name_short);
-                memcpy(p, dir->name_short, data[pt_temp]);
-            }
-            p += data[pt_temp];
-
-            if ((p - data) & 1) /* padding for odd directory ID lengths */
-                *p++ = 0x00;
-
-            /* Write path table entry. */
-            fwrite(data, p - data, 1, viso->tf.fp);
-
-            /* Increment path table index and stop if it overflows. */
-            if (++pt_idx == 0)
-                break;
-
-            /* Move on to the next directory. */
-            dir = dir->next_dir;
-        }
-
-        /* Write this table's size to the corresponding volume descriptor. */
-        pt_temp = ftello64(viso->tf.fp) - pt_start;
-        p       = data;
-        VISO_LBE_32(p, pt_temp);
-        viso_pwrite(data, viso->pt_meta_offsets[i >> 1], 8, 1, viso->tf.fp);
-
-        /* Pad to the next even sector. */
-        write = ftello64(viso->tf.fp) % (viso->sector_size * 2);
-        if (write) {
-            write = (viso->sector_size * 2) - write;
-            memset(data, 0x00, write);
-            fwrite(data, write, 1, viso->tf.fp);
-        }
-    }
-
-    /* Write directory records for each type. */
-    int dir_type = VISO_DIR_CURRENT_ROOT;
-    for (int i = 0; i <= max_vd; i++) {
-        cdrom_image_viso_log("VISO: Generating directory record set #%d:\n", i);
-
-        /* Go through directories. */
-        dir = viso->root_dir;
-        while (dir) {
-            /* Hide the El Torito boot code directory if no other files are present in it. */
-            if (dir == eltorito_dir) {
-                dir = dir->next_dir;
-                continue;
-            }
-
-            /* Pad to the next sector if required. */
-            write = ftello64(viso->tf.fp) % viso->sector_size;
-            if (write) {
-                write = viso->sector_size - write;
-                memset(data, 0x00, write);
-                fwrite(data, write, 1, viso->tf.fp);
-            }
-
-            /* Save this directory's child record array's start offset. */
-            uint64_t dir_start = ftello64(viso->tf.fp);
-
-            /* Write this directory's child record array's sector offset to its record... */
-            uint32_t dir_temp = dir_start / viso->sector_size;
-            p                 = data;
-            VISO_LBE_32(p, dir_temp);
-            viso_pwrite(data, dir->dr_offsets[i] + 2, 8, 1, viso->tf.fp);
-
-            /* ...and to its path table entries. */
-            viso_pwrite(data, dir->pt_offsets[i << 1], 4, 1, viso->tf.fp);           /* little endian */
-            viso_pwrite(data + 4, dir->pt_offsets[(i << 1) | 1], 4, 1, viso->tf.fp); /* big endian */
-
-            if (i == max_vd) /* overwrite pt_offsets in the union if we no longer need them */
-                dir->file = NULL;
-
-            /* Go through entries in this directory. */
-            entry = dir->first_child;
-            while (entry) {
-                /* Skip the El Torito boot code entry if present, or hide the
-                   boot code directory if no other files are present in it. */
-                if ((entry == eltorito_entry) || (entry == eltorito_dir))
-                    goto next_entry;
-
-                cdrom_image_viso_log("[%08X] %s => %s\n", entry, dir->path,
-                                     ((dir_type == VISO_DIR_PARENT) ? ".." : ((dir_type < VISO_DIR_PARENT) ? "." : (i ? entry->basename : entry->name_short))));
-
-                /* Fill directory record. */
-                viso_fill_dir_record(data, entry, viso, dir_type);
-
-                /* Entries cannot cross sector boundaries, so pad to the next sector if needed. */
-                write = viso->sector_size - (ftello64(viso->tf.fp) % viso->sector_size);
-                if (write < data[0]) {
-                    p = data + (viso->sector_size * 2) - write;
-                    memset(p, 0x00, write);
-                    fwrite(p, write, 1, viso->tf.fp);
-                }
-
-                /* Save this entry's record's offset. This overwrites name_short in the union. */
-                entry->dr_offsets[i] = ftello64(viso->tf.fp);
-
-                /* Write data related to the . and .. pseudo-subdirectories,
-                   while advancing the current directory type. */
-                if (dir_type < VISO_DIR_PARENT) {
-                    /* Write a self-referential pointer to this entry. */
-                    p = data + 2;
-                    VISO_LBE_32(p, dir_temp);
-
-                    dir_type = VISO_DIR_PARENT;
-                } else if (dir_type == VISO_DIR_PARENT) {
-                    /* Copy the parent directory's offset and size. The root directory's
-                       parent size is a special, self-referential case handled later. */
-                    viso_pread(data + 2, dir->parent->dr_offsets[i] + 2, 16, 1, viso->tf.fp);
-
-                    dir_type = i ? VISO_DIR_JOLIET : VISO_DIR_REGULAR;
-                }
-
-                /* Write entry. */
-                fwrite(data, data[0], 1, viso->tf.fp);
-next_entry:
-                /* Move on to the next entry, and stop if the end of this directory was reached. */
-                entry = entry->next;
-                if (entry && (entry->parent != dir))
-                    break;
-            }
-
-            /* Write this directory's child record array's size to its parent and . records. */
-            dir_temp = ftello64(viso->tf.fp) - dir_start;
-            p        = data;
-            VISO_LBE_32(p, dir_temp);
-            viso_pwrite(data, dir->dr_offsets[i] + 10, 8, 1, viso->tf.fp);
-            viso_pwrite(data, dir->first_child->dr_offsets[i] + 10, 8, 1, viso->tf.fp);
-            if (dir->parent == dir) /* write size to .. on root directory as well */
-                viso_pwrite(data, dir->first_child->next->dr_offsets[i] + 10, 8, 1, viso->tf.fp);
-
-            /* Move on to the next directory. */
-            dir_type = VISO_DIR_CURRENT;
-            dir      = dir->next_dir;
-        }
-
-        /* Pad to the next even sector. */
-        write = ftello64(viso->tf.fp) % (viso->sector_size * 2);
-        if (write) {
-            write = (viso->sector_size * 2) - write;
-            memset(data, 0x00, write);
-            fwrite(data, write, 1, viso->tf.fp);
-        }
-    }
-
-    /* Allocate entry map for sector->file lookups. */
-    size_t orig_sector_size = viso->sector_size;
-    while (1) {
-        cdrom_image_viso_log("VISO: Allocating entry map for %zu %zu-byte sectors\n", viso->entry_map_size, viso->sector_size);
-        viso->entry_map = (viso_entry_t **) calloc(viso->entry_map_size, sizeof(viso_entry_t *));
-        if (viso->entry_map) {
-            /* Successfully allocated. */
-            break;
-        } else {
-            /* Blank data buffer for padding if this is the first run. */
-            if (orig_sector_size == viso->sector_size)
-                memset(data, 0x00, orig_sector_size);
-
-            /* If we don't have enough memory, double the sector size. */
-            viso->sector_size *= 2;
-            if ((viso->sector_size < VISO_SECTOR_SIZE) || (viso->sector_size > (1 << 30))) /* give up if sectors become too large */
-                goto end;
-
-            /* Go through files, recalculating the entry map size. */
-            size_t orig_entry_map_size = viso->entry_map_size;
-            viso->entry_map_size       = 0;
-            entry                      = viso->root_dir;
-            while (entry) {
-                if (!S_ISDIR(entry->stats.st_mode)) {
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
-                }
-                entry = entry->next;
-            }
-            if (viso->entry_map_size == orig_entry_map_size) /* give up if there was no change in map size */
-                goto end;
-
-            /* Pad metadata to the new size's next sector. */
-            while (ftello64(viso->tf.fp) % viso->sector_size)
-                fwrite(data, orig_sector_size, 1, viso->tf.fp);
-        }
-    }
-
-    /* Start sector counts. */
-    viso->metadata_sectors = ftello64(viso->tf.fp) / viso->sector_size;
-    viso->all_sectors      = viso->metadata_sectors;
-
-    /* Go through files, assigning sectors to them. */
-    cdrom_image_viso_log("VISO: Assigning sectors to files:\n");
-    size_t        base_factor  = viso->sector_size / orig_sector_size;
-    viso_entry_t *prev_entry   = viso->root_dir;
-    viso_entry_t **entry_map_p = viso->entry_map;
-    entry                      = prev_entry->next;
-    while (entry) {
-        /* Skip this entry if it corresponds to a directory. */
-        if (S_ISDIR(entry->stats.st_mode)) {
-            /* Deallocate directory entries to save some memory. */
-            prev_entry->next = entry->next;
-            free(entry);
-            entry = prev_entry->next;
-            continue;
-        }
-
-        /* Write this file's base sector offset to its directory
-           entries, unless this is the El Torito boot code entry,
-           in which case, write offset and size to the boot entry. */
-        if (entry == eltorito_entry) {
-            /* Load the entire file if not emulating, or just the first virtual
-               sector (which usually contains all the boot code) if emulating. */
-            if (eltorito_type == 0x00) { /* non-emulation */
-                uint32_t boot_size = entry->stats.st_size;
-                if (boot_size % 512) /* round up */
-                    boot_size += 512 - (boot_size % 512);
-                *((uint16_t *) &data[0]) = cpu_to_le16(boot_size / 512);
-            } else { /* emulation */
-                *((uint16_t *) &data[0]) = cpu_to_le16(1);
-            }
-            *((uint32_t *) &data[2]) = cpu_to_le32(viso->all_sectors * base_factor);
-            viso_pwrite(data, eltorito_offset, 6, 1, viso->tf.fp);
-        } else {
-            p = data;
-            VISO_LBE_32(p, viso->all_sectors * base_factor);
-            for (int i = 0; i <= max_vd; i++)
-                viso_pwrite(data, entry->dr_offsets[i] + 2, 8, 1, viso->tf.fp);
-        }
-
-        /* Save this file's base offset. This overwrites dr_offsets in the union. */
-        entry->data_offset = ((uint64_t) viso->all_sectors) * viso->sector_size;
-
-        /* Determine how many sectors this file will take. */
-        size_t size = entry->stats.st_size / viso->sector_size;
-        if (entry->stats.st_size % viso->sector_size)
-            size++; /* round up to the next sector */
-        cdrom_image_viso_log("[%08X] %s => %zu + %zu sectors\n", entry, entry->path, viso->all_sectors, size);
-
-        /* Allocate sectors to this file. */
-        viso->all_sectors += size;
-        while (size-- > 0)
-            *entry_map_p++ = entry;
-
-        /* Move on to the next entry. */
-        prev_entry = entry;
-        entry      = entry->next;
-    }
-
-    /* Write final volume size to all volume descriptors. */
-    p = data;
-    VISO_LBE_32(p, viso->all_sectors);
-    for (int i = 0; i < (sizeof(viso->vol_size_offsets) / sizeof(viso->vol_size_offsets[0])); i++)
-        viso_pwrite(data, viso->vol_size_offsets[i], 8, 1, viso->tf.fp);
-
-    /* Metadata processing is finished, read it back to memory. */
-    cdrom_image_viso_log("VISO: Reading back %zu %zu-byte sectors of metadata\n", viso->metadata_sectors, viso->sector_size);
-    viso->metadata = (uint8_t *) calloc(viso->metadata_sectors, viso->sector_size);
-    if (!viso->metadata)
-        goto end;
-    fseeko64(viso->tf.fp, 0, SEEK_SET);
-    size_t metadata_size = viso->metadata_sectors * viso->sector_size;
-    size_t metadata_remain = metadata_size;
-    while (metadata_remain > 0)
-        metadata_remain -= fread(viso->metadata + (metadata_size - metadata_remain), 1, MIN(metadata_remain, viso->sector_size), viso->tf.fp);
-
-    /* We no longer need the temporary file; close and delete it. */
-    fclose(viso->tf.fp);
-    viso->tf.fp = NULL;
-#ifndef ENABLE_CDROM_IMAGE_VISO_LOG
-    remove(nvr_path(viso->tf.fn));
-#endif
-
     /* All good. */
     *error = 0;
 
 end:
+    viso_cache_free(cache);
+
     /* Set the function pointers. */
     viso->tf.priv = viso;
     if (!*error) {
-        cdrom_image_viso_log("VISO: Initialized\n");
+        cdrom_image_viso_log("VISO: Initialized with %zu sectors of metadata and %zu sectors of file data\n",
+                             viso->metadata_sectors, viso->all_sectors - viso->metadata_sectors);
         viso->tf.read       = viso_read;
         viso->tf.get_length = viso_get_length;
         viso->tf.close      = viso_close;
         return &viso->tf;
     } else {
         cdrom_image_viso_log("VISO: Initialization failed\n");
-        if (data)
-            free(data);
         viso_close(&viso->tf);
         return NULL;
     }
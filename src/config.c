@@ -1145,6 +1145,23 @@ load_hard_disks(void)
         p = ini_section_get_string(cat, temp, "");
         strncpy(hdd[c].vhd_parent, p, sizeof(hdd[c].vhd_parent) - 1);
 
+        sprintf(temp, "hdd_%02i_mmap", c + 1);
+        hdd[c].use_mmap = !!ini_section_get_int(cat, temp, 0);
+
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        p = ini_section_get_string(cat, temp, "");
+        memset(hdd[c].overlay_fn, 0x00, sizeof(hdd[c].overlay_fn));
+        if (p[0] != 0x00) {
+            if (path_abs(p))
+                strncpy(hdd[c].overlay_fn, p, sizeof(hdd[c].overlay_fn) - 1);
+            else
+                path_append_filename(hdd[c].overlay_fn, usr_path, p);
+            path_normalize(hdd[c].overlay_fn);
+        }
+
+        sprintf(temp, "hdd_%02i_overlay_discard", c + 1);
+        hdd[c].overlay_discard = !!ini_section_get_int(cat, temp, 0);
+
         /* If disk is empty or invalid, mark it for deletion. */
         if (!hdd_is_valid(c)) {
             sprintf(temp, "hdd_%02i_parameters", c + 1);
@@ -1167,6 +1184,15 @@ load_hard_disks(void)
 
             sprintf(temp, "hdd_%02i_fn", c + 1);
             ini_section_delete_var(cat, temp);
+
+            sprintf(temp, "hdd_%02i_mmap", c + 1);
+            ini_section_delete_var(cat, temp);
+
+            sprintf(temp, "hdd_%02i_overlay", c + 1);
+            ini_section_delete_var(cat, temp);
+
+            sprintf(temp, "hdd_%02i_overlay_discard", c + 1);
+            ini_section_delete_var(cat, temp);
         }
     }
 }
@@ -2642,6 +2668,28 @@ save_hard_disks(void)
         } else
             ini_section_delete_var(cat, temp);
 
+        sprintf(temp, "hdd_%02i_mmap", c + 1);
+        if (hdd_is_valid(c) && hdd[c].use_mmap)
+            ini_section_set_int(cat, temp, hdd[c].use_mmap);
+        else
+            ini_section_delete_var(cat, temp);
+
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        if (hdd_is_valid(c) && hdd[c].overlay_fn[0]) {
+            path_normalize(hdd[c].overlay_fn);
+            if (!strnicmp(hdd[c].overlay_fn, usr_path, strlen(usr_path)))
+                ini_section_set_string(cat, temp, &hdd[c].overlay_fn[strlen(usr_path)]);
+            else
+                ini_section_set_string(cat, temp, hdd[c].overlay_fn);
+        } else
+            ini_section_delete_var(cat, temp);
+
+        sprintf(temp, "hdd_%02i_overlay_discard", c + 1);
+        if (hdd_is_valid(c) && hdd[c].overlay_discard)
+            ini_section_set_int(cat, temp, hdd[c].overlay_discard);
+        else
+            ini_section_delete_var(cat, temp);
+
         sprintf(temp, "hdd_%02i_speed", c + 1);
         if (!hdd_is_valid(c) || ((hdd[c].bus != HDD_BUS_ESDI) && (hdd[c].bus != HDD_BUS_IDE) &&
             (hdd[c].bus != HDD_BUS_SCSI) && (hdd[c].bus != HDD_BUS_ATAPI)))
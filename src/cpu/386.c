@@ -28,6 +28,7 @@
 #include <86box/machine.h>
 #include <86box/plat_fallthrough.h>
 #include <86box/gdbstub.h>
+#include <86box/benchmark.h>
 #ifndef OPS_286_386
 #    define OPS_286_386
 #endif
@@ -291,6 +292,8 @@ exec386_2386(int32_t cycs)
                     in_lock = 1;
                 x86_2386_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
                 in_lock = 0;
+                if (benchmark_mode)
+                    cpu_ins_count++;
                 if (x86_was_reset)
                     break;
             }
@@ -219,6 +219,36 @@ int checkio(uint32_t port, int mask);
         }                                                            \
     }
 
+/* Number of words a forward REP INSW/OUTSW can hand to a block port handler in
+   one go: as many as stay inside the directly mapped page holding the first
+   word, the segment limit and the address size. Returns 0 when the string has
+   to be moved word by word, otherwise points *ptr at the first word. */
+static __inline int
+rep_block_words(const uintptr_t *lookup, uint32_t base, uint32_t addr, uint32_t limit,
+                uint32_t count, uint16_t **ptr)
+{
+    uint32_t linear = base + addr;
+    uint32_t words;
+
+    if (trap || (cpu_state.flags & D_FLAG) || (count < 2) || (base == 0xffffffff) ||
+        (linear & 1) || (addr > limit) || (lookup[linear >> 12] == (uintptr_t) LOOKUP_INV))
+        return 0;
+#ifdef USE_DEBUG_REGS_486
+    if (dr[7] & 0xff)
+        return 0;
+#endif
+
+    words = (0x1000 - (linear & 0xfff)) >> 1;
+    words = MIN(words, ((limit - addr) >> 1) + ((limit - addr) & 1));
+    words = MIN(words, count);
+    if (words < 2)
+        return 0;
+
+    *ptr = (uint16_t *) (lookup[linear >> 12] + (uintptr_t) linear);
+
+    return (int) words;
+}
+
 #define SEG_CHECK_READ(seg)                  \
     do {                                     \
         if ((seg)->base == 0xffffffff) {     \
@@ -31,6 +31,7 @@
 #include <86box/machine.h>
 #include <86box/plat_fallthrough.h>
 #include <86box/gdbstub.h>
+#include <86box/benchmark.h>
 #ifdef USE_DYNAREC
 #    include "codegen.h"
 #    ifdef USE_NEW_DYNAREC
@@ -324,6 +325,8 @@ exec386_dynarec_int(void)
             cpu_state.eflags &= ~(RF_FLAG);
 #    endif
             x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+            if (benchmark_mode)
+                cpu_ins_count++;
         }
 
 #    ifndef USE_NEW_DYNAREC
@@ -524,6 +527,8 @@ exec386_dynarec_dyn(void)
 #    endif
         inrecomp = 1;
         code();
+        if (benchmark_mode)
+            cpu_ins_count += block->ins;
 #    ifdef USE_ACYCS
         acycs = 0;
 #    endif
@@ -550,6 +555,7 @@ exec386_dynarec_dyn(void)
         }
 #    endif
         codegen_block_start_recompile(block);
+        cpu_recomp_count++;
         codegen_in_recompile = 1;
 
         while (!cpu_block_end) {
@@ -578,6 +584,8 @@ exec386_dynarec_dyn(void)
                 codegen_generate_call(opcode, x86_opcodes[(opcode | cpu_state.op32) & 0x3ff], fetchdat, cpu_state.pc, cpu_state.pc - 1);
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                if (benchmark_mode)
+                    cpu_ins_count++;
 
                 if (x86_was_reset)
                     break;
@@ -678,6 +686,8 @@ exec386_dynarec_dyn(void)
                 cpu_state.pc++;
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                if (benchmark_mode)
+                    cpu_ins_count++;
 
                 if (x86_was_reset)
                     break;
@@ -929,6 +939,8 @@ exec386(int32_t cycs)
                 cpu_state.eflags &= ~(RF_FLAG);
 #endif
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                if (benchmark_mode)
+                    cpu_ins_count++;
                 if (x86_was_reset)
                     break;
             }
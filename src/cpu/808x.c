@@ -35,6 +35,7 @@
 #include <86box/ppi.h>
 #include <86box/timer.h>
 #include <86box/gdbstub.h>
+#include <86box/benchmark.h>
 
 /* Is the CPU 8088 or 8086. */
 int is8086 = 0;
@@ -1733,6 +1734,8 @@ execx86(int cycs)
             opcode          = pfq_fetchb();
             handled         = 0;
             oldc            = cpu_state.flags & C_FLAG;
+            if (benchmark_mode)
+                cpu_ins_count++;
             if (clear_lock) {
                 in_lock    = 0;
                 clear_lock = 0;
@@ -263,6 +263,8 @@ uint8_t  _cache[2048];
 
 uint64_t cpu_CR4_mask;
 uint64_t tsc = 0;
+uint64_t cpu_ins_count    = 0;
+uint64_t cpu_recomp_count = 0;
 
 double cpu_dmulti;
 double cpu_busspeed;
@@ -548,6 +548,8 @@ extern uint32_t cpu_cur_status;
 #endif
 extern uint64_t cpu_CR4_mask;
 extern uint64_t tsc;
+extern uint64_t cpu_ins_count;    /* instructions executed, for statistics */
+extern uint64_t cpu_recomp_count; /* dynarec blocks compiled, for statistics */
 extern msr_t    msr;
 extern uint8_t  opcode;
 extern int      cpl_override;
@@ -1,3 +1,6 @@
+#define REP_ADDR_LIMIT_a16 0x0000ffffUL
+#define REP_ADDR_LIMIT_a32 0xffffffffUL
+
 #define REP_OPS(size, CNT_REG, SRC_REG, DEST_REG)                                                                 \
     static int opREP_INSB_##size(uint32_t fetchdat)                                                               \
     {                                                                                                             \
@@ -45,7 +48,9 @@
         addr64a[0] = addr64a[1] = 0x00000000;                                                                     \
                                                                                                                   \
         if (CNT_REG > 0) {                                                                                        \
-            uint16_t temp;                                                                                        \
+            uint16_t  temp;                                                                                       \
+            uint16_t *block;                                                                                      \
+            int       words;                                                                                      \
                                                                                                                   \
             SEG_CHECK_WRITE(&cpu_state.seg_es);                                                                   \
             check_io_perm(DX, 2);                                                                                 \
@@ -54,20 +59,33 @@
             do_mmut_ww(es, DEST_REG, addr64a);                                                                    \
             if (cpu_state.abrt)                                                                                   \
                 return 1;                                                                                         \
-            temp = inw(DX);                                                                                       \
-            writememw_n(es, DEST_REG, addr64a, temp);                                                             \
-            if (cpu_state.abrt)                                                                                   \
-                return 1;                                                                                         \
-                                                                                                                  \
-            if (cpu_state.flags & D_FLAG)                                                                         \
-                DEST_REG -= 2;                                                                                    \
-            else                                                                                                  \
-                DEST_REG += 2;                                                                                    \
-            CNT_REG--;                                                                                            \
-            cycles -= 15;                                                                                         \
-            reads++;                                                                                              \
-            writes++;                                                                                             \
-            total_cycles += 15;                                                                                   \
+            words = rep_block_words(writelookup2, es, DEST_REG,                                                   \
+                                    MIN(cpu_state.seg_es.limit_high, REP_ADDR_LIMIT_##size), CNT_REG, &block);    \
+            if (words)                                                                                            \
+                words = inw_block(DX, block, words);                                                              \
+            if (words) {                                                                                          \
+                DEST_REG += words << 1;                                                                           \
+                CNT_REG -= words;                                                                                 \
+                cycles -= 15 * words;                                                                             \
+                reads += words;                                                                                   \
+                writes += words;                                                                                  \
+                total_cycles += 15 * words;                                                                       \
+            } else {                                                                                              \
+                temp = inw(DX);                                                                                   \
+                writememw_n(es, DEST_REG, addr64a, temp);                                                         \
+                if (cpu_state.abrt)                                                                               \
+                    return 1;                                                                                     \
+                                                                                                                  \
+                if (cpu_state.flags & D_FLAG)                                                                     \
+                    DEST_REG -= 2;                                                                                \
+                else                                                                                              \
+                    DEST_REG += 2;                                                                                \
+                CNT_REG--;                                                                                        \
+                cycles -= 15;                                                                                     \
+                reads++;                                                                                          \
+                writes++;                                                                                         \
+                total_cycles += 15;                                                                               \
+            }                                                                                                     \
         }                                                                                                         \
         PREFETCH_RUN(total_cycles, 1, -1, reads, 0, writes, 0, 0);                                                \
         if (CNT_REG > 0) {                                                                                        \
@@ -153,23 +171,41 @@
         int reads = 0, writes = 0, total_cycles = 0;                                                              \
                                                                                                                   \
         if (CNT_REG > 0) {                                                                                        \
-            uint16_t temp;                                                                                        \
+            uint16_t  temp;                                                                                       \
+            uint16_t *block;                                                                                      \
+            int       words;                                                                                      \
+                                                                                                                  \
             SEG_CHECK_READ(cpu_state.ea_seg);                                                                     \
             CHECK_READ(cpu_state.ea_seg, SRC_REG, SRC_REG + 1UL);                                                 \
-            temp = readmemw(cpu_state.ea_seg->base, SRC_REG);                                                     \
-            if (cpu_state.abrt)                                                                                   \
-                return 1;                                                                                         \
-            check_io_perm(DX, 2);                                                                                 \
-            outw(DX, temp);                                                                                       \
-            if (cpu_state.flags & D_FLAG)                                                                         \
-                SRC_REG -= 2;                                                                                     \
-            else                                                                                                  \
-                SRC_REG += 2;                                                                                     \
-            CNT_REG--;                                                                                            \
-            cycles -= 14;                                                                                         \
-            reads++;                                                                                              \
-            writes++;                                                                                             \
-            total_cycles += 14;                                                                                   \
+            words = rep_block_words(readlookup2, cpu_state.ea_seg->base, SRC_REG,                                 \
+                                    MIN(cpu_state.ea_seg->limit_high, REP_ADDR_LIMIT_##size), CNT_REG, &block);   \
+            if (words) {                                                                                          \
+                check_io_perm(DX, 2);                                                                             \
+                words = outw_block(DX, block, words);                                                             \
+            }                                                                                                     \
+            if (words) {                                                                                          \
+                SRC_REG += words << 1;                                                                            \
+                CNT_REG -= words;                                                                                 \
+                cycles -= 14 * words;                                                                             \
+                reads += words;                                                                                   \
+                writes += words;                                                                                  \
+                total_cycles += 14 * words;                                                                       \
+            } else {                                                                                              \
+                temp = readmemw(cpu_state.ea_seg->base, SRC_REG);                                                 \
+                if (cpu_state.abrt)                                                                               \
+                    return 1;                                                                                     \
+                check_io_perm(DX, 2);                                                                             \
+                outw(DX, temp);                                                                                   \
+                if (cpu_state.flags & D_FLAG)                                                                     \
+                    SRC_REG -= 2;                                                                                 \
+                else                                                                                              \
+                    SRC_REG += 2;                                                                                 \
+                CNT_REG--;                                                                                        \
+                cycles -= 14;                                                                                     \
+                reads++;                                                                                          \
+                writes++;                                                                                         \
+                total_cycles += 14;                                                                               \
+            }                                                                                                     \
         }                                                                                                         \
         PREFETCH_RUN(total_cycles, 1, -1, reads, 0, writes, 0, 0);                                                \
         if (CNT_REG > 0) {                                                                                        \
@@ -26,6 +26,7 @@
 #include <wchar.h>
 #define HAVE_STDARG_H
 #include <86box/86box.h>
+#include <86box/benchmark.h>
 #include <86box/io.h>
 #include <86box/plat.h>
 #include <86box/unittester.h>
@@ -295,7 +296,11 @@ unittester_write(uint16_t port, uint8_t val, UNUSED(void *priv))
                     unittester_log("[UT] Exit received - code = %02X\n", unittester.exit_code);
 
                     /* CHECK: Do we actually exit? */
-                    if (unittester_exit_enabled) {
+                    if (benchmark_mode) {
+                        /* Benchmark run - stop it so the statistics get printed */
+                        unittester_log("[UT] Benchmark running, stopping with code %02X\n", unittester.exit_code);
+                        benchmark_request_stop(unittester.exit_code);
+                    } else if (unittester_exit_enabled) {
                         /* Yes - call exit! */
                         /* Clamp exit code */
                         if (unittester.exit_code > 0x7F)
@@ -1656,6 +1656,8 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
 
                     if (ide->type == IDE_HDD) {
                         ui_sb_update_icon(SB_HDD | hdd[ide->hdd_num].bus, 1);
+                        /* Have the image read the sectors while the command delay runs. */
+                        hdd_image_prefetch(ide->hdd_num, ide_get_sector(ide), ide->tf->secount ? ide->tf->secount : 256);
                         uint32_t sec_count;
                         double   wait_time;
                         if ((val == WIN_READ_DMA) || (val == WIN_READ_DMA_ALT)) {
@@ -1893,6 +1895,66 @@ ide_read_data(ide_t *ide)
     return ret;
 }
 
+/* Block variants of ide_read_data()/ide_write_data() for REP INSW/OUTSW: copy
+   straight between the guest and the sector buffer, stopping at the end of the
+   sector so the last word still goes through the regular path and triggers the
+   end-of-sector processing. Returns 0 when the words must go one at a time. */
+static int
+ide_read_data_block(ide_t *ide, uint16_t *buf, int count)
+{
+    int words;
+
+    if ((ide->type == IDE_NONE) || (ide->type & IDE_SHADOW) || (ide->buffer == NULL) ||
+        (ide->command == WIN_PACKETCMD) || (ide->tf->pos & 1))
+        return 0;
+
+    words = MIN(count, (512 - ide->tf->pos) >> 1);
+    if (words < 2)
+        return 0;
+
+    memcpy(buf, ((uint8_t *) ide->buffer) + ide->tf->pos, (words - 1) << 1);
+    ide->tf->pos += (words - 1) << 1;
+    buf[words - 1] = ide_read_data(ide);
+
+    return words;
+}
+
+static int
+ide_write_data_block(ide_t *ide, const uint16_t *buf, int count)
+{
+    int words;
+
+    if ((ide->type == IDE_NONE) || (ide->type & IDE_SHADOW) || (ide->buffer == NULL) ||
+        (ide->command == WIN_PACKETCMD) || (ide->tf->pos & 1))
+        return 0;
+
+    words = MIN(count, (512 - ide->tf->pos) >> 1);
+    if (words < 2)
+        return 0;
+
+    memcpy(((uint8_t *) ide->buffer) + ide->tf->pos, buf, (words - 1) << 1);
+    ide->tf->pos += (words - 1) << 1;
+    ide_write_data(ide, buf[words - 1]);
+
+    return words;
+}
+
+static int
+ide_readw_block(UNUSED(uint16_t addr), uint16_t *buf, int count, void *priv)
+{
+    const ide_board_t *dev = (ide_board_t *) priv;
+
+    return ide_read_data_block(ide_drives[dev->cur_dev], buf, count);
+}
+
+static int
+ide_writew_block(UNUSED(uint16_t addr), const uint16_t *buf, int count, void *priv)
+{
+    const ide_board_t *dev = (ide_board_t *) priv;
+
+    return ide_write_data_block(ide_drives[dev->cur_dev], buf, count);
+}
+
 static uint8_t
 ide_status(ide_t *ide, ide_t *ide_other, int ch)
 {
@@ -2634,6 +2696,9 @@ ide_handlers(uint8_t board, int set)
                        ide_readb, ide_readw, ide_readl,
                        ide_writeb, ide_writew, ide_writel,
                        ide_boards[board]);
+            io_handler_block(set, ide_boards[board]->base[0],
+                             ide_readw_block, ide_writew_block,
+                             ide_boards[board]);
         }
 
         if (ide_boards[board]->base[1]) {
@@ -26,14 +26,21 @@
 #include <time.h>
 #include <wchar.h>
 #include <errno.h>
-#ifdef __unix__
+#if defined(__unix__) || defined(__APPLE__)
 #include <unistd.h>
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#    include <windows.h>
+#    include <winioctl.h>
+#    include <io.h>
 #endif
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/random.h>
+#include <86box/thread.h>
 #include <86box/hdd.h>
 #include "minivhd/minivhd.h"
 #include "minivhd/internal.h"
@@ -43,6 +50,23 @@
 #define HDD_IMAGE_HDX 2
 #define HDD_IMAGE_VHD 3
 
+/* Size of the read-ahead buffer, enough for the largest ATA transfer. */
+#define HDD_IMAGE_RA_SECTORS 256
+
+/* Copy-on-write overlay sidecar: a header sector, a bitmap with one bit per
+   sector of the image, then the written sectors at their own offsets, from
+   HDD_COW_DATA onwards. Sectors that were never written are holes. */
+#define HDD_COW_MAGIC   "86BoxCOW"
+#define HDD_COW_VERSION 1
+#define HDD_COW_BITMAP  512
+
+typedef struct hdd_cow_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t sectors;
+    uint64_t base_size; /* Size of the image the overlay was made against. */
+} hdd_cow_header_t;
+
 typedef struct hdd_image_t {
     FILE     *file; /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
     MVHDMeta *vhd;  /* Used for HDD_IMAGE_VHD. */
@@ -51,6 +75,32 @@ typedef struct hdd_image_t {
     uint32_t  last_sector;
     uint8_t   type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
     uint8_t   loaded;
+
+    /* Mapping of the whole file, for raw, HDI and HDX images with use_mmap set
+       or under an overlay. */
+    uint8_t  *map;
+    uint64_t  map_size;
+
+    /* Copy-on-write overlay. The image is then opened read-only and sectors
+       that have been written are in the sidecar. */
+    FILE     *cow;
+    uint8_t  *cow_bitmap;
+    uint32_t  cow_bitmap_size;
+    uint64_t  cow_data;
+    uint64_t  file_size;
+
+    /* Read-ahead, filled by the I/O thread. All access to the image goes
+       through lock once the thread is running. */
+    thread_t *thread;
+    event_t  *wake;
+    mutex_t  *lock;
+    uint8_t  *ra_buf;
+    uint32_t  ra_sector;
+    uint32_t  ra_count;
+    uint32_t  req_sector;
+    uint32_t  req_count;
+    uint32_t  next_sector;
+    int       stop;
 } hdd_image_t;
 
 hdd_image_t hdd_images[HDD_NUM];
@@ -241,6 +291,461 @@ prepare_new_hard_disk(uint8_t id, uint64_t full_size)
     return 1;
 }
 
+/* Whether a transfer can go straight through the mapping. Anything reaching
+   past the last sector goes through stdio, which can grow the file. */
+static int
+hdd_image_mapped(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+    return img->map && (sector <= img->last_sector) && (count <= (img->last_sector - sector + 1));
+}
+
+static void
+hdd_image_map(uint8_t id)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    hdd_image_t *img = &hdd_images[id];
+    uint64_t     size;
+    void        *map;
+
+    /* The read-only image under an overlay is always mapped, so that every
+       instance started from it shares the same page cache. */
+    if ((!hdd[id].use_mmap && !img->cow) || !img->loaded || !img->file || (img->type == HDD_IMAGE_VHD))
+        return;
+
+    size = img->base + (((uint64_t) img->last_sector + 1) << 9);
+
+    /* Touching a mapping past the end of the file faults, so a short image
+       (which an overlay never grows) stays on stdio. */
+    fflush(img->file);
+    if ((fseeko64(img->file, 0, SEEK_END) == -1) || (ftello64(img->file) < (off64_t) size))
+        return;
+
+    map = mmap(NULL, size, img->cow ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fileno(img->file), 0);
+    if (map == MAP_FAILED) {
+        hdd_image_log("Hard disk image %i: Unable to map the image, using stdio\n", id);
+        return;
+    }
+
+    img->map      = (uint8_t *) map;
+    img->map_size = size;
+#endif
+}
+
+static void
+hdd_image_unmap(uint8_t id)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    hdd_image_t *img = &hdd_images[id];
+
+    if (!img->map)
+        return;
+
+    msync(img->map, img->map_size, MS_SYNC);
+    munmap(img->map, img->map_size);
+    img->map      = NULL;
+    img->map_size = 0;
+#endif
+}
+
+static int
+hdd_image_cow_present(hdd_image_t *img, uint32_t sector)
+{
+    return (img->cow_bitmap[sector >> 3] >> (sector & 7)) & 1;
+}
+
+/* Sectors are stored at their own offset in the overlay, so it only takes
+   up space for the sectors written if the file is sparse. POSIX file systems
+   do that by default; NTFS has to be asked. */
+static void
+hdd_image_cow_set_sparse(FILE *f)
+{
+#ifdef _WIN32
+    DWORD ret;
+
+    if (!DeviceIoControl((HANDLE) _get_osfhandle(_fileno(f)), FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &ret, NULL))
+        hdd_image_log("Unable to make the overlay sparse, it will use the full disk size\n");
+#else
+    (void) f;
+#endif
+}
+
+/* Opens the overlay of an image, or starts a new one if there is none yet or
+   it was made against a different image. */
+static int
+hdd_image_cow_open(uint8_t id)
+{
+    hdd_image_t     *img     = &hdd_images[id];
+    uint32_t         sectors = img->last_sector + 1;
+    int              valid   = 0;
+    hdd_cow_header_t hdr;
+
+    img->cow_bitmap_size = (sectors + 7) >> 3;
+    img->cow_data        = (HDD_COW_BITMAP + img->cow_bitmap_size + 4095) & ~4095ULL;
+    img->cow_bitmap      = (uint8_t *) calloc(1, img->cow_bitmap_size);
+
+    if (hdd[id].overlay_discard)
+        img->cow = hdd[id].overlay_fn[0] ? plat_fopen(hdd[id].overlay_fn, "wb+") : tmpfile();
+    else {
+        img->cow = plat_fopen(hdd[id].overlay_fn, "rb+");
+        if (img->cow) {
+            if ((fread(&hdr, 1, sizeof(hdr), img->cow) == sizeof(hdr)) && !memcmp(hdr.magic, HDD_COW_MAGIC, 8) &&
+                (hdr.version == HDD_COW_VERSION) && (hdr.sectors == sectors) && (hdr.base_size == img->file_size) &&
+                (fseeko64(img->cow, HDD_COW_BITMAP, SEEK_SET) != -1) &&
+                (fread(img->cow_bitmap, 1, img->cow_bitmap_size, img->cow) == img->cow_bitmap_size))
+                valid = 1;
+            else {
+                pclog("Hard disk image %i: Overlay '%s' does not match the image, starting over\n", id, hdd[id].overlay_fn);
+                memset(img->cow_bitmap, 0x00, img->cow_bitmap_size);
+                fclose(img->cow);
+                img->cow = NULL;
+            }
+        }
+        if (!img->cow)
+            img->cow = plat_fopen(hdd[id].overlay_fn, "wb+");
+    }
+
+    if (img->cow && !valid) {
+        hdd_image_cow_set_sparse(img->cow);
+
+        memset(&hdr, 0x00, sizeof(hdr));
+        memcpy(hdr.magic, HDD_COW_MAGIC, 8);
+        hdr.version   = HDD_COW_VERSION;
+        hdr.sectors   = sectors;
+        hdr.base_size = img->file_size;
+        if ((fwrite(&hdr, 1, sizeof(hdr), img->cow) != sizeof(hdr)) || (fseeko64(img->cow, HDD_COW_BITMAP, SEEK_SET) == -1) ||
+            (fwrite(img->cow_bitmap, 1, img->cow_bitmap_size, img->cow) != img->cow_bitmap_size)) {
+            fclose(img->cow);
+            img->cow = NULL;
+        } else
+            fflush(img->cow);
+    }
+
+    if (!img->cow) {
+        hdd_image_log("Hard disk image %i: Unable to open the overlay\n", id);
+        free(img->cow_bitmap);
+        img->cow_bitmap = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void
+hdd_image_cow_close(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->cow) {
+        fclose(img->cow);
+        img->cow = NULL;
+        if (hdd[id].overlay_discard && hdd[id].overlay_fn[0])
+            plat_remove(hdd[id].overlay_fn);
+    }
+
+    free(img->cow_bitmap);
+    img->cow_bitmap = NULL;
+}
+
+/* Reads sectors from the image under an overlay. Sectors past the end of a
+   short image read as zeroes, as the image is never extended. */
+static int
+hdd_image_base_read(hdd_image_t *img, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    size_t num_read;
+
+    if (hdd_image_mapped(img, sector, count)) {
+        memcpy(buffer, &img->map[img->base + ((uint64_t) sector << 9)], count << 9);
+        return 0;
+    }
+
+    if (fseeko64(img->file, ((uint64_t) sector << 9) + img->base, SEEK_SET) == -1)
+        return -1;
+
+    num_read = fread(buffer, 512, count, img->file);
+    if (num_read < count) {
+        if (!feof(img->file))
+            return -1;
+        memset(&buffer[num_read << 9], 0x00, (count - num_read) << 9);
+    }
+
+    return 0;
+}
+
+/* Reads each run of sectors from wherever it currently lives. */
+static int
+hdd_image_cow_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint32_t     run;
+    int          present;
+    int          ret;
+
+    if ((sector > img->last_sector) || (count > (img->last_sector - sector + 1)))
+        return -1;
+
+    while (count) {
+        present = hdd_image_cow_present(img, sector);
+        for (run = 1; (run < count) && (hdd_image_cow_present(img, sector + run) == present); run++)
+            ;
+
+        if (!present)
+            ret = hdd_image_base_read(img, sector, run, buffer);
+        else if ((fseeko64(img->cow, img->cow_data + ((uint64_t) sector << 9), SEEK_SET) == -1) ||
+                 (fread(buffer, 512, run, img->cow) < run))
+            ret = -1;
+        else
+            ret = 0;
+
+        if (ret < 0) {
+            hdd_image_log("Hard disk image %i: Overlay read error\n", id);
+            return -1;
+        }
+
+        sector += run;
+        count -= run;
+        buffer += run << 9;
+        img->pos = sector;
+    }
+
+    return 0;
+}
+
+/* Writes sectors to the overlay, or zeroes them if buffer is NULL, and
+   marks them as present. The bitmap is only kept on disk if the overlay
+   outlives the session. */
+static int
+hdd_image_cow_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    size_t       num_write;
+    uint32_t     first;
+    uint32_t     last;
+
+    if ((sector > img->last_sector) || (count > (img->last_sector - sector + 1)))
+        return -1;
+
+    if (fseeko64(img->cow, img->cow_data + ((uint64_t) sector << 9), SEEK_SET) == -1) {
+        hdd_image_log("Hard disk image %i: Overlay write error during seek\n", id);
+        return -1;
+    }
+
+    if (buffer)
+        num_write = fwrite(buffer, 512, count, img->cow);
+    else {
+        memset(empty_sector, 0, 512);
+        for (num_write = 0; num_write < count; num_write++) {
+            if (!fwrite(empty_sector, 512, 1, img->cow))
+                break;
+        }
+    }
+    img->pos = sector + num_write;
+
+    if (num_write) {
+        for (uint32_t i = sector; i < (sector + num_write); i++)
+            img->cow_bitmap[i >> 3] |= (1 << (i & 7));
+
+        if (!hdd[id].overlay_discard) {
+            first = sector >> 3;
+            last  = (sector + num_write - 1) >> 3;
+            if ((fseeko64(img->cow, HDD_COW_BITMAP + first, SEEK_SET) == -1) ||
+                (fwrite(&img->cow_bitmap[first], 1, last - first + 1, img->cow) != (last - first + 1)))
+                num_write = 0;
+        }
+    }
+
+    fflush(img->cow);
+
+    return (num_write < count) ? -1 : 0;
+}
+
+static void
+hdd_image_lock(hdd_image_t *img)
+{
+    if (img->lock)
+        thread_wait_mutex(img->lock);
+}
+
+static void
+hdd_image_unlock(hdd_image_t *img)
+{
+    if (img->lock)
+        thread_release_mutex(img->lock);
+}
+
+static int
+hdd_image_overlaps(uint32_t a, uint32_t a_count, uint32_t b, uint32_t b_count)
+{
+    return a_count && b_count && ((a - b) < b_count || (b - a) < a_count);
+}
+
+static int
+hdd_image_do_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    int    non_transferred_sectors;
+    size_t num_read;
+
+    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+        hdd_images[id].vhd->error = 0;
+        non_transferred_sectors   = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
+        hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
+        if (hdd_images[id].vhd->error)
+            return -1;
+    } else if (hdd_images[id].cow)
+        return hdd_image_cow_read(id, sector, count, buffer);
+    else if (hdd_image_mapped(&hdd_images[id], sector, count)) {
+        memcpy(buffer, &hdd_images[id].map[hdd_images[id].base + ((uint64_t) sector << 9)], count << 9);
+        hdd_images[id].pos = sector + count;
+    } else {
+        if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
+            hdd_image_log("Hard disk image %i: Read error during seek\n", id);
+            return -1;
+        }
+
+        num_read           = fread(buffer, 512, count, hdd_images[id].file);
+        hdd_images[id].pos = sector + num_read;
+        if ((num_read < count) && !feof(hdd_images[id].file))
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Reads up to HDD_IMAGE_RA_SECTORS sectors into the read-ahead buffer. Must
+   be called with the image locked. */
+static void
+hdd_image_fill(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint32_t     pos = img->pos;
+
+    img->ra_count = 0;
+
+    if (sector > img->last_sector)
+        return;
+
+    count = MIN(count, HDD_IMAGE_RA_SECTORS);
+    count = MIN(count, img->last_sector - sector + 1);
+
+    if (hdd_image_do_read(id, sector, count, img->ra_buf) == 0) {
+        img->ra_sector = sector;
+        img->ra_count  = count;
+    }
+
+    /* Read-ahead is invisible to the controllers. */
+    img->pos = pos;
+}
+
+static void
+hdd_image_io_thread(void *param)
+{
+    hdd_image_t *img = (hdd_image_t *) param;
+    uint8_t      id  = (uint8_t) (img - hdd_images);
+
+    while (1) {
+        thread_wait_event(img->wake, -1);
+        thread_reset_event(img->wake);
+
+        thread_wait_mutex(img->lock);
+        if (img->stop) {
+            thread_release_mutex(img->lock);
+            break;
+        }
+        if (img->req_count) {
+            hdd_image_fill(id, img->req_sector, img->req_count);
+            img->req_count = 0;
+        }
+        thread_release_mutex(img->lock);
+    }
+}
+
+static void
+hdd_image_async_init(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    /* Mapped images are read with a plain memcpy(), there is nothing to
+       read ahead. */
+    if (img->thread || !img->loaded || img->map)
+        return;
+
+    img->ra_buf      = (uint8_t *) malloc(HDD_IMAGE_RA_SECTORS << 9);
+    img->ra_count    = 0;
+    img->req_count   = 0;
+    img->next_sector = 0xffffffff;
+    img->stop        = 0;
+    img->lock        = thread_create_mutex();
+    img->wake        = thread_create_event();
+    img->thread      = thread_create(hdd_image_io_thread, img);
+}
+
+static void
+hdd_image_async_close(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (!img->thread)
+        return;
+
+    thread_wait_mutex(img->lock);
+    img->stop = 1;
+    thread_release_mutex(img->lock);
+    thread_set_event(img->wake);
+    thread_wait(img->thread);
+    img->thread = NULL;
+
+    thread_destroy_event(img->wake);
+    img->wake = NULL;
+    thread_close_mutex(img->lock);
+    img->lock = NULL;
+
+    free(img->ra_buf);
+    img->ra_buf    = NULL;
+    img->ra_count  = 0;
+    img->req_count = 0;
+}
+
+/* Drops any read-ahead that a write to these sectors would make stale. Must
+   be called with the image locked. */
+static void
+hdd_image_invalidate(hdd_image_t *img, uint32_t sector, uint32_t count)
+{
+    if (hdd_image_overlaps(sector, count, img->ra_sector, img->ra_count))
+        img->ra_count = 0;
+    if (hdd_image_overlaps(sector, count, img->req_sector, img->req_count))
+        img->req_count = 0;
+}
+
+/* Starts reading sectors into the read-ahead buffer in the background, so
+   that the hdd_image_read() that a controller issues once its command delay
+   has run out finds them there. Adjacent requests that have not been started
+   yet are merged. */
+void
+hdd_image_prefetch(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    hdd_image_async_init(id);
+    if (!img->thread || !count)
+        return;
+
+    count = MIN(count, HDD_IMAGE_RA_SECTORS);
+
+    thread_wait_mutex(img->lock);
+    if (((sector - img->ra_sector) < img->ra_count) && ((sector - img->ra_sector + count) <= img->ra_count)) {
+        /* Already there. */
+    } else if (img->req_count && (sector == (img->req_sector + img->req_count)) &&
+               ((img->req_count + count) <= HDD_IMAGE_RA_SECTORS))
+        img->req_count += count;
+    else if (!img->req_count || ((sector - img->req_sector) >= img->req_count) ||
+             ((sector - img->req_sector + count) > img->req_count)) {
+        img->req_sector = sector;
+        img->req_count  = count;
+    }
+    thread_release_mutex(img->lock);
+
+    thread_set_event(img->wake);
+}
+
 void
 hdd_image_init(void)
 {
@@ -264,6 +769,7 @@ hdd_image_load(int id)
     int      is_hdx[2] = { 0, 0 };
     int      is_vhd[2] = { 0, 0 };
     int      vhd_error = 0;
+    int      overlay;
 
     memset(empty_sector, 0, sizeof(empty_sector));
     if (fn) {
@@ -272,6 +778,10 @@ hdd_image_load(int id)
 
     hdd_images[id].base = 0;
 
+    hdd_image_async_close(id);
+    hdd_image_unmap(id);
+    hdd_image_cow_close(id);
+
     if (hdd_images[id].loaded) {
         if (hdd_images[id].file) {
             fclose(hdd_images[id].file);
@@ -289,6 +799,9 @@ hdd_image_load(int id)
     is_vhd[0] = image_is_vhd(fn, 0);
     is_vhd[1] = image_is_vhd(fn, 1);
 
+    /* Differencing VHD's already do what an overlay does. */
+    overlay = (hdd[id].overlay_fn[0] || hdd[id].overlay_discard) && !is_vhd[0];
+
     hdd_images[id].pos = 0;
 
     /* Try to open existing hard disk image */
@@ -297,14 +810,14 @@ hdd_image_load(int id)
         memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
         goto fail_raw;
     }
-    hdd_images[id].file = plat_fopen(fn, "rb+");
+    hdd_images[id].file = plat_fopen(fn, overlay ? "rb" : "rb+");
     if (hdd_images[id].file == NULL) {
         /* Failed to open existing hard disk image */
         if (errno == ENOENT) {
             /* Failed because it does not exist,
                so try to create new file */
-            if (hdd[id].wp) {
-                hdd_image_log("A write-protected image must exist\n");
+            if (hdd[id].wp || overlay) {
+                hdd_image_log("A write-protected or overlaid image must exist\n");
                 memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
                 goto fail_raw;
             }
@@ -391,6 +904,7 @@ retry_vhd:
             ret = prepare_new_hard_disk(id, full_size);
             if (ret <= 0)
                 goto fail_raw;
+            hdd_image_map(id);
             return ret;
         } else {
             /* Failed for another reason */
@@ -497,7 +1011,8 @@ fail_raw:
     if (fseeko64(hdd_images[id].file, 0, SEEK_END) == -1)
         fatal("hdd_image_load(): Error seeking to the end of file\n");
     s = ftello64(hdd_images[id].file);
-    if (s < (full_size + hdd_images[id].base))
+    hdd_images[id].file_size = s;
+    if ((s < (full_size + hdd_images[id].base)) && !overlay)
         ret = prepare_new_hard_disk(id, full_size);
     else {
         hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
@@ -505,6 +1020,17 @@ fail_raw:
         ret                        = 1;
     }
 
+    if (overlay && (hdd_image_cow_open(id) < 0)) {
+        fclose(hdd_images[id].file);
+        hdd_images[id].file   = NULL;
+        hdd_images[id].loaded = 0;
+        memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
+        goto fail_raw;
+    }
+
+    if (ret > 0)
+        hdd_image_map(id);
+
     return ret;
 }
 
@@ -514,13 +1040,16 @@ hdd_image_seek(uint8_t id, uint32_t sector)
     off64_t addr = sector;
     addr         = (uint64_t) sector << 9LL;
 
+    hdd_image_lock(&hdd_images[id]);
     hdd_images[id].pos = sector;
     if (hdd_images[id].type != HDD_IMAGE_VHD) {
         if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, addr + hdd_images[id].base, SEEK_SET) == -1)) {
             hdd_image_log("hdd_image_seek(): Error seeking\n");
+            hdd_image_unlock(&hdd_images[id]);
             return -1;
         }
     }
+    hdd_image_unlock(&hdd_images[id]);
 
     return 0;
 }
@@ -528,28 +1057,40 @@ hdd_image_seek(uint8_t id, uint32_t sector)
 int
 hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
-    size_t num_read;
-
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
-        hdd_images[id].vhd->error = 0;
-        non_transferred_sectors   = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
-        hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
-        if (hdd_images[id].vhd->error)
-            return -1;
-    } else {
-        if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
-            hdd_image_log("Hard disk image %i: Read error during seek\n", id);
-            return -1;
-        }
+    hdd_image_t *img = &hdd_images[id];
+    uint32_t     next;
+    int          ret;
+
+    hdd_image_async_init(id);
+    hdd_image_lock(img);
+
+    /* A read-ahead that was asked for but has not started yet is done right
+       away instead of reading the same sectors twice. */
+    if (hdd_image_overlaps(sector, count, img->req_sector, img->req_count)) {
+        hdd_image_fill(id, img->req_sector, img->req_count);
+        img->req_count = 0;
+    }
 
-        num_read           = fread(buffer, 512, count, hdd_images[id].file);
-        hdd_images[id].pos = sector + num_read;
-        if ((num_read < count) && !feof(hdd_images[id].file))
-            return -1;
+    if (((sector - img->ra_sector) < img->ra_count) && ((sector - img->ra_sector + count) <= img->ra_count)) {
+        memcpy(buffer, &img->ra_buf[(sector - img->ra_sector) << 9], count << 9);
+        img->pos = (img->type == HDD_IMAGE_VHD) ? (sector + count - 1) : (sector + count);
+        ret      = 0;
+    } else
+        ret = hdd_image_do_read(id, sector, count, buffer);
+
+    /* Sequential reads keep the next stretch coming in the background. */
+    next = sector + count;
+    if ((ret == 0) && img->thread && (sector == img->next_sector) && !img->req_count && (next <= img->last_sector) &&
+        (((next - img->ra_sector) >= img->ra_count) || ((img->ra_count - (next - img->ra_sector)) < (HDD_IMAGE_RA_SECTORS / 4)))) {
+        img->req_sector = next;
+        img->req_count  = HDD_IMAGE_RA_SECTORS;
+        thread_set_event(img->wake);
     }
+    img->next_sector = next;
 
-    return 0;
+    hdd_image_unlock(img);
+
+    return ret;
 }
 
 uint32_t
@@ -581,8 +1122,8 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
-int
-hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+static int
+hdd_image_do_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
     int    non_transferred_sectors;
     size_t num_write;
@@ -593,6 +1134,11 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
         hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
         if (hdd_images[id].vhd->error)
             return -1;
+    } else if (hdd_images[id].cow)
+        return hdd_image_cow_write(id, sector, count, buffer);
+    else if (hdd_image_mapped(&hdd_images[id], sector, count)) {
+        memcpy(&hdd_images[id].map[hdd_images[id].base + ((uint64_t) sector << 9)], buffer, count << 9);
+        hdd_images[id].pos = sector + count;
     } else {
         if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1)) {
             hdd_image_log("Hard disk image %i: Write error during seek\n", id);
@@ -609,6 +1155,19 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
+int
+hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    int ret;
+
+    hdd_image_lock(&hdd_images[id]);
+    hdd_image_invalidate(&hdd_images[id], sector, count);
+    ret = hdd_image_do_write(id, sector, count, buffer);
+    hdd_image_unlock(&hdd_images[id]);
+
+    return ret;
+}
+
 int
 hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
@@ -626,8 +1185,8 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
-int
-hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
+static int
+hdd_image_do_zero(uint8_t id, uint32_t sector, uint32_t count)
 {
     if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error   = 0;
@@ -635,6 +1194,11 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
         hdd_images[id].pos          = sector + count - non_transferred_sectors - 1;
         if (hdd_images[id].vhd->error)
             return -1;
+    } else if (hdd_images[id].cow)
+        return hdd_image_cow_write(id, sector, count, NULL);
+    else if (hdd_image_mapped(&hdd_images[id], sector, count)) {
+        memset(&hdd_images[id].map[hdd_images[id].base + ((uint64_t) sector << 9)], 0, (size_t) count << 9);
+        hdd_images[id].pos = sector + count - 1;
     } else {
         memset(empty_sector, 0, 512);
 
@@ -658,6 +1222,19 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
     return 0;
 }
 
+int
+hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
+{
+    int ret;
+
+    hdd_image_lock(&hdd_images[id]);
+    hdd_image_invalidate(&hdd_images[id], sector, count);
+    ret = hdd_image_do_zero(id, sector, count);
+    hdd_image_unlock(&hdd_images[id]);
+
+    return ret;
+}
+
 int
 hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count)
 {
@@ -692,6 +1269,10 @@ hdd_image_unload(uint8_t id, UNUSED(int fn_preserve))
     if (strlen(hdd[id].fn) == 0)
         return;
 
+    hdd_image_async_close(id);
+    hdd_image_unmap(id);
+    hdd_image_cow_close(id);
+
     if (hdd_images[id].loaded) {
         if (hdd_images[id].file != NULL) {
             fclose(hdd_images[id].file);
@@ -716,6 +1297,10 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
         return;
 
+    hdd_image_async_close(id);
+    hdd_image_unmap(id);
+    hdd_image_cow_close(id);
+
     if (hdd_images[id].file != NULL) {
         fclose(hdd_images[id].file);
         hdd_images[id].file = NULL;
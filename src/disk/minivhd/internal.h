@@ -61,10 +61,17 @@
 #define MVHD_START_TS          946684800
 
 
+/* Number of block sector bitmaps kept in memory per image */
+#define MVHD_BITMAP_CACHE_SIZE 16
+
 typedef struct MVHDSectorBitmap {
     uint8_t* curr_bitmap;
     int      sector_count;
     int      curr_block;
+    int      curr_slot;
+    uint8_t* cache;
+    int      cache_block[MVHD_BITMAP_CACHE_SIZE];
+    int      cache_next;
 } MVHDSectorBitmap;
 
 typedef struct MVHDFooter {
@@ -194,13 +194,19 @@ calc_sparse_values(MVHDMeta* vhdm)
 static int
 init_sector_bitmap(MVHDMeta* vhdm, MVHDError* err)
 {
-    vhdm->bitmap.curr_bitmap = calloc(vhdm->bitmap.sector_count, MVHD_SECTOR_SIZE);
-    if (vhdm->bitmap.curr_bitmap == NULL) {
+    vhdm->bitmap.cache = calloc((size_t) vhdm->bitmap.sector_count * MVHD_BITMAP_CACHE_SIZE, MVHD_SECTOR_SIZE);
+    if (vhdm->bitmap.cache == NULL) {
         *err = MVHD_ERR_MEM;
         return -1;
     }
 
-    vhdm->bitmap.curr_block = -1;
+    for (int i = 0; i < MVHD_BITMAP_CACHE_SIZE; i++)
+        vhdm->bitmap.cache_block[i] = -1;
+
+    vhdm->bitmap.cache_next  = 0;
+    vhdm->bitmap.curr_slot   = 0;
+    vhdm->bitmap.curr_bitmap = vhdm->bitmap.cache;
+    vhdm->bitmap.curr_block  = -1;
 
     return 0;
 }
@@ -595,7 +601,8 @@ cleanup_format_buff:
     vhdm->format_buffer.zero_data = NULL;
 
 cleanup_bitmap:
-    free(vhdm->bitmap.curr_bitmap);
+    free(vhdm->bitmap.cache);
+    vhdm->bitmap.cache       = NULL;
     vhdm->bitmap.curr_bitmap = NULL;
 
 cleanup_bat:
@@ -630,8 +637,9 @@ mvhd_close(MVHDMeta* vhdm)
         free(vhdm->block_offset);
         vhdm->block_offset = NULL;
     }
-    if (vhdm->bitmap.curr_bitmap != NULL) {
-        free(vhdm->bitmap.curr_bitmap);
+    if (vhdm->bitmap.cache != NULL) {
+        free(vhdm->bitmap.cache);
+        vhdm->bitmap.cache       = NULL;
         vhdm->bitmap.curr_bitmap = NULL;
     }
     if (vhdm->format_buffer.zero_data != NULL) {
@@ -97,42 +97,71 @@ mvhd_write_empty_sectors(FILE *f, int sector_count)
 }
 
 /**
- * \brief Read the sector bitmap for a block.
- *
- * If the block is sparse, the sector bitmap in memory will be
- * zeroed. Otherwise, the sector bitmap is read from the VHD file.
+ * \brief Write the current sector bitmap to file
  *
  * \param [in] vhdm MiniVHD data structure
- * \param [in] blk The block for which to read the sector bitmap from
  */
 static void
-read_sect_bitmap(MVHDMeta *vhdm, int blk)
+write_curr_sect_bitmap(MVHDMeta *vhdm)
 {
-    if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
-        mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
-        if (!fread(vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
-            vhdm->error = 1;
-    } else
-        memset(vhdm->bitmap.curr_bitmap, 0, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+    /* The bitmap could not be read, so don't overwrite the one in the file. */
+    if (vhdm->bitmap.curr_block < 0) {
+        vhdm->error = 1;
+        return;
+    }
 
-    vhdm->bitmap.curr_block = blk;
+    int64_t abs_offset = (int64_t)vhdm->block_offset[vhdm->bitmap.curr_block] * MVHD_SECTOR_SIZE;
+    if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fwrite(vhdm->bitmap.curr_bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
+        vhdm->error = 1;
 }
 
 /**
- * \brief Write the current sector bitmap in memory to file
+ * \brief Make the sector bitmap for a block the current one.
+ *
+ * The bitmaps of the last MVHD_BITMAP_CACHE_SIZE blocks used are kept in
+ * memory. They always match the file, so on a miss the oldest one is simply
+ * replaced. If the block is sparse, the sector bitmap in memory will be
+ * zeroed. Otherwise, the sector bitmap is read from the VHD file.
  *
  * \param [in] vhdm MiniVHD data structure
+ * \param [in] blk The block for which to read the sector bitmap from
  */
 static void
-write_curr_sect_bitmap(MVHDMeta* vhdm)
+read_sect_bitmap(MVHDMeta *vhdm, int blk)
 {
-    if (vhdm->bitmap.curr_block >= 0) {
-        int64_t abs_offset = (int64_t)vhdm->block_offset[vhdm->bitmap.curr_block] * MVHD_SECTOR_SIZE;
-        if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
-            vhdm->error = 1;
-        if (!fwrite(vhdm->bitmap.curr_bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
-            vhdm->error = 1;
+    MVHDSectorBitmap *bm    = &vhdm->bitmap;
+    size_t            bytes = (size_t) bm->sector_count * MVHD_SECTOR_SIZE;
+    int               slot;
+
+    if (bm->curr_block == blk)
+        return;
+
+    for (slot = 0; slot < MVHD_BITMAP_CACHE_SIZE; slot++) {
+        if (bm->cache_block[slot] == blk)
+            break;
     }
+
+    if (slot == MVHD_BITMAP_CACHE_SIZE) {
+        slot           = bm->cache_next;
+        bm->cache_next = (slot + 1) % MVHD_BITMAP_CACHE_SIZE;
+
+        bm->cache_block[slot] = blk;
+        if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
+            mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
+            if (!fread(&bm->cache[slot * bytes], bytes, 1, vhdm->f)) {
+                vhdm->error = 1;
+                /* Don't keep a bitmap we failed to read. */
+                bm->cache_block[slot] = -1;
+            }
+        } else
+            memset(&bm->cache[slot * bytes], 0, bytes);
+    }
+
+    bm->curr_slot   = slot;
+    bm->curr_bitmap = &bm->cache[slot * bytes];
+    bm->curr_block  = bm->cache_block[slot];
 }
 
 /**
@@ -250,40 +279,67 @@ mvhd_sparse_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buf
     uint32_t s = 0;
     uint32_t ls = 0;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
+    int run = 0;
+    int k = 0;
+    bool present;
     ls = offset + transfer_sectors;
 
-    for (s = offset; s < ls; s++) {
+    /* Runs of sectors within a block that are all present, or all absent,
+       are handled with a single read or memset. */
+    for (s = offset; s < ls; s += run) {
         blk = s / vhdm->sect_per_block;
         sib = s % vhdm->sect_per_block;
-        if (blk != prev_blk) {
-            prev_blk = blk;
-            if (vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(vhdm, blk);
-                if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                    vhdm->error = 1;
-            } else {
-                addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                       MVHD_SECTOR_SIZE;
-                if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                    vhdm->error = 1;
-            }
+        read_sect_bitmap(vhdm, blk);
+
+        present = VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib) != 0;
+        for (run = 1; ((s + run) < ls) && ((sib + run) < vhdm->sect_per_block); run++) {
+            k = sib + run;
+            if ((VHD_TESTBIT(vhdm->bitmap.curr_bitmap, k) != 0) != present)
+                break;
         }
 
-        if (VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib)) {
-            if (!fread(buff, MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
+        if (present) {
+            addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+                   MVHD_SECTOR_SIZE;
+            if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
                 vhdm->error = 1;
-        } else {
-            memset(buff, 0, MVHD_SECTOR_SIZE);
-            mvhd_fseeko64(vhdm->f, MVHD_SECTOR_SIZE, SEEK_CUR);
-        }
-        buff += MVHD_SECTOR_SIZE;
+            if (!fread(buff, (size_t) run * MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
+                vhdm->error = 1;
+        } else
+            memset(buff, 0, (size_t) run * MVHD_SECTOR_SIZE);
+
+        buff += (size_t) run * MVHD_SECTOR_SIZE;
     }
 
     return truncated_sectors;
 }
 
+/**
+ * \brief Find the image in a differencing chain that holds a sector
+ *
+ * \param [in] vhdm MiniVHD data structure of the child image
+ * \param [in] s The sector to look up
+ *
+ * \return The first image in the chain that has the sector, or the base
+ * image if none of the differencing images do
+ */
+static MVHDMeta *
+diff_sector_owner(MVHDMeta *vhdm, uint32_t s)
+{
+    int sib;
+
+    while (vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
+        read_sect_bitmap(vhdm, s / vhdm->sect_per_block);
+        sib = s % vhdm->sect_per_block;
+        if (VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib))
+            break;
+        vhdm = vhdm->parent;
+    }
+
+    return vhdm;
+}
+
 int
 mvhd_diff_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
 {
@@ -294,39 +350,33 @@ mvhd_diff_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t *buff = (uint8_t*)out_buff;
-    MVHDMeta *curr_vhdm = vhdm;
+    MVHDMeta *curr_vhdm = NULL;
     uint32_t s = 0;
     uint32_t ls = 0;
-    int blk = 0;
-    int sib = 0;
+    int run = 0;
     ls = offset + transfer_sectors;
 
-    for (s = offset; s < ls; s++) {
-        while (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
-            blk = s / curr_vhdm->sect_per_block;
-            sib = s % curr_vhdm->sect_per_block;
-            if (curr_vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(curr_vhdm, blk);
-            }
-            if (!VHD_TESTBIT(curr_vhdm->bitmap.curr_bitmap, sib)) {
-                curr_vhdm = curr_vhdm->parent;
-            } else { break; }
-        }
+    /* Consecutive sectors that come from the same image in the chain are
+       read from it in one go. The chain lookups only test bits in cached
+       sector bitmaps. */
+    for (s = offset; s < ls; s += run) {
+        curr_vhdm = diff_sector_owner(vhdm, s);
+        for (run = 1; ((s + run) < ls) && (diff_sector_owner(vhdm, s + run) == curr_vhdm); run++)
+            ;
 
         /* We handle actual sector reading using the fixed or sparse functions,
            as a differencing VHD is also a sparse VHD */
         if ((curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) ||
             (curr_vhdm->footer.disk_type == MVHD_TYPE_DYNAMIC))
-            mvhd_sparse_read(curr_vhdm, s, 1, buff);
+            mvhd_sparse_read(curr_vhdm, s, run, buff);
         else
-            mvhd_fixed_read(curr_vhdm, s, 1, buff);
+            mvhd_fixed_read(curr_vhdm, s, run, buff);
         if (curr_vhdm->error) {
             curr_vhdm->error = 0;
             vhdm->error = 1;
         }
 
-        curr_vhdm = vhdm;
-        buff += MVHD_SECTOR_SIZE;
+        buff += (size_t) run * MVHD_SECTOR_SIZE;
     }
 
     return truncated_sectors;
@@ -366,50 +416,50 @@ mvhd_sparse_diff_write(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *i
     uint32_t s = 0;
     uint32_t ls = 0;
     int blk = 0;
-    int prev_blk = -1;
     int sib = 0;
+    int run = 0;
+    int k = 0;
+    int bitmap_changed = 0;
     ls = offset + transfer_sectors;
 
     if (offset < total_sectors) {
-        for (s = offset; s < ls; s++) {
+        /* The part of the write falling in each block goes out with a single
+           fwrite. The sector bitmap is written through as soon as a sector
+           becomes present, so an acknowledged write is never lost to a stale
+           bitmap; rewriting sectors that are already present costs nothing
+           extra. */
+        for (s = offset; s < ls; s += run) {
             blk = s / vhdm->sect_per_block;
             sib = s % vhdm->sect_per_block;
-            if (vhdm->bitmap.curr_block != blk && prev_blk >= 0) {
-                /* Write the sector bitmap for the previous block, before we replace it. */
-                write_curr_sect_bitmap(vhdm);
-            }
+            run = MIN(ls - s, (uint32_t) (vhdm->sect_per_block - sib));
 
-            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK) {
-                /* "read" the sector bitmap first, before creating a new block, as the bitmap will be
-                   zero either way */
-                read_sect_bitmap(vhdm, blk);
+            /* "read" the sector bitmap first, before creating a new block, as the bitmap will be
+               zero either way */
+            read_sect_bitmap(vhdm, blk);
+            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK)
                 create_block(vhdm, blk);
-            }
 
-            if (blk != prev_blk) {
-                if (vhdm->bitmap.curr_block != blk) {
-                    read_sect_bitmap(vhdm, blk);
-                    if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                        vhdm->error = 1;
-                } else {
-                    addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                           MVHD_SECTOR_SIZE;
-                    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                        vhdm->error = 1;
+            addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
+                   MVHD_SECTOR_SIZE;
+            if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
+                vhdm->error = 1;
+            if (!fwrite(buff, (size_t) run * MVHD_SECTOR_SIZE, 1, vhdm->f))
+                vhdm->error = 1;
+
+            bitmap_changed = 0;
+            for (k = sib; k < (sib + run); k++) {
+                if (!VHD_TESTBIT(vhdm->bitmap.curr_bitmap, k)) {
+                    VHD_SETBIT(vhdm->bitmap.curr_bitmap, k);
+                    bitmap_changed = 1;
                 }
-                prev_blk = blk;
             }
+            if (bitmap_changed)
+                write_curr_sect_bitmap(vhdm);
 
-            if (!fwrite(buff, MVHD_SECTOR_SIZE, 1, vhdm->f))
-                vhdm->error = 1;
-            VHD_SETBIT(vhdm->bitmap.curr_bitmap, sib);
-            buff += MVHD_SECTOR_SIZE;
+            buff += (size_t) run * MVHD_SECTOR_SIZE;
         }
     }
 
-    /* And write the sector bitmap for the last block we visited to disk */
-    write_curr_sect_bitmap(vhdm);
-
     fflush(vhdm->f);
 
     return truncated_sectors;
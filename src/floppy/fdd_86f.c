@@ -160,6 +160,33 @@ typedef struct sector_t {
     void   *prev;
 } sector_t;
 
+/* The most sectors a decoded track may hold before it is left to the bit-cell path. */
+#define DECODED_SECTORS 256
+
+typedef struct decoded_sector_t {
+    sector_id_t id;
+    uint32_t    id_pos;   /* Bit cell at which the ID address mark ends. */
+    uint32_t    data_pos; /* Bit cell at which the data address mark ends. */
+    uint32_t    data_ofs; /* Offset of the sector data in the decoded buffer. */
+    crc_t       data_crc;
+} decoded_sector_t;
+
+/*
+ * Sectors decoded from the bit cells of the current track, used to
+ * serve READ DATA without going through the MFM decoder bit by bit.
+ * It is only marked as standard if every sector has an intact ID and
+ * data field with nothing else on the track, as otherwise there is no
+ * telling what a copy protection scheme relies on.
+ */
+typedef struct decoded_track_t {
+    uint8_t          valid;
+    uint8_t          standard;
+    uint16_t         sectors;
+    uint32_t         raw_size;
+    decoded_sector_t sector[DECODED_SECTORS];
+    uint8_t          data[53048];
+} decoded_track_t;
+
 /* Disk flags:
  *  Bit 0   Has surface data (1 = yes, 0 = no)
  *  Bits 2, 1   Hole (3 = ED + 2000 kbps, 2 = ED, 1 = HD, 0 = DD)
@@ -223,6 +250,16 @@ typedef struct d86f_t {
     uint8_t    *filebuf;
     uint8_t    *outbuf;
     sector_t   *last_side_sector[2];
+
+    /* READ DATA being served from the decoded track. */
+    uint8_t         fast_read;
+    uint8_t         fast_side;
+    uint16_t        fast_sector;
+    uint32_t        fast_byte;
+    uint32_t        fast_data_len;
+    uint32_t        fast_end;
+    uint32_t        fast_cells;
+    decoded_track_t decoded[2];
 } d86f_t;
 
 static const uint8_t encoded_fm[64] = {
@@ -258,6 +295,8 @@ uint8_t  d86f_poll_read_data(int drive, int side, uint16_t pos);
 void     d86f_poll_write_data(int drive, int side, uint16_t pos, uint8_t data);
 int      d86f_format_conditions(int drive);
 
+static uint32_t d86f_fast_read_interval(int drive);
+
 #ifdef ENABLE_D86F_LOG
 int d86f_do_log = ENABLE_D86F_LOG;
 
@@ -779,8 +818,9 @@ d86f_get_encoding(int drive)
 uint64_t
 d86f_byteperiod(int drive)
 {
-    double dusec = (double) TIMER_USEC;
-    double p     = 2.0;
+    d86f_t *dev   = d86f[drive];
+    double  dusec = (double) TIMER_USEC;
+    double  p     = 2.0;
 
     switch (d86f_track_flags(drive) & 0x0f) {
         case 0x02: /* 125 kbps, FM */
@@ -808,7 +848,10 @@ d86f_byteperiod(int drive)
             break;
     }
 
-    return (uint64_t) (p * dusec);
+    /* While READ DATA is served from the decoded track, only poll when there is something to do. */
+    dev->fast_cells = dev->fast_read ? d86f_fast_read_interval(drive) : 1;
+
+    return ((uint64_t) (p * dusec)) * dev->fast_cells;
 }
 
 int
@@ -1144,6 +1187,8 @@ d86f_put_bit(int drive, int side, int bit)
     if (fdc_get_diswr(d86f_fdc))
         return;
 
+    dev->decoded[side].valid = 0;
+
     track_word = dev->track_pos >> 4;
 
     /* We need to make sure we read the bits from MSB to LSB. */
@@ -1848,6 +1893,8 @@ d86f_write_direct_common(int drive, int side, uint16_t byte, uint8_t type, uint3
     if (fdc_get_diswr(d86f_fdc))
         return;
 
+    dev->decoded[side].valid = 0;
+
     dbyte.byte  = byte & 0xff;
     dpbyte.byte = dev->preceding_bit[side] & 0xff;
 
@@ -2450,6 +2497,322 @@ d86f_turbo_poll(int drive, int side)
     }
 }
 
+static __inline int
+d86f_cell(const uint16_t *enc, int reverse, uint32_t pos)
+{
+    uint16_t word = enc[pos >> 4];
+
+    /* We store the words as big endian, unless the image is in reverse endianness. */
+    if (!reverse)
+        word = (word >> 8) | (word << 8);
+
+    return (word >> (15 - (pos & 15))) & 1;
+}
+
+/* Returns the 16 bit cells ending at pos, as d86f_get_bit() would leave them in last_word. */
+static uint16_t
+d86f_cell_word(const uint16_t *enc, int reverse, uint32_t raw, uint32_t pos)
+{
+    uint16_t word = 0;
+
+    pos = (pos + raw - 15) % raw;
+    for (uint8_t i = 0; i < 16; i++) {
+        word = (word << 1) | d86f_cell(enc, reverse, pos);
+        pos  = (pos + 1) % raw;
+    }
+
+    return word;
+}
+
+static void
+d86f_decode_track(int drive, int side)
+{
+    d86f_t           *dev     = d86f[drive];
+    decoded_track_t  *dt      = &dev->decoded[side];
+    const uint16_t   *enc     = d86f_handler[drive].encoded_data(drive, side);
+    int               reverse = d86f_reverse_bytes(drive);
+    uint32_t          raw     = d86f_handler[drive].get_raw_size(drive, side);
+    uint32_t          marks[DECODED_SECTORS * 2];
+    uint16_t          types[DECODED_SECTORS * 2];
+    uint32_t          count  = 0;
+    uint32_t          syncs  = 0;
+    uint32_t          ofs    = 0;
+    uint64_t          window = 0;
+    decoded_sector_t *s;
+    uint32_t          id;
+    uint32_t          dam;
+    uint32_t          len;
+    crc_t             crc;
+    crc_t             track_crc;
+
+    dt->valid    = 1;
+    dt->standard = 0;
+    dt->sectors  = 0;
+    dt->raw_size = raw;
+
+    if (!d86f_is_mfm(drive))
+        return;
+
+    /* Weak bits read back differently on every revolution. */
+    if (d86f_has_surface_desc(drive) && dev->track_surface_data[side]) {
+        len = d86f_get_array_size(drive, side, 1);
+        for (uint32_t i = 0; i < len; i++) {
+            if (dev->track_surface_data[side][i])
+                return;
+        }
+    }
+
+    /* Find every address mark preceded by three A1 sync marks, running past the
+       end of the track to catch the ones which straddle the index hole. */
+    for (uint32_t i = 0; i < (raw + 63); i++) {
+        window = (window << 1) | d86f_cell(enc, reverse, (i < raw) ? i : (i - raw));
+        if (i < 63)
+            continue;
+
+        if ((window & 0xffff) == 0x4489)
+            syncs++;
+        else if ((window >> 16) == 0x448944894489ULL) {
+            if (count == (DECODED_SECTORS * 2))
+                return;
+            marks[count]   = (i < raw) ? i : (i - raw);
+            types[count++] = window & 0xffff;
+        }
+    }
+
+    /* Anything but plain ID and data fields in turn is left to the bit cells. */
+    if (!count || (count & 1) || (syncs != (count * 3)))
+        return;
+
+    id = (types[0] == 0x5554) ? 0 : 1;
+    for (uint32_t i = 0; i < (count >> 1); i++, id = (id + 2) % count) {
+        dam = (id + 1) % count;
+        s   = &dt->sector[i];
+
+        if ((types[id] != 0x5554) || (types[dam] != 0x5545))
+            return;
+
+        /* The data mark must be found after the ID has been read. */
+        if (((marks[dam] + raw - marks[id]) % raw) <= 145)
+            return;
+
+        crc.word = 0xcdb4;
+        fdd_calccrc(decodefm(drive, types[id]), &crc);
+        for (uint8_t j = 0; j < 6; j++) {
+            if (j < 4) {
+                s->id.byte_array[j] = decodefm(drive, d86f_cell_word(enc, reverse, raw, marks[id] + ((j + 1) << 4)));
+                fdd_calccrc(s->id.byte_array[j], &crc);
+            } else
+                track_crc.bytes[(j & 1) ^ 1] = decodefm(drive, d86f_cell_word(enc, reverse, raw, marks[id] + ((j + 1) << 4)));
+        }
+        if ((crc.word != track_crc.word) || (s->id.id.n > 7))
+            return;
+
+        /* The data field and its CRC must end before the next ID sync marks. */
+        len = 128 << s->id.id.n;
+        if ((((marks[(dam + 1) % count] + raw - marks[dam]) % raw) <= ((len + 2) << 4) + 48) || ((ofs + len) > sizeof(dt->data)))
+            return;
+
+        crc.word = 0xcdb4;
+        fdd_calccrc(decodefm(drive, types[dam]), &crc);
+        for (uint32_t j = 0; j < (len + 2); j++) {
+            if (j < len) {
+                dt->data[ofs + j] = decodefm(drive, d86f_cell_word(enc, reverse, raw, marks[dam] + ((j + 1) << 4)));
+                fdd_calccrc(dt->data[ofs + j], &crc);
+            } else
+                s->data_crc.bytes[(j - len) ^ 1] = decodefm(drive, d86f_cell_word(enc, reverse, raw, marks[dam] + ((j + 1) << 4)));
+        }
+        if (crc.word != s->data_crc.word)
+            return;
+
+        for (uint32_t j = 0; j < i; j++) {
+            if (dt->sector[j].id.dword == s->id.dword)
+                return;
+        }
+
+        s->id_pos   = marks[id];
+        s->data_pos = marks[dam];
+        s->data_ofs = ofs;
+        ofs += len;
+    }
+
+    dt->sectors  = count >> 1;
+    dt->standard = 1;
+}
+
+/* Moves the head over a number of bit cells at once, keeping count of the index pulses on the way. */
+static void
+d86f_skip_cells(int drive, int side, uint32_t cells)
+{
+    d86f_t  *dev  = d86f[drive];
+    uint32_t raw  = d86f_handler[drive].get_raw_size(drive, side);
+    uint32_t hole = ((d86f_handler[drive].index_hole_pos(drive, side) + raw - dev->track_pos - 1) % raw) + 1;
+
+    if ((cells >= hole) && (dev->state != STATE_IDLE))
+        dev->index_count += 1 + ((cells - hole) / raw);
+
+    dev->track_pos = (dev->track_pos + cells) % raw;
+}
+
+/* Refills the shift registers the bit-cell path works from after cells were skipped. */
+static void
+d86f_sync_words(int drive, int side)
+{
+    d86f_t  *dev = d86f[drive];
+    uint32_t raw = d86f_handler[drive].get_raw_size(drive, side);
+
+    for (uint8_t i = 0; i < 2; i++)
+        dev->last_word[i] = d86f_cell_word(d86f_handler[drive].encoded_data(drive, i), d86f_reverse_bytes(drive),
+                                           raw, (dev->track_pos + raw - 1) % raw);
+}
+
+/* Bit cell at which the bit-cell path would act on the given byte of the sector being read. */
+static uint32_t
+d86f_fast_read_pos(const d86f_t *dev, uint32_t byte)
+{
+    const decoded_track_t *dt = &dev->decoded[dev->fast_side];
+
+    return (dt->sector[dev->fast_sector].data_pos + 17 + (byte << 4)) % dt->raw_size;
+}
+
+static uint32_t
+d86f_fast_read_next(const d86f_t *dev, uint32_t byte)
+{
+    return ((byte + 1) < dev->fast_data_len) ? (byte + 1) : dev->fast_end;
+}
+
+/* Number of bit cells until the poll after this one has something to do. */
+static uint32_t
+d86f_fast_read_interval(int drive)
+{
+    const d86f_t *dev = d86f[drive];
+    uint32_t      raw = dev->decoded[dev->fast_side].raw_size;
+    uint32_t      pos = d86f_fast_read_pos(dev, dev->fast_byte);
+
+    if (dev->track_pos == pos) {
+        if (dev->fast_byte == dev->fast_end)
+            return 1;
+        pos = d86f_fast_read_pos(dev, d86f_fast_read_next(dev, dev->fast_byte));
+    }
+
+    return (pos + raw - dev->track_pos) % raw;
+}
+
+/*
+ * Starts serving a READ DATA command from the decoded track, if it will
+ * find its sector the same way the bit-cell path would.
+ */
+static int
+d86f_fast_read_start(int drive, int side)
+{
+    d86f_t                 *dev = d86f[drive];
+    decoded_track_t        *dt  = &dev->decoded[side];
+    const decoded_sector_t *s   = NULL;
+    uint16_t                idx = 0;
+    uint32_t                raw;
+    uint32_t                span;
+    uint32_t                hole;
+    uint32_t                len;
+    crc_t                   crc;
+
+    /* Images which generate a new revolution every time are always read from the bit cells. */
+    if (dev->id_find.sync_marks || (d86f_handler[drive].read_revolution != common_read_revolution) ||
+        !d86f_can_read_address(drive) || d86f_wrong_densel(drive))
+        return 0;
+
+    raw = d86f_handler[drive].get_raw_size(drive, side);
+    if (!dt->valid || (dt->raw_size != raw))
+        d86f_decode_track(drive, side);
+    if (!dt->standard)
+        return 0;
+
+    for (idx = 0; idx < dt->sectors; idx++) {
+        if (dt->sector[idx].id.dword == dev->req_sector.dword) {
+            s = &dt->sector[idx];
+            break;
+        }
+    }
+    if (s == NULL)
+        return 0;
+
+    /* The ID is only found if all three of its sync marks are still ahead, and the
+       command fails if the index hole goes past twice before the data mark is. */
+    span = ((s->id_pos + (raw << 1) - 48 - dev->track_pos) % raw) + 48 + ((s->data_pos + raw - s->id_pos) % raw);
+    hole = ((d86f_handler[drive].index_hole_pos(drive, side) + raw - dev->track_pos - 1) % raw) + 1;
+    if ((span >= hole) && ((dev->index_count + 1 + ((span - hole) / raw)) >= 2))
+        return 0;
+
+    d86f_handler[drive].set_sector(drive, side, s->id.id.c, s->id.id.h, s->id.id.r, s->id.id.n);
+
+    /* Images which serve the sector data themselves must still match the CRC on the track. */
+    len = 128 << s->id.id.n;
+    if (d86f_handler[drive].read_data != NULL) {
+        crc.word = 0xcdb4;
+        fdd_calccrc(0xfb, &crc);
+        for (uint32_t i = 0; i < len; i++)
+            fdd_calccrc(d86f_handler[drive].read_data(drive, side, i), &crc);
+        if (crc.word != s->data_crc.word)
+            return 0;
+    }
+
+    dev->last_sector.dword = s->id.dword;
+    dev->id_found |= 1;
+
+    dev->fast_read     = 1;
+    dev->fast_side     = side;
+    dev->fast_sector   = idx;
+    dev->fast_data_len = MIN(len, d86f_get_data_len(drive));
+    dev->fast_end      = len + 2 + fdc_get_gap(d86f_fdc) - 1;
+    dev->fast_byte     = dev->fast_data_len ? 0 : dev->fast_end;
+
+    return 1;
+}
+
+static void
+d86f_fast_read_poll(int drive, int side)
+{
+    d86f_t                 *dev         = d86f[drive];
+    const decoded_track_t  *dt          = &dev->decoded[dev->fast_side];
+    const decoded_sector_t *s           = &dt->sector[dev->fast_sector];
+    uint32_t                cells       = fdd_get_turbo(drive) ? d86f_fast_read_interval(drive) : dev->fast_cells;
+    int                     read_status = 0;
+    uint8_t                 data;
+
+    dev->fast_cells = 1;
+
+    if (!dt->valid || (side != dev->fast_side) || (dev->req_sector.dword != s->id.dword) ||
+        (dev->state != ((dev->fast_read == 2) ? STATE_06_READ_DATA : STATE_06_FIND_ID))) {
+        /* The command was cut short or the track changed, let the bit-cell path take over. */
+        dev->fast_read = 0;
+    } else if (dev->track_pos == d86f_fast_read_pos(dev, dev->fast_byte)) {
+        if (dev->fast_byte == dev->fast_end) {
+            dev->data_find.sync_marks = dev->data_find.bits_obtained = dev->data_find.bytes_obtained = 0;
+            dev->error_condition                                                                     = 0;
+            dev->state                                                                               = STATE_IDLE;
+            dev->fast_read                                                                           = 0;
+            fdc_sector_finishread(d86f_fdc);
+        } else {
+            dev->state     = STATE_06_READ_DATA;
+            dev->fast_read = 2;
+
+            if (d86f_handler[drive].read_data != NULL)
+                data = d86f_handler[drive].read_data(drive, side, dev->fast_byte);
+            else
+                data = dt->data[s->data_ofs + dev->fast_byte];
+
+            read_status = fdc_data(d86f_fdc, data, dev->fast_byte == (dev->fast_data_len - 1));
+            if (read_status == -1)
+                dev->dma_over++;
+
+            dev->fast_byte = d86f_fast_read_next(dev, dev->fast_byte);
+        }
+    }
+
+    d86f_skip_cells(drive, side, cells);
+
+    if (!dev->fast_read)
+        d86f_sync_words(drive, side);
+}
+
 void
 d86f_poll(int drive)
 {
@@ -2473,6 +2836,11 @@ d86f_poll(int drive)
         return;
     }
 
+    if (dev->fast_read || ((dev->state == STATE_06_FIND_ID) && d86f_fast_read_start(drive, side))) {
+        d86f_fast_read_poll(drive, side);
+        return;
+    }
+
     if ((dev->state != STATE_IDLE) && (dev->state != STATE_SECTOR_NOT_FOUND) && ((dev->state & 0xF8) != 0xE8)) {
         if (!d86f_can_read_address(drive))
             dev->state = STATE_SECTOR_NOT_FOUND;
@@ -3058,6 +3426,8 @@ d86f_seek(int drive, int track)
             d86f_read_track(drive, track, 0, side, dev->track_encoded_data[side], dev->track_surface_data[side]);
     }
 
+    dev->decoded[0].valid = dev->decoded[1].valid = 0;
+
     dev->state = STATE_IDLE;
 }
 
@@ -3098,7 +3468,8 @@ d86f_set_cur_track(int drive, int track)
 {
     d86f_t *dev = d86f[drive];
 
-    dev->cur_track = track;
+    dev->cur_track        = track;
+    dev->decoded[0].valid = dev->decoded[1].valid = 0;
 }
 
 void
@@ -83,6 +83,8 @@ extern uint32_t lang_sys; /* (-) system language code */
 
 extern int dump_on_exit;        /* (O) dump regs on exit*/
 extern int start_in_fullscreen; /* (O) start in fullscreen */
+extern int turbo_mode;          /* (O) run unthrottled */
+extern int turbo_fps;           /* (O) frames presented per second in turbo mode */
 #ifdef _WIN32
 extern int force_debug; /* (O) force debug output */
 #endif
@@ -0,0 +1,34 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the headless benchmark runner.
+ */
+#ifndef EMU_BENCHMARK_H
+#define EMU_BENCHMARK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int          benchmark_mode;       /* (O) run headless and print statistics */
+extern int          benchmark_line_check; /* (O) check the scanline converters and exit */
+extern int          benchmark_secs;       /* (O) emulated seconds to run, always > 0 */
+extern volatile int benchmark_stop;       /* stop requested by the guest */
+extern int          benchmark_exit_code;  /* exit code requested by the guest */
+extern uint64_t     benchmark_timer_ns;   /* host time spent in timer callbacks */
+
+extern uint64_t benchmark_clock_ns(void);
+extern void     benchmark_request_stop(int exit_code);
+extern int      benchmark_run(void);
+extern int      benchmark_line_conv_check(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*EMU_BENCHMARK_H*/
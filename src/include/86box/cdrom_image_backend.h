@@ -89,9 +89,19 @@ typedef struct track_t {
     track_index_t idx[3];
 } track_t;
 
+/* A stretch of LBA's (+150) that resolve to the same track and index, up to
+   the start of the next one. Track -1 means no track. */
+typedef struct track_range_t {
+    uint64_t      start;
+    int32_t       track;
+    int32_t       index;
+} track_range_t;
+
 typedef struct cd_img_t {
-    int32_t       tracks_num;
-    track_t      *tracks;
+    int32_t        tracks_num;
+    track_t       *tracks;
+    int32_t        ranges_num;
+    track_range_t *ranges;
 } cd_img_t;
 
 /* Binary file functions. */
@@ -107,8 +117,10 @@ extern int  cdi_is_mode2(cd_img_t *cdi, uint32_t sector);
 extern int  cdi_get_mode2_form(cd_img_t *cdi, uint32_t sector);
 extern int  cdi_load_iso(cd_img_t *cdi, const char *filename);
 extern int  cdi_load_cue(cd_img_t *cdi, const char *cuefile);
+extern int  cdi_load_chd(cd_img_t *cdi, const char *filename);
 extern void cdi_close(cd_img_t *cdi);
 extern int  cdi_set_device(cd_img_t *cdi, const char *path);
+extern void cdi_swap_words(uint8_t *buffer, size_t count);
 
 /* Virtual ISO functions. */
 extern int           viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count);
@@ -116,4 +128,21 @@ extern uint64_t      viso_get_length(void *priv);
 extern void          viso_close(void *priv);
 extern track_file_t *viso_init(const char *dirname, int *error);
 
+/* CHD functions. */
+typedef struct chd_track_info_t {
+    int      track;
+    char     type[32];
+    char     subtype[32];
+    char     pgtype[32];
+    uint32_t frames;
+    uint32_t pregap;
+    uint32_t postgap;
+} chd_track_info_t;
+
+extern void         *chd_image_open(const char *filename);
+extern int           chd_image_get_track(void *priv, int num, chd_track_info_t *info);
+extern track_file_t *chd_image_track_init(void *priv, const char *filename, uint64_t first_frame,
+                                          uint32_t frames, uint32_t frame_size, int motorola);
+extern void          chd_image_release(void *priv);
+
 #endif /*CDROM_IMAGE_BACKEND_H*/
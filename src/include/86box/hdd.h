@@ -182,6 +182,10 @@ typedef struct hard_disk_t {
 
     uint32_t speed_preset;
     uint32_t vhd_blocksize;
+    uint32_t use_mmap; /* Map raw, HDI and HDX images into memory */
+    uint32_t overlay_discard; /* Throw the overlay away when the image is closed */
+
+    char overlay_fn[1024]; /* Copy-on-write overlay over a read-only raw, HDI or HDX image */
 
     double avg_rotation_lat_usec;
     double full_stroke_usec;
@@ -202,6 +206,7 @@ extern int      hdd_image_load(int id);
 extern int      hdd_image_seek(uint8_t id, uint32_t sector);
 extern int      hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int      hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern void     hdd_image_prefetch(uint8_t id, uint32_t sector, uint32_t count);
 extern int      hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int      hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer);
 extern int      hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count);
@@ -103,12 +103,29 @@ extern void io_handler_interleaved(int set, uint16_t base, int size,
                                    void (*outl)(uint16_t addr, uint32_t val, void *priv),
                                    void *priv);
 
+extern void io_sethandler_block(uint16_t base,
+                                int (*inw)(uint16_t addr, uint16_t *buf, int count, void *priv),
+                                int (*outw)(uint16_t addr, const uint16_t *buf, int count, void *priv),
+                                void *priv);
+
+extern void io_removehandler_block(uint16_t base,
+                                   int (*inw)(uint16_t addr, uint16_t *buf, int count, void *priv),
+                                   int (*outw)(uint16_t addr, const uint16_t *buf, int count, void *priv),
+                                   void *priv);
+
+extern void io_handler_block(int set, uint16_t base,
+                             int (*inw)(uint16_t addr, uint16_t *buf, int count, void *priv),
+                             int (*outw)(uint16_t addr, const uint16_t *buf, int count, void *priv),
+                             void *priv);
+
 extern uint8_t  inb(uint16_t port);
 extern void     outb(uint16_t port, uint8_t val);
 extern uint16_t inw(uint16_t port);
 extern void     outw(uint16_t port, uint16_t val);
 extern uint32_t inl(uint16_t port);
 extern void     outl(uint16_t port, uint32_t val);
+extern int      inw_block(uint16_t port, uint16_t *buf, int count);
+extern int      outw_block(uint16_t port, const uint16_t *buf, int count);
 
 extern void *io_trap_add(void (*func)(int size, uint16_t addr, uint8_t write, uint8_t val, void *priv),
                          void *priv);
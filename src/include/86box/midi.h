@@ -31,7 +31,7 @@ extern void        midi_in_device_init(void);
 typedef struct midi_device_t {
     void (*play_sysex)(uint8_t *sysex, unsigned int len);
     void (*play_msg)(uint8_t *msg);
-    void (*poll)(void);
+    void (*poll)(int samples); /* Called with the samples elapsed at SOUND_FREQ. */
     void (*reset)(void);
     int (*write)(uint8_t val);
 } midi_device_t;
@@ -77,7 +77,7 @@ extern void midi_raw_out_rt_byte(uint8_t val);
 extern void midi_raw_out_thru_rt_byte(uint8_t val);
 extern void midi_raw_out_byte(uint8_t val);
 extern void midi_clear_buffer(void);
-extern void midi_poll(void);
+extern void midi_poll(int samples);
 extern void midi_reset(void);
 
 extern void midi_in_handler(int set, void (*msg)(void *priv, uint8_t *msg, uint32_t len), int (*sysex)(void *priv, uint8_t *buffer, uint32_t len, int abort), void *priv);
@@ -160,6 +160,7 @@ extern void     plat_resize_request(int x, int y, int monitor_index);
 extern uint32_t plat_language_code(char *langcode);
 extern void     plat_language_code_r(uint32_t lcid, char *outbuf, int len);
 extern void     plat_get_cpu_string(char *outbuf, uint8_t len);
+extern int      plat_get_cpu_count(void);
 extern void     plat_set_thread_name(void *thread, const char *name);
 
 /* Resource management. */
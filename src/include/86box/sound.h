@@ -52,13 +52,14 @@ extern int gated;
 extern int speakval;
 extern int speakon;
 
-extern int sound_pos_global;
-
-extern int music_pos_global;
-extern int wavetable_pos_global;
-
 extern int sound_card_current[SOUND_CARD_MAX];
 
+/* Sample the guest has reached within the buffer being filled, for devices
+   catching up their output when a register is touched. */
+extern int sound_get_pos(void);
+extern int music_get_pos(void);
+extern int wavetable_get_pos(void);
+
 extern void sound_add_handler(void (*get_buffer)(int32_t *buffer,
                                                  int len, void *priv),
                               void *priv);
@@ -100,6 +101,7 @@ extern void sound_card_reset(void);
 
 extern void sound_cd_thread_end(void);
 extern void sound_cd_thread_reset(void);
+extern void sound_mix_thread_end(void);
 
 extern void closeal(void);
 extern void inital(void);
@@ -52,6 +52,9 @@ typedef struct pc_timer_t {
 
     struct pc_timer_t *prev;
     struct pc_timer_t *next;
+
+    int      heap_idx; /* Position in the timer heap, -1 if not queued. */
+    uint32_t seq;      /* Enable order, breaks ties between equal timestamps. */
 } pc_timer_t;
 
 #ifdef __cplusplus
@@ -0,0 +1,52 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Span kernels and band workers shared by the 2D blitters.
+ *
+ *          Raster operations are given as ROP2 truth tables: bit
+ *          ((src << 1) | dst) of the operation is the result for that
+ *          pair of source and destination bits.
+ */
+
+#ifndef VIDEO_BLIT_SPAN_H
+#define VIDEO_BLIT_SPAN_H
+
+#define BLIT_ROP_ZERO 0x0
+#define BLIT_ROP_DST  0xa
+#define BLIT_ROP_SRC  0xc
+#define BLIT_ROP_ONE  0xf
+
+/*Whether the result of a raster operation depends on the destination.*/
+#define BLIT_ROP_READS_DST(rop) ((((rop) >> 1) & 5) != ((rop) & 5))
+
+/*Bands smaller than this are not worth waking another thread for.*/
+#define BLIT_BAND_MIN_ROWS 32
+
+typedef void (*blit_band_func_t)(void *priv, int start, int end);
+
+typedef struct blit_bands_t blit_bands_t;
+
+/*Fills count pixels of bpp bytes each with col. bpp may be 1 to 4.*/
+extern void blit_span_fill(uint8_t *dst, uint32_t col, int count, int bpp, int rop);
+
+/*Draws count pixels from a row of 8 repeating colours, starting with
+  cols[phase].*/
+extern void blit_span_pattern(uint8_t *dst, const uint32_t *cols, int phase, int count, int bpp, int rop);
+
+/*Combines bytes bytes of src into dst. Overlapping spans are handled like
+  memmove().*/
+extern void blit_span_copy(uint8_t *dst, const uint8_t *src, int bytes, int rop);
+
+extern blit_bands_t *blit_bands_init(int threads);
+extern void          blit_bands_close(blit_bands_t *bands);
+
+/*Runs func over rows [0, rows), split into one band per thread, and returns
+  once every band is done. The calling thread draws the first band.*/
+extern void blit_bands_run(blit_bands_t *bands, int rows, blit_band_func_t func, void *priv);
+
+#endif /*VIDEO_BLIT_SPAN_H*/
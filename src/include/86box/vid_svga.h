@@ -114,6 +114,8 @@ typedef struct svga_t {
     int lastline;
     int firstline_draw;
     int lastline_draw;
+    int blit_x_add;
+    int blit_y_add;
     int displine;
     int fullchange;
     int x_add;
@@ -161,6 +163,7 @@ typedef struct svga_t {
     uint32_t  banked_mask;
     uint32_t  ca;
     uint32_t  overscan_color;
+    uint32_t  blit_overscan_color;
     uint32_t *map8;
     uint32_t  pallook[512];
 
@@ -376,6 +379,7 @@ enum {
 };
 
 uint32_t svga_lookup_lut_ram(svga_t* svga, uint32_t val);
+uint32_t svga_conv_16to32(struct svga_t *svga, uint16_t color, uint8_t bpp);
 
 /* We need a way to add a device with a pointer to a parent device so it can attach itself to it, and
    possibly also a second ATi 68860 RAM DAC type that auto-sets SVGA render on RAM DAC render change. */
@@ -38,6 +38,23 @@ extern uint8_t egaremap2bpp[256];
 
 extern void svga_recalc_remap_func(svga_t *svga);
 
+/* Converters for contiguous runs of VRAM, picked for the host CPU. */
+typedef struct svga_line_conv_t {
+    const char *name;
+    void (*conv_8to32)(uint32_t *dst, const uint8_t *src, const uint32_t *pal, uint32_t mask, int count);
+    void (*conv_15to32)(uint32_t *dst, const uint8_t *src, int count);
+    void (*conv_16to32)(uint32_t *dst, const uint8_t *src, int count);
+    void (*conv_24to32)(uint32_t *dst, const uint8_t *src, int count);
+    void (*conv_32to32)(uint32_t *dst, const uint8_t *src, int count);
+    void (*conv_abgr8888)(uint32_t *dst, const uint8_t *src, int count);
+    void (*conv_rgba8888)(uint32_t *dst, const uint8_t *src, int count);
+} svga_line_conv_t;
+
+extern svga_line_conv_t       svga_line_conv;
+extern const svga_line_conv_t svga_line_conv_c;
+
+extern void svga_line_conv_init(void);
+
 extern void svga_render_null(svga_t *svga);
 extern void svga_render_blank(svga_t *svga);
 extern void svga_render_overscan_left(svga_t *svga);
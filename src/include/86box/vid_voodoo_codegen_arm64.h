@@ -0,0 +1,1597 @@
+/*Registers :
+
+  alphaMode
+  fbzMode & 0x1f3fff
+  fbzColorPath
+*/
+
+/*AArch64 port of the x86-64 pipeline generator. The generated code follows
+  the x86-64 version instruction for instruction, with the x86 registers
+  mapped as follows :
+
+  X0 = state, X1 = params, W3 = real_y
+  W4-W7 = EAX, EBX, ECX, EDX
+  X8 = RBP, X15 = RSI (when not params), X16/X17 = scratch
+  X9 = logtable, X14 = bilinear_lookup
+  V0-V7 = XMM0-XMM7
+  V16 = xmm_01_w, V17 = xmm_ff_w, V18 = xmm_ff_b, V19 = minus_254
+  V20 = colbfog (XMM15), V21/V22 = scratch
+
+  The alookup/aminuslookup/xmm_00_ff_w tables are replaced by DUPs from
+  general purpose registers. Only caller saved registers are used, so no
+  prologue or epilogue is needed.*/
+
+#ifndef VIDEO_VOODOO_CODEGEN_ARM64_H
+#define VIDEO_VOODOO_CODEGEN_ARM64_H
+
+#if defined(__APPLE__) && defined(__aarch64__)
+#    include <pthread.h>
+#endif
+#ifdef _MSC_VER
+#    include <windows.h>
+#endif
+
+#define BLOCK_SIZE 8192
+
+#define addlong(val)                                \
+    do {                                            \
+        *(uint32_t *) &code_block[block_pos] = val; \
+        block_pos += 4;                             \
+    } while (0)
+
+#define REG_STATE    0
+#define REG_PARAMS   1
+#define REG_REAL_Y   3
+#define REG_EAX      4
+#define REG_EBX      5
+#define REG_ECX      6
+#define REG_EDX      7
+#define REG_EBP      8
+#define REG_LOGTABLE 9
+#define REG_BILINEAR 14
+#define REG_ESI      15
+#define REG_TEMP     16
+#define REG_TEMP2    17
+#define REG_ZR       31
+
+#define REG_XMM_01_W  16
+#define REG_XMM_FF_W  17
+#define REG_XMM_FF_B  18
+#define REG_MINUS_254 19
+#define REG_COLBFOG   20
+#define REG_VTEMP     21
+#define REG_VTEMP2    22
+
+#define COND_EQ 0x0
+#define COND_NE 0x1
+#define COND_HS 0x2
+#define COND_LO 0x3
+#define COND_MI 0x4
+#define COND_HI 0x8
+#define COND_LS 0x9
+#define COND_GE 0xa
+#define COND_LT 0xb
+
+/*Integer instructions*/
+#define A64_MOVZ_W(d, imm, hw)          (0x52800000 | ((hw) << 21) | (((imm) & 0xffff) << 5) | (d))
+#define A64_MOVK_W(d, imm, hw)          (0x72800000 | ((hw) << 21) | (((imm) & 0xffff) << 5) | (d))
+#define A64_MOVZ_X(d, imm, hw)          (0xd2800000 | ((hw) << 21) | (((imm) & 0xffff) << 5) | (d))
+#define A64_MOVK_X(d, imm, hw)          (0xf2800000 | ((hw) << 21) | (((imm) & 0xffff) << 5) | (d))
+#define A64_MOV_W(d, m)                 (0x2a0003e0 | ((m) << 16) | (d))
+#define A64_ADD_IMM_W(d, n, imm)        (0x11000000 | ((imm) << 10) | ((n) << 5) | (d))
+#define A64_ADD_IMM_X(d, n, imm)        (0x91000000 | ((imm) << 10) | ((n) << 5) | (d))
+#define A64_SUB_IMM_W(d, n, imm)        (0x51000000 | ((imm) << 10) | ((n) << 5) | (d))
+#define A64_ADDS_IMM_W(d, n, imm)       (0x31000000 | ((imm) << 10) | ((n) << 5) | (d))
+#define A64_CMP_IMM_W(n, imm)           (0x7100001f | ((imm) << 10) | ((n) << 5))
+#define A64_ADD_W(d, n, m)              (0x0b000000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_ADD_LSL_W(d, n, m, shift)   (0x0b000000 | ((m) << 16) | ((shift) << 10) | ((n) << 5) | (d))
+#define A64_ADD_X(d, n, m)              (0x8b000000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_ADD_UXTW_X(d, n, m, shift)  (0x8b204000 | ((m) << 16) | ((shift) << 10) | ((n) << 5) | (d))
+#define A64_SUB_W(d, n, m)              (0x4b000000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_NEG_W(d, m)                 (0x4b0003e0 | ((m) << 16) | (d))
+#define A64_CMP_W(n, m)                 (0x6b00001f | ((m) << 16) | ((n) << 5))
+#define A64_CMP_X(n, m)                 (0xeb00001f | ((m) << 16) | ((n) << 5))
+#define A64_ORR_W(d, n, m)              (0x2a000000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_EOR_W(d, n, m)              (0x4a000000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_AND_W(d, n, m)              (0x0a000000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_MVN_W(d, m)                 (0x2a2003e0 | ((m) << 16) | (d))
+/*Logical immediates, restricted to a single run of len ones starting at bit lsb*/
+#define A64_LOGIC_IMM_W(op, d, n, lsb, len) ((op) | (((32 - (lsb)) & 31) << 16) | (((len) - 1) << 10) | ((n) << 5) | (d))
+#define A64_AND_IMM_W(d, n, lsb, len)   A64_LOGIC_IMM_W(0x12000000, d, n, lsb, len)
+#define A64_EOR_IMM_W(d, n, lsb, len)   A64_LOGIC_IMM_W(0x52000000, d, n, lsb, len)
+#define A64_ANDS_IMM_W(d, n, lsb, len)  A64_LOGIC_IMM_W(0x72000000, d, n, lsb, len)
+#define A64_LSL_IMM_W(d, n, shift)      (0x53000000 | (((32 - (shift)) & 31) << 16) | ((31 - (shift)) << 10) | ((n) << 5) | (d))
+#define A64_LSR_IMM_W(d, n, shift)      (0x53007c00 | ((shift) << 16) | ((n) << 5) | (d))
+#define A64_ASR_IMM_W(d, n, shift)      (0x13007c00 | ((shift) << 16) | ((n) << 5) | (d))
+#define A64_UBFX_W(d, n, lsb, width)    (0x53000000 | ((lsb) << 16) | (((lsb) + (width) - 1) << 10) | ((n) << 5) | (d))
+#define A64_LSL_IMM_X(d, n, shift)      (0xd3400000 | (((64 - (shift)) & 63) << 16) | ((63 - (shift)) << 10) | ((n) << 5) | (d))
+#define A64_LSR_IMM_X(d, n, shift)      (0xd340fc00 | ((shift) << 16) | ((n) << 5) | (d))
+#define A64_ASR_IMM_X(d, n, shift)      (0x9340fc00 | ((shift) << 16) | ((n) << 5) | (d))
+#define A64_LSLV_W(d, n, m)             (0x1ac02000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_LSRV_W(d, n, m)             (0x1ac02400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_ASRV_W(d, n, m)             (0x1ac02800 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_LSRV_X(d, n, m)             (0x9ac02400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_MUL_W(d, n, m)              (0x1b007c00 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_MUL_X(d, n, m)              (0x9b007c00 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_SDIV_X(d, n, m)             (0x9ac00c00 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_CLZ_W(d, n)                 (0x5ac01000 | ((n) << 5) | (d))
+#define A64_CLZ_X(d, n)                 (0xdac01000 | ((n) << 5) | (d))
+#define A64_CSEL_W(d, n, m, cond)       (0x1a800000 | ((m) << 16) | ((cond) << 12) | ((n) << 5) | (d))
+
+/*Branches. Offsets are in instructions*/
+#define A64_B(offset)                   (0x14000000 | ((offset) & 0x3ffffff))
+#define A64_BCOND(cond, offset)         (0x54000000 | (((offset) & 0x7ffff) << 5) | (cond))
+#define A64_CBZ_W(t, offset)            (0x34000000 | (((offset) & 0x7ffff) << 5) | (t))
+#define A64_CBNZ_W(t, offset)           (0x35000000 | (((offset) & 0x7ffff) << 5) | (t))
+#define A64_TBZ(t, bit, offset)         (0x36000000 | ((bit) << 19) | (((offset) & 0x3fff) << 5) | (t))
+#define A64_RET                         0xd65f03c0
+
+/*Loads and stores, base register plus immediate offset (see codegen_arm64_ldst())*/
+#define A64_LDRB_W 0x39400000
+#define A64_LDRH_W 0x79400000
+#define A64_LDR_W  0xb9400000
+#define A64_LDR_X  0xf9400000
+#define A64_STRH_W 0x79000000
+#define A64_STR_W  0xb9000000
+#define A64_STR_X  0xf9000000
+#define A64_LDR_S  0xbd400000
+#define A64_LDR_D  0xfd400000
+#define A64_LDR_Q  0x3dc00000
+#define A64_STR_D  0xfd000000
+#define A64_STR_Q  0x3d800000
+
+/*Loads and stores, base register plus 32-bit index register scaled by the access size*/
+#define A64_LDRB_UXTW(t, n, m)          (0x38604800 | ((m) << 16) | ((n) << 5) | (t))
+#define A64_LDRH_UXTW(t, n, m)          (0x78605800 | ((m) << 16) | ((n) << 5) | (t))
+#define A64_STRH_UXTW(t, n, m)          (0x78205800 | ((m) << 16) | ((n) << 5) | (t))
+#define A64_LDR_W_UXTW(t, n, m)         (0xb8605800 | ((m) << 16) | ((n) << 5) | (t))
+#define A64_LDR_X_UXTW(t, n, m)         (0xf8605800 | ((m) << 16) | ((n) << 5) | (t))
+#define A64_LDR_S_UXTW(t, n, m)         (0xbc605800 | ((m) << 16) | ((n) << 5) | (t))
+#define A64_LDRB_X(t, n, m)             (0x38606800 | ((m) << 16) | ((n) << 5) | (t))
+
+/*SIMD instructions. .4H/.8B forms are used where x86 operates on the low
+  quadword only, full width forms elsewhere so the upper quadword matches the
+  x86 register contents*/
+#define A64_FMOV_S_W(d, n)              (0x1e270000 | ((n) << 5) | (d))
+#define A64_FMOV_W_S(d, n)              (0x1e260000 | ((n) << 5) | (d))
+#define A64_DUP_4H_W(d, n)              (0x0e020c00 | ((n) << 5) | (d))
+#define A64_DUP_4H_ELEM(d, n, i)        (0x0e000400 | ((((i) << 2) | 2) << 16) | ((n) << 5) | (d))
+#define A64_DUP_2S_ELEM0(d, n)          (0x0e040400 | ((n) << 5) | (d))
+#define A64_DUP_2D_ELEM0(d, n)          (0x4e080400 | ((n) << 5) | (d))
+#define A64_INS_H_W(d, i, n)            (0x4e001c00 | ((((i) << 2) | 2) << 16) | ((n) << 5) | (d))
+#define A64_MOV_8B(d, n)                (0x0ea01c00 | ((n) << 16) | ((n) << 5) | (d))
+#define A64_MOVI_ZERO(d)                (0x6f00e400 | (d))
+#define A64_UXTL_8H(d, n)               (0x2f08a400 | ((n) << 5) | (d))
+#define A64_SQXTN_4H(d, n)              (0x0e614800 | ((n) << 5) | (d))
+#define A64_SQXTUN_8B(d, n)             (0x2e212800 | ((n) << 5) | (d))
+#define A64_SQXTUN2_16B(d, n)           (0x6e212800 | ((n) << 5) | (d))
+#define A64_SMULL_4S(d, n, m)           (0x0e60c000 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_MUL_8H(d, n, m)             (0x4e609c00 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_ADD_8H(d, n, m)             (0x4e608400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_ADD_16B(d, n, m)            (0x4e208400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_ADD_4S(d, n, m)             (0x4ea08400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_ADD_2D(d, n, m)             (0x4ee08400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_SUB_8H(d, n, m)             (0x6e608400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_SUB_4S(d, n, m)             (0x6ea08400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_SUB_2D(d, n, m)             (0x6ee08400 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_EOR_16B(d, n, m)            (0x6e201c00 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_UQADD_16B(d, n, m)          (0x6e200c00 | ((m) << 16) | ((n) << 5) | (d))
+#define A64_EXT_16B(d, n, m, index)     (0x6e000000 | ((m) << 16) | ((index) << 11) | ((n) << 5) | (d))
+#define A64_USHR_8H(d, n, shift)        (0x6f000400 | ((32 - (shift)) << 16) | ((n) << 5) | (d))
+#define A64_SSHR_8H(d, n, shift)        (0x4f000400 | ((32 - (shift)) << 16) | ((n) << 5) | (d))
+#define A64_SSHR_4S(d, n, shift)        (0x4f000400 | ((64 - (shift)) << 16) | ((n) << 5) | (d))
+
+/*Branch fixups*/
+#define A64_PATCH_BCOND(pos)                                                                        \
+    do {                                                                                            \
+        *(uint32_t *) &code_block[pos] |= ((((block_pos) - (pos)) >> 2) & 0x7ffff) << 5;            \
+    } while (0)
+#define A64_PATCH_B(pos)                                                                            \
+    do {                                                                                            \
+        *(uint32_t *) &code_block[pos] |= (((block_pos) - (pos)) >> 2) & 0x3ffffff;                 \
+    } while (0)
+
+/*x86 PACKSSDW/PACKUSWB of a register with itself*/
+#define addpackssdw(reg)                                     \
+    do {                                                     \
+        addlong(A64_SQXTN_4H(reg, reg));                     \
+        addlong(A64_DUP_2D_ELEM0(reg, reg));                 \
+    } while (0)
+#define addpackuswb(reg)                                     \
+    do {                                                     \
+        addlong(A64_SQXTUN_8B(reg, reg));                    \
+        addlong(A64_DUP_2D_ELEM0(reg, reg));                 \
+    } while (0)
+
+#define addldst(opcode, rt, rn, offset) block_pos = codegen_arm64_ldst(code_block, block_pos, opcode, rt, rn, offset)
+#define addmovimm(rd, imm)              block_pos = codegen_arm64_mov_imm(code_block, block_pos, rd, imm, 0)
+#define addmovimm64(rd, imm)            block_pos = codegen_arm64_mov_imm(code_block, block_pos, rd, imm, 1)
+
+static const uint64_t voodoo_neon_consts[4] = {
+    0x0001000100010001ULL, /*xmm_01_w*/
+    0x00ff00ff00ff00ffULL, /*xmm_ff_w*/
+    0x0000000000ffffffULL, /*xmm_ff_b*/
+    0xff02ff02ff02ff02ULL  /*minus_254*/
+};
+
+static uint16_t bilinear_lookup[256 * 2][8];
+
+static inline int
+codegen_arm64_ldst(uint8_t *code_block, int block_pos, uint32_t opcode, int rt, int rn, int offset)
+{
+    int scale = opcode >> 30;
+
+    if ((opcode & 0x04800000) == 0x04800000) /*128-bit SIMD*/
+        scale = 4;
+
+    if ((offset >= 0) && !(offset & ((1 << scale) - 1)) && ((offset >> scale) < 4096))
+        addlong(opcode | ((offset >> scale) << 10) | (rn << 5) | rt);
+    else if ((offset >= -256) && (offset < 256)) /*Unscaled form*/
+        addlong((opcode & ~0x01000000) | ((offset & 0x1ff) << 12) | (rn << 5) | rt);
+    else {
+        addlong(A64_ADD_IMM_X(REG_TEMP2, rn, offset));
+        addlong(opcode | (REG_TEMP2 << 5) | rt);
+    }
+
+    return block_pos;
+}
+
+static inline int
+codegen_arm64_mov_imm(uint8_t *code_block, int block_pos, int rd, uint64_t imm, int is_64)
+{
+    int num_hw = is_64 ? 4 : 2;
+    int first  = 1;
+
+    if (!is_64)
+        imm &= 0xffffffff;
+
+    for (int hw = 0; hw < num_hw; hw++) {
+        uint16_t val = (imm >> (hw * 16)) & 0xffff;
+
+        if (!val && !(first && (hw == (num_hw - 1))))
+            continue;
+        if (first) {
+            addlong(is_64 ? A64_MOVZ_X(rd, val, hw) : A64_MOVZ_W(rd, val, hw));
+            first = 0;
+        } else
+            addlong(is_64 ? A64_MOVK_X(rd, val, hw) : A64_MOVK_W(rd, val, hw));
+    }
+
+    return block_pos;
+}
+
+static inline int
+codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int block_pos, int tmu)
+{
+    if (params->textureMode[tmu] & 1) {
+        addldst(A64_LDR_X, REG_EBX, REG_STATE, tmu ? offsetof(voodoo_state_t, tmu1_s) : offsetof(voodoo_state_t, tmu0_s)); /*LDR X5, state->tmu0_s*/
+        addlong(A64_MOVZ_X(REG_EAX, 1, 3)); /*MOV X4, (1 << 48)*/
+        addlong(A64_MOVZ_X(REG_EDX, 0, 0)); /*MOV X7, #0*/
+        addldst(A64_LDR_X, REG_ECX, REG_STATE, tmu ? offsetof(voodoo_state_t, tmu1_t) : offsetof(voodoo_state_t, tmu0_t)); /*LDR X6, state->tmu0_t*/
+        addldst(A64_LDR_X, REG_TEMP, REG_STATE, tmu ? offsetof(voodoo_state_t, tmu1_w) : offsetof(voodoo_state_t, tmu0_w)); /*LDR X16, state->tmu0_w*/
+        addlong(A64_CMP_X(REG_TEMP, REG_ZR)); /*CMP X16, #0*/
+        addlong(A64_BCOND(COND_EQ, 2));       /*B.EQ +*/
+        addlong(A64_SDIV_X(REG_EAX, REG_EAX, REG_TEMP)); /*SDIV X4, X4, X16*/
+        addlong(A64_ASR_IMM_X(REG_EBX, REG_EBX, 14));    /*ASR X5, X5, #14*/
+        addlong(A64_ASR_IMM_X(REG_ECX, REG_ECX, 14));    /*ASR X6, X6, #14*/
+        addlong(A64_MUL_X(REG_EBX, REG_EBX, REG_EAX));   /*MUL X5, X5, X4*/
+        addlong(A64_MUL_X(REG_ECX, REG_ECX, REG_EAX));   /*MUL X6, X6, X4*/
+        addlong(A64_ASR_IMM_X(REG_EBX, REG_EBX, 30));    /*ASR X5, X5, #30*/
+        addlong(A64_ASR_IMM_X(REG_ECX, REG_ECX, 30));    /*ASR X6, X6, #30*/
+        /*BSR EDX, RAX - EDX is left at 0 when RAX is 0*/
+        addlong(A64_CLZ_X(REG_TEMP, REG_EAX));                       /*CLZ X16, X4*/
+        addlong(A64_MOVZ_W(REG_TEMP2, 63, 0));                       /*MOV W17, #63*/
+        addlong(A64_SUB_W(REG_TEMP, REG_TEMP2, REG_TEMP));           /*SUB W16, W17, W16*/
+        addlong(A64_CMP_X(REG_EAX, REG_ZR));                         /*CMP X4, #0*/
+        addlong(A64_CSEL_W(REG_EDX, REG_TEMP, REG_EDX, COND_NE));    /*CSEL W7, W16, W7, NE*/
+        addlong(A64_LSL_IMM_X(REG_EAX, REG_EAX, 8));                 /*LSL X4, X4, #8*/
+        addldst(A64_STR_W, REG_ECX, REG_STATE, offsetof(voodoo_state_t, tex_t)); /*STR W6, state->tex_t*/
+        addlong(A64_MOV_W(REG_ECX, REG_EDX));                        /*MOV W6, W7*/
+        addlong(A64_SUB_IMM_W(REG_EDX, REG_EDX, 19));                /*SUB W7, W7, #19*/
+        addlong(A64_LSRV_X(REG_EAX, REG_EAX, REG_ECX));              /*LSR X4, X4, X6*/
+        addlong(A64_LSL_IMM_W(REG_EDX, REG_EDX, 8));                 /*LSL W7, W7, #8*/
+        addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 0, 8));              /*AND W4, W4, #0xff*/
+        addldst(A64_STR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, tex_s)); /*STR W5, state->tex_s*/
+        addlong(A64_LDRB_X(REG_EAX, REG_LOGTABLE, REG_EAX));         /*LDRB W4, [X9(logtable), X4]*/
+        addlong(A64_ORR_W(REG_EAX, REG_EAX, REG_EDX));               /*ORR W4, W4, W7*/
+        addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, tmu[tmu].lod)); /*LDR W16, state->lod*/
+        addlong(A64_ADD_W(REG_EAX, REG_EAX, REG_TEMP));              /*ADD W4, W4, W16*/
+        addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, lod_min[tmu])); /*LDR W16, state->lod_min*/
+        addlong(A64_CMP_W(REG_EAX, REG_TEMP));                       /*CMP W4, W16*/
+        addlong(A64_CSEL_W(REG_EAX, REG_TEMP, REG_EAX, COND_LT));    /*CSEL W4, W16, W4, LT*/
+        addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, lod_max[tmu])); /*LDR W16, state->lod_max*/
+        addlong(A64_CMP_W(REG_EAX, REG_TEMP));                       /*CMP W4, W16*/
+        addlong(A64_CSEL_W(REG_EAX, REG_TEMP, REG_EAX, COND_GE));    /*CSEL W4, W16, W4, GE*/
+        addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 8));                 /*LSR W4, W4, #8*/
+        addldst(A64_STR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, lod)); /*STR W4, state->lod*/
+    } else {
+        addldst(A64_LDR_X, REG_EAX, REG_STATE, tmu ? offsetof(voodoo_state_t, tmu1_s) : offsetof(voodoo_state_t, tmu0_s)); /*LDR X4, state->tmu0_s*/
+        addldst(A64_LDR_X, REG_ECX, REG_STATE, tmu ? offsetof(voodoo_state_t, tmu1_t) : offsetof(voodoo_state_t, tmu0_t)); /*LDR X6, state->tmu0_t*/
+        addlong(A64_LSR_IMM_X(REG_EAX, REG_EAX, 28)); /*LSR X4, X4, #28*/
+        addldst(A64_LDR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, lod_min[tmu])); /*LDR W5, state->lod_min*/
+        addlong(A64_LSR_IMM_X(REG_ECX, REG_ECX, 28)); /*LSR X6, X6, #28*/
+        /*tex_s and tex_t are written as 64-bit values, as the x86-64 generator does*/
+        addldst(A64_STR_X, REG_EAX, REG_STATE, offsetof(voodoo_state_t, tex_s)); /*STR X4, state->tex_s*/
+        addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 8)); /*LSR W5, W5, #8*/
+        addldst(A64_STR_X, REG_ECX, REG_STATE, offsetof(voodoo_state_t, tex_t)); /*STR X6, state->tex_t*/
+        addldst(A64_STR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, lod)); /*STR W5, state->lod*/
+    }
+
+    if (params->fbzColorPath & FBZCP_TEXTURE_ENABLED) {
+        if (voodoo->bilinear_enabled && (params->textureMode[tmu] & 6)) {
+            int clamp_pos;
+            int clamp_pos2 = 0;
+            int done_pos;
+
+            addlong(A64_MOVZ_W(REG_EDX, 8, 0)); /*MOV W7, #8*/
+            addldst(A64_LDR_W, REG_ECX, REG_STATE, offsetof(voodoo_state_t, lod)); /*LDR W6, state->lod*/
+            addlong(A64_MOVZ_W(REG_EBP, 1, 0));                  /*MOV W8, #1*/
+            addlong(A64_SUB_W(REG_EDX, REG_EDX, REG_ECX));       /*SUB W7, W7, W6*/
+            addlong(A64_LSLV_W(REG_EBP, REG_EBP, REG_ECX));      /*LSL W8, W8, W6*/
+            addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, tex_s)); /*LDR W4, state->tex_s*/
+            addlong(A64_LSL_IMM_W(REG_EBP, REG_EBP, 3));         /*LSL W8, W8, #3*/
+            addldst(A64_LDR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, tex_t)); /*LDR W5, state->tex_t*/
+            if (params->tLOD[tmu] & LOD_TMIRROR_S) {
+                addlong(A64_TBZ(REG_EAX, 12, 2));     /*TBZ W4, #12, +*/
+                addlong(A64_MVN_W(REG_EAX, REG_EAX)); /*MVN W4, W4*/
+            }
+            if (params->tLOD[tmu] & LOD_TMIRROR_T) {
+                addlong(A64_TBZ(REG_EBX, 12, 2));     /*TBZ W5, #12, +*/
+                addlong(A64_MVN_W(REG_EBX, REG_EBX)); /*MVN W5, W5*/
+            }
+            addlong(A64_SUB_W(REG_EAX, REG_EAX, REG_EBP));  /*SUB W4, W4, W8*/
+            addlong(A64_SUB_W(REG_EBX, REG_EBX, REG_EBP));  /*SUB W5, W5, W8*/
+            addlong(A64_ASRV_W(REG_EAX, REG_EAX, REG_ECX)); /*ASR W4, W4, W6*/
+            addlong(A64_ASRV_W(REG_EBX, REG_EBX, REG_ECX)); /*ASR W5, W5, W6*/
+            addlong(A64_MOV_W(REG_EBP, REG_EAX));           /*MOV W8, W4*/
+            addlong(A64_MOV_W(REG_ECX, REG_EBX));           /*MOV W6, W5*/
+            addlong(A64_AND_IMM_W(REG_EBP, REG_EBP, 0, 4)); /*AND W8, W8, #0xf*/
+            addlong(A64_LSL_IMM_W(REG_ECX, REG_ECX, 4));    /*LSL W6, W6, #4*/
+            addlong(A64_ASR_IMM_W(REG_EAX, REG_EAX, 4));    /*ASR W4, W4, #4*/
+            addlong(A64_AND_IMM_W(REG_ECX, REG_ECX, 4, 4)); /*AND W6, W6, #0xf0*/
+            addlong(A64_ASR_IMM_W(REG_EBX, REG_EBX, 4));    /*ASR W5, W5, #4*/
+            addlong(A64_ORR_W(REG_EBP, REG_EBP, REG_ECX));  /*ORR W8, W8, W6*/
+            addldst(A64_LDR_W, REG_ECX, REG_STATE, offsetof(voodoo_state_t, lod)); /*LDR W6, state->lod*/
+            addlong(A64_LSL_IMM_W(REG_EBP, REG_EBP, 5));    /*LSL W8, W8, #5*/
+            /*W4 = S, W5 = T, W6 = LOD, W7 = tex_shift, X15 = params, X0 = state, W8 = bilinear shift*/
+            addlong(A64_ADD_UXTW_X(REG_ESI, REG_PARAMS, REG_ECX, 2)); /*ADD X15, X1, W6, UXTW #2*/
+            addldst(A64_STR_W, REG_EBP, REG_STATE, offsetof(voodoo_state_t, ebp_store)); /*STR W8, ebp_store*/
+            addlong(A64_ADD_IMM_X(REG_TEMP, REG_STATE, offsetof(voodoo_state_t, tex[tmu]))); /*ADD X16, X0, state->tex*/
+            addlong(A64_LDR_X_UXTW(REG_EBP, REG_TEMP, REG_ECX)); /*LDR X8, [X16, W6, UXTW #3]*/
+            addlong(A64_MOV_W(REG_ECX, REG_EDX));                /*MOV W6, W7*/
+            addlong(A64_MOV_W(REG_EDX, REG_EBX));                /*MOV W7, W5*/
+            if (!state->clamp_s[tmu]) {
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_w_mask[tmu])); /*LDR W16, params->tex_w_mask[X15]*/
+                addlong(A64_AND_W(REG_EAX, REG_EAX, REG_TEMP));                                   /*AND W4, W4, W16*/
+            }
+            if (state->clamp_t[tmu]) {
+                addlong(A64_ADDS_IMM_W(REG_EDX, REG_EDX, 1)); /*ADDS W7, W7, #1*/
+                addlong(A64_CSEL_W(REG_EDX, REG_ZR, REG_EDX, COND_MI)); /*CSEL W7, WZR, W7, MI*/
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_h_mask[tmu])); /*LDR W16, params->tex_h_mask[X15]*/
+                addlong(A64_CMP_W(REG_EDX, REG_TEMP));                     /*CMP W7, W16*/
+                addlong(A64_CSEL_W(REG_EDX, REG_TEMP, REG_EDX, COND_HI));  /*CSEL W7, W16, W7, HI*/
+                addlong(A64_CMP_IMM_W(REG_EBX, 0));                        /*CMP W5, #0*/
+                addlong(A64_CSEL_W(REG_EBX, REG_ZR, REG_EBX, COND_MI));    /*CSEL W5, WZR, W5, MI*/
+                addlong(A64_CMP_W(REG_EBX, REG_TEMP));                     /*CMP W5, W16*/
+                addlong(A64_CSEL_W(REG_EBX, REG_TEMP, REG_EBX, COND_HI));  /*CSEL W5, W16, W5, HI*/
+            } else {
+                addlong(A64_ADD_IMM_W(REG_EDX, REG_EDX, 1)); /*ADD W7, W7, #1*/
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_h_mask[tmu])); /*LDR W16, params->tex_h_mask[X15]*/
+                addlong(A64_AND_W(REG_EDX, REG_EDX, REG_TEMP)); /*AND W7, W7, W16*/
+                addlong(A64_AND_W(REG_EBX, REG_EBX, REG_TEMP)); /*AND W5, W5, W16*/
+            }
+            /*W4 = S, W5 = T0, W7 = T1*/
+            addlong(A64_LSLV_W(REG_EBX, REG_EBX, REG_ECX));           /*LSL W5, W5, W6*/
+            addlong(A64_LSLV_W(REG_EDX, REG_EDX, REG_ECX));           /*LSL W7, W7, W6*/
+            addlong(A64_ADD_UXTW_X(REG_EBX, REG_EBP, REG_EBX, 2));    /*ADD X5, X8, W5, UXTW #2*/
+            addlong(A64_ADD_UXTW_X(REG_EDX, REG_EBP, REG_EDX, 2));    /*ADD X7, X8, W7, UXTW #2*/
+            if (state->clamp_s[tmu]) {
+                addldst(A64_LDR_W, REG_EBP, REG_ESI, offsetof(voodoo_params_t, tex_w_mask[tmu])); /*LDR W8, params->tex_w_mask[X15]*/
+                addldst(A64_LDR_W, REG_ESI, REG_STATE, offsetof(voodoo_state_t, ebp_store));     /*LDR W15, ebp_store*/
+                addlong(A64_CMP_IMM_W(REG_EAX, 0));                     /*CMP W4, #0*/
+                addlong(A64_CSEL_W(REG_EAX, REG_ZR, REG_EAX, COND_MI)); /*CSEL W4, WZR, W4, MI*/
+                clamp_pos = block_pos;
+                addlong(A64_BCOND(COND_MI, 0));                         /*B.MI clamp - clamp on 0*/
+                addlong(A64_CMP_W(REG_EAX, REG_EBP));                   /*CMP W4, W8*/
+                addlong(A64_CSEL_W(REG_EAX, REG_EBP, REG_EAX, COND_HS)); /*CSEL W4, W8, W4, HS*/
+                clamp_pos2 = block_pos;
+                addlong(A64_BCOND(COND_HS, 0)); /*B.HS clamp - clamp on +*/
+            } else {
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_w_mask[tmu])); /*LDR W16, params->tex_w_mask[X15]*/
+                addlong(A64_CMP_W(REG_EAX, REG_TEMP)); /*CMP W4, W16 - is S at texture edge (ie will wrap/clamp)?*/
+                addldst(A64_LDR_W, REG_ESI, REG_STATE, offsetof(voodoo_state_t, ebp_store)); /*LDR W15, ebp_store*/
+                clamp_pos = block_pos;
+                addlong(A64_BCOND(COND_EQ, 0)); /*B.EQ wrap*/
+            }
+
+            addlong(A64_ADD_UXTW_X(REG_TEMP, REG_EBX, REG_EAX, 2)); /*ADD X16, X5, W4, UXTW #2*/
+            addldst(A64_LDR_D, 0, REG_TEMP, 0);                     /*LDR D0, [X16]*/
+            addlong(A64_ADD_UXTW_X(REG_TEMP, REG_EDX, REG_EAX, 2)); /*ADD X16, X7, W4, UXTW #2*/
+            addldst(A64_LDR_D, 1, REG_TEMP, 0);                     /*LDR D1, [X16]*/
+
+            done_pos = block_pos;
+            addlong(A64_B(0)); /*B done*/
+            A64_PATCH_BCOND(clamp_pos);
+            if (clamp_pos2)
+                A64_PATCH_BCOND(clamp_pos2);
+
+            if (state->clamp_s[tmu]) {
+                /*S clamped - the two S coordinates are the same*/
+                addlong(A64_LDR_S_UXTW(0, REG_EBX, REG_EAX)); /*LDR S0, [X5, W4, UXTW #2]*/
+                addlong(A64_LDR_S_UXTW(1, REG_EDX, REG_EAX)); /*LDR S1, [X7, W4, UXTW #2]*/
+                addlong(A64_DUP_2S_ELEM0(0, 0));              /*DUP V0.2S, V0.S[0]*/
+                addlong(A64_DUP_2S_ELEM0(1, 1));              /*DUP V1.2S, V1.S[0]*/
+            } else {
+                /*S wrapped - the two S coordinates are not contiguous*/
+                addlong(A64_LDR_S_UXTW(0, REG_EBX, REG_EAX)); /*LDR S0, [X5, W4, UXTW #2]*/
+                addlong(A64_LDR_S_UXTW(1, REG_EDX, REG_EAX)); /*LDR S1, [X7, W4, UXTW #2]*/
+                addldst(A64_LDRH_W, REG_TEMP, REG_EBX, 0);    /*LDRH W16, [X5]*/
+                addlong(A64_INS_H_W(0, 2, REG_TEMP));         /*INS V0.H[2], W16*/
+                addldst(A64_LDRH_W, REG_TEMP, REG_EDX, 0);    /*LDRH W16, [X7]*/
+                addlong(A64_INS_H_W(1, 2, REG_TEMP));         /*INS V1.H[2], W16*/
+                addldst(A64_LDRH_W, REG_TEMP, REG_EBX, 2);    /*LDRH W16, [X5, #2]*/
+                addlong(A64_INS_H_W(0, 3, REG_TEMP));         /*INS V0.H[3], W16*/
+                addldst(A64_LDRH_W, REG_TEMP, REG_EDX, 2);    /*LDRH W16, [X7, #2]*/
+                addlong(A64_INS_H_W(1, 3, REG_TEMP));         /*INS V1.H[3], W16*/
+            }
+            A64_PATCH_B(done_pos);
+
+            addlong(A64_UXTL_8H(0, 0)); /*UXTL V0.8H, V0.8B*/
+            addlong(A64_UXTL_8H(1, 1)); /*UXTL V1.8H, V1.8B*/
+
+            addlong(A64_ADD_X(REG_ESI, REG_BILINEAR, REG_ESI)); /*ADD X15, X14(bilinear_lookup), X15*/
+
+            addldst(A64_LDR_Q, REG_VTEMP, REG_ESI, 0);          /*LDR Q21, bilinear_lookup[X15]*/
+            addldst(A64_LDR_Q, REG_VTEMP2, REG_ESI, 0x10);      /*LDR Q22, bilinear_lookup[X15]+0x10*/
+            addlong(A64_MUL_8H(0, 0, REG_VTEMP));               /*MUL V0.8H, V0.8H, V21.8H*/
+            addlong(A64_MUL_8H(1, 1, REG_VTEMP2));              /*MUL V1.8H, V1.8H, V22.8H*/
+            addlong(A64_ADD_8H(0, 0, 1));                       /*ADD V0.8H, V0.8H, V1.8H*/
+            addlong(A64_EXT_16B(1, 0, 0, 8));                   /*EXT V1.16B, V0.16B, V0.16B, #8*/
+            addlong(A64_ADD_8H(0, 0, 1));                       /*ADD V0.8H, V0.8H, V1.8H*/
+            addlong(A64_USHR_8H(0, 0, 8));                      /*USHR V0.8H, V0.8H, #8*/
+            addlong(A64_SQXTUN_8B(0, 0));                       /*SQXTUN V0.8B, V0.8H*/
+
+            addlong(A64_FMOV_W_S(REG_EAX, 0)); /*FMOV W4, S0*/
+        } else {
+            addlong(A64_MOVZ_W(REG_EDX, 8, 0)); /*MOV W7, #8*/
+            addldst(A64_LDR_W, REG_ECX, REG_STATE, offsetof(voodoo_state_t, lod)); /*LDR W6, state->lod*/
+            addlong(A64_ADD_IMM_X(REG_TEMP, REG_STATE, offsetof(voodoo_state_t, tex[tmu]))); /*ADD X16, X0, state->tex*/
+            addlong(A64_LDR_X_UXTW(REG_EBP, REG_TEMP, REG_ECX)); /*LDR X8, [X16, W6, UXTW #3]*/
+            addlong(A64_SUB_W(REG_EDX, REG_EDX, REG_ECX));       /*SUB W7, W7, W6*/
+            addlong(A64_ADD_IMM_W(REG_ECX, REG_ECX, 4));         /*ADD W6, W6, #4*/
+            addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, tex_s)); /*LDR W4, state->tex_s*/
+            addldst(A64_LDR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, tex_t)); /*LDR W5, state->tex_t*/
+            if (params->tLOD[tmu] & LOD_TMIRROR_S) {
+                addlong(A64_TBZ(REG_EAX, 12, 2));     /*TBZ W4, #12, +*/
+                addlong(A64_MVN_W(REG_EAX, REG_EAX)); /*MVN W4, W4*/
+            }
+            if (params->tLOD[tmu] & LOD_TMIRROR_T) {
+                addlong(A64_TBZ(REG_EBX, 12, 2));     /*TBZ W5, #12, +*/
+                addlong(A64_MVN_W(REG_EBX, REG_EBX)); /*MVN W5, W5*/
+            }
+            addlong(A64_LSRV_W(REG_EAX, REG_EAX, REG_ECX)); /*LSR W4, W4, W6*/
+            addlong(A64_LSRV_W(REG_EBX, REG_EBX, REG_ECX)); /*LSR W5, W5, W6*/
+            addlong(A64_ADD_UXTW_X(REG_ESI, REG_PARAMS, REG_ECX, 2)); /*ADD X15, X1, W6, UXTW #2*/
+            if (state->clamp_s[tmu]) {
+                addlong(A64_CMP_IMM_W(REG_EAX, 0));                     /*CMP W4, #0*/
+                addlong(A64_CSEL_W(REG_EAX, REG_ZR, REG_EAX, COND_MI)); /*CSEL W4, WZR, W4, MI*/
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_w_mask[tmu]) - 0x10); /*LDR W16, params->tex_w_mask[X15]*/
+                addlong(A64_CMP_W(REG_EAX, REG_TEMP));                    /*CMP W4, W16*/
+                addlong(A64_CSEL_W(REG_EAX, REG_TEMP, REG_EAX, COND_HS)); /*CSEL W4, W16, W4, HS*/
+            } else {
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_w_mask[tmu]) - 0x10); /*LDR W16, params->tex_w_mask[X15]*/
+                addlong(A64_AND_W(REG_EAX, REG_EAX, REG_TEMP)); /*AND W4, W4, W16*/
+            }
+            if (state->clamp_t[tmu]) {
+                addlong(A64_CMP_IMM_W(REG_EBX, 0));                     /*CMP W5, #0*/
+                addlong(A64_CSEL_W(REG_EBX, REG_ZR, REG_EBX, COND_MI)); /*CSEL W5, WZR, W5, MI*/
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_h_mask[tmu]) - 0x10); /*LDR W16, params->tex_h_mask[X15]*/
+                addlong(A64_CMP_W(REG_EBX, REG_TEMP));                    /*CMP W5, W16*/
+                addlong(A64_CSEL_W(REG_EBX, REG_TEMP, REG_EBX, COND_HS)); /*CSEL W5, W16, W5, HS*/
+            } else {
+                addldst(A64_LDR_W, REG_TEMP, REG_ESI, offsetof(voodoo_params_t, tex_h_mask[tmu]) - 0x10); /*LDR W16, params->tex_h_mask[X15]*/
+                addlong(A64_AND_W(REG_EBX, REG_EBX, REG_TEMP)); /*AND W5, W5, W16*/
+            }
+            addlong(A64_MOV_W(REG_ECX, REG_EDX));           /*MOV W6, W7*/
+            addlong(A64_LSLV_W(REG_EBX, REG_EBX, REG_ECX)); /*LSL W5, W5, W6*/
+            addlong(A64_ADD_W(REG_EBX, REG_EBX, REG_EAX));  /*ADD W5, W5, W4*/
+
+            addlong(A64_LDR_W_UXTW(REG_EAX, REG_EBP, REG_EBX)); /*LDR W4, [X8, W5, UXTW #2]*/
+        }
+    }
+
+    return block_pos;
+}
+
+/*TCA/TC_MSELECT_DETAIL blend factor, left in reg*/
+static inline int
+codegen_detail_factor(uint8_t *code_block, voodoo_params_t *params, int block_pos, int reg, int tmu)
+{
+    addmovimm(reg, params->detail_bias[tmu]); /*MOV reg, params->detail_bias*/
+    addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, lod)); /*LDR W16, state->lod*/
+    addlong(A64_SUB_W(reg, reg, REG_TEMP)); /*SUB reg, reg, W16*/
+    addmovimm(REG_EDX, params->detail_max[tmu]); /*MOV W7, params->detail_max*/
+    addlong(A64_LSL_IMM_W(reg, reg, params->detail_scale[tmu])); /*LSL reg, reg, params->detail_scale*/
+    addlong(A64_CMP_W(reg, REG_EDX));                            /*CMP reg, W7*/
+    addlong(A64_CSEL_W(reg, REG_EDX, reg, COND_GE));             /*CSEL reg, W7, reg, GE*/
+
+    return block_pos;
+}
+
+/*Blend a vector of colour words with factors in V5, result = (x * f + 1 + ((x * f) >> 8)) >> 8*/
+static inline int
+codegen_alpha_blend(uint8_t *code_block, int block_pos, int reg, int factor)
+{
+    addlong(A64_MUL_8H(reg, reg, factor));                  /*MUL reg.8H, reg.8H, factor.8H*/
+    addlong(A64_MOV_8B(5, reg));                            /*MOV V5.8B, reg.8B*/
+    addlong(A64_ADD_8H(reg, reg, REG_XMM_01_W));            /*ADD reg.8H, reg.8H, V16(xmm_01_w).8H*/
+    addlong(A64_USHR_8H(5, 5, 8));                          /*USHR V5.8H, V5.8H, #8*/
+    addlong(A64_ADD_8H(reg, reg, 5));                       /*ADD reg.8H, reg.8H, V5.8H*/
+    addlong(A64_USHR_8H(reg, reg, 8));                      /*USHR reg.8H, reg.8H, #8*/
+
+    return block_pos;
+}
+
+static inline int
+voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int depthop)
+{
+    int block_pos       = 0;
+    int z_skip_pos      = 0;
+    int a_skip_pos      = 0;
+    int chroma_skip_pos = 0;
+    int depth_jump_pos  = 0;
+    int depth_jump_pos2 = 0;
+    int loop_jump_pos   = 0;
+
+#if defined(__APPLE__) && defined(__aarch64__)
+    if (__builtin_available(macOS 11.0, *)) {
+        pthread_jit_write_protect_np(0);
+    }
+#endif
+
+    /*Arguments : X0 = state, X1 = params, W2 = x, W3 = real_y*/
+    addmovimm64(REG_TEMP, (uintptr_t) voodoo_neon_consts); /*MOV X16, voodoo_neon_consts*/
+    addldst(A64_LDR_D, REG_XMM_01_W, REG_TEMP, 0x00);       /*LDR D16, xmm_01_w*/
+    addldst(A64_LDR_D, REG_XMM_FF_W, REG_TEMP, 0x08);       /*LDR D17, xmm_ff_w*/
+    addldst(A64_LDR_D, REG_XMM_FF_B, REG_TEMP, 0x10);       /*LDR D18, xmm_ff_b*/
+    addldst(A64_LDR_D, REG_MINUS_254, REG_TEMP, 0x18);      /*LDR D19, minus_254*/
+
+    addmovimm64(REG_LOGTABLE, (uintptr_t) logtable);        /*MOV X9, logtable*/
+    addmovimm64(REG_BILINEAR, (uintptr_t) bilinear_lookup); /*MOV X14, bilinear_lookup*/
+
+    loop_jump_pos = block_pos;
+    if (params->col_tiled || params->aux_tiled) {
+        addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, x)); /*LDR W4, state->x*/
+        addlong(A64_MOV_W(REG_EBX, REG_EAX));           /*MOV W5, W4*/
+        addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 0, 6)); /*AND W4, W4, #63*/
+        addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 6));    /*LSR W5, W5, #6*/
+        addlong(A64_LSL_IMM_W(REG_EBX, REG_EBX, 11));   /*LSL W5, W5, #11  - tile is 128*32, << 12, div 2 because word index*/
+        addlong(A64_ADD_W(REG_EAX, REG_EAX, REG_EBX));  /*ADD W4, W4, W5*/
+        addldst(A64_STR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, x_tiled)); /*STR W4, state->x_tiled*/
+    }
+
+    if ((params->fbzMode & FBZ_W_BUFFER) || (params->fogMode & (FOG_ENABLE | FOG_CONSTANT | FOG_Z | FOG_ALPHA)) == FOG_ENABLE) {
+        addlong(A64_MOVZ_W(REG_EAX, 0, 0)); /*MOV W4, #0 (new_depth)*/
+        addldst(A64_LDRH_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, w) + 4); /*LDRH W16, w+4*/
+        depth_jump_pos = block_pos;
+        addlong(A64_CBNZ_W(REG_TEMP, 0)); /*CBNZ W16, got_depth*/
+        addldst(A64_LDR_W, REG_EDX, REG_STATE, offsetof(voodoo_state_t, w)); /*LDR W7, w*/
+        addlong(A64_MOVZ_W(REG_EAX, 0xf001, 0));      /*MOV W4, #0xf001 (new_depth)*/
+        addlong(A64_MOV_W(REG_EBX, REG_EDX));         /*MOV W5, W7*/
+        addlong(A64_LSR_IMM_W(REG_EDX, REG_EDX, 16)); /*LSR W7, W7, #16*/
+        depth_jump_pos2 = block_pos;
+        addlong(A64_CBZ_W(REG_EDX, 0)); /*CBZ W7, got_depth*/
+        addlong(A64_MOVZ_W(REG_ECX, 19, 0));                /*MOV W6, #19*/
+        addlong(A64_CLZ_W(REG_TEMP, REG_EDX));              /*CLZ W16, W7*/
+        addlong(A64_MOVZ_W(REG_TEMP2, 31, 0));              /*MOV W17, #31*/
+        addlong(A64_SUB_W(REG_EAX, REG_TEMP2, REG_TEMP));   /*SUB W4, W17, W16 - BSR*/
+        addlong(A64_MOVZ_W(REG_EDX, 15, 0));                /*MOV W7, #15*/
+        addlong(A64_MVN_W(REG_EBX, REG_EBX));               /*MVN W5, W5*/
+        addlong(A64_SUB_W(REG_EDX, REG_EDX, REG_EAX));      /*SUB W7, W7, W4 - W7 = exp*/
+        addlong(A64_SUB_W(REG_ECX, REG_ECX, REG_EDX));      /*SUB W6, W6, W7*/
+        addlong(A64_LSL_IMM_W(REG_EDX, REG_EDX, 12));       /*LSL W7, W7, #12*/
+        addlong(A64_LSRV_W(REG_EBX, REG_EBX, REG_ECX));     /*LSR W5, W5, W6*/
+        addlong(A64_AND_IMM_W(REG_EBX, REG_EBX, 0, 12));    /*AND W5, W5, #0xfff - W5 = mant*/
+        addlong(A64_ADD_W(REG_EAX, REG_EDX, REG_EBX));      /*ADD W4, W7, W5*/
+        addlong(A64_ADD_IMM_W(REG_EAX, REG_EAX, 1));        /*ADD W4, W4, #1*/
+        addlong(A64_MOVZ_W(REG_EBX, 0xffff, 0));            /*MOV W5, #0xffff*/
+        addlong(A64_CMP_W(REG_EAX, REG_EBX));               /*CMP W4, W5*/
+        addlong(A64_CSEL_W(REG_EAX, REG_EBX, REG_EAX, COND_HI)); /*CSEL W4, W5, W4, HI*/
+
+        A64_PATCH_BCOND(depth_jump_pos);
+        A64_PATCH_BCOND(depth_jump_pos2);
+
+        if ((params->fogMode & (FOG_ENABLE | FOG_CONSTANT | FOG_Z | FOG_ALPHA)) == FOG_ENABLE) {
+            addldst(A64_STR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, w_depth)); /*STR W4, state->w_depth*/
+        }
+    }
+    if (!(params->fbzMode & FBZ_W_BUFFER)) {
+        addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, z)); /*LDR W4, z*/
+        addlong(A64_MOVZ_W(REG_EBX, 0xffff, 0));                 /*MOV W5, #0xffff*/
+        addlong(A64_MOVZ_W(REG_ECX, 0, 0));                      /*MOV W6, #0*/
+        addlong(A64_ASR_IMM_W(REG_EAX, REG_EAX, 12));            /*ASR W4, W4, #12*/
+        addlong(A64_CMP_IMM_W(REG_EAX, 0));                      /*CMP W4, #0*/
+        addlong(A64_CSEL_W(REG_EAX, REG_ECX, REG_EAX, COND_MI)); /*CSEL W4, W6, W4, MI*/
+        addlong(A64_CMP_W(REG_EAX, REG_EBX));                    /*CMP W4, W5*/
+        addlong(A64_CSEL_W(REG_EAX, REG_EBX, REG_EAX, COND_HI)); /*CSEL W4, W5, W4, HI*/
+    }
+
+    if (params->fbzMode & FBZ_DEPTH_BIAS) {
+        addldst(A64_LDR_W, REG_TEMP, REG_PARAMS, offsetof(voodoo_params_t, zaColor)); /*LDR W16, params->zaColor*/
+        addlong(A64_ADD_W(REG_EAX, REG_EAX, REG_TEMP));   /*ADD W4, W4, W16*/
+        addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 0, 16)); /*AND W4, W4, #0xffff*/
+    }
+
+    addldst(A64_STR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, new_depth)); /*STR W4, state->new_depth*/
+
+    if ((params->fbzMode & FBZ_DEPTH_ENABLE) && (depthop != DEPTHOP_ALWAYS) && (depthop != DEPTHOP_NEVER)) {
+        int cond;
+
+        addldst(A64_LDR_W, REG_EBX, REG_STATE, params->aux_tiled ? offsetof(voodoo_state_t, x_tiled) : offsetof(voodoo_state_t, x)); /*LDR W5, state->x*/
+        addldst(A64_LDR_X, REG_ECX, REG_STATE, offsetof(voodoo_state_t, aux_mem)); /*LDR X6, aux_mem*/
+        addlong(A64_LDRH_UXTW(REG_EBX, REG_ECX, REG_EBX)); /*LDRH W5, [X6, W5, UXTW #1]*/
+        if (params->fbzMode & FBZ_DEPTH_SOURCE) {
+            addldst(A64_LDRH_W, REG_EAX, REG_PARAMS, offsetof(voodoo_params_t, zaColor)); /*LDRH W4, params->zaColor*/
+        }
+        addlong(A64_CMP_W(REG_EAX, REG_EBX)); /*CMP W4, W5*/
+        if (depthop == DEPTHOP_LESSTHAN)
+            cond = COND_HS;
+        else if (depthop == DEPTHOP_EQUAL)
+            cond = COND_NE;
+        else if (depthop == DEPTHOP_LESSTHANEQUAL)
+            cond = COND_HI;
+        else if (depthop == DEPTHOP_GREATERTHAN)
+            cond = COND_LS;
+        else if (depthop == DEPTHOP_NOTEQUAL)
+            cond = COND_EQ;
+        else if (depthop == DEPTHOP_GREATERTHANEQUAL)
+            cond = COND_LO;
+        else
+            fatal("Bad depth_op\n");
+        z_skip_pos = block_pos;
+        addlong(A64_BCOND(cond, 0)); /*B.cond skip*/
+    } else if ((params->fbzMode & FBZ_DEPTH_ENABLE) && (depthop == DEPTHOP_NEVER)) {
+        addlong(A64_RET); /*RET*/
+    }
+
+    /*V0 = colour*/
+
+    /*X0 = state, X1 = params*/
+
+    if ((params->textureMode[0] & TEXTUREMODE_LOCAL_MASK) == TEXTUREMODE_LOCAL || !voodoo->dual_tmus) {
+        /*TMU0 only sampling local colour or only one TMU, only sample TMU0*/
+        block_pos = codegen_texture_fetch(code_block, voodoo, params, state, block_pos, 0);
+
+        addlong(A64_FMOV_S_W(0, REG_EAX));            /*FMOV S0, W4*/
+        addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 24)); /*LSR W4, W4, #24*/
+        addldst(A64_STR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, tex_a)); /*STR W4, state->tex_a*/
+    } else if ((params->textureMode[0] & TEXTUREMODE_MASK) == TEXTUREMODE_PASSTHROUGH) {
+        /*TMU0 in pass-through mode, only sample TMU1*/
+        block_pos = codegen_texture_fetch(code_block, voodoo, params, state, block_pos, 1);
+
+        addlong(A64_FMOV_S_W(0, REG_EAX));            /*FMOV S0, W4*/
+        addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 24)); /*LSR W4, W4, #24*/
+        addldst(A64_STR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, tex_a)); /*STR W4, state->tex_a*/
+    } else {
+        block_pos = codegen_texture_fetch(code_block, voodoo, params, state, block_pos, 1);
+
+        addlong(A64_FMOV_S_W(3, REG_EAX)); /*FMOV S3, W4*/
+        if ((params->textureMode[1] & TEXTUREMODE_TRILINEAR) && tc_sub_clocal_1) {
+            addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, lod)); /*LDR W4, state->lod*/
+            addlong(A64_MOVZ_W(REG_EBX, tc_reverse_blend_1 ? 0 : 1, 0));  /*MOV W5, #!tc_reverse_blend_1*/
+            addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 0, 1));                /*AND W4, W4, #1*/
+            addlong(A64_MOVZ_W(REG_ECX, tca_reverse_blend_1 ? 0 : 1, 0)); /*MOV W6, #!tca_reverse_blend_1*/
+            addlong(A64_EOR_W(REG_EBX, REG_EBX, REG_EAX));                 /*EOR W5, W5, W4*/
+            addlong(A64_EOR_W(REG_ECX, REG_ECX, REG_EAX));                 /*EOR W6, W6, W4*/
+            addlong(A64_LSL_IMM_W(REG_EBX, REG_EBX, 4));                   /*LSL W5, W5, #4*/
+            /*W5 = tc_reverse_blend, W6 = tca_reverse_blend*/
+        }
+        addlong(A64_UXTL_8H(3, 3)); /*UXTL V3.8H, V3.8B*/
+        if (tc_sub_clocal_1) {
+            switch (tc_mselect_1) {
+                case TC_MSELECT_ZERO:
+                    addlong(A64_MOVI_ZERO(0)); /*MOVI V0, #0*/
+                    break;
+                case TC_MSELECT_CLOCAL:
+                    addlong(A64_MOV_8B(0, 3)); /*MOV V0.8B, V3.8B*/
+                    break;
+                case TC_MSELECT_AOTHER:
+                    addlong(A64_MOVI_ZERO(0)); /*MOVI V0, #0*/
+                    break;
+                case TC_MSELECT_ALOCAL:
+                    addlong(A64_DUP_4H_ELEM(0, 3, 3)); /*DUP V0.4H, V3.H[3]*/
+                    break;
+                case TC_MSELECT_DETAIL:
+                    block_pos = codegen_detail_factor(code_block, params, block_pos, REG_EAX, 1);
+                    addlong(A64_DUP_4H_W(0, REG_EAX)); /*DUP V0.4H, W4*/
+                    break;
+                case TC_MSELECT_LOD_FRAC:
+                    addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, lod_frac[1])); /*LDR W16, state->lod_frac[1]*/
+                    addlong(A64_DUP_4H_W(0, REG_TEMP)); /*DUP V0.4H, W16*/
+                    break;
+            }
+            if (params->textureMode[1] & TEXTUREMODE_TRILINEAR) {
+                addlong(A64_LSR_IMM_W(REG_TEMP, REG_EBX, 4));        /*LSR W16, W5, #4*/
+                addlong(A64_NEG_W(REG_TEMP, REG_TEMP));              /*NEG W16, W16*/
+                addlong(A64_AND_IMM_W(REG_TEMP, REG_TEMP, 0, 8));    /*AND W16, W16, #0xff*/
+                addlong(A64_DUP_4H_W(REG_VTEMP, REG_TEMP));          /*DUP V21.4H, W16 (xmm_00_ff_w)*/
+                addlong(A64_EOR_16B(0, 0, REG_VTEMP));               /*EOR V0.16B, V0.16B, V21.16B*/
+            } else if (!tc_reverse_blend_1) {
+                addlong(A64_EOR_16B(0, 0, REG_XMM_FF_W)); /*EOR V0.16B, V0.16B, V17(xmm_ff_w).16B*/
+            }
+            addlong(A64_ADD_8H(0, 0, REG_XMM_01_W)); /*ADD V0.8H, V0.8H, V16(xmm_01_w).8H*/
+            addlong(A64_MOVI_ZERO(1));               /*MOVI V1, #0*/
+            addlong(A64_SMULL_4S(0, 0, 3));          /*SMULL V0.4S, V0.4H, V3.4H*/
+            addlong(A64_SSHR_4S(0, 0, 8));           /*SSHR V0.4S, V0.4S, #8*/
+            addpackssdw(0);                          /*PACKSSDW V0, V0*/
+            addlong(A64_SUB_8H(1, 1, 0));            /*SUB V1.8H, V1.8H, V0.8H*/
+            if (tc_add_clocal_1) {
+                addlong(A64_ADD_8H(1, 1, 3)); /*ADD V1.8H, V1.8H, V3.8H*/
+            } else if (tc_add_alocal_1) {
+                addlong(A64_DUP_4H_ELEM(0, 3, 3)); /*DUP V0.4H, V3.H[3]*/
+                addlong(A64_ADD_8H(1, 1, 0));      /*ADD V1.8H, V1.8H, V0.8H*/
+            }
+            addlong(A64_SQXTUN_8B(3, 3));   /*SQXTUN V3.8B, V3.8H*/
+            addlong(A64_SQXTUN2_16B(3, 1)); /*SQXTUN2 V3.16B, V1.8H*/
+            if (tca_sub_clocal_1) {
+                addlong(A64_FMOV_W_S(REG_EBX, 3)); /*FMOV W5, S3*/
+            }
+            addlong(A64_UXTL_8H(3, 3)); /*UXTL V3.8H, V3.8B*/
+        }
+
+        if (tca_sub_clocal_1) {
+            addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 24)); /*LSR W5, W5, #24*/
+            switch (tca_mselect_1) {
+                case TCA_MSELECT_ZERO:
+                    addlong(A64_MOVZ_W(REG_EAX, 0, 0)); /*MOV W4, #0*/
+                    break;
+                case TCA_MSELECT_CLOCAL:
+                    addlong(A64_MOV_W(REG_EAX, REG_EBX)); /*MOV W4, W5*/
+                    break;
+                case TCA_MSELECT_AOTHER:
+                    addlong(A64_MOVZ_W(REG_EAX, 0, 0)); /*MOV W4, #0*/
+                    break;
+                case TCA_MSELECT_ALOCAL:
+                    addlong(A64_MOV_W(REG_EAX, REG_EBX)); /*MOV W4, W5*/
+                    break;
+                case TCA_MSELECT_DETAIL:
+                    block_pos = codegen_detail_factor(code_block, params, block_pos, REG_EAX, 1);
+                    break;
+                case TCA_MSELECT_LOD_FRAC:
+                    addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, lod_frac[1])); /*LDR W4, state->lod_frac[1]*/
+                    break;
+            }
+            if (params->textureMode[1] & TEXTUREMODE_TRILINEAR) {
+                addlong(A64_NEG_W(REG_TEMP, REG_ECX));           /*NEG W16, W6*/
+                addlong(A64_AND_IMM_W(REG_TEMP, REG_TEMP, 0, 8)); /*AND W16, W16, #0xff (i_00_ff_w)*/
+                addlong(A64_EOR_W(REG_EAX, REG_EAX, REG_TEMP));   /*EOR W4, W4, W16*/
+            } else if (!tc_reverse_blend_1) {
+                addlong(A64_EOR_IMM_W(REG_EAX, REG_EAX, 0, 8)); /*EOR W4, W4, #0xff*/
+            }
+            addlong(A64_ADD_IMM_W(REG_EAX, REG_EAX, 1));    /*ADD W4, W4, #1*/
+            addlong(A64_MUL_W(REG_EAX, REG_EAX, REG_EBX));  /*MUL W4, W4, W5*/
+            addlong(A64_MOVZ_W(REG_ECX, 0xff, 0));          /*MOV W6, #0xff*/
+            addlong(A64_NEG_W(REG_EAX, REG_EAX));           /*NEG W4, W4*/
+            addlong(A64_ASR_IMM_W(REG_EAX, REG_EAX, 8));    /*ASR W4, W4, #8*/
+            if (tca_add_clocal_1 || tca_add_alocal_1) {
+                addlong(A64_ADD_W(REG_EAX, REG_EAX, REG_EBX)); /*ADD W4, W4, W5*/
+            }
+            addlong(A64_CMP_W(REG_ECX, REG_EAX));                    /*CMP W6, W4*/
+            addlong(A64_CSEL_W(REG_ECX, REG_EAX, REG_ECX, COND_HI)); /*CSEL W6, W4, W6, HI*/
+            addlong(A64_INS_H_W(3, 3, REG_EAX));                     /*INS V3.H[3], W4*/
+        }
+
+        block_pos = codegen_texture_fetch(code_block, voodoo, params, state, block_pos, 0);
+
+        addlong(A64_FMOV_S_W(0, REG_EAX)); /*FMOV S0, W4*/
+        addlong(A64_FMOV_S_W(7, REG_EAX)); /*FMOV S7, W4*/
+
+        if (params->textureMode[0] & TEXTUREMODE_TRILINEAR) {
+            addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, lod)); /*LDR W4, state->lod*/
+            addlong(A64_MOVZ_W(REG_EBX, tc_reverse_blend ? 0 : 1, 0));  /*MOV W5, #!tc_reverse_blend*/
+            addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 0, 1));              /*AND W4, W4, #1*/
+            addlong(A64_MOVZ_W(REG_ECX, tca_reverse_blend ? 0 : 1, 0)); /*MOV W6, #!tca_reverse_blend*/
+            addlong(A64_EOR_W(REG_EBX, REG_EBX, REG_EAX));               /*EOR W5, W5, W4*/
+            addlong(A64_EOR_W(REG_ECX, REG_ECX, REG_EAX));               /*EOR W6, W6, W4*/
+            addlong(A64_LSL_IMM_W(REG_EBX, REG_EBX, 4));                 /*LSL W5, W5, #4*/
+            /*W5 = tc_reverse_blend, W6 = tca_reverse_blend*/
+        }
+
+        /*V0 = TMU0 output, V3 = TMU1 output*/
+
+        addlong(A64_UXTL_8H(0, 0)); /*UXTL V0.8H, V0.8B*/
+        if (tc_zero_other) {
+            addlong(A64_MOVI_ZERO(1)); /*MOVI V1, #0*/
+        } else {
+            addlong(A64_MOV_8B(1, 3)); /*MOV V1.8B, V3.8B*/
+        }
+        if (tc_sub_clocal) {
+            addlong(A64_SUB_8H(1, 1, 0)); /*SUB V1.8H, V1.8H, V0.8H*/
+        }
+
+        switch (tc_mselect) {
+            case TC_MSELECT_ZERO:
+                addlong(A64_MOVI_ZERO(4)); /*MOVI V4, #0*/
+                break;
+            case TC_MSELECT_CLOCAL:
+                addlong(A64_MOV_8B(4, 0)); /*MOV V4.8B, V0.8B*/
+                break;
+            case TC_MSELECT_AOTHER:
+                addlong(A64_DUP_4H_ELEM(4, 3, 3)); /*DUP V4.4H, V3.H[3]*/
+                break;
+            case TC_MSELECT_ALOCAL:
+                addlong(A64_DUP_4H_ELEM(4, 0, 3)); /*DUP V4.4H, V0.H[3]*/
+                break;
+            case TC_MSELECT_DETAIL:
+                block_pos = codegen_detail_factor(code_block, params, block_pos, REG_EAX, 0);
+                addlong(A64_DUP_4H_W(4, REG_EAX)); /*DUP V4.4H, W4*/
+                break;
+            case TC_MSELECT_LOD_FRAC:
+                addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, lod_frac[0])); /*LDR W16, state->lod_frac[0]*/
+                addlong(A64_DUP_4H_W(4, REG_TEMP)); /*DUP V4.4H, W16*/
+                break;
+        }
+        if (params->textureMode[0] & TEXTUREMODE_TRILINEAR) {
+            addlong(A64_LSR_IMM_W(REG_TEMP, REG_EBX, 4));     /*LSR W16, W5, #4*/
+            addlong(A64_NEG_W(REG_TEMP, REG_TEMP));           /*NEG W16, W16*/
+            addlong(A64_AND_IMM_W(REG_TEMP, REG_TEMP, 0, 8)); /*AND W16, W16, #0xff*/
+            addlong(A64_DUP_4H_W(REG_VTEMP, REG_TEMP));       /*DUP V21.4H, W16 (xmm_00_ff_w)*/
+            addlong(A64_EOR_16B(4, 4, REG_VTEMP));            /*EOR V4.16B, V4.16B, V21.16B*/
+        } else if (!tc_reverse_blend) {
+            addlong(A64_EOR_16B(4, 4, REG_XMM_FF_W)); /*EOR V4.16B, V4.16B, V17(xmm_ff_w).16B*/
+        }
+        addlong(A64_ADD_8H(4, 4, REG_XMM_01_W)); /*ADD V4.8H, V4.8H, V16(xmm_01_w).8H*/
+        addlong(A64_SMULL_4S(1, 1, 4));          /*SMULL V1.4S, V1.4H, V4.4H*/
+
+        if (tca_sub_clocal) {
+            addlong(A64_FMOV_W_S(REG_EBX, 7)); /*FMOV W5, S7*/
+        }
+
+        addlong(A64_SSHR_4S(1, 1, 8)); /*SSHR V1.4S, V1.4S, #8*/
+        addpackssdw(1);                /*PACKSSDW V1, V1*/
+
+        if (tca_sub_clocal) {
+            addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 24)); /*LSR W5, W5, #24*/
+        }
+
+        if (tc_add_clocal) {
+            addlong(A64_ADD_8H(1, 1, 0)); /*ADD V1.8H, V1.8H, V0.8H*/
+        } else if (tc_add_alocal) {
+            addlong(A64_DUP_4H_ELEM(4, 0, 3)); /*DUP V4.4H, V0.H[3]*/
+            addlong(A64_ADD_16B(1, 1, 4));     /*ADD V1.16B, V1.16B, V4.16B (x86 uses PADDB here)*/
+        }
+        if (tc_invert_output) {
+            addlong(A64_EOR_16B(1, 1, REG_XMM_FF_W)); /*EOR V1.16B, V1.16B, V17(xmm_ff_w).16B*/
+        }
+
+        addpackuswb(0); /*PACKUSWB V0, V0*/
+        addpackuswb(3); /*PACKUSWB V3, V3*/
+        addpackuswb(1); /*PACKUSWB V1, V1*/
+
+        if (tca_zero_other) {
+            addlong(A64_MOVZ_W(REG_EAX, 0, 0)); /*MOV W4, #0*/
+        } else {
+            addlong(A64_FMOV_W_S(REG_EAX, 3));            /*FMOV W4, S3*/
+            addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 24)); /*LSR W4, W4, #24*/
+        }
+        if (tca_sub_clocal) {
+            addlong(A64_SUB_W(REG_EAX, REG_EAX, REG_EBX)); /*SUB W4, W4, W5*/
+        }
+        switch (tca_mselect) {
+            case TCA_MSELECT_ZERO:
+                addlong(A64_MOVZ_W(REG_EBX, 0, 0)); /*MOV W5, #0*/
+                break;
+            case TCA_MSELECT_CLOCAL:
+                addlong(A64_FMOV_W_S(REG_EBX, 7));            /*FMOV W5, S7*/
+                addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 24)); /*LSR W5, W5, #24*/
+                break;
+            case TCA_MSELECT_AOTHER:
+                addlong(A64_FMOV_W_S(REG_EBX, 3));            /*FMOV W5, S3*/
+                addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 24)); /*LSR W5, W5, #24*/
+                break;
+            case TCA_MSELECT_ALOCAL:
+                addlong(A64_FMOV_W_S(REG_EBX, 7));            /*FMOV W5, S7*/
+                addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 24)); /*LSR W5, W5, #24*/
+                break;
+            case TCA_MSELECT_DETAIL:
+                block_pos = codegen_detail_factor(code_block, params, block_pos, REG_EBX, 1);
+                break;
+            case TCA_MSELECT_LOD_FRAC:
+                addldst(A64_LDR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, lod_frac[0])); /*LDR W5, state->lod_frac[0]*/
+                break;
+        }
+        if (params->textureMode[0] & TEXTUREMODE_TRILINEAR) {
+            addlong(A64_NEG_W(REG_TEMP, REG_ECX));            /*NEG W16, W6*/
+            addlong(A64_AND_IMM_W(REG_TEMP, REG_TEMP, 0, 8)); /*AND W16, W16, #0xff (i_00_ff_w)*/
+            addlong(A64_EOR_W(REG_EBX, REG_EBX, REG_TEMP));   /*EOR W5, W5, W16*/
+        } else if (!tca_reverse_blend) {
+            addlong(A64_EOR_IMM_W(REG_EBX, REG_EBX, 0, 8)); /*EOR W5, W5, #0xff*/
+        }
+
+        addlong(A64_ADD_IMM_W(REG_EBX, REG_EBX, 1));   /*ADD W5, W5, #1*/
+        addlong(A64_MUL_W(REG_EAX, REG_EAX, REG_EBX)); /*MUL W4, W4, W5*/
+        addlong(A64_MOVZ_W(REG_EDX, 0, 0));            /*MOV W7, #0*/
+        addlong(A64_ASR_IMM_W(REG_EAX, REG_EAX, 8));   /*ASR W4, W4, #8*/
+        if (tca_add_clocal || tca_add_alocal) {
+            addlong(A64_FMOV_W_S(REG_EBX, 7));             /*FMOV W5, S7*/
+            addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 24));  /*LSR W5, W5, #24*/
+            addlong(A64_ADD_W(REG_EAX, REG_EAX, REG_EBX)); /*ADD W4, W4, W5*/
+        }
+        addlong(A64_CMP_IMM_W(REG_EAX, 0));                      /*CMP W4, #0*/
+        addlong(A64_CSEL_W(REG_EAX, REG_EDX, REG_EAX, COND_MI)); /*CSEL W4, W7, W4, MI*/
+        addlong(A64_MOVZ_W(REG_EDX, 0xff, 0));                   /*MOV W7, #0xff*/
+        addlong(A64_CMP_IMM_W(REG_EAX, 0xff));                   /*CMP W4, #0xff*/
+        addlong(A64_CSEL_W(REG_EAX, REG_EDX, REG_EAX, COND_HI)); /*CSEL W4, W7, W4, HI*/
+        if (tca_invert_output) {
+            addlong(A64_EOR_IMM_W(REG_EAX, REG_EAX, 0, 8)); /*EOR W4, W4, #0xff*/
+        }
+
+        addldst(A64_STR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, tex_a)); /*STR W4, state->tex_a*/
+
+        addlong(A64_MOV_8B(0, 1)); /*MOV V0.8B, V1.8B*/
+    }
+    if (cc_mselect == CC_MSELECT_TEXRGB) {
+        addlong(A64_MOV_8B(4, 0)); /*MOV V4.8B, V0.8B*/
+    }
+
+    if ((params->fbzMode & FBZ_CHROMAKEY)) {
+        switch (_rgb_sel) {
+            case CC_LOCALSELECT_ITER_RGB:
+                addldst(A64_LDR_Q, 0, REG_STATE, offsetof(voodoo_state_t, ib)); /*LDR Q0, ib*/ /* ir, ig and ib must be in same dqword!*/
+                addlong(A64_SSHR_4S(0, 0, 12));    /*SSHR V0.4S, V0.4S, #12*/
+                addpackssdw(0);                    /*PACKSSDW V0, V0*/
+                addpackuswb(0);                    /*PACKUSWB V0, V0*/
+                addlong(A64_FMOV_W_S(REG_EAX, 0)); /*FMOV W4, S0*/
+                break;
+            case CC_LOCALSELECT_COLOR1:
+                addldst(A64_LDR_W, REG_EAX, REG_PARAMS, offsetof(voodoo_params_t, color1)); /*LDR W4, params->color1*/
+                break;
+            case CC_LOCALSELECT_TEX:
+                addlong(A64_FMOV_W_S(REG_EAX, 0)); /*FMOV W4, S0*/
+                break;
+        }
+        addldst(A64_LDR_W, REG_EBX, REG_PARAMS, offsetof(voodoo_params_t, chromaKey)); /*LDR W5, params->chromaKey*/
+        addlong(A64_EOR_W(REG_EBX, REG_EBX, REG_EAX));       /*EOR W5, W5, W4*/
+        addlong(A64_ANDS_IMM_W(REG_EBX, REG_EBX, 0, 24));    /*ANDS W5, W5, #0xffffff*/
+        chroma_skip_pos = block_pos;
+        addlong(A64_BCOND(COND_EQ, 0)); /*B.EQ skip*/
+    }
+
+    if (voodoo->trexInit1[0] & (1 << 18)) {
+        addmovimm(REG_EAX, voodoo->tmuConfig); /*MOV W4, tmuConfig*/
+        addlong(A64_FMOV_S_W(0, REG_EAX));     /*FMOV S0, W4*/
+    }
+
+    if (params->alphaMode & ((1 << 0) | (1 << 4))) {
+        /*W5 = a_other*/
+        switch (a_sel) {
+            case A_SEL_ITER_A:
+                addldst(A64_LDR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, ia)); /*LDR W5, state->ia*/
+                addlong(A64_MOVZ_W(REG_EAX, 0, 0));                      /*MOV W4, #0*/
+                addlong(A64_MOVZ_W(REG_EDX, 0xff, 0));                   /*MOV W7, #0xff*/
+                addlong(A64_ASR_IMM_W(REG_EBX, REG_EBX, 12));            /*ASR W5, W5, #12*/
+                addlong(A64_CMP_IMM_W(REG_EBX, 0));                      /*CMP W5, #0*/
+                addlong(A64_CSEL_W(REG_EBX, REG_EAX, REG_EBX, COND_MI)); /*CSEL W5, W4, W5, MI*/
+                addlong(A64_CMP_W(REG_EBX, REG_EDX));                    /*CMP W5, W7*/
+                addlong(A64_CSEL_W(REG_EBX, REG_EDX, REG_EBX, COND_HI)); /*CSEL W5, W7, W5, HI*/
+                break;
+            case A_SEL_TEX:
+                addldst(A64_LDR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, tex_a)); /*LDR W5, state->tex_a*/
+                break;
+            case A_SEL_COLOR1:
+                addldst(A64_LDRB_W, REG_EBX, REG_PARAMS, offsetof(voodoo_params_t, color1) + 3); /*LDRB W5, params->color1+3*/
+                break;
+            default:
+                addlong(A64_MOVZ_W(REG_EBX, 0, 0)); /*MOV W5, #0*/
+                break;
+        }
+        /*W6 = a_local*/
+        switch (cca_localselect) {
+            case CCA_LOCALSELECT_ITER_A:
+                if (a_sel == A_SEL_ITER_A) {
+                    addlong(A64_MOV_W(REG_ECX, REG_EBX)); /*MOV W6, W5*/
+                } else {
+                    addldst(A64_LDR_W, REG_ECX, REG_STATE, offsetof(voodoo_state_t, ia)); /*LDR W6, state->ia*/
+                    addlong(A64_MOVZ_W(REG_EAX, 0, 0));                      /*MOV W4, #0*/
+                    addlong(A64_MOVZ_W(REG_EDX, 0xff, 0));                   /*MOV W7, #0xff*/
+                    addlong(A64_ASR_IMM_W(REG_ECX, REG_ECX, 12));            /*ASR W6, W6, #12*/
+                    addlong(A64_CMP_IMM_W(REG_ECX, 0));                      /*CMP W6, #0*/
+                    addlong(A64_CSEL_W(REG_ECX, REG_EAX, REG_ECX, COND_MI)); /*CSEL W6, W4, W6, MI*/
+                    addlong(A64_CMP_W(REG_ECX, REG_EDX));                    /*CMP W6, W7*/
+                    addlong(A64_CSEL_W(REG_ECX, REG_EDX, REG_ECX, COND_HI)); /*CSEL W6, W7, W6, HI*/
+                }
+                break;
+            case CCA_LOCALSELECT_COLOR0:
+                addldst(A64_LDRB_W, REG_ECX, REG_PARAMS, offsetof(voodoo_params_t, color0) + 3); /*LDRB W6, params->color0+3*/
+                break;
+            case CCA_LOCALSELECT_ITER_Z:
+                addldst(A64_LDR_W, REG_ECX, REG_STATE, offsetof(voodoo_state_t, z)); /*LDR W6, state->z*/
+                if (a_sel != A_SEL_ITER_A) {
+                    addlong(A64_MOVZ_W(REG_EAX, 0, 0));    /*MOV W4, #0*/
+                    addlong(A64_MOVZ_W(REG_EDX, 0xff, 0)); /*MOV W7, #0xff*/
+                }
+                addlong(A64_ASR_IMM_W(REG_ECX, REG_ECX, 20));            /*ASR W6, W6, #20*/
+                addlong(A64_CMP_IMM_W(REG_ECX, 0));                      /*CMP W6, #0*/
+                addlong(A64_CSEL_W(REG_ECX, REG_EAX, REG_ECX, COND_MI)); /*CSEL W6, W4, W6, MI*/
+                addlong(A64_CMP_W(REG_ECX, REG_EDX));                    /*CMP W6, W7*/
+                addlong(A64_CSEL_W(REG_ECX, REG_EDX, REG_ECX, COND_HI)); /*CSEL W6, W7, W6, HI*/
+                break;
+
+            default:
+                addlong(A64_MOVZ_W(REG_ECX, 0xff, 0)); /*MOV W6, #0xff*/
+                break;
+        }
+
+        if (cca_zero_other) {
+            addlong(A64_MOVZ_W(REG_EDX, 0, 0)); /*MOV W7, #0*/
+        } else {
+            addlong(A64_MOV_W(REG_EDX, REG_EBX)); /*MOV W7, W5*/
+        }
+
+        if (cca_sub_clocal) {
+            addlong(A64_SUB_W(REG_EDX, REG_EDX, REG_ECX)); /*SUB W7, W7, W6*/
+        }
+    }
+
+    if (cc_sub_clocal || cc_mselect == 1 || cc_add == 1) {
+        /*V1 = local*/
+        if (!cc_localselect_override) {
+            if (cc_localselect) {
+                addldst(A64_LDR_S, 1, REG_PARAMS, offsetof(voodoo_params_t, color0)); /*LDR S1, params->color0*/
+            } else {
+                addldst(A64_LDR_Q, 1, REG_STATE, offsetof(voodoo_state_t, ib)); /*LDR Q1, ib*/ /* ir, ig and ib must be in same dqword!*/
+                addlong(A64_SSHR_4S(1, 1, 12)); /*SSHR V1.4S, V1.4S, #12*/
+                addpackssdw(1);                 /*PACKSSDW V1, V1*/
+                addpackuswb(1);                 /*PACKUSWB V1, V1*/
+            }
+        } else {
+            int local_pos;
+            int local_pos2;
+
+            addldst(A64_LDRB_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, tex_a)); /*LDRB W16, state->tex_a*/
+            local_pos = block_pos;
+            addlong(A64_TBZ(REG_TEMP, 7, 0)); /*TBZ W16, #7, !cc_localselect*/
+            addldst(A64_LDR_S, 1, REG_PARAMS, offsetof(voodoo_params_t, color0)); /*LDR S1, params->color0*/
+            local_pos2 = block_pos;
+            addlong(A64_B(0)); /*B +*/
+            /*!cc_localselect:*/
+            *(uint32_t *) &code_block[local_pos] |= (((block_pos - local_pos) >> 2) & 0x3fff) << 5;
+            addldst(A64_LDR_Q, 1, REG_STATE, offsetof(voodoo_state_t, ib)); /*LDR Q1, ib*/ /* ir, ig and ib must be in same dqword!*/
+            addlong(A64_SSHR_4S(1, 1, 12)); /*SSHR V1.4S, V1.4S, #12*/
+            addpackssdw(1);                 /*PACKSSDW V1, V1*/
+            addpackuswb(1);                 /*PACKUSWB V1, V1*/
+            A64_PATCH_B(local_pos2);
+        }
+        addlong(A64_UXTL_8H(1, 1)); /*UXTL V1.8H, V1.8B*/
+    }
+    if (!cc_zero_other) {
+        if (_rgb_sel == CC_LOCALSELECT_ITER_RGB) {
+            addldst(A64_LDR_Q, 0, REG_STATE, offsetof(voodoo_state_t, ib)); /*LDR Q0, ib*/ /* ir, ig and ib must be in same dqword!*/
+            addlong(A64_SSHR_4S(0, 0, 12)); /*SSHR V0.4S, V0.4S, #12*/
+            addpackssdw(0);                 /*PACKSSDW V0, V0*/
+            addpackuswb(0);                 /*PACKUSWB V0, V0*/
+        } else if (_rgb_sel == CC_LOCALSELECT_TEX) {
+            /*V0 already holds the texture colour*/
+        } else if (_rgb_sel == CC_LOCALSELECT_COLOR1) {
+            addldst(A64_LDR_S, 0, REG_PARAMS, offsetof(voodoo_params_t, color1)); /*LDR S0, params->color1*/
+        } else {
+            /*MOVD XMM0, src_r*/
+        }
+        addlong(A64_UXTL_8H(0, 0)); /*UXTL V0.8H, V0.8B*/
+        if (cc_sub_clocal) {
+            addlong(A64_SUB_8H(0, 0, 1)); /*SUB V0.8H, V0.8H, V1.8H*/
+        }
+    } else {
+        addlong(A64_MOVI_ZERO(0)); /*MOVI V0, #0*/
+        if (cc_sub_clocal) {
+            addlong(A64_SUB_8H(0, 0, 1)); /*SUB V0.8H, V0.8H, V1.8H*/
+        }
+    }
+
+    if (params->alphaMode & ((1 << 0) | (1 << 4))) {
+        if (!(cca_mselect == 0 && cca_reverse_blend == 0)) {
+            switch (cca_mselect) {
+                case CCA_MSELECT_ALOCAL:
+                    addlong(A64_MOV_W(REG_EAX, REG_ECX)); /*MOV W4, W6*/
+                    break;
+                case CCA_MSELECT_AOTHER:
+                    addlong(A64_MOV_W(REG_EAX, REG_EBX)); /*MOV W4, W5*/
+                    break;
+                case CCA_MSELECT_ALOCAL2:
+                    addlong(A64_MOV_W(REG_EAX, REG_ECX)); /*MOV W4, W6*/
+                    break;
+                case CCA_MSELECT_TEX:
+                    addldst(A64_LDRB_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, tex_a)); /*LDRB W4, state->tex_a*/
+                    break;
+
+                case CCA_MSELECT_ZERO:
+                default:
+                    addlong(A64_MOVZ_W(REG_EAX, 0, 0)); /*MOV W4, #0*/
+                    break;
+            }
+            if (!cca_reverse_blend) {
+                addlong(A64_EOR_IMM_W(REG_EAX, REG_EAX, 0, 8)); /*EOR W4, W4, #0xff*/
+            }
+            addlong(A64_ADD_IMM_W(REG_EAX, REG_EAX, 1));   /*ADD W4, W4, #1*/
+            addlong(A64_MUL_W(REG_EDX, REG_EDX, REG_EAX)); /*MUL W7, W7, W4*/
+            addlong(A64_LSR_IMM_W(REG_EDX, REG_EDX, 8));   /*LSR W7, W7, #8*/
+        }
+    }
+
+    if ((params->alphaMode & ((1 << 0) | (1 << 4)))) {
+        addlong(A64_MOVZ_W(REG_EAX, 0, 0)); /*MOV W4, #0*/
+    }
+
+    if (!(cc_mselect == 0 && cc_reverse_blend == 0) && cc_mselect == CC_MSELECT_AOTHER) {
+        /*Copy a_other to V3 before it gets modified*/
+        addlong(A64_DUP_4H_W(3, REG_EDX)); /*DUP V3.4H, W7*/
+    }
+
+    if (cca_add && (params->alphaMode & ((1 << 0) | (1 << 4)))) {
+        addlong(A64_ADD_W(REG_EDX, REG_EDX, REG_ECX)); /*ADD W7, W7, W6*/
+    }
+
+    if ((params->alphaMode & ((1 << 0) | (1 << 4)))) {
+        addlong(A64_CMP_IMM_W(REG_EDX, 0));                      /*CMP W7, #0*/
+        addlong(A64_CSEL_W(REG_EDX, REG_EAX, REG_EDX, COND_MI)); /*CSEL W7, W4, W7, MI*/
+        addlong(A64_MOVZ_W(REG_EAX, 0xff, 0));                   /*MOV W4, #0xff*/
+        addlong(A64_CMP_IMM_W(REG_EDX, 0xff));                   /*CMP W7, #0xff*/
+        addlong(A64_CSEL_W(REG_EDX, REG_EAX, REG_EDX, COND_HI)); /*CSEL W7, W4, W7, HI*/
+        if (cca_invert_output) {
+            addlong(A64_EOR_IMM_W(REG_EDX, REG_EDX, 0, 8)); /*EOR W7, W7, #0xff*/
+        }
+    }
+
+    if (!(cc_mselect == 0 && cc_reverse_blend == 0)) {
+        switch (cc_mselect) {
+            case CC_MSELECT_ZERO:
+                addlong(A64_MOVI_ZERO(3)); /*MOVI V3, #0*/
+                break;
+            case CC_MSELECT_CLOCAL:
+                addlong(A64_MOV_8B(3, 1)); /*MOV V3.8B, V1.8B*/
+                break;
+            case CC_MSELECT_ALOCAL:
+                addlong(A64_DUP_4H_W(3, REG_ECX)); /*DUP V3.4H, W6*/
+                break;
+            case CC_MSELECT_AOTHER:
+                /*Handled above*/
+                break;
+            case CC_MSELECT_TEX:
+                addldst(A64_LDRH_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, tex_a)); /*LDRH W16, state->tex_a*/
+                addlong(A64_INS_H_W(3, 0, REG_TEMP)); /*INS V3.H[0], W16*/
+                addlong(A64_INS_H_W(3, 1, REG_TEMP)); /*INS V3.H[1], W16*/
+                addlong(A64_INS_H_W(3, 2, REG_TEMP)); /*INS V3.H[2], W16*/
+                break;
+            case CC_MSELECT_TEXRGB:
+                addlong(A64_UXTL_8H(4, 4)); /*UXTL V4.8H, V4.8B*/
+                addlong(A64_MOV_8B(3, 4));  /*MOV V3.8B, V4.8B*/
+                break;
+            default:
+                addlong(A64_MOVI_ZERO(3)); /*MOVI V3, #0*/
+                break;
+        }
+        if (!cc_reverse_blend) {
+            addlong(A64_EOR_16B(3, 3, REG_XMM_FF_W)); /*EOR V3.16B, V3.16B, V17(xmm_ff_w).16B*/
+        }
+        addlong(A64_ADD_8H(3, 3, REG_XMM_01_W)); /*ADD V3.8H, V3.8H, V16(xmm_01_w).8H*/
+        addlong(A64_SMULL_4S(0, 0, 3));          /*SMULL V0.4S, V0.4H, V3.4H*/
+        addlong(A64_SSHR_4S(0, 0, 8));           /*SSHR V0.4S, V0.4S, #8*/
+        addpackssdw(0);                          /*PACKSSDW V0, V0*/
+    }
+
+    if (cc_add == 1) {
+        addlong(A64_ADD_8H(0, 0, 1)); /*ADD V0.8H, V0.8H, V1.8H*/
+    }
+
+    addpackuswb(0); /*PACKUSWB V0, V0*/
+
+    if (cc_invert_output) {
+        addlong(A64_EOR_16B(0, 0, REG_XMM_FF_B)); /*EOR V0.16B, V0.16B, V18(xmm_ff_b).16B*/
+    }
+
+    addlong(A64_MOV_8B(REG_COLBFOG, 0)); /*MOV V20(colbfog).8B, V0.8B*/
+
+    if (params->fogMode & FOG_ENABLE) {
+        if (params->fogMode & FOG_CONSTANT) {
+            addldst(A64_LDR_S, 3, REG_PARAMS, offsetof(voodoo_params_t, fogColor)); /*LDR S3, params->fogColor*/
+            addlong(A64_UQADD_16B(0, 0, 3)); /*UQADD V0.16B, V0.16B, V3.16B*/
+        } else {
+            addlong(A64_UXTL_8H(0, 0)); /*UXTL V0.8H, V0.8B*/
+
+            if (!(params->fogMode & FOG_ADD)) {
+                addldst(A64_LDR_S, 3, REG_PARAMS, offsetof(voodoo_params_t, fogColor)); /*LDR S3, params->fogColor*/
+                addlong(A64_UXTL_8H(3, 3)); /*UXTL V3.8H, V3.8B*/
+            } else {
+                addlong(A64_MOVI_ZERO(3)); /*MOVI V3, #0*/
+            }
+
+            if (!(params->fogMode & FOG_MULT)) {
+                addlong(A64_SUB_8H(3, 3, 0)); /*SUB V3.8H, V3.8H, V0.8H*/
+            }
+
+            /*Divide by 2 to prevent overflow on multiply*/
+            addlong(A64_SSHR_8H(3, 3, 1)); /*SSHR V3.8H, V3.8H, #1*/
+
+            switch (params->fogMode & (FOG_Z | FOG_ALPHA)) {
+                case 0:
+                    addldst(A64_LDR_W, REG_EBX, REG_STATE, offsetof(voodoo_state_t, w_depth)); /*LDR W5, state->w_depth*/
+                    addlong(A64_MOV_W(REG_EAX, REG_EBX));              /*MOV W4, W5*/
+                    addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 10));      /*LSR W5, W5, #10*/
+                    addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 2));       /*LSR W4, W4, #2*/
+                    addlong(A64_AND_IMM_W(REG_EBX, REG_EBX, 0, 6));    /*AND W5, W5, #0x3f*/
+                    addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 0, 8));    /*AND W4, W4, #0xff*/
+                    addlong(A64_ADD_UXTW_X(REG_TEMP, REG_PARAMS, REG_EBX, 1)); /*ADD X16, X1, W5, UXTW #1*/
+                    addldst(A64_LDRB_W, REG_TEMP2, REG_TEMP, offsetof(voodoo_params_t, fogTable) + 1); /*LDRB W17, params->fogTable+1[X16]*/
+                    addlong(A64_MUL_W(REG_EAX, REG_EAX, REG_TEMP2));   /*MUL W4, W4, W17*/
+                    addldst(A64_LDRB_W, REG_EBX, REG_TEMP, offsetof(voodoo_params_t, fogTable)); /*LDRB W5, params->fogTable[X16]*/
+                    addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 10));      /*LSR W4, W4, #10*/
+                    addlong(A64_ADD_W(REG_EAX, REG_EAX, REG_EBX));     /*ADD W4, W4, W5*/
+                    break;
+
+                case FOG_Z:
+                    addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, z)); /*LDR W4, state->z*/
+                    addlong(A64_UBFX_W(REG_EAX, REG_EAX, 12, 8)); /*UBFX W4, W4, #12, #8*/
+                    break;
+
+                case FOG_ALPHA:
+                    addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, ia)); /*LDR W4, state->ia*/
+                    addlong(A64_MOVZ_W(REG_EBX, 0, 0));                      /*MOV W5, #0*/
+                    addlong(A64_ASR_IMM_W(REG_EAX, REG_EAX, 12));            /*ASR W4, W4, #12*/
+                    addlong(A64_CMP_IMM_W(REG_EAX, 0));                      /*CMP W4, #0*/
+                    addlong(A64_CSEL_W(REG_EAX, REG_EBX, REG_EAX, COND_MI)); /*CSEL W4, W5, W4, MI*/
+                    addlong(A64_MOVZ_W(REG_EBX, 0xff, 0));                   /*MOV W5, #0xff*/
+                    addlong(A64_CMP_IMM_W(REG_EAX, 0xff));                   /*CMP W4, #0xff*/
+                    addlong(A64_CSEL_W(REG_EAX, REG_EBX, REG_EAX, COND_HS)); /*CSEL W4, W5, W4, HS*/
+                    break;
+
+                case FOG_W:
+                    addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, w) + 4); /*LDR W4, state->w+4*/
+                    addlong(A64_MOVZ_W(REG_EBX, 0, 0));                      /*MOV W5, #0*/
+                    addlong(A64_CMP_IMM_W(REG_EAX, 0));                      /*CMP W4, #0*/
+                    addlong(A64_CSEL_W(REG_EAX, REG_EBX, REG_EAX, COND_MI)); /*CSEL W4, W5, W4, MI*/
+                    addlong(A64_MOVZ_W(REG_EBX, 0xff, 0));                   /*MOV W5, #0xff*/
+                    addlong(A64_CMP_IMM_W(REG_EAX, 0xff));                   /*CMP W4, #0xff*/
+                    addlong(A64_CSEL_W(REG_EAX, REG_EBX, REG_EAX, COND_HS)); /*CSEL W4, W5, W4, HS*/
+                    break;
+            }
+            addlong(A64_ADD_IMM_W(REG_TEMP, REG_EAX, 1));  /*ADD W16, W4, #1*/
+            addlong(A64_DUP_4H_W(REG_VTEMP, REG_TEMP));    /*DUP V21.4H, W16 (alookup[fog_a + 1])*/
+            addlong(A64_ADD_W(REG_EAX, REG_EAX, REG_EAX)); /*ADD W4, W4, W4*/
+
+            addlong(A64_MUL_8H(3, 3, REG_VTEMP)); /*MUL V3.8H, V3.8H, V21.8H*/
+            addlong(A64_SSHR_8H(3, 3, 7));        /*SSHR V3.8H, V3.8H, #7*/
+
+            if (params->fogMode & FOG_MULT) {
+                addlong(A64_MOV_8B(0, 3)); /*MOV V0.8B, V3.8B*/
+            } else {
+                addlong(A64_ADD_8H(0, 0, 3)); /*ADD V0.8H, V0.8H, V3.8H*/
+            }
+            addpackuswb(0); /*PACKUSWB V0, V0*/
+        }
+    }
+
+    if ((params->alphaMode & 1) && (alpha_func != AFUNC_NEVER) && (alpha_func != AFUNC_ALWAYS)) {
+        int cond = COND_HS;
+
+        addldst(A64_LDRB_W, REG_ECX, REG_PARAMS, offsetof(voodoo_params_t, alphaMode) + 3); /*LDRB W6, params->alphaMode+3*/
+        addlong(A64_CMP_W(REG_EDX, REG_ECX)); /*CMP W7, W6*/
+
+        switch (alpha_func) {
+            case AFUNC_LESSTHAN:
+                cond = COND_HS;
+                break;
+            case AFUNC_EQUAL:
+                cond = COND_NE;
+                break;
+            case AFUNC_LESSTHANEQUAL:
+                cond = COND_HI;
+                break;
+            case AFUNC_GREATERTHAN:
+                cond = COND_LS;
+                break;
+            case AFUNC_NOTEQUAL:
+                cond = COND_EQ;
+                break;
+            case AFUNC_GREATERTHANEQUAL:
+                cond = COND_LO;
+                break;
+        }
+        a_skip_pos = block_pos;
+        addlong(A64_BCOND(cond, 0)); /*B.cond skip*/
+    } else if ((params->alphaMode & 1) && (alpha_func == AFUNC_NEVER)) {
+        addlong(A64_RET); /*RET*/
+    }
+
+    if (params->alphaMode & (1 << 4)) {
+        addmovimm64(REG_TEMP, (uintptr_t) rgb565); /*MOV X16, rgb565*/
+        addldst(A64_LDR_W, REG_EAX, REG_STATE, params->col_tiled ? offsetof(voodoo_state_t, x_tiled) : offsetof(voodoo_state_t, x)); /*LDR W4, state->x*/
+        addldst(A64_LDR_X, REG_EBP, REG_STATE, offsetof(voodoo_state_t, fb_mem)); /*LDR X8, fb_mem*/
+        addlong(A64_ADD_W(REG_EDX, REG_EDX, REG_EDX));        /*ADD W7, W7, W7*/
+        addlong(A64_LDRH_UXTW(REG_EAX, REG_EBP, REG_EAX));    /*LDRH W4, [X8, W4, UXTW #1]*/
+        addlong(A64_UXTL_8H(0, 0));                           /*UXTL V0.8H, V0.8B*/
+        addlong(A64_LDR_S_UXTW(4, REG_TEMP, REG_EAX));        /*LDR S4, [X16(rgb565), W4, UXTW #2]*/
+        addlong(A64_UXTL_8H(4, 4));                           /*UXTL V4.8H, V4.8B*/
+        addlong(A64_MOV_8B(6, 4));                            /*MOV V6.8B, V4.8B*/
+
+        switch (dest_afunc) {
+            case AFUNC_AZERO:
+                addlong(A64_MOVI_ZERO(4)); /*MOVI V4, #0*/
+                break;
+            case AFUNC_ASRC_ALPHA:
+                addlong(A64_LSR_IMM_W(REG_TEMP, REG_EDX, 1)); /*LSR W16, W7, #1*/
+                addlong(A64_DUP_4H_W(REG_VTEMP, REG_TEMP));   /*DUP V21.4H, W16 (alookup[src_a])*/
+                block_pos = codegen_alpha_blend(code_block, block_pos, 4, REG_VTEMP);
+                break;
+            case AFUNC_A_COLOR:
+                block_pos = codegen_alpha_blend(code_block, block_pos, 4, 0);
+                break;
+            case AFUNC_ADST_ALPHA:
+                break;
+            case AFUNC_AONE:
+                break;
+            case AFUNC_AOMSRC_ALPHA:
+                addlong(A64_LSR_IMM_W(REG_TEMP, REG_EDX, 1));        /*LSR W16, W7, #1*/
+                addlong(A64_EOR_IMM_W(REG_TEMP, REG_TEMP, 0, 8));    /*EOR W16, W16, #0xff*/
+                addlong(A64_DUP_4H_W(REG_VTEMP, REG_TEMP));          /*DUP V21.4H, W16 (aminuslookup[src_a])*/
+                block_pos = codegen_alpha_blend(code_block, block_pos, 4, REG_VTEMP);
+                break;
+            case AFUNC_AOM_COLOR:
+                addlong(A64_MOV_8B(REG_VTEMP, REG_XMM_FF_W)); /*MOV V21.8B, V17(xmm_ff_w).8B*/
+                addlong(A64_SUB_8H(REG_VTEMP, REG_VTEMP, 0)); /*SUB V21.8H, V21.8H, V0.8H*/
+                block_pos = codegen_alpha_blend(code_block, block_pos, 4, REG_VTEMP);
+                break;
+            case AFUNC_AOMDST_ALPHA:
+                addlong(A64_MOVI_ZERO(4)); /*MOVI V4, #0*/
+                break;
+            case AFUNC_ACOLORBEFOREFOG:
+                block_pos = codegen_alpha_blend(code_block, block_pos, 4, REG_COLBFOG);
+                break;
+        }
+
+        switch (src_afunc) {
+            case AFUNC_AZERO:
+                addlong(A64_MOVI_ZERO(0)); /*MOVI V0, #0*/
+                break;
+            case AFUNC_ASRC_ALPHA:
+                addlong(A64_LSR_IMM_W(REG_TEMP, REG_EDX, 1)); /*LSR W16, W7, #1*/
+                addlong(A64_DUP_4H_W(REG_VTEMP, REG_TEMP));   /*DUP V21.4H, W16 (alookup[src_a])*/
+                block_pos = codegen_alpha_blend(code_block, block_pos, 0, REG_VTEMP);
+                break;
+            case AFUNC_A_COLOR:
+                block_pos = codegen_alpha_blend(code_block, block_pos, 0, 6);
+                break;
+            case AFUNC_ADST_ALPHA:
+                break;
+            case AFUNC_AONE:
+                break;
+            case AFUNC_AOMSRC_ALPHA:
+                addlong(A64_LSR_IMM_W(REG_TEMP, REG_EDX, 1));     /*LSR W16, W7, #1*/
+                addlong(A64_EOR_IMM_W(REG_TEMP, REG_TEMP, 0, 8)); /*EOR W16, W16, #0xff*/
+                addlong(A64_DUP_4H_W(REG_VTEMP, REG_TEMP));       /*DUP V21.4H, W16 (aminuslookup[src_a])*/
+                block_pos = codegen_alpha_blend(code_block, block_pos, 0, REG_VTEMP);
+                break;
+            case AFUNC_AOM_COLOR:
+                addlong(A64_MOV_8B(REG_VTEMP, REG_XMM_FF_W)); /*MOV V21.8B, V17(xmm_ff_w).8B*/
+                addlong(A64_SUB_8H(REG_VTEMP, REG_VTEMP, 6)); /*SUB V21.8H, V21.8H, V6.8H*/
+                block_pos = codegen_alpha_blend(code_block, block_pos, 0, REG_VTEMP);
+                break;
+            case AFUNC_AOMDST_ALPHA:
+                addlong(A64_MOVI_ZERO(0)); /*MOVI V0, #0*/
+                break;
+            case AFUNC_ASATURATE:
+                block_pos = codegen_alpha_blend(code_block, block_pos, 0, REG_MINUS_254);
+                break;
+        }
+
+        addlong(A64_ADD_8H(0, 0, 4)); /*ADD V0.8H, V0.8H, V4.8H*/
+
+        addpackuswb(0); /*PACKUSWB V0, V0*/
+    }
+
+    addldst(A64_LDR_W, REG_EDX, REG_STATE, params->col_tiled ? offsetof(voodoo_state_t, x_tiled) : offsetof(voodoo_state_t, x)); /*LDR W7, state->x*/
+
+    addlong(A64_FMOV_W_S(REG_EAX, 0)); /*FMOV W4, S0*/
+
+    if (params->fbzMode & FBZ_RGB_WMASK) {
+        if (dither) {
+            addmovimm64(REG_TEMP, dither2x2 ? (uintptr_t) dither_rb2x2 : (uintptr_t) dither_rb); /*MOV X16, dither_rb*/
+            addlong(A64_MOV_W(REG_ESI, REG_REAL_Y));         /*MOV W15, W3 (real_y)*/
+            addlong(A64_UBFX_W(REG_EBX, REG_EAX, 8, 8));     /*UBFX W5, W4, #8, #8*/ /*G*/
+            if (dither2x2) {
+                addlong(A64_AND_IMM_W(REG_EDX, REG_EDX, 0, 1)); /*AND W7, W7, #1*/
+                addlong(A64_AND_IMM_W(REG_ESI, REG_ESI, 0, 1)); /*AND W15, W15, #1*/
+                addlong(A64_LSL_IMM_W(REG_EBX, REG_EBX, 2));    /*LSL W5, W5, #2*/
+            } else {
+                addlong(A64_AND_IMM_W(REG_EDX, REG_EDX, 0, 2)); /*AND W7, W7, #3*/
+                addlong(A64_AND_IMM_W(REG_ESI, REG_ESI, 0, 2)); /*AND W15, W15, #3*/
+                addlong(A64_LSL_IMM_W(REG_EBX, REG_EBX, 4));    /*LSL W5, W5, #4*/
+            }
+            addlong(A64_AND_IMM_W(REG_ECX, REG_EAX, 0, 8)); /*AND W6, W4, #0xff*/ /*R*/
+            if (dither2x2) {
+                addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 14));            /*LSR W4, W4, #14*/
+                addlong(A64_ADD_LSL_W(REG_ESI, REG_EDX, REG_ESI, 1));    /*ADD W15, W7, W15, LSL #1*/
+            } else {
+                addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 12));            /*LSR W4, W4, #12*/
+                addlong(A64_ADD_LSL_W(REG_ESI, REG_EDX, REG_ESI, 2));    /*ADD W15, W7, W15, LSL #2*/
+            }
+            addldst(A64_LDR_W, REG_EDX, REG_STATE, voodoo->col_tiled ? offsetof(voodoo_state_t, x_tiled) : offsetof(voodoo_state_t, x)); /*LDR W7, state->x*/
+            addlong(A64_ADD_UXTW_X(REG_ESI, REG_TEMP, REG_ESI, 0)); /*ADD X15, X16, W15, UXTW*/
+            if (dither2x2) {
+                addlong(A64_LSL_IMM_W(REG_ECX, REG_ECX, 2));    /*LSL W6, W6, #2*/
+                addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 2, 8)); /*AND W4, W4, #0x3fc*/ /*B*/
+            } else {
+                addlong(A64_LSL_IMM_W(REG_ECX, REG_ECX, 4));    /*LSL W6, W6, #4*/
+                addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 4, 8)); /*AND W4, W4, #0xff0*/ /*B*/
+            }
+            addmovimm64(REG_TEMP2, dither2x2 ? ((uintptr_t) dither_g2x2 - (uintptr_t) dither_rb2x2) : ((uintptr_t) dither_g - (uintptr_t) dither_rb)); /*MOV X17, dither_g - dither_rb*/
+            addlong(A64_ADD_X(REG_TEMP2, REG_ESI, REG_TEMP2));       /*ADD X17, X15, X17*/
+            addlong(A64_LDRB_UXTW(REG_EBX, REG_TEMP2, REG_EBX));     /*LDRB W5, dither_g[X17, W5, UXTW]*/
+            addlong(A64_LDRB_UXTW(REG_ECX, REG_ESI, REG_ECX));       /*LDRB W6, dither_rb[X15, W6, UXTW]*/
+            addlong(A64_LDRB_UXTW(REG_EAX, REG_ESI, REG_EAX));       /*LDRB W4, dither_rb[X15, W4, UXTW]*/
+            addlong(A64_LSL_IMM_W(REG_EBX, REG_EBX, 5));             /*LSL W5, W5, #5*/
+            addlong(A64_LSL_IMM_W(REG_EAX, REG_EAX, 11));            /*LSL W4, W4, #11*/
+            addlong(A64_ORR_W(REG_EAX, REG_EAX, REG_EBX));           /*ORR W4, W4, W5*/
+            addlong(A64_ORR_W(REG_EAX, REG_EAX, REG_ECX));           /*ORR W4, W4, W6*/
+        } else {
+            addlong(A64_MOV_W(REG_EBX, REG_EAX));             /*MOV W5, W4*/
+            addlong(A64_UBFX_W(REG_ECX, REG_EAX, 8, 8));      /*UBFX W6, W4, #8, #8*/
+            addlong(A64_LSR_IMM_W(REG_EAX, REG_EAX, 3));      /*LSR W4, W4, #3*/
+            addlong(A64_LSR_IMM_W(REG_EBX, REG_EBX, 8));      /*LSR W5, W5, #8*/
+            addlong(A64_LSL_IMM_W(REG_ECX, REG_ECX, 3));      /*LSL W6, W6, #3*/
+            addlong(A64_AND_IMM_W(REG_EAX, REG_EAX, 0, 5));   /*AND W4, W4, #0x001f*/
+            addlong(A64_AND_IMM_W(REG_EBX, REG_EBX, 11, 5));  /*AND W5, W5, #0xf800*/
+            addlong(A64_AND_IMM_W(REG_ECX, REG_ECX, 5, 6));   /*AND W6, W6, #0x07e0*/
+            addlong(A64_ORR_W(REG_EAX, REG_EAX, REG_EBX));    /*ORR W4, W4, W5*/
+            addlong(A64_ORR_W(REG_EAX, REG_EAX, REG_ECX));    /*ORR W4, W4, W6*/
+        }
+        addldst(A64_LDR_X, REG_ESI, REG_STATE, offsetof(voodoo_state_t, fb_mem)); /*LDR X15, fb_mem*/
+        addlong(A64_STRH_UXTW(REG_EAX, REG_ESI, REG_EDX)); /*STRH W4, [X15, W7, UXTW #1]*/
+    }
+
+    if ((params->fbzMode & (FBZ_DEPTH_WMASK | FBZ_DEPTH_ENABLE)) == (FBZ_DEPTH_WMASK | FBZ_DEPTH_ENABLE)) {
+        addldst(A64_LDR_W, REG_EDX, REG_STATE, params->aux_tiled ? offsetof(voodoo_state_t, x_tiled) : offsetof(voodoo_state_t, x)); /*LDR W7, state->x*/
+        addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, new_depth)); /*LDR W4, new_depth*/
+        addldst(A64_LDR_X, REG_ESI, REG_STATE, offsetof(voodoo_state_t, aux_mem));   /*LDR X15, aux_mem*/
+        addlong(A64_STRH_UXTW(REG_EAX, REG_ESI, REG_EDX)); /*STRH W4, [X15, W7, UXTW #1]*/
+    }
+
+    if (z_skip_pos)
+        A64_PATCH_BCOND(z_skip_pos);
+    if (a_skip_pos)
+        A64_PATCH_BCOND(a_skip_pos);
+    if (chroma_skip_pos)
+        A64_PATCH_BCOND(chroma_skip_pos);
+
+    addldst(A64_LDR_Q, 1, REG_STATE, offsetof(voodoo_state_t, ib));                /*LDR Q1, state->ib*/
+    addldst(A64_LDR_Q, 3, REG_STATE, offsetof(voodoo_state_t, tmu0_s));            /*LDR Q3, state->tmu0_s*/
+    addldst(A64_LDR_D, 4, REG_STATE, offsetof(voodoo_state_t, tmu0_w));            /*LDR D4, state->tmu0_w*/
+    addldst(A64_LDR_Q, 0, REG_PARAMS, offsetof(voodoo_params_t, dBdX));            /*LDR Q0, params->dBdX*/
+    addldst(A64_LDR_W, REG_EAX, REG_PARAMS, offsetof(voodoo_params_t, dZdX));      /*LDR W4, params->dZdX*/
+    addldst(A64_LDR_Q, 5, REG_PARAMS, offsetof(voodoo_params_t, tmu[0].dSdX));     /*LDR Q5, params->tmu[0].dSdX*/
+    addldst(A64_LDR_D, 6, REG_PARAMS, offsetof(voodoo_params_t, tmu[0].dWdX));     /*LDR D6, params->tmu[0].dWdX*/
+
+    if (state->xdir > 0) {
+        addlong(A64_ADD_4S(1, 1, 0)); /*ADD V1.4S, V1.4S, V0.4S*/
+    } else {
+        addlong(A64_SUB_4S(1, 1, 0)); /*SUB V1.4S, V1.4S, V0.4S*/
+    }
+
+    addldst(A64_LDR_D, 0, REG_STATE, offsetof(voodoo_state_t, w));   /*LDR D0, state->w*/
+    addldst(A64_STR_Q, 1, REG_STATE, offsetof(voodoo_state_t, ib));  /*STR Q1, state->ib*/
+    addldst(A64_LDR_D, 7, REG_PARAMS, offsetof(voodoo_params_t, dWdX)); /*LDR D7, params->dWdX*/
+    addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, z)); /*LDR W16, state->z*/
+
+    if (state->xdir > 0) {
+        addlong(A64_ADD_2D(3, 3, 5));                    /*ADD V3.2D, V3.2D, V5.2D*/
+        addlong(A64_ADD_2D(4, 4, 6));                    /*ADD V4.2D, V4.2D, V6.2D*/
+        addlong(A64_ADD_2D(0, 0, 7));                    /*ADD V0.2D, V0.2D, V7.2D*/
+        addlong(A64_ADD_W(REG_TEMP, REG_TEMP, REG_EAX)); /*ADD W16, W16, W4*/
+    } else {
+        addlong(A64_SUB_2D(3, 3, 5));                    /*SUB V3.2D, V3.2D, V5.2D*/
+        addlong(A64_SUB_2D(4, 4, 6));                    /*SUB V4.2D, V4.2D, V6.2D*/
+        addlong(A64_SUB_2D(0, 0, 7));                    /*SUB V0.2D, V0.2D, V7.2D*/
+        addlong(A64_SUB_W(REG_TEMP, REG_TEMP, REG_EAX)); /*SUB W16, W16, W4*/
+    }
+    addldst(A64_STR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, z)); /*STR W16, state->z*/
+
+    if (voodoo->dual_tmus) {
+        addldst(A64_LDR_Q, 5, REG_PARAMS, offsetof(voodoo_params_t, tmu[1].dSdX)); /*LDR Q5, params->tmu[1].dSdX*/
+        addldst(A64_LDR_D, 6, REG_PARAMS, offsetof(voodoo_params_t, tmu[1].dWdX)); /*LDR D6, params->tmu[1].dWdX*/
+    }
+
+    addldst(A64_STR_Q, 3, REG_STATE, offsetof(voodoo_state_t, tmu0_s)); /*STR Q3, state->tmu0_s*/
+    addldst(A64_STR_D, 4, REG_STATE, offsetof(voodoo_state_t, tmu0_w)); /*STR D4, state->tmu0_w*/
+    addldst(A64_STR_D, 0, REG_STATE, offsetof(voodoo_state_t, w));      /*STR D0, state->w*/
+
+    if (voodoo->dual_tmus) {
+        addldst(A64_LDR_Q, 3, REG_STATE, offsetof(voodoo_state_t, tmu1_s)); /*LDR Q3, state->tmu1_s*/
+        addldst(A64_LDR_D, 4, REG_STATE, offsetof(voodoo_state_t, tmu1_w)); /*LDR D4, state->tmu1_w*/
+
+        if (state->xdir > 0) {
+            addlong(A64_ADD_2D(3, 3, 5)); /*ADD V3.2D, V3.2D, V5.2D*/
+            addlong(A64_ADD_2D(4, 4, 6)); /*ADD V4.2D, V4.2D, V6.2D*/
+        } else {
+            addlong(A64_SUB_2D(3, 3, 5)); /*SUB V3.2D, V3.2D, V5.2D*/
+            addlong(A64_SUB_2D(4, 4, 6)); /*SUB V4.2D, V4.2D, V6.2D*/
+        }
+
+        addldst(A64_STR_Q, 3, REG_STATE, offsetof(voodoo_state_t, tmu1_s)); /*STR Q3, state->tmu1_s*/
+        addldst(A64_STR_D, 4, REG_STATE, offsetof(voodoo_state_t, tmu1_w)); /*STR D4, state->tmu1_w*/
+    }
+
+    addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, pixel_count)); /*LDR W16, state->pixel_count*/
+    addlong(A64_ADD_IMM_W(REG_TEMP, REG_TEMP, 1));                                  /*ADD W16, W16, #1*/
+    addldst(A64_STR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, pixel_count)); /*STR W16, state->pixel_count*/
+
+    if (params->fbzColorPath & FBZCP_TEXTURE_ENABLED) {
+        addldst(A64_LDR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, texel_count)); /*LDR W16, state->texel_count*/
+        if ((params->textureMode[0] & TEXTUREMODE_MASK) == TEXTUREMODE_PASSTHROUGH || (params->textureMode[0] & TEXTUREMODE_LOCAL_MASK) == TEXTUREMODE_LOCAL) {
+            addlong(A64_ADD_IMM_W(REG_TEMP, REG_TEMP, 1)); /*ADD W16, W16, #1*/
+        } else {
+            addlong(A64_ADD_IMM_W(REG_TEMP, REG_TEMP, 2)); /*ADD W16, W16, #2*/
+        }
+        addldst(A64_STR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, texel_count)); /*STR W16, state->texel_count*/
+    }
+
+    addldst(A64_LDR_W, REG_EAX, REG_STATE, offsetof(voodoo_state_t, x)); /*LDR W4, state->x*/
+
+    if (state->xdir > 0) {
+        addlong(A64_ADD_IMM_W(REG_TEMP, REG_EAX, 1)); /*ADD W16, W4, #1*/
+    } else {
+        addlong(A64_SUB_IMM_W(REG_TEMP, REG_EAX, 1)); /*SUB W16, W4, #1*/
+    }
+    addldst(A64_STR_W, REG_TEMP, REG_STATE, offsetof(voodoo_state_t, x)); /*STR W16, state->x*/
+
+    addldst(A64_LDR_W, REG_TEMP2, REG_STATE, offsetof(voodoo_state_t, x2)); /*LDR W17, state->x2*/
+    addlong(A64_CMP_W(REG_EAX, REG_TEMP2));                                 /*CMP W4, W17*/
+    addlong(A64_BCOND(COND_NE, (loop_jump_pos - block_pos) >> 2));          /*B.NE loop_jump_pos*/
+
+    addlong(A64_RET); /*RET*/
+
+#if defined(__APPLE__) && defined(__aarch64__)
+    if (__builtin_available(macOS 11.0, *)) {
+        pthread_jit_write_protect_np(1);
+    }
+#endif
+#ifndef _MSC_VER
+    __clear_cache((char *) code_block, (char *) &code_block[block_pos]);
+#else
+    FlushInstructionCache(GetCurrentProcess(), code_block, block_pos);
+#endif
+
+    return block_pos;
+}
+
+#include <86box/vid_voodoo_codegen_cache.h>
+
+void
+voodoo_codegen_init(voodoo_t *voodoo)
+{
+    voodoo_codegen_cache_init(voodoo);
+
+    for (uint16_t c = 0; c < 256; c++) {
+        int d[4];
+        int _ds = c & 0xf;
+        int dt  = c >> 4;
+
+        d[0] = (16 - _ds) * (16 - dt);
+        d[1] = _ds * (16 - dt);
+        d[2] = (16 - _ds) * dt;
+        d[3] = _ds * dt;
+
+        for (uint8_t i = 0; i < 4; i++) {
+            bilinear_lookup[c * 2][i]         = d[0];
+            bilinear_lookup[c * 2][i + 4]     = d[1];
+            bilinear_lookup[c * 2 + 1][i]     = d[2];
+            bilinear_lookup[c * 2 + 1][i + 4] = d[3];
+        }
+    }
+}
+
+void
+voodoo_codegen_close(voodoo_t *voodoo)
+{
+    voodoo_codegen_cache_close(voodoo);
+}
+
+#endif /*VIDEO_VOODOO_CODEGEN_ARM64_H*/
@@ -0,0 +1,147 @@
+/*Generated pipeline cache, shared by the Voodoo code generators.
+
+  Each render thread owns a set-associative cache of BLOCK_NUM generated
+  pipelines. The render state the generated code depends on is hashed into a
+  64-bit key which selects the set; a hit also requires the full state to
+  match. Within a set, the least recently used pipeline is replaced.
+
+  Only the generated code lives in the executable mapping. The cache entries
+  are kept in ordinary memory, so lookups never write to a page that may be
+  write protected (MAP_JIT on macOS).
+
+  The including code generator must define BLOCK_SIZE and voodoo_generate(),
+  which returns the number of bytes emitted.*/
+
+#ifndef VIDEO_VOODOO_CODEGEN_CACHE_H
+#define VIDEO_VOODOO_CODEGEN_CACHE_H
+
+#define BLOCK_SETS 64
+#define BLOCK_WAYS 4
+#define BLOCK_NUM  (BLOCK_SETS * BLOCK_WAYS)
+
+#define LOD_MASK   (LOD_TMIRROR_S | LOD_TMIRROR_T)
+
+/*All fields are 32 bits wide so the key has no padding and can be hashed and
+  compared as an array of words.*/
+typedef struct voodoo_codegen_key_t {
+    int      xdir;
+    uint32_t alphaMode;
+    uint32_t fbzMode;
+    uint32_t fogMode;
+    uint32_t fbzColorPath;
+    uint32_t textureMode[2];
+    uint32_t tLOD[2];
+    uint32_t trexInit1;
+    int      is_tiled;
+} voodoo_codegen_key_t;
+
+typedef struct voodoo_codegen_data_t {
+    uint8_t             *code_block; /*BLOCK_SIZE bytes in voodoo->codegen_code*/
+    uint64_t             hash;
+    uint32_t             last_used;
+    int                  valid;
+    voodoo_codegen_key_t key;
+} voodoo_codegen_data_t;
+
+#define VOODOO_CODEGEN_CODE_SIZE(voodoo) (BLOCK_SIZE * BLOCK_NUM * (voodoo)->render_threads)
+
+int voodoo_recomp = 0;
+
+static inline uint64_t
+voodoo_codegen_hash(const voodoo_codegen_key_t *key)
+{
+    const uint32_t *words = (const uint32_t *) key;
+    uint64_t        hash  = 0xcbf29ce484222325ULL;
+
+    for (unsigned int c = 0; c < (sizeof(voodoo_codegen_key_t) / sizeof(uint32_t)); c++) {
+        hash ^= words[c];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash ^ (hash >> 32);
+}
+
+static inline void *
+voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
+{
+    voodoo_codegen_data_t *codegen_data = voodoo->codegen_data;
+    voodoo_codegen_data_t *set;
+    voodoo_codegen_data_t *data;
+    voodoo_codegen_data_t *victim;
+    voodoo_codegen_key_t   key;
+    uint64_t               hash;
+    uint32_t               clock;
+
+    key.xdir           = state->xdir;
+    key.alphaMode      = params->alphaMode;
+    key.fbzMode        = params->fbzMode;
+    key.fogMode        = params->fogMode;
+    key.fbzColorPath   = params->fbzColorPath;
+    key.textureMode[0] = params->textureMode[0];
+    key.textureMode[1] = params->textureMode[1];
+    key.tLOD[0]        = params->tLOD[0] & LOD_MASK;
+    key.tLOD[1]        = params->tLOD[1] & LOD_MASK;
+    key.trexInit1      = voodoo->trexInit1[0] & (1 << 18);
+    key.is_tiled       = (params->col_tiled || params->aux_tiled) ? 1 : 0;
+
+    hash   = voodoo_codegen_hash(&key);
+    set    = &codegen_data[((odd_even * BLOCK_SETS) + (hash & (BLOCK_SETS - 1))) * BLOCK_WAYS];
+    clock  = ++voodoo->codegen_clock[odd_even];
+    victim = &set[0];
+
+    for (uint8_t c = 0; c < BLOCK_WAYS; c++) {
+        data = &set[c];
+
+        if (data->valid && (data->hash == hash) && !memcmp(&data->key, &key, sizeof(voodoo_codegen_key_t))) {
+            data->last_used = clock;
+            voodoo->codegen_hits[odd_even]++;
+            return data->code_block;
+        }
+
+        /*Prefer an empty entry, otherwise the least recently used one*/
+        if (victim->valid && (!data->valid || ((int32_t) (data->last_used - victim->last_used) < 0)))
+            victim = data;
+    }
+
+    voodoo_recomp++;
+    voodoo->codegen_misses[odd_even]++;
+    voodoo->codegen_bytes[odd_even] += voodoo_generate(victim->code_block, voodoo, params, state, depth_op);
+
+    victim->hash      = hash;
+    victim->key       = key;
+    victim->last_used = clock;
+    victim->valid     = 1;
+
+    return victim->code_block;
+}
+
+static void
+voodoo_codegen_cache_init(voodoo_t *voodoo)
+{
+    voodoo_codegen_data_t *codegen_data;
+
+    voodoo->codegen_code = plat_mmap(VOODOO_CODEGEN_CODE_SIZE(voodoo), 1);
+    voodoo->codegen_data = calloc(BLOCK_NUM * voodoo->render_threads, sizeof(voodoo_codegen_data_t));
+
+    codegen_data = voodoo->codegen_data;
+    for (int c = 0; c < (BLOCK_NUM * voodoo->render_threads); c++)
+        codegen_data[c].code_block = &voodoo->codegen_code[c * BLOCK_SIZE];
+}
+
+/*Also logs the cache statistics of each render thread, for tuning BLOCK_SETS
+  and BLOCK_WAYS.*/
+static void
+voodoo_codegen_cache_close(voodoo_t *voodoo)
+{
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo_render_log("Voodoo codegen thread %i: %i hits, %i misses, %" PRIu64 " bytes generated\n",
+                          c, voodoo->codegen_hits[c], voodoo->codegen_misses[c], voodoo->codegen_bytes[c]);
+    }
+
+    plat_munmap(voodoo->codegen_code, VOODOO_CODEGEN_CODE_SIZE(voodoo));
+    free(voodoo->codegen_data);
+    voodoo->codegen_code = NULL;
+    voodoo->codegen_data = NULL;
+}
+
+#endif /*VIDEO_VOODOO_CODEGEN_CACHE_H*/
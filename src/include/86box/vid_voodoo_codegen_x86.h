@@ -14,33 +14,13 @@
 #    include <xmmintrin.h>
 #endif
 
-#define BLOCK_NUM  8
-#define BLOCK_MASK (BLOCK_NUM - 1)
 #define BLOCK_SIZE 8192
 
-#define LOD_MASK   (LOD_TMIRROR_S | LOD_TMIRROR_T)
-
 /* Suppress a false positive warning on gcc that causes excessive build log spam */
 #if __GNUC__ >= 10
 #    pragma GCC diagnostic ignored "-Wstringop-overflow"
 #endif
 
-typedef struct voodoo_x86_data_t {
-    uint8_t  code_block[BLOCK_SIZE];
-    int      xdir;
-    uint32_t alphaMode;
-    uint32_t fbzMode;
-    uint32_t fogMode;
-    uint32_t fbzColorPath;
-    uint32_t textureMode[2];
-    uint32_t tLOD[2];
-    uint32_t trexInit1;
-    int      is_tiled;
-} voodoo_x86_data_t;
-
-static int last_block[4]          = { 0, 0 };
-static int next_block_to_write[4] = { 0, 0 };
-
 #define addbyte(val)                   \
     do {                               \
         code_block[block_pos++] = val; \
@@ -629,7 +609,7 @@ codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *pa
     return block_pos;
 }
 
-static inline void
+static inline int
 voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int depthop)
 {
     int block_pos       = 0;
@@ -3129,56 +3109,16 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
 
     if (params->textureMode[1] & TEXTUREMODE_TRILINEAR)
         cs = cs;
-}
-int voodoo_recomp = 0;
-
-static inline void *
-voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
-{
-    int                c;
-    int                b = last_block[odd_even];
-    voodoo_x86_data_t *data;
-    voodoo_x86_data_t *codegen_data = voodoo->codegen_data;
-
-    for (c = 0; c < 8; c++) {
-        data = &codegen_data[odd_even + b * 4];
-
-        if (state->xdir == data->xdir && params->alphaMode == data->alphaMode && params->fbzMode == data->fbzMode && params->fogMode == data->fogMode && params->fbzColorPath == data->fbzColorPath && (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1 && params->textureMode[0] == data->textureMode[0] && params->textureMode[1] == data->textureMode[1] && (params->tLOD[0] & LOD_MASK) == data->tLOD[0] && (params->tLOD[1] & LOD_MASK) == data->tLOD[1] && ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled) {
-            last_block[odd_even] = b;
-            return data->code_block;
-        }
 
-        b = (b + 1) & 7;
-    }
-    voodoo_recomp++;
-    data = &codegen_data[odd_even + next_block_to_write[odd_even] * 4];
-#if 0
-    code_block = data->code_block;
-#endif
-
-    voodoo_generate(data->code_block, voodoo, params, state, depth_op);
-
-    data->xdir           = state->xdir;
-    data->alphaMode      = params->alphaMode;
-    data->fbzMode        = params->fbzMode;
-    data->fogMode        = params->fogMode;
-    data->fbzColorPath   = params->fbzColorPath;
-    data->trexInit1      = voodoo->trexInit1[0] & (1 << 18);
-    data->textureMode[0] = params->textureMode[0];
-    data->textureMode[1] = params->textureMode[1];
-    data->tLOD[0]        = params->tLOD[0] & LOD_MASK;
-    data->tLOD[1]        = params->tLOD[1] & LOD_MASK;
-    data->is_tiled       = (params->col_tiled || params->aux_tiled) ? 1 : 0;
-
-    next_block_to_write[odd_even] = (next_block_to_write[odd_even] + 1) & 7;
-
-    return data->code_block;
+    return block_pos;
 }
 
+#include <86box/vid_voodoo_codegen_cache.h>
+
 void
 voodoo_codegen_init(voodoo_t *voodoo)
 {
-    voodoo->codegen_data = plat_mmap(sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4, 1);
+    voodoo_codegen_cache_init(voodoo);
 
     for (uint16_t c = 0; c < 256; c++) {
         int d[4];
@@ -3204,7 +3144,7 @@ voodoo_codegen_init(voodoo_t *voodoo)
 void
 voodoo_codegen_close(voodoo_t *voodoo)
 {
-    plat_munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4);
+    voodoo_codegen_cache_close(voodoo);
 }
 
 #endif /*VIDEO_VOODOO_CODEGEN_X86_H*/
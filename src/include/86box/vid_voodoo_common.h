@@ -30,7 +30,11 @@
 
 #define TEX_DIRTY_SHIFT 10
 
-#define TEX_CACHE_MAX   64
+/*Decoded textures are looked up through a hash of base address, tLOD and
+  palette checksum. The number of entries per TMU is configurable.*/
+#define TEX_CACHE_DEFAULT 64
+#define TEX_HASH_SHIFT    9
+#define TEX_HASH_SIZE     (1 << TEX_HASH_SHIFT)
 
 #ifdef __cplusplus
 #    include <atomic>
@@ -104,6 +108,16 @@ enum {
 #define PARAM_FULL(x)    ((voodoo->params_write_idx - voodoo->params_read_idx[x]) >= PARAM_SIZE)
 #define PARAM_EMPTY(x)   (voodoo->params_read_idx[x] == voodoo->params_write_idx)
 
+/*Render threads each own a set of horizontal screen tiles, VOODOO_TILE_HEIGHT
+  lines high, dealt out round-robin. Every thread walks the whole triangle
+  ring in order and only draws into the tiles it owns, so depth and colour
+  ordering within a tile is the same as with a single thread.*/
+#define VOODOO_MAX_RENDER_THREADS 16
+#define VOODOO_TILE_SHIFT         3
+#define VOODOO_TILE_HEIGHT        (1 << VOODOO_TILE_SHIFT)
+#define VOODOO_TILE_ROWS          (2048 >> VOODOO_TILE_SHIFT)
+#define VOODOO_TILE_OWNER(y)      (voodoo->tile_owner[((y) >> VOODOO_TILE_SHIFT) & (VOODOO_TILE_ROWS - 1)])
+
 typedef struct
 {
     uint32_t addr_type;
@@ -234,11 +248,14 @@ typedef struct texture_t {
     uint32_t   base;
     uint32_t   tLOD;
     atomic_int refcount;
-    atomic_int refcount_r[4];
+    atomic_int refcount_r[VOODOO_MAX_RENDER_THREADS];
     int        is16;
     uint32_t   palette_checksum;
-    uint32_t   addr_start[4];
-    uint32_t   addr_end[4];
+    uint32_t   addr_start[LOD_MAX + 1];
+    uint32_t   addr_end[LOD_MAX + 1];
+    uint32_t   lod_valid; /*LODs decoded and still matching texture memory*/
+    int        hash;
+    int        hash_next;
     uint32_t  *data;
 } texture_t;
 
@@ -266,6 +283,11 @@ typedef struct clip_t {
     int y_max;
 } clip_t;
 
+typedef struct voodoo_render_thread_t {
+    struct voodoo_t *voodoo;
+    int              odd_even;
+} voodoo_render_thread_t;
+
 typedef struct voodoo_t {
     mem_mapping_t mapping;
 
@@ -362,25 +384,26 @@ typedef struct voodoo_t {
     int    ncc_dirty[2];
 
     thread_t *fifo_thread;
-    thread_t *render_thread[4];
+    thread_t *render_thread[VOODOO_MAX_RENDER_THREADS];
     event_t  *wake_fifo_thread;
     event_t  *wake_main_thread;
     event_t  *fifo_not_full_event;
-    event_t  *render_not_full_event[4];
-    event_t  *wake_render_thread[4];
+    event_t  *render_not_full_event[VOODOO_MAX_RENDER_THREADS];
+    event_t  *wake_render_thread[VOODOO_MAX_RENDER_THREADS];
 
     int voodoo_busy;
-    int render_voodoo_busy[4];
+    int render_voodoo_busy[VOODOO_MAX_RENDER_THREADS];
 
-    int render_threads;
-    int odd_even_mask;
+    int                    render_threads;
+    voodoo_render_thread_t render_thread_data[VOODOO_MAX_RENDER_THREADS];
+    uint8_t                tile_owner[VOODOO_TILE_ROWS];
 
-    int pixel_count[4];
-    int texel_count[4];
+    int pixel_count[VOODOO_MAX_RENDER_THREADS];
+    int texel_count[VOODOO_MAX_RENDER_THREADS];
     int tri_count;
     int frame_count;
-    int pixel_count_old[4];
-    int texel_count_old[4];
+    int pixel_count_old[VOODOO_MAX_RENDER_THREADS];
+    int texel_count_old[VOODOO_MAX_RENDER_THREADS];
     int wr_count;
     int rd_count;
     int tex_count;
@@ -411,7 +434,7 @@ typedef struct voodoo_t {
     atomic_int   cmd_written_fifo_2;
 
     voodoo_params_t params_buffer[PARAM_SIZE];
-    atomic_int      params_read_idx[4];
+    atomic_int      params_read_idx[VOODOO_MAX_RENDER_THREADS];
     atomic_int      params_write_idx;
 
     uint32_t   cmdfifo_base;
@@ -656,27 +679,36 @@ typedef struct voodoo_t {
     uint8_t  thefilterb[256][256];
     uint16_t purpleline[256][3];
 
-    texture_t texture_cache[2][TEX_CACHE_MAX];
-    uint8_t   texture_present[2][16384];
-    int       texture_last_removed;
+    texture_t *texture_cache[2];
+    int        texture_cache_size;
+    int        texture_hash[2][TEX_HASH_SIZE];
+    uint16_t   texture_present[2][16384]; /*Number of cached LODs covering each page*/
+    int        texture_last_removed;
 
     uint32_t palette_checksum[2];
     int      palette_dirty[2];
 
     uint64_t time;
-    int      render_time[4];
+    int      render_time[VOODOO_MAX_RENDER_THREADS];
 
     int      force_blit_count;
     int      can_blit;
     mutex_t *force_blit_mutex;
 
-    int   use_recompiler;
-    void *codegen_data;
+    int      use_recompiler;
+    void    *codegen_data; /*Pipeline cache entries*/
+    uint8_t *codegen_code; /*Executable mapping holding the generated code*/
+
+    /*Pipeline cache LRU clock and statistics, per render thread*/
+    uint32_t codegen_clock[VOODOO_MAX_RENDER_THREADS];
+    int      codegen_hits[VOODOO_MAX_RENDER_THREADS];
+    int      codegen_misses[VOODOO_MAX_RENDER_THREADS];
+    uint64_t codegen_bytes[VOODOO_MAX_RENDER_THREADS];
 
     struct voodoo_set_t *set;
 
     uint8_t fifo_thread_run;
-    uint8_t render_thread_run[4];
+    uint8_t render_thread_run[VOODOO_MAX_RENDER_THREADS];
 
     uint8_t *vram;
     uint8_t *changedvram;
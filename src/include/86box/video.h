@@ -98,6 +98,15 @@ typedef struct dbcs_font_t {
 
 struct blit_data_struct;
 
+/* Maximum number of dirty row spans handed to a blit function per frame. */
+#define VIDEO_DIRTY_SPANS 16
+
+/* A run of target buffer rows that changed since the previous blit. */
+typedef struct video_span_t {
+    int y;
+    int h;
+} video_span_t;
+
 typedef struct monitor_t {
     char                     name[512];
     int                      mon_xsize;
@@ -110,7 +119,8 @@ typedef struct monitor_t {
     double                   mon_res_x;
     double                   mon_res_y;
     int                      mon_bpp;
-    bitmap_t                *target_buffer;
+    bitmap_t                *target_buffer; /* Drawn into by the emulation. */
+    bitmap_t                *front_buffer;  /* Read by the blit function. */
     int                      mon_video_timing_read_b;
     int                      mon_video_timing_read_w;
     int                      mon_video_timing_read_l;
@@ -222,6 +232,18 @@ extern void (*video_recalctimings)(void);
 extern void video_screenshot_monitor(uint32_t *buf, int start_x, int start_y, int row_len, int monitor_index);
 extern void video_screenshot(uint32_t *buf, int start_x, int start_y, int row_len);
 
+/* Asynchronous capture, see vid_capture.c. */
+extern char capture_path[1024];
+
+extern void video_capture_init(void);
+extern void video_capture_close(void);
+extern void video_capture_flush(void);
+extern void video_capture_screenshot(const char *fn, const uint32_t *buf, int start_x, int start_y, int row_len, int w, int h, int monitor_index);
+extern void video_capture_frame(const uint32_t *buf, int start_x, int start_y, int row_len, int w, int h, uint32_t refresh_mhz, int monitor_index);
+extern int  video_capture_stream_start(const char *path, int monitor_index);
+extern void video_capture_stream_stop(void);
+extern int  video_capture_stream_active(void);
+
 #ifdef _WIN32
 extern void * (__cdecl *video_copy)(void *_Dst, const void *_Src, size_t _Size);
 extern void *__cdecl video_transform_copy(void *_Dst, const void *_Src, size_t _Size);
@@ -253,6 +275,9 @@ extern void video_blit_memtoscreen_8(int x, int y, int w, int h);
 extern void video_blend_monitor(int x, int y, int monitor_index);
 extern void video_process_8_monitor(int x, int y, int monitor_index);
 extern void video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index);
+extern void video_blit_memtoscreen_dirty_monitor(int x, int y, int w, int h, int monitor_index);
+extern void video_mark_dirty_monitor(int y, int h, int monitor_index);
+extern int  video_get_dirty_spans_monitor(const video_span_t **spans, int monitor_index);
 extern void video_blit_complete_monitor(int monitor_index);
 extern void video_wait_for_blit_monitor(int monitor_index);
 extern void video_wait_for_buffer_monitor(int monitor_index);
@@ -266,6 +291,7 @@ extern void      updatewindowsize(int x, int y);
 extern void    video_monitor_init(int);
 extern void    video_monitor_close(int);
 extern void    video_init(void);
+extern void    video_init_tables(void);
 extern void    video_close(void);
 extern void    video_reset_close(void);
 extern void    video_pre_reset(int card);
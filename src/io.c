@@ -55,9 +55,17 @@ typedef struct {
     void     *priv;
 } io_trap_t;
 
-int   initialized = 0;
-io_t *io[NPORTS];
-io_t *io_last[NPORTS];
+typedef struct {
+    int (*inw)(uint16_t addr, uint16_t *buf, int count, void *priv);
+    int (*outw)(uint16_t addr, const uint16_t *buf, int count, void *priv);
+
+    void *priv;
+} io_block_t;
+
+int         initialized = 0;
+io_t       *io[NPORTS];
+io_t       *io_last[NPORTS];
+io_block_t *io_block[NPORTS];
 
 #ifdef ENABLE_IO_LOG
 int io_do_log = ENABLE_IO_LOG;
@@ -85,8 +93,10 @@ io_init(void)
     io_t *q;
 
     if (!initialized) {
-        for (c = 0; c < NPORTS; c++)
+        for (c = 0; c < NPORTS; c++) {
             io[c] = io_last[c] = NULL;
+            io_block[c]        = NULL;
+        }
         initialized = 1;
     }
 
@@ -105,6 +115,9 @@ io_init(void)
 
         /* io[c] should be NULL. */
         io[c] = io_last[c] = NULL;
+
+        free(io_block[c]);
+        io_block[c] = NULL;
     }
 }
 
@@ -279,6 +292,84 @@ io_handler_interleaved(int set, uint16_t base, int size,
     io_handler_common(set, base, size, inb, inw, inl, outb, outw, outl, priv, 2);
 }
 
+/* Block handlers let a device move a run of words through one port in a single
+   call, for REP INSW/OUTSW. They sit alongside the normal handlers, which must
+   also be registered on the port, and return the number of words moved. */
+void
+io_sethandler_block(uint16_t base,
+                    int (*inw)(uint16_t addr, uint16_t *buf, int count, void *priv),
+                    int (*outw)(uint16_t addr, const uint16_t *buf, int count, void *priv),
+                    void *priv)
+{
+    io_block_t *p = io_block[base];
+
+    if (p == NULL) {
+        p = (io_block_t *) malloc(sizeof(io_block_t));
+        io_block[base] = p;
+    } else
+        io_log("I/O: Replacing block handler on port %04X\n", base);
+
+    p->inw  = inw;
+    p->outw = outw;
+    p->priv = priv;
+}
+
+void
+io_removehandler_block(uint16_t base,
+                       int (*inw)(uint16_t addr, uint16_t *buf, int count, void *priv),
+                       int (*outw)(uint16_t addr, const uint16_t *buf, int count, void *priv),
+                       void *priv)
+{
+    io_block_t *p = io_block[base];
+
+    if ((p != NULL) && (p->inw == inw) && (p->outw == outw) && (p->priv == priv)) {
+        free(p);
+        io_block[base] = NULL;
+    }
+}
+
+void
+io_handler_block(int set, uint16_t base,
+                 int (*inw)(uint16_t addr, uint16_t *buf, int count, void *priv),
+                 int (*outw)(uint16_t addr, const uint16_t *buf, int count, void *priv),
+                 void *priv)
+{
+    if (set)
+        io_sethandler_block(base, inw, outw, priv);
+    else
+        io_removehandler_block(base, inw, outw, priv);
+}
+
+/* A block transfer is only equivalent to a run of inw()/outw() calls if the
+   port's owner is the only one that would see them: no PCI configuration
+   window, no trap or second device chained on the port, and no byte-only
+   handler on either half of the word. */
+static int
+io_block_exclusive(uint16_t port, const io_block_t *blk, int write)
+{
+    const io_t *p;
+
+    if ((pci_flags & FLAG_CONFIG_IO_ON) && ((port + 1) >= pci_base) && (port < (pci_base + pci_size)))
+        return 0;
+
+    if ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && ((port + 1) >= 0xc000) && (port < 0xc100))
+        return 0;
+
+    if (amstrad_latch & 0x80000000)
+        return 0;
+
+    p = io[port];
+    if ((p == NULL) || (p->next != NULL) || (p->priv != blk->priv) || (write ? !p->outw : !p->inw))
+        return 0;
+
+    for (p = io[(port + 1) & 0xffff]; p != NULL; p = p->next) {
+        if (write ? (p->outb && !p->outw) : (p->inb && !p->inw))
+            return 0;
+    }
+
+    return 1;
+}
+
 #ifdef USE_DEBUG_REGS_486
 extern int trap;
 /* Set trap for I/O address breakpoints. */
@@ -597,6 +688,46 @@ outw(uint16_t port, uint16_t val)
     return;
 }
 
+int
+inw_block(uint16_t port, uint16_t *buf, int count)
+{
+    const io_block_t *blk = io_block[port];
+    int               ret;
+
+    if ((blk == NULL) || (blk->inw == NULL) || !io_block_exclusive(port, blk, 0))
+        return 0;
+
+#ifdef USE_DEBUG_REGS_486
+    io_debug_check_addr(port);
+#endif
+
+    ret = blk->inw(port, buf, count, blk->priv);
+
+    io_log("[%04X:%08X] (%i) in w(%04X) block %i/%i\n", CS, cpu_state.pc, in_smm, port, ret, count);
+
+    return ret;
+}
+
+int
+outw_block(uint16_t port, const uint16_t *buf, int count)
+{
+    const io_block_t *blk = io_block[port];
+    int               ret;
+
+    if ((blk == NULL) || (blk->outw == NULL) || !io_block_exclusive(port, blk, 1))
+        return 0;
+
+#ifdef USE_DEBUG_REGS_486
+    io_debug_check_addr(port);
+#endif
+
+    ret = blk->outw(port, buf, count, blk->priv);
+
+    io_log("[%04X:%08X] (%i) outw(%04X) block %i/%i\n", CS, cpu_state.pc, in_smm, port, ret, count);
+
+    return ret;
+}
+
 uint32_t
 inl(uint16_t port)
 {
@@ -1829,6 +1829,80 @@ mem_write_phys(void *src, uint32_t addr, int transfer_size)
     }
 }
 
+/* Returns how many bytes from addr, a multiple of transfer_size and no more
+   than len, can be reached straight through map->exec without leaving the
+   granule, or 0 if the next unit has to go through the handlers. */
+static uint32_t
+mem_phys_block_len(const mem_mapping_t *map, uint32_t addr, uint32_t len, int transfer_size)
+{
+    uint32_t off;
+    uint32_t n;
+
+    if (!cpu_use_exec || !map || !map->exec)
+        return 0;
+
+    n   = MIN(len, MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK)) & ~(transfer_size - 1);
+    off = (addr - map->base) & map->mask;
+
+    if (!n || (((addr + n - 1 - map->base) & map->mask) != (off + n - 1)))
+        return 0;
+
+    return n;
+}
+
+/* Bulk versions of mem_read_phys() and mem_write_phys() for bus masters:
+   len bytes, a multiple of transfer_size, are moved with the mapping looked
+   up once per granule. */
+void
+mem_read_phys_block(void *dest, uint32_t addr, uint32_t len, int transfer_size)
+{
+    uint8_t       *p   = (uint8_t *) dest;
+    uint32_t       pos = 0;
+    mem_mapping_t *map;
+    uint32_t       n;
+
+    mem_logical_addr = 0xffffffff;
+
+    while (pos < len) {
+        map = read_mapping_bus[(addr + pos) >> MEM_GRANULARITY_BITS];
+        n   = mem_phys_block_len(map, addr + pos, len - pos, transfer_size);
+
+        if (n)
+            memcpy(&p[pos], &map->exec[(addr + pos - map->base) & map->mask], n);
+        else {
+            n = transfer_size;
+            mem_read_phys(&p[pos], addr + pos, transfer_size);
+        }
+
+        pos += n;
+    }
+}
+
+void
+mem_write_phys_block(const void *src, uint32_t addr, uint32_t len, int transfer_size)
+{
+    const uint8_t *p   = (const uint8_t *) src;
+    uint32_t       pos = 0;
+    mem_mapping_t *map;
+    uint32_t       n;
+
+    mem_logical_addr = 0xffffffff;
+
+    while (pos < len) {
+        map = write_mapping_bus[(addr + pos) >> MEM_GRANULARITY_BITS];
+        n   = mem_phys_block_len(map, addr + pos, len - pos, transfer_size);
+
+        if (n)
+            memcpy(&map->exec[(addr + pos - map->base) & map->mask], &p[pos], n);
+        else {
+            n = transfer_size;
+            mem_write_phys((void *) &p[pos], addr + pos, transfer_size);
+        }
+
+        pos += n;
+    }
+}
+
 uint8_t
 mem_read_ram(uint32_t addr, UNUSED(void *priv))
 {
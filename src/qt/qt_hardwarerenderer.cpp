@@ -197,7 +197,7 @@ HardwareRenderer::setRenderType(RenderType type)
 }
 
 void
-HardwareRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
+HardwareRenderer::onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h)
 {
     auto  tval    = this;
     void *nuldata = 0;
@@ -207,17 +207,27 @@ HardwareRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
     if (!m_texture || !m_texture->isCreated()) {
         buf_usage[buf_idx].clear();
         source.setRect(x, y, w, h);
+        m_fullUpload = true;
         return;
     }
+    /* The texture keeps the previous frame, so only the changed rows need
+       uploading unless the source rectangle moved. */
+    if (m_fullUpload || (origSource != QRect(x, y, w, h))) {
+        dirty_y      = y;
+        dirty_h      = h;
+        m_fullUpload = false;
+    }
     m_context->makeCurrent(this);
+    if (dirty_h > 0) {
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
-    m_texture->setData(x, y, 0, w, h, 0, QOpenGLTexture::PixelFormat::RGBA, QOpenGLTexture::PixelType::UInt8, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * y + x * 4)), &m_transferOptions);
+        m_texture->setData(x, dirty_y, 0, w, dirty_h, 0, QOpenGLTexture::PixelFormat::RGBA, QOpenGLTexture::PixelType::UInt8, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * dirty_y + x * 4)), &m_transferOptions);
 #else
-    m_texture->bind();
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, 2048);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, QOpenGLTexture::PixelFormat::RGBA, QOpenGLTexture::PixelType::UInt8, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * y + x * 4)));
-    m_texture->release();
+        m_texture->bind();
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 2048);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, dirty_y, w, dirty_h, QOpenGLTexture::PixelFormat::RGBA, QOpenGLTexture::PixelType::UInt8, (const void *) ((uintptr_t) imagebufs[buf_idx].get() + (uintptr_t) (2048 * 4 * dirty_y + x * 4)));
+        m_texture->release();
 #endif
+    }
     buf_usage[buf_idx].clear();
     source.setRect(x, y, w, h);
     if (origSource != source)
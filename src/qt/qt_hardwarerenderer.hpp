@@ -34,6 +34,7 @@ private:
     bool                        wayland = false;
     QOpenGLContext             *m_context;
     QOpenGLTexture             *m_texture { nullptr };
+    bool                        m_fullUpload { true };
     QOpenGLShaderProgram       *m_prog { nullptr };
     QOpenGLTextureBlitter      *m_blt { nullptr };
     QOpenGLBuffer               m_vbo[2];
@@ -93,7 +94,7 @@ public:
     void setRenderType(RenderType type);
 
 public slots:
-    void onBlit(int buf_idx, int x, int y, int w, int h);
+    void onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h);
 
 protected:
     std::array<std::unique_ptr<uint8_t>, 2> imagebufs;
@@ -86,6 +86,7 @@ extern "C" {
 #include <86box/keyboard.h>
 #include <86box/timer.h>
 #include <86box/nvr.h>
+#include <86box/benchmark.h>
 extern int qt_nvr_save(void);
 }
 
@@ -283,6 +284,9 @@ main_thread_fn()
 #endif
             drawits += static_cast<int>(new_time - old_time);
         old_time = new_time;
+        /* In turbo mode, run back-to-back slices as fast as the host allows. */
+        if (turbo_mode && (drawits <= 0))
+            drawits = 10;
         if (drawits > 0 && !dopause) {
             /* Yes, so do one frame now. */
             drawits -= 10;
@@ -379,6 +383,10 @@ main(int argc, char *argv[])
         return 0;
     }
 
+    /* The scanline converter check needs neither a machine nor a window. */
+    if (benchmark_line_check)
+        return benchmark_line_conv_check();
+
     bool startMaximized = window_remember && monitor_settings[0].mon_window_maximized;
     fprintf(stderr, "Qt: version %s, platform \"%s\"\n", qVersion(), QApplication::platformName().toUtf8().data());
     ProgSettings::loadTranslators(&app);
@@ -412,6 +420,10 @@ main(int argc, char *argv[])
         return 6;
     }
 
+    /* The benchmark runs without any windows or renderer. */
+    if (benchmark_mode)
+        return benchmark_run();
+
     // UUID / copy / move detection
     if(!util::compareUuid()) {
         QMessageBox movewarnbox;
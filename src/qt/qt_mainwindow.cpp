@@ -332,6 +332,7 @@ MainWindow::MainWindow(QWidget *parent)
     connect(this, &MainWindow::statusBarMessage, status.get(), &MachineStatus::message, Qt::QueuedConnection);
 
     ui->actionKeyboard_requires_capture->setChecked(kbd_req_capture);
+    ui->actionTurbo_mode->setChecked(turbo_mode);
     ui->actionRight_CTRL_is_left_ALT->setChecked(rctrl_is_lalt);
     ui->actionResizable_window->setChecked(vid_resize == 1);
     ui->actionRemember_size_and_position->setChecked(window_remember);
@@ -923,6 +924,12 @@ MainWindow::on_actionPause_triggered()
     plat_pause(dopause ^ 1);
 }
 
+void
+MainWindow::on_actionTurbo_mode_triggered(bool checked)
+{
+    turbo_mode = checked;
+}
+
 void
 MainWindow::on_actionExit_triggered()
 {
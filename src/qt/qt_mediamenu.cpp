@@ -575,7 +575,11 @@ MediaMenu::cdromMount(int i, int dir, const QString &arg)
     else {
         filename = QFileDialog::getOpenFileName(parentWidget, QString(),
                                                 QString(),
+#ifdef USE_LIBCHDR
+            tr("CD-ROM images") % util::DlgFilter({ "iso", "cue", "chd" }) % tr("All files") % util::DlgFilter({ "*" }, true));
+#else
             tr("CD-ROM images") % util::DlgFilter({ "iso", "cue" }) % tr("All files") % util::DlgFilter({ "*" }, true));
+#endif
     }
 
     if (filename.isEmpty())
@@ -427,10 +427,13 @@ OpenGLRenderer::getBuffers()
 }
 
 void
-OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
+OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h)
 {
-    if (notReady())
+    if (notReady()) {
+        /* The dirty rows of this blit are lost, so upload everything next time. */
+        fullUpload = true;
         return;
+    }
 
     context->makeCurrent(this);
 
@@ -449,14 +452,26 @@ OpenGLRenderer::onBlit(int buf_idx, int x, int y, int w, int h)
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
         glTexImage2D(GL_TEXTURE_2D, 0, (GLenum) QOpenGLTexture::RGBA8_UNorm, source.width(), source.height(), 0, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, NULL);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBufferID);
+
+        /* The new texture is empty, so it needs every row. */
+        fullUpload = true;
     }
 
-    if (!hasBufferStorage)
-        glBufferSubData(GL_PIXEL_UNPACK_BUFFER, BUFFERBYTES * buf_idx, h * ROW_LENGTH * sizeof(uint32_t) + (y * ROW_LENGTH * sizeof(uint32_t)), (uint8_t *) unpackBuffer + BUFFERBYTES * buf_idx);
+    if (fullUpload) {
+        dirty_y    = y;
+        dirty_h    = h;
+        fullUpload = false;
+    }
+
+    /* Only the rows that changed since the previous blit need uploading. */
+    if (dirty_h > 0) {
+        if (!hasBufferStorage)
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, BUFFERBYTES * buf_idx + dirty_y * ROW_LENGTH * sizeof(uint32_t), dirty_h * ROW_LENGTH * sizeof(uint32_t), (uint8_t *) unpackBuffer + BUFFERBYTES * buf_idx + dirty_y * ROW_LENGTH * sizeof(uint32_t));
 
-    glPixelStorei(GL_UNPACK_SKIP_PIXELS, BUFFERPIXELS * buf_idx + y * ROW_LENGTH + x);
-    glPixelStorei(GL_UNPACK_ROW_LENGTH, ROW_LENGTH);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, NULL);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, BUFFERPIXELS * buf_idx + dirty_y * ROW_LENGTH + x);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, ROW_LENGTH);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, dirty_y - y, w, dirty_h, (GLenum) QOpenGLTexture::BGRA, (GLenum) QOpenGLTexture::UInt32_RGBA8_Rev, NULL);
+    }
 
     /* TODO: check if fence sync is implementable here and still has any benefit. */
     glFinish();
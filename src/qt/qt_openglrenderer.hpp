@@ -63,7 +63,7 @@ signals:
     void errorInitializing();
 
 public slots:
-    void onBlit(int buf_idx, int x, int y, int w, int h);
+    void onBlit(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h);
 
 protected:
     void exposeEvent(QExposeEvent *event) override;
@@ -85,6 +85,7 @@ private:
 
     bool isInitialized = false;
     bool isFinalized   = false;
+    bool fullUpload    = true; /* Upload every row on the next blit. */
 
     GLuint unpackBufferID = 0;
     GLuint vertexArrayID  = 0;
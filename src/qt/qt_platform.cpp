@@ -774,6 +774,14 @@ plat_get_cpu_string(char *outbuf, uint8_t len) {
 
 }
 
+int
+plat_get_cpu_count(void)
+{
+    unsigned int count = std::thread::hardware_concurrency();
+
+    return (count > 0) ? count : 1;
+}
+
 void
 plat_set_thread_name(void *thread, const char *name)
 {
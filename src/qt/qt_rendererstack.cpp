@@ -33,6 +33,7 @@
 
 #include "evdev_mouse.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <stdexcept>
 
@@ -346,6 +347,7 @@ RendererStack::createRenderer(Renderer renderer)
                 connect(hw, &OpenGLRenderer::initialized, [=]() {
                     /* Buffers are available only after initialization. */
                     imagebufs = rendererWindow->getBuffers();
+                    buffersChanged = true;
                     endblit();
                     emit rendererChanged();
                 });
@@ -378,6 +380,7 @@ RendererStack::createRenderer(Renderer renderer)
                 connect(hw, &VulkanWindowRenderer::rendererInitialized, [=]() {
                     /* Buffers are available only after initialization. */
                     imagebufs = rendererWindow->getBuffers();
+                    buffersChanged = true;
                     endblit();
                     emit rendererChanged();
                 });
@@ -408,6 +411,7 @@ RendererStack::createRenderer(Renderer renderer)
 
     if (renderer != Renderer::OpenGL3 && renderer != Renderer::Vulkan) {
         imagebufs = rendererWindow->getBuffers();
+        buffersChanged = true;
         endblit();
         emit rendererChanged();
     }
@@ -417,10 +421,43 @@ RendererStack::createRenderer(Renderer renderer)
 void
 RendererStack::blit(int x, int y, int w, int h)
 {
+    const video_span_t *spans;
+    int                 count;
+
     if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0) ||
         (w > 2048) || (h > 2048) ||
-        (monitors[m_monitor_index].target_buffer == NULL) || imagebufs.empty() ||
-        std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
+        (monitors[m_monitor_index].front_buffer == NULL) || imagebufs.empty()) {
+        buffersChanged = true;
+        video_blit_complete_monitor(m_monitor_index);
+        return;
+    }
+
+    /* Each image buffer, and the renderer's texture, only has to catch up on
+       the rows that changed since it was last filled, including the rows of
+       frames dropped below because the buffer was still in use. */
+    if (buffersChanged.exchange(false) || (bufDirty.size() != imagebufs.size()) ||
+        (x != sx) || (y != sy) || (w != sw) || (h != sh)) {
+        bufDirty.assign(imagebufs.size(), std::bitset<2048>().set());
+        dirtyTop    = y;
+        dirtyBottom = y + h;
+    } else {
+        count = video_get_dirty_spans_monitor(&spans, m_monitor_index);
+        for (int i = 0; i < count; i++) {
+            for (auto &dirty : bufDirty) {
+                for (int y1 = spans[i].y; y1 < (spans[i].y + spans[i].h); y1++)
+                    dirty.set(y1);
+            }
+            if (dirtyTop >= dirtyBottom) {
+                dirtyTop    = spans[i].y;
+                dirtyBottom = spans[i].y + spans[i].h;
+            } else {
+                dirtyTop    = std::min(dirtyTop, spans[i].y);
+                dirtyBottom = std::max(dirtyBottom, spans[i].y + spans[i].h);
+            }
+        }
+    }
+
+    if (std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
         video_blit_complete_monitor(m_monitor_index);
         return;
     }
@@ -429,16 +466,24 @@ RendererStack::blit(int x, int y, int w, int h)
     sw = this->w = w;
     sh = this->h       = h;
     uint8_t *imagebits = std::get<uint8_t *>(imagebufs[currentBuf]);
+    auto    &dirty     = bufDirty[currentBuf];
     for (int y1 = y; y1 < (y + h); y1++) {
+        if (!dirty.test(y1))
+            continue;
         auto scanline = imagebits + (y1 * rendererWindow->getBytesPerRow()) + (x * 4);
-        video_copy(scanline, &(monitors[m_monitor_index].target_buffer->line[y1][x]), w * 4);
+        video_copy(scanline, &(monitors[m_monitor_index].front_buffer->line[y1][x]), w * 4);
     }
+    dirty.reset();
 
     if (monitors[m_monitor_index].mon_screenshots) {
         video_screenshot_monitor((uint32_t *) imagebits, x, y, 2048, m_monitor_index);
     }
     video_blit_complete_monitor(m_monitor_index);
-    emit blitToRenderer(currentBuf, sx, sy, sw, sh);
+    if (dirtyTop >= dirtyBottom)
+        emit blitToRenderer(currentBuf, sx, sy, sw, sh, sy, 0);
+    else
+        emit blitToRenderer(currentBuf, sx, sy, sw, sh, dirtyTop, dirtyBottom - dirtyTop);
+    dirtyTop = dirtyBottom = 0;
     currentBuf = (currentBuf + 1) % imagebufs.size();
 }
 
@@ -9,6 +9,7 @@
 #include <QCursor>
 
 #include <atomic>
+#include <bitset>
 #include <memory>
 #include <tuple>
 #include <vector>
@@ -79,7 +80,7 @@ public:
     void (*mouse_exit_func)()                   = nullptr;
 
 signals:
-    void blitToRenderer(int buf_idx, int x, int y, int w, int h);
+    void blitToRenderer(int buf_idx, int x, int y, int w, int h, int dirty_y, int dirty_h);
     void rendererChanged();
 
 public slots:
@@ -105,6 +106,13 @@ private:
 
     std::vector<std::tuple<uint8_t *, std::atomic_flag *>> imagebufs;
 
+    /* Rows each image buffer is still missing, and the span of rows the
+       renderer has not been handed yet. */
+    std::vector<std::bitset<2048>> bufDirty;
+    std::atomic_bool               buffersChanged { true };
+    int                            dirtyTop    = 0;
+    int                            dirtyBottom = 0;
+
     RendererCommon          *rendererWindow { nullptr };
     std::unique_ptr<QWidget> current;
 };
@@ -744,17 +744,16 @@ scsi_disk_blocks(scsi_disk_t *dev, int32_t *len, UNUSED(int first_batch), int ou
 
     *len = dev->requested_blocks << 9;
 
-    for (int i = 0; i < dev->requested_blocks; i++) {
-        if (out) {
-            if (hdd_image_write(dev->id, dev->sector_pos + i, 1, dev->temp_buffer + (i << 9)) < 0) {
-                scsi_disk_write_error(dev);
-                return -1;
-            }
-        } else {
-            if (hdd_image_read(dev->id, dev->sector_pos + i, 1, dev->temp_buffer + (i << 9)) < 0) {
-                scsi_disk_read_error(dev);
-                return -1;
-            }
+    /* The whole transfer goes to the image as one request. */
+    if (out) {
+        if (hdd_image_write(dev->id, dev->sector_pos, dev->requested_blocks, dev->temp_buffer) < 0) {
+            scsi_disk_write_error(dev);
+            return -1;
+        }
+    } else {
+        if (hdd_image_read(dev->id, dev->sector_pos, dev->requested_blocks, dev->temp_buffer) < 0) {
+            scsi_disk_read_error(dev);
+            return -1;
         }
     }
 
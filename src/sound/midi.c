@@ -201,10 +201,10 @@ midi_in_close(void)
 }
 
 void
-midi_poll(void)
+midi_poll(int samples)
 {
     if (midi_out && midi_out->m_out_device && midi_out->m_out_device->poll)
-        midi_out->m_out_device->poll();
+        midi_out->m_out_device->poll(samples);
 }
 
 void
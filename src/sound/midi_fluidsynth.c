@@ -54,12 +54,12 @@ fluidsynth_available(void)
 }
 
 void
-fluidsynth_poll(void)
+fluidsynth_poll(int samples)
 {
     fluidsynth_t *data = &fsdev;
-    data->midi_pos++;
-    if (data->midi_pos == SOUND_FREQ / RENDER_RATE) {
-        data->midi_pos = 0;
+    data->midi_pos += samples;
+    if (data->midi_pos >= SOUND_FREQ / RENDER_RATE) {
+        data->midi_pos -= SOUND_FREQ / RENDER_RATE;
         thread_set_event(data->event);
     }
 }
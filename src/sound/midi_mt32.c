@@ -199,11 +199,11 @@ mt32_stream_int16(int16_t *stream, int len)
 }
 
 void
-mt32_poll(void)
+mt32_poll(int samples)
 {
-    midi_pos++;
-    if (midi_pos == SOUND_FREQ / RENDER_RATE) {
-        midi_pos = 0;
+    midi_pos += samples;
+    if (midi_pos >= SOUND_FREQ / RENDER_RATE) {
+        midi_pos -= SOUND_FREQ / RENDER_RATE;
         thread_set_event(event);
     }
 }
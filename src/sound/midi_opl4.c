@@ -601,12 +601,12 @@ opl4_midi_thread(void *arg)
 }
 
 static void
-opl4_midi_poll(void)
+opl4_midi_poll(int samples)
 {
     opl4_midi_t *opl4_midi = opl4_midi_cur;
-    opl4_midi->midi_pos++;
-    if (opl4_midi->midi_pos == RENDER_RATE) {
-        opl4_midi->midi_pos = 0;
+    opl4_midi->midi_pos += samples;
+    if (opl4_midi->midi_pos >= RENDER_RATE) {
+        opl4_midi->midi_pos -= RENDER_RATE;
         thread_set_event(opl4_midi->wait_event);
     }
 }
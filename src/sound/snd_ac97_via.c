@@ -538,7 +538,8 @@ ac97_via_update_stereo(ac97_via_t *dev, ac97_via_sgd_t *sgd)
     else if (r > 32767)
         r = 32767;
 
-    for (; sgd->pos < sound_pos_global; sgd->pos++) {
+    const int pos = sound_get_pos();
+    for (; sgd->pos < pos; sgd->pos++) {
         sgd->buffer[sgd->pos * 2]     = l;
         sgd->buffer[sgd->pos * 2 + 1] = r;
     }
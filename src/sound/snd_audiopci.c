@@ -2393,7 +2393,8 @@ es137x_update(es137x_t *dev)
     else if (r > 32767)
         r = 32767;
 
-    for (; dev->pos < ((dev->type == AUDIOPCI_ES1370) ? wavetable_pos_global : sound_pos_global); dev->pos++) {
+    const int pos = (dev->type == AUDIOPCI_ES1370) ? wavetable_get_pos() : sound_get_pos();
+    for (; dev->pos < pos; dev->pos++) {
         dev->buffer[dev->pos * 2]     = l;
         dev->buffer[dev->pos * 2 + 1] = r;
     }
@@ -29,7 +29,9 @@ typedef struct lpt_dac_t {
 static void
 dac_update(lpt_dac_t *lpt_dac)
 {
-    for (; lpt_dac->pos < sound_pos_global; lpt_dac->pos++) {
+    const int pos = sound_get_pos();
+
+    for (; lpt_dac->pos < pos; lpt_dac->pos++) {
         lpt_dac->buffer[0][lpt_dac->pos] = (int8_t) (lpt_dac->dac_val_l ^ 0x80) * 0x40;
         lpt_dac->buffer[1][lpt_dac->pos] = (int8_t) (lpt_dac->dac_val_r ^ 0x80) * 0x40;
     }
@@ -200,15 +200,16 @@ static int32_t *
 esfm_drv_update(void *priv)
 {
     esfm_drv_t *dev = (esfm_drv_t *) priv;
+    const int   pos = music_get_pos();
 
-    if (dev->pos >= music_pos_global)
+    if (dev->pos >= pos)
         return dev->buffer;
 
     esfm_drv_generate_stream(dev,
                              &dev->buffer[dev->pos * 2],
-                             music_pos_global - dev->pos);
+                             pos - dev->pos);
 
-    for (; dev->pos < music_pos_global; dev->pos++) {
+    for (; dev->pos < pos; dev->pos++) {
         dev->buffer[dev->pos * 2] /= 2;
         dev->buffer[(dev->pos * 2) + 1] /= 2;
     }
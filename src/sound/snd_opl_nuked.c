@@ -1554,15 +1554,16 @@ static int32_t *
 nuked_drv_update(void *priv)
 {
     nuked_drv_t *dev = (nuked_drv_t *) priv;
+    const int    pos = music_get_pos();
 
-    if (dev->pos >= music_pos_global)
+    if (dev->pos >= pos)
         return dev->buffer;
 
     OPL3_GenerateStream(&dev->opl,
                           &dev->buffer[dev->pos * 2],
-                          music_pos_global - dev->pos);
+                          pos - dev->pos);
 
-    for (; dev->pos < music_pos_global; dev->pos++) {
+    for (; dev->pos < pos; dev->pos++) {
         dev->buffer[dev->pos * 2] /= 2;
         dev->buffer[(dev->pos * 2) + 1] /= 2;
     }
@@ -87,7 +87,7 @@ public:
 protected:
     int32_t  m_buffer[MUSICBUFLEN * 2];
     int      m_buf_pos;
-    int      *m_buf_pos_global;
+    int    (*m_buf_get_pos)(void);
     int8_t   m_flags;
     fm_type  m_type;
     uint32_t m_samplerate;
@@ -110,7 +110,7 @@ public:
         m_subtract[0]    = 80.0;
         m_subtract[1]    = 320.0;
         m_type           = type;
-        m_buf_pos_global = (samplerate == FREQ_49716) ? &music_pos_global : &wavetable_pos_global;
+        m_buf_get_pos    = (samplerate == FREQ_49716) ? music_get_pos : wavetable_get_pos;
 
         if (m_type == FM_YMF278B) {
             if (rom_load_linear("roms/sound/yamaha/yrw801.rom", 0, 0x200000, 0, m_yrw801) == 0) {
@@ -222,12 +222,14 @@ public:
 
     virtual int32_t *update() override
     {
-        if (m_buf_pos >= *m_buf_pos_global)
+        const int pos = m_buf_get_pos();
+
+        if (m_buf_pos >= pos)
             return m_buffer;
 
-        generate(&m_buffer[m_buf_pos * 2], *m_buf_pos_global - m_buf_pos);
+        generate(&m_buffer[m_buf_pos * 2], pos - m_buf_pos);
 
-        for (; m_buf_pos < *m_buf_pos_global; m_buf_pos++) {
+        for (; m_buf_pos < pos; m_buf_pos++) {
             m_buffer[m_buf_pos * 2] /= 2;
             m_buffer[(m_buf_pos * 2) + 1] /= 2;
         }
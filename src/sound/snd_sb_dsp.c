@@ -3041,11 +3041,13 @@ sb_poll_i(void *priv)
 void
 sb_dsp_update(sb_dsp_t *dsp)
 {
+    const int pos = sound_get_pos();
+
     if (dsp->muted) {
         dsp->sbdatl = 0;
         dsp->sbdatr = 0;
     }
-    for (; dsp->pos < sound_pos_global; dsp->pos++) {
+    for (; dsp->pos < pos; dsp->pos++) {
         dsp->buffer[dsp->pos * 2]     = dsp->sbdatl;
         dsp->buffer[dsp->pos * 2 + 1] = dsp->sbdatr;
     }
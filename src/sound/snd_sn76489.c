@@ -32,7 +32,9 @@ sn76489_check_tap_2(sn76489_t *sn76489)
 static void
 sn76489_update(sn76489_t *sn76489)
 {
-    for (; sn76489->pos < sound_pos_global; sn76489->pos++) {
+    const int pos = sound_get_pos();
+
+    for (; sn76489->pos < pos; sn76489->pos++) {
         int16_t result = 0;
 
         for (uint8_t c = 1; c < 4; c++) {
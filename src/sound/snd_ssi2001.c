@@ -28,11 +28,13 @@ typedef struct entertainer_t {
 static void
 ssi2001_update(ssi2001_t *ssi2001)
 {
-    if (ssi2001->pos >= sound_pos_global)
+    const int pos = sound_get_pos();
+
+    if (ssi2001->pos >= pos)
         return;
 
-    sid_fillbuf(&ssi2001->buffer[ssi2001->pos], sound_pos_global - ssi2001->pos, ssi2001->psid);
-    ssi2001->pos = sound_pos_global;
+    sid_fillbuf(&ssi2001->buffer[ssi2001->pos], pos - ssi2001->pos, ssi2001->psid);
+    ssi2001->pos = pos;
 }
 
 static void
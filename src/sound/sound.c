@@ -18,6 +18,7 @@
  */
 #include <math.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,10 +47,25 @@ typedef struct {
     void *priv;
 } sound_handler_t;
 
+/* Single-producer, single-consumer queue of whole buffers from a sound
+   source to the mixer thread. */
+#define SOUND_RING_SLOTS 4
+
+typedef struct {
+    uint8_t    *data; /* SOUND_RING_SLOTS slots of slot_size bytes each. */
+    size_t      slot_size;
+    atomic_uint head; /* Advanced by the producer only. */
+    atomic_uint tail; /* Advanced by the mixer thread only. */
+} sound_ring_t;
+
+/* The poll timers fire every eighth of a buffer rather than every sample;
+   in between, the current sample is derived from the time left until the
+   next poll. */
+#define SOUND_POLL_BATCH     (SOUNDBUFLEN / 8)
+#define MUSIC_POLL_BATCH     (MUSICBUFLEN / 8)
+#define WAVETABLE_POLL_BATCH (WTBUFLEN / 8)
+
 int sound_card_current[SOUND_CARD_MAX] = { 0, 0, 0, 0 };
-int sound_pos_global                   = 0;
-int music_pos_global                   = 0;
-int wavetable_pos_global               = 0;
 int sound_gain                         = 0;
 
 static sound_handler_t sound_handlers[8];
@@ -62,6 +78,9 @@ static double     cd_audio_volume_lut[256];
 static thread_t  *sound_cd_thread_h;
 static event_t   *sound_cd_event;
 static event_t   *sound_cd_start_event;
+static thread_t  *sound_mix_thread_h;
+static event_t   *sound_mix_event;
+static event_t   *sound_mix_start_event;
 static int32_t   *outbuffer;
 static float     *outbuffer_ex;
 static int16_t   *outbuffer_ex_int16;
@@ -76,10 +95,16 @@ static int        music_handlers_num;
 static int        wavetable_handlers_num;
 static pc_timer_t sound_poll_timer;
 static uint64_t   sound_poll_latch;
+static int        sound_poll_end;
+static int        sound_poll_len;
 static pc_timer_t music_poll_timer;
 static uint64_t   music_poll_latch;
+static int        music_poll_end;
+static int        music_poll_len;
 static pc_timer_t wavetable_poll_timer;
 static uint64_t   wavetable_poll_latch;
+static int        wavetable_poll_end;
+static int        wavetable_poll_len;
 
 static int16_t      cd_buffer[CDROM_NUM][CD_BUFLEN * 2];
 static float        cd_out_buffer[CD_BUFLEN * 2];
@@ -89,6 +114,18 @@ static unsigned int cd_vol_r;
 static int          cd_buf_update    = CD_BUFLEN / SOUNDBUFLEN;
 static volatile int cdaudioon        = 0;
 static int          cd_thread_enable = 0;
+static volatile int sound_mix_on     = 0;
+static atomic_int   cd_ring_discard;
+
+static int32_t sound_ring_data[SOUND_RING_SLOTS][SOUNDBUFLEN * 2];
+static int32_t music_ring_data[SOUND_RING_SLOTS][MUSICBUFLEN * 2];
+static int32_t wavetable_ring_data[SOUND_RING_SLOTS][WTBUFLEN * 2];
+static float   cd_ring_data[SOUND_RING_SLOTS][CD_BUFLEN * 2];
+
+static sound_ring_t sound_ring     = { (uint8_t *) sound_ring_data, sizeof(sound_ring_data[0]) };
+static sound_ring_t music_ring     = { (uint8_t *) music_ring_data, sizeof(music_ring_data[0]) };
+static sound_ring_t wavetable_ring = { (uint8_t *) wavetable_ring_data, sizeof(wavetable_ring_data[0]) };
+static sound_ring_t cd_ring        = { (uint8_t *) cd_ring_data, sizeof(cd_ring_data[0]) };
 
 static void (*filter_cd_audio)(int channel, double *buffer, void *priv) = NULL;
 static void *filter_cd_audio_p                                          = NULL;
@@ -242,6 +279,144 @@ sound_set_cd_volume(unsigned int vol_l, unsigned int vol_r)
     cd_vol_r = vol_r;
 }
 
+/* Copies a finished buffer into the next free slot and wakes the mixer. If
+   the mixer has fallen behind the buffer is dropped, as the host would have
+   had no free buffer to queue it in either. */
+static void
+sound_ring_push(sound_ring_t *ring, const void *buf, size_t size)
+{
+    const unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if ((head - tail) >= SOUND_RING_SLOTS)
+        return;
+
+    memcpy(ring->data + ((head % SOUND_RING_SLOTS) * ring->slot_size), buf, size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    thread_set_event(sound_mix_event);
+}
+
+static const void *
+sound_ring_peek(sound_ring_t *ring)
+{
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail)
+        return NULL;
+
+    return ring->data + ((tail % SOUND_RING_SLOTS) * ring->slot_size);
+}
+
+static void
+sound_ring_pop(sound_ring_t *ring)
+{
+    const unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+static void
+sound_ring_flush(sound_ring_t *ring)
+{
+    atomic_store_explicit(&ring->tail, atomic_load_explicit(&ring->head, memory_order_acquire),
+                          memory_order_release);
+}
+
+/* Converts the queued buffers of one stream to the host format and hands them
+   to the audio backend. */
+static void
+sound_mix_stream(sound_ring_t *ring, float *out, int16_t *out_int16, int len,
+                 void (*give)(const void *buf))
+{
+    const int32_t *buf;
+
+    while ((buf = sound_ring_peek(ring)) != NULL) {
+        for (int c = 0; c < len * 2; c++) {
+            if (sound_is_float)
+                out[c] = ((float) buf[c]) / (float) 32768.0;
+            else {
+                int32_t val = buf[c];
+
+                if (val > 32767)
+                    val = 32767;
+                if (val < -32768)
+                    val = -32768;
+
+                out_int16[c] = (int16_t) val;
+            }
+        }
+
+        sound_ring_pop(ring);
+
+        if (sound_is_float)
+            give(out);
+        else
+            give(out_int16);
+    }
+}
+
+static void
+sound_mix_thread(UNUSED(void *param))
+{
+    const void *buf;
+
+    thread_set_event(sound_mix_start_event);
+
+    while (sound_mix_on) {
+        thread_wait_event(sound_mix_event, -1);
+        thread_reset_event(sound_mix_event);
+
+        if (!sound_mix_on)
+            return;
+
+        sound_mix_stream(&sound_ring, outbuffer_ex, outbuffer_ex_int16, SOUNDBUFLEN, givealbuffer);
+        sound_mix_stream(&music_ring, outbuffer_m_ex, outbuffer_m_ex_int16, MUSICBUFLEN, givealbuffer_music);
+        sound_mix_stream(&wavetable_ring, outbuffer_w_ex, outbuffer_w_ex_int16, WTBUFLEN, givealbuffer_wt);
+
+        /* The CD audio thread already produces the host format. Only the
+           mixer consumes, so it is also the one to drop stale buffers. */
+        if (atomic_exchange(&cd_ring_discard, 0))
+            sound_ring_flush(&cd_ring);
+        while ((buf = sound_ring_peek(&cd_ring)) != NULL) {
+            givealbuffer_cd(buf);
+            sound_ring_pop(&cd_ring);
+        }
+    }
+}
+
+static void
+sound_mix_thread_start(void)
+{
+    if (sound_mix_on)
+        return;
+
+    sound_mix_on = 1;
+
+    sound_mix_thread_h = thread_create(sound_mix_thread, NULL);
+
+    sound_log("Waiting for mixer start event...\n");
+    thread_wait_event(sound_mix_start_event, -1);
+    thread_reset_event(sound_mix_start_event);
+    sound_log("Done!\n");
+}
+
+void
+sound_mix_thread_end(void)
+{
+    if (sound_mix_on) {
+        sound_mix_on = 0;
+
+        sound_log("Waiting for mixer thread to terminate...\n");
+        thread_set_event(sound_mix_event);
+        thread_wait(sound_mix_thread_h);
+        sound_log("Mixer thread terminated...\n");
+
+        sound_mix_thread_h = NULL;
+    }
+}
+
 static void
 sound_cd_clean_buffers(void)
 {
@@ -355,10 +530,13 @@ sound_cd_thread(UNUSED(void *param))
             }
         }
 
+        if (turbo_mode)
+            continue;
+
         if (sound_is_float)
-            givealbuffer_cd(cd_out_buffer);
+            sound_ring_push(&cd_ring, cd_out_buffer, sizeof(cd_out_buffer));
         else
-            givealbuffer_cd(cd_out_buffer_int16);
+            sound_ring_push(&cd_ring, cd_out_buffer_int16, sizeof(cd_out_buffer_int16));
     }
 }
 
@@ -472,6 +650,11 @@ sound_init(void)
             available_cdrom_drives++;
     }
 
+    /* Created once and kept: the CD audio thread may queue a buffer at any
+       time, even while the mixer thread is being restarted. */
+    sound_mix_start_event = thread_create_event();
+    sound_mix_event       = thread_create_event();
+
     if (available_cdrom_drives) {
         cdaudioon = 1;
 
@@ -532,15 +715,43 @@ sound_set_pc_speaker_filter(void (*filter)(int channel, double *buffer, void *pr
     }
 }
 
+/* Position within the current buffer: the end of the pending batch, less the
+   samples that are still to come before the timer reaches it. */
+static int
+sound_poll_get_pos(pc_timer_t *timer, uint64_t latch, int end, int len)
+{
+    const uint64_t remaining = timer_get_remaining_u64(timer);
+    const uint64_t behind    = (remaining + latch - 1) / latch;
+
+    return end - (int) MIN(behind, (uint64_t) len);
+}
+
+int
+sound_get_pos(void)
+{
+    return sound_poll_get_pos(&sound_poll_timer, sound_poll_latch, sound_poll_end, sound_poll_len);
+}
+
+int
+music_get_pos(void)
+{
+    return sound_poll_get_pos(&music_poll_timer, music_poll_latch, music_poll_end, music_poll_len);
+}
+
+int
+wavetable_get_pos(void)
+{
+    return sound_poll_get_pos(&wavetable_poll_timer, wavetable_poll_latch, wavetable_poll_end, wavetable_poll_len);
+}
+
 void
 sound_poll(UNUSED(void *priv))
 {
-    timer_advance_u64(&sound_poll_timer, sound_poll_latch);
-
-    midi_poll();
+    /* The MIDI renderers only count samples to pace their own threads, so
+       they are told about the whole batch at once. */
+    midi_poll(sound_poll_len);
 
-    sound_pos_global++;
-    if (sound_pos_global == SOUNDBUFLEN) {
+    if (sound_poll_end == SOUNDBUFLEN) {
         int c;
 
         memset(outbuffer, 0x00, SOUNDBUFLEN * 2 * sizeof(int32_t));
@@ -548,23 +759,9 @@ sound_poll(UNUSED(void *priv))
         for (c = 0; c < sound_handlers_num; c++)
             sound_handlers[c].get_buffer(outbuffer, SOUNDBUFLEN, sound_handlers[c].priv);
 
-        for (c = 0; c < SOUNDBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_ex[c] = ((float) outbuffer[c]) / (float) 32768.0;
-            else {
-                if (outbuffer[c] > 32767)
-                    outbuffer[c] = 32767;
-                if (outbuffer[c] < -32768)
-                    outbuffer[c] = -32768;
-
-                outbuffer_ex_int16[c] = (int16_t) outbuffer[c];
-            }
-        }
-
-        if (sound_is_float)
-            givealbuffer(outbuffer_ex);
-        else
-            givealbuffer(outbuffer_ex_int16);
+        /* In turbo mode the guest runs ahead of the host, so drop the audio. */
+        if (!turbo_mode)
+            sound_ring_push(&sound_ring, outbuffer, SOUNDBUFLEN * 2 * sizeof(int32_t));
 
         if (cd_thread_enable) {
             cd_buf_update--;
@@ -574,17 +771,18 @@ sound_poll(UNUSED(void *priv))
             }
         }
 
-        sound_pos_global = 0;
+        sound_poll_end = 0;
     }
+
+    sound_poll_len = MIN(SOUND_POLL_BATCH, SOUNDBUFLEN - sound_poll_end);
+    sound_poll_end += sound_poll_len;
+    timer_advance_u64(&sound_poll_timer, sound_poll_latch * sound_poll_len);
 }
 
 void
 music_poll(UNUSED(void *priv))
 {
-    timer_advance_u64(&music_poll_timer, music_poll_latch);
-
-    music_pos_global++;
-    if (music_pos_global == MUSICBUFLEN) {
+    if (music_poll_end == MUSICBUFLEN) {
         int c;
 
         memset(outbuffer_m, 0x00, MUSICBUFLEN * 2 * sizeof(int32_t));
@@ -592,35 +790,21 @@ music_poll(UNUSED(void *priv))
         for (c = 0; c < music_handlers_num; c++)
             music_handlers[c].get_buffer(outbuffer_m, MUSICBUFLEN, music_handlers[c].priv);
 
-        for (c = 0; c < MUSICBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_m_ex[c] = ((float) outbuffer_m[c]) / (float) 32768.0;
-            else {
-                if (outbuffer_m[c] > 32767)
-                    outbuffer_m[c] = 32767;
-                if (outbuffer_m[c] < -32768)
-                    outbuffer_m[c] = -32768;
-
-                outbuffer_m_ex_int16[c] = (int16_t) outbuffer_m[c];
-            }
-        }
-
-        if (sound_is_float)
-            givealbuffer_music(outbuffer_m_ex);
-        else
-            givealbuffer_music(outbuffer_m_ex_int16);
+        if (!turbo_mode)
+            sound_ring_push(&music_ring, outbuffer_m, MUSICBUFLEN * 2 * sizeof(int32_t));
 
-        music_pos_global = 0;
+        music_poll_end = 0;
     }
+
+    music_poll_len = MIN(MUSIC_POLL_BATCH, MUSICBUFLEN - music_poll_end);
+    music_poll_end += music_poll_len;
+    timer_advance_u64(&music_poll_timer, music_poll_latch * music_poll_len);
 }
 
 void
 wavetable_poll(UNUSED(void *priv))
 {
-    timer_advance_u64(&wavetable_poll_timer, wavetable_poll_latch);
-
-    wavetable_pos_global++;
-    if (wavetable_pos_global == WTBUFLEN) {
+    if (wavetable_poll_end == WTBUFLEN) {
         int c;
 
         memset(outbuffer_w, 0x00, WTBUFLEN * 2 * sizeof(int32_t));
@@ -628,26 +812,15 @@ wavetable_poll(UNUSED(void *priv))
         for (c = 0; c < wavetable_handlers_num; c++)
             wavetable_handlers[c].get_buffer(outbuffer_w, WTBUFLEN, wavetable_handlers[c].priv);
 
-        for (c = 0; c < WTBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_w_ex[c] = ((float) outbuffer_w[c]) / (float) 32768.0;
-            else {
-                if (outbuffer_w[c] > 32767)
-                    outbuffer_w[c] = 32767;
-                if (outbuffer_w[c] < -32768)
-                    outbuffer_w[c] = -32768;
-
-                outbuffer_w_ex_int16[c] = (int16_t) outbuffer_w[c];
-            }
-        }
-
-        if (sound_is_float)
-            givealbuffer_wt(outbuffer_w_ex);
-        else
-            givealbuffer_wt(outbuffer_w_ex_int16);
+        if (!turbo_mode)
+            sound_ring_push(&wavetable_ring, outbuffer_w, WTBUFLEN * 2 * sizeof(int32_t));
 
-        wavetable_pos_global = 0;
+        wavetable_poll_end = 0;
     }
+
+    wavetable_poll_len = MIN(WAVETABLE_POLL_BATCH, WTBUFLEN - wavetable_poll_end);
+    wavetable_poll_end += wavetable_poll_len;
+    timer_advance_u64(&wavetable_poll_timer, wavetable_poll_latch * wavetable_poll_len);
 }
 
 void
@@ -663,6 +836,9 @@ sound_speed_changed(void)
 void
 sound_reset(void)
 {
+    /* The mixer thread converts into the buffers reallocated below. */
+    sound_mix_thread_end();
+
     sound_realloc_buffers();
 
     music_realloc_buffers();
@@ -674,16 +850,28 @@ sound_reset(void)
 
     inital();
 
+    /* The CD audio thread keeps running while the mixer is stopped, so its
+       ring may hold buffers from before the reset, in the old format. */
+    sound_ring_flush(&sound_ring);
+    sound_ring_flush(&music_ring);
+    sound_ring_flush(&wavetable_ring);
+    sound_ring_flush(&cd_ring);
+    atomic_store(&cd_ring_discard, 0);
+    sound_mix_thread_start();
+
+    sound_poll_end = sound_poll_len = 0;
     timer_add(&sound_poll_timer, sound_poll, NULL, 1);
 
     sound_handlers_num = 0;
     memset(sound_handlers, 0x00, 8 * sizeof(sound_handler_t));
 
+    music_poll_end = music_poll_len = 0;
     timer_add(&music_poll_timer, music_poll, NULL, 1);
 
     music_handlers_num = 0;
     memset(music_handlers, 0x00, 8 * sizeof(sound_handler_t));
 
+    wavetable_poll_end = wavetable_poll_len = 0;
     timer_add(&wavetable_poll_timer, wavetable_poll, NULL, 1);
 
     wavetable_handlers_num = 0;
@@ -747,6 +935,11 @@ sound_cd_thread_reset(void)
             available_cdrom_drives++;
     }
 
+    /* Drop whatever the CD audio thread queued before the drives stopped. */
+    atomic_store(&cd_ring_discard, 1);
+    if (sound_mix_on)
+        thread_set_event(sound_mix_event);
+
     if (available_cdrom_drives && !cd_thread_enable) {
         cdaudioon = 1;
 
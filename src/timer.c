@@ -1,23 +1,221 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include <86box/86box.h>
 #include <86box/timer.h>
+#include <86box/benchmark.h>
 #include <86box/nv/vid_nv_rivatimer.h>
 
 uint64_t TIMER_USEC;
 uint32_t timer_target;
 
+#ifdef USE_TIMER_LIST
 /*Enabled timers are stored in a linked list, with the first timer to expire at
   the head.*/
 pc_timer_t *timer_head = NULL;
+#else
+/*Enabled timers are stored in a binary min-heap, with the first timer to expire
+  at index 0. Each timer keeps its own heap index so it can be removed or
+  rescheduled in O(log n). Timers with equal timestamps are ordered by the
+  sequence number, latest enabled first, to match the order of the old
+  linked list.*/
+static pc_timer_t **timer_heap       = NULL;
+static int          timer_heap_count = 0;
+static int          timer_heap_size  = 0;
+static uint32_t     timer_seq        = 0;
+#endif
 
 /* Are we initialized? */
 int timer_inited = 0;
 
 static void timer_advance_ex(pc_timer_t *timer, int start);
 
+#ifndef USE_TIMER_LIST
+/*True if timer a should be processed before timer b*/
+static __inline int
+timer_heap_before(pc_timer_t *a, pc_timer_t *b)
+{
+    int64_t diff = (int64_t) (a->ts.ts64 - b->ts.ts64);
+
+    if (diff != 0)
+        return diff < 0;
+
+    return (int32_t) (a->seq - b->seq) > 0;
+}
+
+static __inline void
+timer_heap_set(int idx, pc_timer_t *timer)
+{
+    timer_heap[idx] = timer;
+    timer->heap_idx = idx;
+}
+
+static void
+timer_heap_sift_up(int idx)
+{
+    pc_timer_t *timer = timer_heap[idx];
+
+    while (idx > 0) {
+        int parent = (idx - 1) >> 1;
+
+        if (!timer_heap_before(timer, timer_heap[parent]))
+            break;
+
+        timer_heap_set(idx, timer_heap[parent]);
+        idx = parent;
+    }
+
+    timer_heap_set(idx, timer);
+}
+
+static void
+timer_heap_sift_down(int idx)
+{
+    pc_timer_t *timer = timer_heap[idx];
+
+    while (1) {
+        int child = (idx << 1) + 1;
+
+        if (child >= timer_heap_count)
+            break;
+
+        if (((child + 1) < timer_heap_count) && timer_heap_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+
+        if (!timer_heap_before(timer_heap[child], timer))
+            break;
+
+        timer_heap_set(idx, timer_heap[child]);
+        idx = child;
+    }
+
+    timer_heap_set(idx, timer);
+}
+
+/*Remove the timer at the given heap index, filling the hole with the last
+  entry*/
+static void
+timer_heap_remove(int idx)
+{
+    pc_timer_t *last;
+
+    timer_heap[idx]->heap_idx = -1;
+
+    timer_heap_count--;
+    if (idx == timer_heap_count)
+        return;
+
+    last = timer_heap[timer_heap_count];
+    timer_heap_set(idx, last);
+
+    if ((idx > 0) && timer_heap_before(last, timer_heap[(idx - 1) >> 1]))
+        timer_heap_sift_up(idx);
+    else
+        timer_heap_sift_down(idx);
+}
+
+void
+timer_enable(pc_timer_t *timer)
+{
+    if (!timer_inited || (timer == NULL))
+        return;
+
+    timer->seq = timer_seq++;
+
+    if (timer->flags & TIMER_ENABLED) {
+        /*Already queued - reschedule in place*/
+        if ((timer->heap_idx < 0) || (timer->heap_idx >= timer_heap_count) || (timer_heap[timer->heap_idx] != timer))
+            fatal("timer_enable - timer not in heap\n");
+
+        timer_heap_sift_up(timer->heap_idx);
+        timer_heap_sift_down(timer->heap_idx);
+    } else {
+        if (timer_heap_count == timer_heap_size) {
+            int          new_size = timer_heap_size ? (timer_heap_size << 1) : 64;
+            pc_timer_t **new_heap = (pc_timer_t **) realloc(timer_heap, new_size * sizeof(pc_timer_t *));
+
+            if (new_heap == NULL)
+                fatal("timer_enable - out of memory\n");
+
+            timer_heap      = new_heap;
+            timer_heap_size = new_size;
+        }
+
+        timer_heap_set(timer_heap_count++, timer);
+        timer_heap_sift_up(timer->heap_idx);
+
+        timer->flags |= TIMER_ENABLED;
+    }
+
+    if (timer_heap[0] == timer)
+        timer_target = timer->ts.ts32.integer;
+}
+
+void
+timer_disable(pc_timer_t *timer)
+{
+    if (!timer_inited || (timer == NULL) || !(timer->flags & TIMER_ENABLED))
+        return;
+
+    if ((timer->heap_idx < 0) || (timer->heap_idx >= timer_heap_count) || (timer_heap[timer->heap_idx] != timer))
+        fatal("timer_disable - timer not in heap\n");
+
+    timer->flags &= ~TIMER_ENABLED;
+    timer->in_callback = 0;
+
+    timer_heap_remove(timer->heap_idx);
+}
+
+static void
+timer_process_queue(void)
+{
+    pc_timer_t *timer;
+
+    if (!timer_heap_count)
+        return;
+
+    while (timer_heap_count) {
+        timer = timer_heap[0];
+
+        if (!TIMER_LESS_THAN_VAL(timer, (uint32_t) tsc))
+            break;
+
+        timer_heap_remove(0);
+        timer->flags &= ~TIMER_ENABLED;
+
+        if (timer->flags & TIMER_SPLIT)
+            timer_advance_ex(timer, 0);   /* We're splitting a > 1 s period into
+                                                 multiple <= 1 s periods. */
+        else if (timer->callback != NULL) {
+            /* Make sure it's not NULL, so that we can
+               have a NULL callback when no operation
+               is needed. */
+            timer->in_callback = 1;
+            timer->callback(timer->priv);
+            timer->in_callback = 0;
+        }
+    }
+
+    if (timer_heap_count)
+        timer_target = timer_heap[0]->ts.ts32.integer;
+}
+
+void
+timer_close(void)
+{
+    /* Invalidate the heap index of all queued timers so it is assured that
+       timers that are not in malloc'd structs don't keep pointing into the
+       heap. */
+    for (int i = 0; i < timer_heap_count; i++)
+        timer_heap[i]->heap_idx = -1;
+
+    timer_heap_count = 0;
+
+    timer_inited = 0;
+}
+#else
 void
 timer_enable(pc_timer_t *timer)
 {
@@ -106,8 +304,8 @@ timer_disable(pc_timer_t *timer)
     timer->prev = timer->next = NULL;
 }
 
-void
-timer_process(void)
+static void
+timer_process_queue(void)
 {
     pc_timer_t *timer;
 
@@ -162,6 +360,22 @@ timer_close(void)
 
     timer_inited = 0;
 }
+#endif
+
+void
+timer_process(void)
+{
+    uint64_t start;
+
+    if (!benchmark_mode) {
+        timer_process_queue();
+        return;
+    }
+
+    start = benchmark_clock_ns();
+    timer_process_queue();
+    benchmark_timer_ns += benchmark_clock_ns() - start;
+}
 
 void
 timer_init(void)
@@ -185,6 +399,7 @@ timer_add(pc_timer_t *timer, void (*callback)(void *priv), void *priv, int start
     timer->priv        = priv;
     timer->flags       = 0;
     timer->prev        = timer->next = NULL;
+    timer->heap_idx    = -1;
     if (start_timer)
         timer_set_delay_u64(timer, 0);
 }
@@ -268,6 +483,7 @@ timer_set_new_tsc(uint64_t new_tsc)
         update_tsc();
 #endif
 
+#ifdef USE_TIMER_LIST
     if (!timer_head) {
         tsc = new_tsc;
         return;
@@ -282,6 +498,22 @@ timer_set_new_tsc(uint64_t new_tsc)
 
         timer = timer->next;
     }
+#else
+    if (!timer_heap_count) {
+        tsc = new_tsc;
+        return;
+    }
+
+    timer_target = new_tsc + (int32_t)(timer_get_ts_int(timer_heap[0]) - (uint32_t)tsc);
+
+    /* Every timer is shifted by the same amount, so the heap order holds. */
+    for (int i = 0; i < timer_heap_count; i++) {
+        timer = timer_heap[i];
+
+        int32_t offset_from_current_tsc = (int32_t)(timer_get_ts_int(timer) - (uint32_t)tsc);
+        timer->ts.ts32.integer = new_tsc + offset_from_current_tsc;
+    }
+#endif
 
     tsc = new_tsc;
 }
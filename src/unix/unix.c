@@ -44,6 +44,7 @@
 #include <86box/video.h>
 #include <86box/ui.h>
 #include <86box/gdbstub.h>
+#include <86box/benchmark.h>
 
 #define __USE_GNU 1 /* shouldn't be done, yet it is */
 #include <pthread.h>
@@ -555,6 +556,9 @@ main_thread(void *param)
 #endif
             drawits += (new_time - old_time);
         old_time = new_time;
+        /* In turbo mode, run back-to-back slices as fast as the host allows. */
+        if (turbo_mode && (drawits <= 0))
+            drawits = 10;
         if (drawits > 0 && !dopause) {
             /* Yes, so do one frame now. */
             drawits -= 10;
@@ -974,6 +978,7 @@ monitor_thread(void *param)
                         "moeject <id> - eject image from MO drive <id>.\n\n"
                         "hardreset - hard reset the emulated system.\n"
                         "pause - pause the the emulated system.\n"
+                        "turbo [fps] - toggle unthrottled execution, presenting <fps> frames per second.\n"
                         "fullscreen - toggle fullscreen.\n"
                         "version - print version and license information.\n"
                         "exit - exit 86Box.\n");
@@ -1021,6 +1026,11 @@ monitor_thread(void *param)
                 } else if (strncasecmp(xargv[0], "pause", 5) == 0) {
                     plat_pause(dopause ^ 1);
                     printf("%s", dopause ? "Paused.\n" : "Unpaused.\n");
+                } else if (strncasecmp(xargv[0], "turbo", 5) == 0) {
+                    if (cmdargc >= 2)
+                        turbo_fps = atoi(xargv[1]);
+                    turbo_mode ^= 1;
+                    printf("%s", turbo_mode ? "Turbo mode enabled.\n" : "Turbo mode disabled.\n");
                 } else if (strncasecmp(xargv[0], "hardreset", 9) == 0) {
                     pc_reset_hard();
                 } else if (strncasecmp(xargv[0], "cdload", 6) == 0 && cmdargc >= 3) {
@@ -1186,6 +1196,13 @@ main(int argc, char **argv)
     ret = pc_init(argc, argv);
     if (ret == 0)
         return 0;
+
+    /* The scanline converter check needs neither a machine nor a window. */
+    if (benchmark_line_check) {
+        ret = benchmark_line_conv_check();
+        SDL_Quit();
+        return ret;
+    }
     if (!pc_init_modules()) {
         ui_msgbox_header(MBX_FATAL, L"No ROMs found.", L"86Box could not find any usable ROM images.\n\nPlease download a ROM set and extract it into the \"roms\" directory.");
         SDL_Quit();
@@ -1200,6 +1217,13 @@ main(int argc, char **argv)
         fprintf(stderr, "Failed to create blit mutex: %s", SDL_GetError());
         return -1;
     }
+
+    /* The benchmark runs without a window, renderer or console. */
+    if (benchmark_mode) {
+        ret = benchmark_run();
+        SDL_Quit();
+        return ret;
+    }
     libedithandle = dlopen(LIBEDIT_LIBRARY, RTLD_LOCAL | RTLD_LAZY);
     if (libedithandle) {
         f_readline    = dlsym(libedithandle, "readline");
@@ -1389,6 +1413,14 @@ plat_get_cpu_string(char *outbuf, uint8_t len) {
     strncpy(outbuf, cpu_string, len);
 }
 
+int
+plat_get_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (int) count : 1;
+}
+
 void
 plat_set_thread_name(void *thread, const char *name)
 {
@@ -39,6 +39,7 @@
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
 #include <86box/vid_ati_eeprom.h>
+#include <86box/vid_blit_span.h>
 
 #ifdef CLAMP
 #    undef CLAMP
@@ -294,6 +295,9 @@ typedef struct mach64_t {
     uint8_t thread_run;
     void   *i2c;
     void   *ddc;
+
+    blit_bands_t *bands;
+    int           blit_rop;
 } mach64_t;
 
 static video_timings_t timing_mach64_isa = { .type = VIDEO_ISA, .write_b = 3, .write_w = 3, .write_l = 6, .read_b = 5, .read_w = 5, .read_l = 10 };
@@ -1600,6 +1604,206 @@ mach64_start_line(mach64_t *mach64)
         svga->changedvram[(((addr) >> 3) & mach64->vram_mask) >> 12] = svga->monitor->mon_changeframecount;    \
     }
 
+/*Mixes 0x0-0xf as the ROP2 truth tables the span kernels take.*/
+static const uint8_t mach64_mix_rop[16] = {
+    0x5, 0x0, 0xf, 0xa, 0x3, 0x6, 0x9, 0xc,
+    0x7, 0xb, 0xd, 0xe, 0x8, 0x4, 0x2, 0x1
+};
+
+static void
+mach64_mark_span(mach64_t *mach64, uint32_t addr, uint32_t len)
+{
+    svga_t *svga = &mach64->svga;
+
+    for (uint32_t page = addr >> 12; page <= ((addr + len - 1) >> 12); page++)
+        svga->changedvram[page] = svga->monitor->mon_changeframecount;
+}
+
+/*Draws count pixels from an 8 pixel colour row, starting at pixel address
+  dst. Runs that wrap around the end of VRAM are drawn a pixel at a time.*/
+static void
+mach64_pattern_span(mach64_t *mach64, uint32_t dst, const uint32_t *cols, int phase, int count)
+{
+    svga_t  *svga     = &mach64->svga;
+    int      size     = mach64->accel.dst_size;
+    uint32_t dst_addr = (dst << size) & mach64->vram_mask;
+
+    if ((dst_addr + (count << size)) <= (mach64->vram_mask + 1)) {
+        blit_span_pattern(&svga->vram[dst_addr], cols, phase, count, 1 << size, mach64->blit_rop);
+        mach64_mark_span(mach64, dst_addr, count << size);
+        return;
+    }
+
+    for (int x = 0; x < count; x++) {
+        dst_addr = ((dst + x) << size) & mach64->vram_mask;
+        blit_span_fill(&svga->vram[dst_addr], cols[(phase + x) & 7], 1, 1 << size, mach64->blit_rop);
+        svga->changedvram[dst_addr >> 12] = svga->monitor->mon_changeframecount;
+    }
+}
+
+/*Combines count pixels from pixel address src into pixel address dst, both
+  the leftmost of the run. The span kernels are only used where the result
+  does not depend on the order the engine walks the run in.*/
+static void
+mach64_copy_span(mach64_t *mach64, uint32_t dst, uint32_t src, int count)
+{
+    svga_t  *svga     = &mach64->svga;
+    int      size     = mach64->accel.dst_size;
+    uint32_t len      = count << size;
+    uint32_t dst_addr = (dst << size) & mach64->vram_mask;
+    uint32_t src_addr = (src << size) & mach64->vram_mask;
+    int      x;
+
+    if (((dst_addr + len) <= (mach64->vram_mask + 1)) && ((src_addr + len) <= (mach64->vram_mask + 1)) &&
+        (((dst_addr + len) <= src_addr) || ((src_addr + len) <= dst_addr) || ((mach64->accel.xinc > 0) == (dst_addr <= src_addr)))) {
+        blit_span_copy(&svga->vram[dst_addr], &svga->vram[src_addr], len, mach64->blit_rop);
+        mach64_mark_span(mach64, dst_addr, len);
+        return;
+    }
+
+    for (int c = 0; c < count; c++) {
+        x        = (mach64->accel.xinc > 0) ? c : (count - 1 - c);
+        dst_addr = ((dst + x) << size) & mach64->vram_mask;
+        src_addr = ((src + x) << size) & mach64->vram_mask;
+        blit_span_copy(&svga->vram[dst_addr], &svga->vram[src_addr], 1 << size, mach64->blit_rop);
+        svga->changedvram[dst_addr >> 12] = svga->monitor->mon_changeframecount;
+    }
+}
+
+static void
+mach64_blit_band(void *priv, int start, int end)
+{
+    mach64_t *mach64  = (mach64_t *) priv;
+    int       x_first = mach64->accel.dst_x_start;
+    int       x_last  = mach64->accel.dst_x_start + ((mach64->accel.dst_width - 1) * mach64->accel.xinc);
+    uint32_t  fg      = (mach64->accel.source_fg == SRC_FG) ? mach64->accel.dp_frgd_clr : mach64->accel.dp_bkgd_clr;
+    uint32_t  bg      = (mach64->accel.source_bg == SRC_FG) ? mach64->accel.dp_frgd_clr : mach64->accel.dp_bkgd_clr;
+    uint32_t  cols[8];
+
+    for (int y = start; y < end; y++) {
+        int dst_y = (mach64->accel.dst_y_start + (y * mach64->accel.yinc)) & 0x3fff;
+        int src_y = (mach64->accel.src_y_start + (y * mach64->accel.yinc)) & 0x3fff;
+        int x_l   = MAX(MIN(x_first, x_last), mach64->accel.sc_left);
+        int x_r   = MIN(MAX(x_first, x_last), mach64->accel.sc_right);
+
+        if ((dst_y < mach64->accel.sc_top) || (dst_y > mach64->accel.sc_bottom) || (x_r < x_l))
+            continue;
+
+        if (mach64->accel.source_fg == SRC_BLITSRC) {
+            mach64_copy_span(mach64, mach64->accel.dst_offset + (dst_y * mach64->accel.dst_pitch) + x_l,
+                             mach64->accel.src_offset + (src_y * mach64->accel.src_pitch) + mach64->accel.src_x_start + (x_l - x_first),
+                             (x_r - x_l) + 1);
+            continue;
+        }
+
+        for (int x = 0; x < 8; x++)
+            cols[x] = ((mach64->accel.source_mix == MONO_SRC_1) || mach64->accel.pattern[dst_y & 7][x]) ? fg : bg;
+
+        mach64_pattern_span(mach64, mach64->accel.dst_offset + (dst_y * mach64->accel.dst_pitch) + x_l, cols, x_l & 7, (x_r - x_l) + 1);
+    }
+}
+
+/*Whether a rectangle of rows at pixel address offset stays clear of the
+  end of VRAM, and returns the first and last pixel addresses it touches.*/
+static int
+mach64_blit_rect_bounds(mach64_t *mach64, uint32_t offset, uint32_t pitch, int y_start, int x_start, int64_t *lo, int64_t *hi)
+{
+    int y_first = y_start;
+    int y_last  = y_start + ((mach64->accel.dst_height - 1) * mach64->accel.yinc);
+    int x_first = x_start;
+    int x_last  = x_start + ((mach64->accel.dst_width - 1) * mach64->accel.xinc);
+
+    if ((MIN(y_first, y_last) < 0) || (MAX(y_first, y_last) > 0x3fff))
+        return 0;
+
+    *lo = offset + ((int64_t) MIN(y_first, y_last) * pitch) + MIN(x_first, x_last);
+    *hi = offset + ((int64_t) MAX(y_first, y_last) * pitch) + MAX(x_first, x_last);
+
+    return ((*hi + 1) << mach64->accel.dst_size) <= ((int64_t) mach64->vram_mask + 1);
+}
+
+/*Solid fills, monochrome pattern fills and screen to screen copies that
+  need no per-pixel tests go through the span kernels a row at a time, and
+  are split into bands across the blitter threads where the rows do not
+  overlap. Returns 0 if mach64_blit() has to draw this one a pixel at a
+  time.*/
+static int
+mach64_blit_rect_spans(mach64_t *mach64)
+{
+    uint32_t pix_mask = (mach64->accel.dst_size == 2) ? 0xffffffff : ((1 << (8 << mach64->accel.dst_size)) - 1);
+    int      x_last   = mach64->accel.dst_x_start + ((mach64->accel.dst_width - 1) * mach64->accel.xinc);
+    int      copy     = (mach64->accel.source_fg == SRC_BLITSRC);
+    int      bands;
+    int64_t  dst_lo;
+    int64_t  dst_hi;
+    int64_t  src_lo;
+    int64_t  src_hi;
+
+    if ((mach64->dst_cntl & (DST_POLYGON_EN | DST_24_ROT_EN)) || (mach64->src_cntl & (SRC_LINEAR_EN | SRC_PATT_EN)) ||
+        (mach64->accel.dst_size > 2) || (mach64->accel.mix_fg > 0xf) ||
+        (mach64->accel.clr_cmp_fn == 1) || (mach64->accel.clr_cmp_fn == 4) || (mach64->accel.clr_cmp_fn == 5) ||
+        ((mach64->accel.write_mask & pix_mask) != pix_mask) || (mach64->accel.dst_width <= 0) || (mach64->accel.dst_height <= 0))
+        return 0;
+
+    switch (mach64->accel.source_mix) {
+        case MONO_SRC_1:
+            if ((mach64->accel.source_fg != SRC_FG) && (mach64->accel.source_fg != SRC_BG) && !copy)
+                return 0;
+            break;
+        case MONO_SRC_PAT:
+            if ((mach64->accel.mix_bg != mach64->accel.mix_fg) ||
+                ((mach64->accel.source_fg != SRC_FG) && (mach64->accel.source_fg != SRC_BG)) ||
+                ((mach64->accel.source_bg != SRC_FG) && (mach64->accel.source_bg != SRC_BG)))
+                return 0;
+            break;
+
+        default:
+            return 0;
+    }
+
+    if ((MIN(mach64->accel.dst_x_start, x_last) < 0) || (MAX(mach64->accel.dst_x_start, x_last) > 0xfff))
+        return 0;
+
+    if (copy) {
+        x_last = mach64->accel.src_x_start + ((mach64->accel.dst_width - 1) * mach64->accel.xinc);
+        if ((mach64->accel.src_size != mach64->accel.dst_size) || (mach64->accel.src_width1 < mach64->accel.dst_width) ||
+            (MIN(mach64->accel.src_x_start, x_last) < 0) || (MAX(mach64->accel.src_x_start, x_last) > 0xfff))
+            return 0;
+    }
+
+    mach64->blit_rop = mach64_mix_rop[mach64->accel.mix_fg];
+
+    /*Rows may only go in parallel if no two destination rows share a pixel,
+      and a copy's source and destination are apart.*/
+    bands = (mach64->accel.dst_width <= (int) mach64->accel.dst_pitch) &&
+            mach64_blit_rect_bounds(mach64, mach64->accel.dst_offset, mach64->accel.dst_pitch,
+                                    mach64->accel.dst_y_start, mach64->accel.dst_x_start, &dst_lo, &dst_hi);
+    if (bands && copy)
+        bands = mach64_blit_rect_bounds(mach64, mach64->accel.src_offset, mach64->accel.src_pitch,
+                                        mach64->accel.src_y_start, mach64->accel.src_x_start, &src_lo, &src_hi) &&
+                ((src_hi < dst_lo) || (dst_hi < src_lo));
+
+    if (bands)
+        blit_bands_run(mach64->bands, mach64->accel.dst_height, mach64_blit_band, mach64);
+    else
+        mach64_blit_band(mach64, 0, mach64->accel.dst_height);
+
+    mach64->accel.dst_y += mach64->accel.dst_height * mach64->accel.yinc;
+    mach64->accel.src_y += mach64->accel.dst_height * mach64->accel.yinc;
+    mach64->accel.src_x_start = (mach64->src_y_x >> 16) & 0xfff;
+    mach64->accel.dst_height  = 0;
+
+    /*Blit finished*/
+    mach64_log("mach64 blit finished\n");
+    mach64->accel.busy = 0;
+    if (mach64->dst_cntl & DST_X_TILE)
+        mach64->dst_y_x = (mach64->dst_y_x & 0xfff) | ((mach64->dst_y_x + (mach64->accel.dst_width << 16)) & 0xfff0000);
+    if (mach64->dst_cntl & DST_Y_TILE)
+        mach64->dst_y_x = (mach64->dst_y_x & 0xfff0000) | ((mach64->dst_y_x + (mach64->dst_height_width & 0x1fff)) & 0xfff);
+
+    return 1;
+}
+
 void
 mach64_blit(uint32_t cpu_dat, int count, mach64_t *mach64)
 {
@@ -1614,6 +1818,9 @@ mach64_blit(uint32_t cpu_dat, int count, mach64_t *mach64)
 
     switch (mach64->accel.op) {
         case OP_RECT:
+            if ((count == -1) && !mach64->accel.dst_x && !mach64->accel.dst_y && mach64_blit_rect_spans(mach64))
+                return;
+
             while (count) {
                 uint8_t  write_mask = 0;
                 uint32_t src_dat = 0;
@@ -4583,6 +4790,7 @@ mach64_common_init(const device_t *info)
     mach64->wake_fifo_thread = thread_create_event();
     mach64->fifo_not_full_event = thread_create_event();
     mach64->fifo_thread = thread_create(fifo_thread, mach64);
+    mach64->bands = blit_bands_init(device_get_config_int("blit_threads"));
 
     mach64->i2c = i2c_gpio_init("ddc_ati_mach64");
     mach64->ddc = ddc_init(i2c_gpio_get_bus(mach64->i2c));
@@ -4683,6 +4891,7 @@ mach64_close(void *priv)
     thread_wait(mach64->fifo_thread);
     thread_destroy_event(mach64->fifo_not_full_event);
     thread_destroy_event(mach64->wake_fifo_thread);
+    blit_bands_close(mach64->bands);
 
     svga_close(&mach64->svga);
 
@@ -4733,6 +4942,37 @@ static const device_config_t mach64gx_config[] = {
             }
         }
     },
+    {
+        .name = "blit_threads",
+        .description = "Blitter threads",
+        .type = CONFIG_SELECTION,
+        .default_int = 1,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = ""
+            }
+        }
+    },
     {
         .type = CONFIG_END
     }
@@ -4758,6 +4998,37 @@ static const device_config_t mach64vt2_config[] = {
             }
         }
     },
+    {
+        .name = "blit_threads",
+        .description = "Blitter threads",
+        .type = CONFIG_SELECTION,
+        .default_int = 1,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = ""
+            }
+        }
+    },
     {
         .type = CONFIG_END
     }
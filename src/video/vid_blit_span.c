@@ -0,0 +1,426 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Span kernels and band workers shared by the 2D blitters.
+ *
+ *          Raster operations are bitwise, so every kernel works on bytes
+ *          regardless of the pixel format. Each of the sixteen operations
+ *          gets its own copy of the loop, with SSE2 doing 16 bytes at a
+ *          time where available.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <stdatomic.h>
+#include <86box/86box.h>
+#include <86box/plat.h>
+#include <86box/thread.h>
+#include <86box/vid_blit_span.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define BLIT_SPAN_SSE2
+#    include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#    define BLIT_INLINE static __forceinline
+#else
+#    define BLIT_INLINE static __attribute__((always_inline)) inline
+#endif
+
+#define BLIT_MAX_BAND_THREADS 8
+
+/*A whole number of 16-byte chunks and of 8-pixel pattern rows at 1, 2, 3
+  or 4 bytes per pixel.*/
+#define BLIT_PATTERN_SIZE 96
+
+typedef struct blit_band_t {
+    struct blit_bands_t *bands;
+    thread_t            *thread;
+    event_t             *wake;
+    int                  start;
+    int                  end;
+} blit_band_t;
+
+struct blit_bands_t {
+    int              threads;
+    int              run;
+    blit_band_func_t func;
+    void            *priv;
+    atomic_int       pending;
+    event_t         *done;
+    blit_band_t      band[BLIT_MAX_BAND_THREADS];
+};
+
+BLIT_INLINE uint64_t
+blit_rop64(const int rop, uint64_t s, uint64_t d)
+{
+    switch (rop) {
+        case 0x0:
+            return 0;
+        case 0x1:
+            return ~(s | d);
+        case 0x2:
+            return d & ~s;
+        case 0x3:
+            return ~s;
+        case 0x4:
+            return s & ~d;
+        case 0x5:
+            return ~d;
+        case 0x6:
+            return s ^ d;
+        case 0x7:
+            return ~(s & d);
+        case 0x8:
+            return s & d;
+        case 0x9:
+            return ~(s ^ d);
+        case 0xa:
+            return d;
+        case 0xb:
+            return d | ~s;
+        case 0xc:
+            return s;
+        case 0xd:
+            return s | ~d;
+        case 0xe:
+            return s | d;
+
+        default:
+            return ~0ULL;
+    }
+}
+
+#ifdef BLIT_SPAN_SSE2
+BLIT_INLINE __m128i
+blit_rop128(const int rop, __m128i s, __m128i d)
+{
+    const __m128i ones = _mm_set1_epi32(-1);
+
+    switch (rop) {
+        case 0x0:
+            return _mm_setzero_si128();
+        case 0x1:
+            return _mm_xor_si128(_mm_or_si128(s, d), ones);
+        case 0x2:
+            return _mm_andnot_si128(s, d);
+        case 0x3:
+            return _mm_xor_si128(s, ones);
+        case 0x4:
+            return _mm_andnot_si128(d, s);
+        case 0x5:
+            return _mm_xor_si128(d, ones);
+        case 0x6:
+            return _mm_xor_si128(s, d);
+        case 0x7:
+            return _mm_xor_si128(_mm_and_si128(s, d), ones);
+        case 0x8:
+            return _mm_and_si128(s, d);
+        case 0x9:
+            return _mm_xor_si128(_mm_xor_si128(s, d), ones);
+        case 0xa:
+            return d;
+        case 0xb:
+            return _mm_or_si128(d, _mm_xor_si128(s, ones));
+        case 0xc:
+            return s;
+        case 0xd:
+            return _mm_or_si128(s, _mm_xor_si128(d, ones));
+        case 0xe:
+            return _mm_or_si128(s, d);
+
+        default:
+            return ones;
+    }
+}
+#endif
+
+#define BLIT_ROP_SWITCH(rop, kernel, ...)  \
+    switch (rop) {                         \
+        case 0x0:                          \
+            kernel(__VA_ARGS__, 0x0);      \
+            break;                         \
+        case 0x1:                          \
+            kernel(__VA_ARGS__, 0x1);      \
+            break;                         \
+        case 0x2:                          \
+            kernel(__VA_ARGS__, 0x2);      \
+            break;                         \
+        case 0x3:                          \
+            kernel(__VA_ARGS__, 0x3);      \
+            break;                         \
+        case 0x4:                          \
+            kernel(__VA_ARGS__, 0x4);      \
+            break;                         \
+        case 0x5:                          \
+            kernel(__VA_ARGS__, 0x5);      \
+            break;                         \
+        case 0x6:                          \
+            kernel(__VA_ARGS__, 0x6);      \
+            break;                         \
+        case 0x7:                          \
+            kernel(__VA_ARGS__, 0x7);      \
+            break;                         \
+        case 0x8:                          \
+            kernel(__VA_ARGS__, 0x8);      \
+            break;                         \
+        case 0x9:                          \
+            kernel(__VA_ARGS__, 0x9);      \
+            break;                         \
+        case 0xa:                          \
+            kernel(__VA_ARGS__, 0xa);      \
+            break;                         \
+        case 0xb:                          \
+            kernel(__VA_ARGS__, 0xb);      \
+            break;                         \
+        case 0xc:                          \
+            kernel(__VA_ARGS__, 0xc);      \
+            break;                         \
+        case 0xd:                          \
+            kernel(__VA_ARGS__, 0xd);      \
+            break;                         \
+        case 0xe:                          \
+            kernel(__VA_ARGS__, 0xe);      \
+            break;                         \
+        default:                           \
+            kernel(__VA_ARGS__, 0xf);      \
+            break;                         \
+    }
+
+/*Walks upwards, which is safe for overlapping spans with dst below src.*/
+BLIT_INLINE void
+blit_copy_fwd(uint8_t *dst, const uint8_t *src, int bytes, const int rop)
+{
+    uint64_t s;
+    uint64_t d;
+    int      c = 0;
+
+#ifdef BLIT_SPAN_SSE2
+    for (; (c + 16) <= bytes; c += 16) {
+        __m128i s128 = _mm_loadu_si128((const __m128i *) &src[c]);
+        __m128i d128 = _mm_loadu_si128((const __m128i *) &dst[c]);
+
+        _mm_storeu_si128((__m128i *) &dst[c], blit_rop128(rop, s128, d128));
+    }
+#endif
+    for (; (c + 8) <= bytes; c += 8) {
+        memcpy(&s, &src[c], 8);
+        memcpy(&d, &dst[c], 8);
+        d = blit_rop64(rop, s, d);
+        memcpy(&dst[c], &d, 8);
+    }
+    for (; c < bytes; c++)
+        dst[c] = (uint8_t) blit_rop64(rop, src[c], dst[c]);
+}
+
+/*Walks downwards, for overlapping spans with dst above src.*/
+BLIT_INLINE void
+blit_copy_bwd(uint8_t *dst, const uint8_t *src, int bytes, const int rop)
+{
+    uint64_t s;
+    uint64_t d;
+    int      c = bytes;
+
+#ifdef BLIT_SPAN_SSE2
+    for (; c >= 16; c -= 16) {
+        __m128i s128 = _mm_loadu_si128((const __m128i *) &src[c - 16]);
+        __m128i d128 = _mm_loadu_si128((const __m128i *) &dst[c - 16]);
+
+        _mm_storeu_si128((__m128i *) &dst[c - 16], blit_rop128(rop, s128, d128));
+    }
+#endif
+    for (; c >= 8; c -= 8) {
+        memcpy(&s, &src[c - 8], 8);
+        memcpy(&d, &dst[c - 8], 8);
+        d = blit_rop64(rop, s, d);
+        memcpy(&dst[c - 8], &d, 8);
+    }
+    for (; c > 0; c--)
+        dst[c - 1] = (uint8_t) blit_rop64(rop, src[c - 1], dst[c - 1]);
+}
+
+BLIT_INLINE void
+blit_fill_kernel(uint8_t *dst, const uint8_t *pat, int bytes, const int rop)
+{
+    uint64_t s;
+    uint64_t d;
+    int      c = 0;
+    int      p = 0;
+
+#ifdef BLIT_SPAN_SSE2
+    for (; (c + 16) <= bytes; c += 16) {
+        __m128i s128 = _mm_loadu_si128((const __m128i *) &pat[p]);
+        __m128i d128 = _mm_loadu_si128((const __m128i *) &dst[c]);
+
+        _mm_storeu_si128((__m128i *) &dst[c], blit_rop128(rop, s128, d128));
+        p = (p + 16) % BLIT_PATTERN_SIZE;
+    }
+#endif
+    for (; (c + 8) <= bytes; c += 8) {
+        memcpy(&s, &pat[p], 8);
+        memcpy(&d, &dst[c], 8);
+        d = blit_rop64(rop, s, d);
+        memcpy(&dst[c], &d, 8);
+        p = (p + 8) % BLIT_PATTERN_SIZE;
+    }
+    for (; c < bytes; c++) {
+        dst[c] = (uint8_t) blit_rop64(rop, pat[p], dst[c]);
+        p      = (p + 1) % BLIT_PATTERN_SIZE;
+    }
+}
+
+void
+blit_span_fill(uint8_t *dst, uint32_t col, int count, int bpp, int rop)
+{
+    uint8_t pat[BLIT_PATTERN_SIZE];
+
+    rop &= 0xf;
+    if ((count <= 0) || (rop == BLIT_ROP_DST))
+        return;
+
+    if ((bpp == 1) && !BLIT_ROP_READS_DST(rop)) {
+        memset(dst, (uint8_t) blit_rop64(rop, col, 0), count);
+        return;
+    }
+
+    for (int c = 0; c < BLIT_PATTERN_SIZE; c++)
+        pat[c] = col >> ((c % bpp) << 3);
+
+    BLIT_ROP_SWITCH(rop, blit_fill_kernel, dst, pat, count * bpp)
+}
+
+void
+blit_span_pattern(uint8_t *dst, const uint32_t *cols, int phase, int count, int bpp, int rop)
+{
+    uint8_t pat[BLIT_PATTERN_SIZE];
+
+    rop &= 0xf;
+    if ((count <= 0) || (rop == BLIT_ROP_DST))
+        return;
+
+    for (int c = 0; c < BLIT_PATTERN_SIZE; c++)
+        pat[c] = cols[(phase + (c / bpp)) & 7] >> ((c % bpp) << 3);
+
+    BLIT_ROP_SWITCH(rop, blit_fill_kernel, dst, pat, count * bpp)
+}
+
+void
+blit_span_copy(uint8_t *dst, const uint8_t *src, int bytes, int rop)
+{
+    rop &= 0xf;
+    if ((bytes <= 0) || (rop == BLIT_ROP_DST))
+        return;
+
+    if (rop == BLIT_ROP_SRC)
+        memmove(dst, src, bytes);
+    else if ((dst <= src) || (dst >= (src + bytes))) {
+        BLIT_ROP_SWITCH(rop, blit_copy_fwd, dst, src, bytes)
+    } else {
+        BLIT_ROP_SWITCH(rop, blit_copy_bwd, dst, src, bytes)
+    }
+}
+
+static void
+blit_band_thread(void *param)
+{
+    blit_band_t  *band  = (blit_band_t *) param;
+    blit_bands_t *bands = band->bands;
+
+    while (1) {
+        thread_wait_event(band->wake, -1);
+        thread_reset_event(band->wake);
+        if (!bands->run)
+            break;
+
+        bands->func(bands->priv, band->start, band->end);
+
+        if (atomic_fetch_sub(&bands->pending, 1) == 1)
+            thread_set_event(bands->done);
+    }
+}
+
+/*A thread count of 0 sizes the pool to the host, leaving one core for the
+  CPU thread. Returns NULL when the blitter should stay single-threaded.*/
+blit_bands_t *
+blit_bands_init(int threads)
+{
+    blit_bands_t *bands;
+
+    if (threads <= 0)
+        threads = plat_get_cpu_count() - 1;
+    if (threads > BLIT_MAX_BAND_THREADS)
+        threads = BLIT_MAX_BAND_THREADS;
+    if (threads <= 1)
+        return NULL;
+
+    bands          = (blit_bands_t *) calloc(1, sizeof(blit_bands_t));
+    bands->threads = threads;
+    bands->run     = 1;
+    bands->done    = thread_create_event();
+
+    for (int c = 1; c < threads; c++) {
+        bands->band[c].bands  = bands;
+        bands->band[c].wake   = thread_create_event();
+        bands->band[c].thread = thread_create(blit_band_thread, &bands->band[c]);
+    }
+
+    return bands;
+}
+
+void
+blit_bands_close(blit_bands_t *bands)
+{
+    if (bands == NULL)
+        return;
+
+    bands->run = 0;
+    for (int c = 1; c < bands->threads; c++) {
+        thread_set_event(bands->band[c].wake);
+        thread_wait(bands->band[c].thread);
+        thread_destroy_event(bands->band[c].wake);
+    }
+    thread_destroy_event(bands->done);
+
+    free(bands);
+}
+
+void
+blit_bands_run(blit_bands_t *bands, int rows, blit_band_func_t func, void *priv)
+{
+    int threads;
+    int band_rows;
+
+    if ((bands == NULL) || (rows < (BLIT_BAND_MIN_ROWS * 2))) {
+        func(priv, 0, rows);
+        return;
+    }
+
+    threads = bands->threads;
+    if (threads > (rows / BLIT_BAND_MIN_ROWS))
+        threads = rows / BLIT_BAND_MIN_ROWS;
+    band_rows = (rows + threads - 1) / threads;
+
+    bands->func = func;
+    bands->priv = priv;
+    atomic_store(&bands->pending, threads - 1);
+    thread_reset_event(bands->done);
+
+    for (int c = 1; c < threads; c++) {
+        bands->band[c].start = c * band_rows;
+        bands->band[c].end   = ((c + 1) * band_rows > rows) ? rows : ((c + 1) * band_rows);
+        thread_set_event(bands->band[c].wake);
+    }
+
+    func(priv, 0, band_rows);
+
+    while (atomic_load(&bands->pending))
+        thread_wait_event(bands->done, -1);
+}
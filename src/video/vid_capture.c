@@ -0,0 +1,601 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Asynchronous screenshot and frame capture.
+ *
+ *          The blit thread only copies the visible rectangle into one of
+ *          a small pool of frames; encoding and file I/O happen on a
+ *          background thread. Screenshots wait for a free frame, while
+ *          stream frames are dropped when the pool is exhausted so that
+ *          recording never holds up presentation or the emulation.
+ *
+ *          A stream is written according to the extension of its path:
+ *            .y4m  - YUV4MPEG2 4:2:0; may be a named pipe read by an
+ *                    external encoder
+ *            .raw  - concatenated 32-bit BGRx frames
+ *            other - a directory receiving a numbered PNG sequence
+ */
+#include <stdatomic.h>
+#include <setjmp.h>
+#include <png.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/path.h>
+#include <86box/plat.h>
+#include <86box/plat_unused.h>
+#include <86box/thread.h>
+#include <86box/video.h>
+
+#define CAPTURE_POOL_SIZE 4
+
+enum {
+    CAPTURE_SCREENSHOT = 0,
+    CAPTURE_STREAM
+};
+
+enum {
+    CAPTURE_MODE_PNG = 0,
+    CAPTURE_MODE_RAW,
+    CAPTURE_MODE_Y4M
+};
+
+typedef struct capture_frame_t {
+    struct capture_frame_t *next;
+
+    int       type;
+    int       monitor_index;
+    int       w;
+    int       h;
+    uint32_t  refresh_mhz;
+    size_t    size;
+    uint32_t *data;
+    char      fn[1024];
+} capture_frame_t;
+
+typedef struct capture_stream_t {
+    int      mode;
+    int      monitor_index;
+    int      frame_w;
+    int      frame_h;
+    int      w;
+    int      h;
+    uint32_t frames;
+    uint32_t skipped;
+    FILE    *fp;
+    uint8_t *yuv;
+    char     path[1024];
+} capture_stream_t;
+
+char capture_path[1024] = { '\0' }; /* (O) stream frames here at startup */
+
+static capture_frame_t  capture_pool[CAPTURE_POOL_SIZE];
+static capture_frame_t *capture_free_list;
+static capture_frame_t *capture_queue_head;
+static capture_frame_t *capture_queue_tail;
+static int              capture_busy;
+static volatile int     capture_run;
+
+static capture_stream_t capture_stream;
+static atomic_int       capture_stream_on;
+static atomic_uint      capture_dropped;
+
+static thread_t *capture_thread_h;
+static mutex_t  *capture_mutex;
+static event_t  *capture_wake;
+static event_t  *capture_free;
+static event_t  *capture_idle;
+
+#ifdef ENABLE_CAPTURE_LOG
+int capture_do_log = ENABLE_CAPTURE_LOG;
+
+static void
+capture_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (capture_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define capture_log(fmt, ...)
+#endif
+
+static capture_frame_t *
+capture_get_frame(int wait)
+{
+    capture_frame_t *frame;
+
+    while (1) {
+        thread_wait_mutex(capture_mutex);
+        frame = capture_free_list;
+        if (frame)
+            capture_free_list = frame->next;
+        thread_release_mutex(capture_mutex);
+
+        if (frame || !wait)
+            return frame;
+
+        thread_wait_event(capture_free, 10);
+        thread_reset_event(capture_free);
+    }
+}
+
+static void
+capture_put_frame(capture_frame_t *frame)
+{
+    thread_wait_mutex(capture_mutex);
+    frame->next       = capture_free_list;
+    capture_free_list = frame;
+    thread_release_mutex(capture_mutex);
+
+    thread_set_event(capture_free);
+}
+
+static void
+capture_queue_frame(capture_frame_t *frame)
+{
+    frame->next = NULL;
+
+    thread_wait_mutex(capture_mutex);
+    if (capture_queue_tail)
+        capture_queue_tail->next = frame;
+    else
+        capture_queue_head = frame;
+    capture_queue_tail = frame;
+    thread_release_mutex(capture_mutex);
+
+    thread_set_event(capture_wake);
+}
+
+/* Copy a rectangle of 0x00RRGGBB pixels into a pooled frame, growing its
+   buffer only when a larger mode than any seen before shows up. A NULL
+   source gives a black frame. */
+static int
+capture_fill_frame(capture_frame_t *frame, const uint32_t *buf, int start_x, int start_y, int row_len, int w, int h)
+{
+    size_t size = (size_t) w * h * sizeof(uint32_t);
+
+    if (size > frame->size) {
+        free(frame->data);
+        frame->data = (uint32_t *) malloc(size);
+        if (frame->data == NULL) {
+            frame->size = 0;
+            return 0;
+        }
+        frame->size = size;
+    }
+
+    frame->w = w;
+    frame->h = h;
+
+    if (buf == NULL)
+        memset(frame->data, 0x00, size);
+    else {
+        for (int y = 0; y < h; y++)
+            memcpy(&frame->data[y * w], &buf[((start_y + y) * row_len) + start_x], w * sizeof(uint32_t));
+    }
+
+    return 1;
+}
+
+/* The frame rows are written as they are: libpng drops the padding byte
+   and swaps the channel order of each little-endian 0x00RRGGBB pixel. */
+static void
+capture_write_png(const char *fn, const uint32_t *data, int w, int h)
+{
+    png_structp png_ptr;
+    png_infop   info_ptr;
+    FILE       *fp;
+
+    fp = plat_fopen(fn, "wb");
+    if (!fp) {
+        capture_log("[capture] File %s could not be opened for writing\n", fn);
+        return;
+    }
+
+    png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png_ptr) {
+        capture_log("[capture] png_create_write_struct failed\n");
+        fclose(fp);
+        return;
+    }
+
+    info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr) {
+        capture_log("[capture] png_create_info_struct failed\n");
+        png_destroy_write_struct(&png_ptr, NULL);
+        fclose(fp);
+        return;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        capture_log("[capture] Error writing %s\n", fn);
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(fp);
+        return;
+    }
+
+    png_init_io(png_ptr, fp);
+
+    png_set_IHDR(png_ptr, info_ptr, w, h,
+                 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+
+    png_write_info(png_ptr, info_ptr);
+
+    png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
+    png_set_bgr(png_ptr);
+
+    for (int y = 0; y < h; y++)
+        png_write_row(png_ptr, (png_bytep) &data[y * w]);
+
+    png_write_end(png_ptr, NULL);
+
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(fp);
+}
+
+/* BT.601 limited range, with each chroma sample taken from the average of
+   a 2x2 block; odd edges are cropped, as 4:2:0 requires even sizes. */
+static void
+capture_write_y4m(capture_stream_t *stream, const uint32_t *data, int w)
+{
+    int      cw      = stream->w >> 1;
+    int      ch      = stream->h >> 1;
+    uint8_t *y_plane = stream->yuv;
+    uint8_t *u_plane = y_plane + (stream->w * stream->h);
+    uint8_t *v_plane = u_plane + (cw * ch);
+
+    for (int y = 0; y < stream->h; y++) {
+        const uint32_t *src = &data[y * w];
+
+        for (int x = 0; x < stream->w; x++) {
+            int r = (src[x] >> 16) & 0xff;
+            int g = (src[x] >> 8) & 0xff;
+            int b = src[x] & 0xff;
+
+            *y_plane++ = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        }
+    }
+
+    for (int y = 0; y < ch; y++) {
+        const uint32_t *src0 = &data[(y << 1) * w];
+        const uint32_t *src1 = src0 + w;
+
+        for (int x = 0; x < cw; x++) {
+            uint32_t p[4] = { src0[x << 1], src0[(x << 1) + 1], src1[x << 1], src1[(x << 1) + 1] };
+            int      r    = 0;
+            int      g    = 0;
+            int      b    = 0;
+
+            for (uint8_t i = 0; i < 4; i++) {
+                r += (p[i] >> 16) & 0xff;
+                g += (p[i] >> 8) & 0xff;
+                b += p[i] & 0xff;
+            }
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+
+            *u_plane++ = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            *v_plane++ = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+
+    fputs("FRAME\n", stream->fp);
+    fwrite(stream->yuv, 1, (stream->w * stream->h) + (2 * cw * ch), stream->fp);
+}
+
+static void
+capture_write_stream(capture_frame_t *frame)
+{
+    capture_stream_t *stream = &capture_stream;
+    char              fn[1024];
+
+    /* A stop may race with a frame already taken by the blit thread. */
+    if (!atomic_load(&capture_stream_on))
+        return;
+
+    /* The first frame fixes the stream geometry; frames from any other
+       video mode are counted and skipped. */
+    if (stream->frames == 0) {
+        stream->frame_w = frame->w;
+        stream->frame_h = frame->h;
+        stream->w       = frame->w;
+        stream->h       = frame->h;
+
+        if (stream->mode == CAPTURE_MODE_Y4M) {
+            stream->w &= ~1;
+            stream->h &= ~1;
+            if (stream->yuv == NULL)
+                stream->yuv = (uint8_t *) malloc((stream->w * stream->h * 3) >> 1);
+            if ((stream->yuv == NULL) || (stream->w == 0) || (stream->h == 0)) {
+                free(stream->yuv);
+                stream->yuv = NULL;
+                stream->skipped++;
+                return;
+            }
+            /* The header fixes the rate, so the first frame's one is used
+               for the whole stream. */
+            fprintf(stream->fp, "YUV4MPEG2 W%i H%i F%u:1000 Ip A1:1 C420jpeg\n", stream->w, stream->h,
+                    frame->refresh_mhz ? frame->refresh_mhz : 60000);
+        }
+    } else if ((frame->w != stream->frame_w) || (frame->h != stream->frame_h)) {
+        stream->skipped++;
+        return;
+    }
+
+    switch (stream->mode) {
+        case CAPTURE_MODE_Y4M:
+            capture_write_y4m(stream, frame->data, frame->w);
+            break;
+
+        case CAPTURE_MODE_RAW:
+            fwrite(frame->data, sizeof(uint32_t), (size_t) frame->w * frame->h, stream->fp);
+            break;
+
+        default:
+            snprintf(fn, sizeof(fn), "%sframe_%08u.png", stream->path, stream->frames);
+            capture_write_png(fn, frame->data, frame->w, frame->h);
+            break;
+    }
+
+    stream->frames++;
+}
+
+static void
+capture_thread(UNUSED(void *param))
+{
+    capture_frame_t *frame;
+
+    while (1) {
+        thread_wait_event(capture_wake, -1);
+        thread_reset_event(capture_wake);
+
+        while (1) {
+            thread_wait_mutex(capture_mutex);
+            frame = capture_queue_head;
+            if (frame) {
+                capture_queue_head = frame->next;
+                if (capture_queue_head == NULL)
+                    capture_queue_tail = NULL;
+                capture_busy = 1;
+            }
+            thread_release_mutex(capture_mutex);
+
+            if (frame == NULL)
+                break;
+
+            if (frame->type == CAPTURE_SCREENSHOT)
+                capture_write_png(frame->fn, frame->data, frame->w, frame->h);
+            else
+                capture_write_stream(frame);
+
+            thread_wait_mutex(capture_mutex);
+            capture_busy = 0;
+            thread_release_mutex(capture_mutex);
+
+            capture_put_frame(frame);
+        }
+
+        thread_set_event(capture_idle);
+
+        if (!capture_run)
+            break;
+    }
+}
+
+/* Wait until every queued frame has been written out. */
+void
+video_capture_flush(void)
+{
+    int idle;
+
+    if (capture_thread_h == NULL)
+        return;
+
+    while (1) {
+        thread_wait_mutex(capture_mutex);
+        idle = (capture_queue_head == NULL) && !capture_busy;
+        thread_release_mutex(capture_mutex);
+
+        if (idle)
+            break;
+
+        thread_wait_event(capture_idle, 10);
+        thread_reset_event(capture_idle);
+    }
+}
+
+void
+video_capture_screenshot(const char *fn, const uint32_t *buf, int start_x, int start_y, int row_len, int w, int h, int monitor_index)
+{
+    capture_frame_t *frame;
+
+    if ((capture_thread_h == NULL) || (w <= 0) || (h <= 0))
+        return;
+
+    frame = capture_get_frame(1);
+
+    if (!capture_fill_frame(frame, buf, start_x, start_y, row_len, w, h)) {
+        capture_log("[capture] Unable to allocate a %ix%i frame\n", w, h);
+        capture_put_frame(frame);
+        return;
+    }
+
+    frame->type          = CAPTURE_SCREENSHOT;
+    frame->monitor_index = monitor_index;
+    snprintf(frame->fn, sizeof(frame->fn), "%s", fn);
+
+    capture_queue_frame(frame);
+}
+
+/* Called by the blit thread with the rectangle about to be presented and
+   the guest frame rate in millihertz, or 0 if it is not known yet. */
+void
+video_capture_frame(const uint32_t *buf, int start_x, int start_y, int row_len, int w, int h, uint32_t refresh_mhz, int monitor_index)
+{
+    capture_frame_t *frame;
+
+    if (!atomic_load(&capture_stream_on) || (monitor_index != capture_stream.monitor_index) ||
+        (w <= 0) || (h <= 0))
+        return;
+
+    frame = capture_get_frame(0);
+    if (frame == NULL) {
+        atomic_fetch_add(&capture_dropped, 1);
+        return;
+    }
+
+    if (!capture_fill_frame(frame, buf, start_x, start_y, row_len, w, h)) {
+        atomic_fetch_add(&capture_dropped, 1);
+        capture_put_frame(frame);
+        return;
+    }
+
+    frame->type          = CAPTURE_STREAM;
+    frame->monitor_index = monitor_index;
+    frame->refresh_mhz   = refresh_mhz;
+
+    capture_queue_frame(frame);
+}
+
+int
+video_capture_stream_active(void)
+{
+    return atomic_load(&capture_stream_on);
+}
+
+void
+video_capture_stream_stop(void)
+{
+    capture_stream_t *stream = &capture_stream;
+
+    if (!atomic_load(&capture_stream_on))
+        return;
+
+    /* Let the queued frames through before closing the sink; anything the
+       blit thread slips in after that is discarded by the worker. */
+    video_capture_flush();
+    atomic_store(&capture_stream_on, 0);
+    video_capture_flush();
+
+    if (stream->fp)
+        fclose(stream->fp);
+    free(stream->yuv);
+
+    pclog("Capture: %u frames written to %s, %u dropped, %u skipped after a mode change\n",
+          stream->frames, stream->path, atomic_load(&capture_dropped), stream->skipped);
+
+    memset(stream, 0x00, sizeof(capture_stream_t));
+}
+
+int
+video_capture_stream_start(const char *path, int monitor_index)
+{
+    capture_stream_t *stream = &capture_stream;
+    char             *ext;
+
+    if ((capture_thread_h == NULL) || (path == NULL) || (path[0] == '\0'))
+        return 0;
+
+    video_capture_stream_stop();
+
+    snprintf(stream->path, sizeof(stream->path), "%s", path);
+    stream->monitor_index = monitor_index;
+
+    ext = path_get_extension(stream->path);
+    if (!strcasecmp(ext, "y4m"))
+        stream->mode = CAPTURE_MODE_Y4M;
+    else if (!strcasecmp(ext, "raw"))
+        stream->mode = CAPTURE_MODE_RAW;
+    else
+        stream->mode = CAPTURE_MODE_PNG;
+
+    if (stream->mode == CAPTURE_MODE_PNG) {
+        if (!plat_dir_check(stream->path))
+            plat_dir_create(stream->path);
+        path_slash(stream->path);
+    } else {
+        stream->fp = plat_fopen(stream->path, "wb");
+        if (stream->fp == NULL) {
+            pclog("Capture: unable to open %s for writing\n", stream->path);
+            memset(stream, 0x00, sizeof(capture_stream_t));
+            return 0;
+        }
+    }
+
+    atomic_store(&capture_dropped, 0);
+    atomic_store(&capture_stream_on, 1);
+
+    return 1;
+}
+
+void
+video_capture_init(void)
+{
+    if (capture_thread_h != NULL)
+        return;
+
+    capture_free_list  = NULL;
+    capture_queue_head = NULL;
+    capture_queue_tail = NULL;
+    capture_busy       = 0;
+
+    for (uint8_t i = 0; i < CAPTURE_POOL_SIZE; i++) {
+        capture_pool[i].data = NULL;
+        capture_pool[i].size = 0;
+        capture_pool[i].next = capture_free_list;
+        capture_free_list    = &capture_pool[i];
+    }
+
+    capture_mutex = thread_create_mutex();
+    capture_wake  = thread_create_event();
+    capture_free  = thread_create_event();
+    capture_idle  = thread_create_event();
+
+    capture_run      = 1;
+    capture_thread_h = thread_create(capture_thread, NULL);
+
+    if (capture_path[0] != '\0')
+        video_capture_stream_start(capture_path, 0);
+}
+
+void
+video_capture_close(void)
+{
+    if (capture_thread_h == NULL)
+        return;
+
+    video_capture_stream_stop();
+    video_capture_flush();
+
+    capture_run = 0;
+    thread_set_event(capture_wake);
+    thread_wait(capture_thread_h);
+    capture_thread_h = NULL;
+
+    thread_destroy_event(capture_idle);
+    thread_destroy_event(capture_free);
+    thread_destroy_event(capture_wake);
+    thread_close_mutex(capture_mutex);
+
+    for (uint8_t i = 0; i < CAPTURE_POOL_SIZE; i++) {
+        free(capture_pool[i].data);
+        capture_pool[i].data = NULL;
+        capture_pool[i].size = 0;
+    }
+}
@@ -36,6 +36,7 @@
 #include <86box/vid_ddc.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_blit_span.h>
 
 #define ROM_MILLENNIUM    "roms/video/matrox/matrox2064wr2.BIN"
 #define ROM_MILLENNIUM_II "roms/video/matrox/matrox2164wpc.BIN"
@@ -555,6 +556,9 @@ typedef struct mystique_t {
 
     uint8_t thread_run;
 
+    blit_bands_t *bands;
+    int           blit_rop;
+
     void *i2c, *i2c_ddc, *ddc;
 } mystique_t;
 
@@ -3510,6 +3514,287 @@ blit_idump_read(mystique_t *mystique)
     return ret;
 }
 
+/*Bytes per pixel at the running pixel width, or 0 for widths the span
+  kernels do not handle.*/
+static int
+mystique_bpp(mystique_t *mystique)
+{
+    switch (mystique->maccess_running & MACCESS_PWIDTH_MASK) {
+        case MACCESS_PWIDTH_8:
+            return 1;
+        case MACCESS_PWIDTH_16:
+            return 2;
+        case MACCESS_PWIDTH_24:
+            return 3;
+        case MACCESS_PWIDTH_32:
+            return 4;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+static void
+mystique_mark_span(mystique_t *mystique, uint32_t addr, uint32_t len)
+{
+    svga_t *svga = &mystique->svga;
+
+    for (uint32_t page = addr >> 12; page <= ((addr + len - 1) >> 12); page++)
+        svga->changedvram[page] = changeframecount;
+}
+
+/*Draws count pixels from an 8 pixel colour row, starting at pixel offset
+  dst. Runs that wrap around the end of VRAM are drawn a pixel at a time.*/
+static void
+mystique_pattern_span(mystique_t *mystique, uint32_t dst, const uint32_t *cols, int phase, int count, int rop)
+{
+    svga_t  *svga     = &mystique->svga;
+    int      bpp      = mystique_bpp(mystique);
+    uint32_t dst_addr = (dst * bpp) & mystique->vram_mask;
+
+    if ((dst_addr + (count * bpp)) <= (mystique->vram_mask + 1)) {
+        blit_span_pattern(&svga->vram[dst_addr], cols, phase, count, bpp, rop);
+        mystique_mark_span(mystique, dst_addr, count * bpp);
+        return;
+    }
+
+    for (int x = 0; x < count; x++) {
+        dst_addr = ((dst + x) * bpp) & mystique->vram_mask;
+        blit_span_fill(&svga->vram[dst_addr], cols[(phase + x) & 7], 1, bpp, rop);
+        svga->changedvram[dst_addr >> 12] = changeframecount;
+    }
+}
+
+/*Combines count pixels from pixel offset src into pixel offset dst, both the
+  leftmost of the run. The span kernels are only used where the result does
+  not depend on the order the engine walks the run in x_dir.*/
+static void
+mystique_copy_span(mystique_t *mystique, uint32_t dst, uint32_t src, int count, int x_dir, int rop)
+{
+    svga_t  *svga     = &mystique->svga;
+    int      bpp      = mystique_bpp(mystique);
+    uint32_t len      = count * bpp;
+    uint32_t dst_addr = (dst * bpp) & mystique->vram_mask;
+    uint32_t src_addr = (src * bpp) & mystique->vram_mask;
+    int      x;
+
+    if (((dst_addr + len) <= (mystique->vram_mask + 1)) && ((src_addr + len) <= (mystique->vram_mask + 1)) &&
+        (((dst_addr + len) <= src_addr) || ((src_addr + len) <= dst_addr) || ((x_dir > 0) == (dst_addr <= src_addr)))) {
+        blit_span_copy(&svga->vram[dst_addr], &svga->vram[src_addr], len, rop);
+        mystique_mark_span(mystique, dst_addr, len);
+        return;
+    }
+
+    for (int c = 0; c < count; c++) {
+        x        = (x_dir > 0) ? c : (count - 1 - c);
+        dst_addr = ((dst + x) * bpp) & mystique->vram_mask;
+        src_addr = ((src + x) * bpp) & mystique->vram_mask;
+        blit_span_copy(&svga->vram[dst_addr], &svga->vram[src_addr], bpp, rop);
+        svga->changedvram[dst_addr >> 12] = changeframecount;
+    }
+}
+
+/*Whether rows of width pixels, going up from the pixel offset of the
+  lowest one, stay clear of each other and of the end of VRAM.*/
+static int
+blit_rows_apart(mystique_t *mystique, uint32_t lowest, int x, int width)
+{
+    uint32_t pitch = mystique->dwgreg.pitch & PITCH_MASK;
+
+    return (width <= (int) pitch) &&
+           (((uint64_t) lowest + x + ((uint64_t) mystique->dwgreg.length * pitch) + width) <= ((mystique->vram_mask + 1) / mystique_bpp(mystique)));
+}
+
+/*Draws one row of an opaque trapezoid.*/
+static void
+blit_trap_row(mystique_t *mystique, uint32_t ydst, uint32_t ydst_lin)
+{
+    int16_t  x_l  = mystique->dwgreg.fxleft & 0xffff;
+    int16_t  x_r  = mystique->dwgreg.fxright & 0xffff;
+    int      yoff = (mystique->dwgreg.yoff + ydst) & 7;
+    int      x_start;
+    int      x_end;
+    uint32_t cols[8];
+
+    if ((ydst_lin < mystique->dwgreg.ytop) || (ydst_lin > mystique->dwgreg.ybot))
+        return;
+
+    /*The engine always walks rightwards from fxleft, for as many pixels as
+      the edges are apart.*/
+    x_start = x_l;
+    x_end   = x_l + ((x_l > x_r) ? (x_l - x_r) : (x_r - x_l)) - 1;
+    if (x_start < mystique->dwgreg.cxleft)
+        x_start = mystique->dwgreg.cxleft;
+    if (x_end > mystique->dwgreg.cxright)
+        x_end = mystique->dwgreg.cxright;
+    if (x_end < x_start)
+        return;
+
+    for (int x = 0; x < 8; x++)
+        cols[x] = mystique->dwgreg.pattern[yoff][(mystique->dwgreg.xoff + x) & 15] ? mystique->dwgreg.fcol : mystique->dwgreg.bcol;
+
+    mystique_pattern_span(mystique, ydst_lin + x_start, cols, x_start & 7, (x_end - x_start) + 1, mystique->blit_rop);
+}
+
+static void
+blit_trap_band(void *priv, int start, int end)
+{
+    mystique_t *mystique = (mystique_t *) priv;
+
+    for (int y = start; y < end; y++)
+        blit_trap_row(mystique, (mystique->dwgreg.ydst + y) & 0x7fffff,
+                      mystique->dwgreg.ydst_lin + (y * (mystique->dwgreg.pitch & PITCH_MASK)));
+}
+
+/*Opaque BLK, RPL and RSTR trapezoids go through the span kernels, and
+  rectangles are split into bands across the blitter threads. Returns 0 if
+  blit_trap() has to draw this one a pixel at a time.*/
+static int
+blit_trap_spans(mystique_t *mystique)
+{
+    int err_l = (int32_t) mystique->dwgreg.ar[1];
+    int err_r = (int32_t) mystique->dwgreg.ar[4];
+
+    if ((mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) || !mystique_bpp(mystique))
+        return 0;
+
+    switch (mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) {
+        case DWGCTRL_ATYPE_BLK:
+        case DWGCTRL_ATYPE_RPL:
+            mystique->blit_rop = BLIT_ROP_SRC;
+            break;
+        case DWGCTRL_ATYPE_RSTR:
+            mystique->blit_rop = (mystique->dwgreg.dwgctrl_running & DWGCTRL_BOP_MASK) >> 16;
+            break;
+
+        default:
+            return 0;
+    }
+
+    if (!mystique->dwgreg.ar[0] && !mystique->dwgreg.ar[6] && blit_rows_apart(mystique, mystique->dwgreg.ydst_lin, MAX(mystique->dwgreg.fxleft, 0), abs(mystique->dwgreg.fxright - mystique->dwgreg.fxleft))) {
+        /*Neither edge moves and no two rows share a pixel, so the rows can
+          be drawn in any order.*/
+        blit_bands_run(mystique->bands, mystique->dwgreg.length, blit_trap_band, mystique);
+
+        mystique->dwgreg.ydst = (mystique->dwgreg.ydst + mystique->dwgreg.length) & 0x7fffff;
+        mystique->dwgreg.ydst_lin += mystique->dwgreg.length * (mystique->dwgreg.pitch & PITCH_MASK);
+        mystique->dwgreg.selline = (mystique->dwgreg.selline + mystique->dwgreg.length) & 7;
+        return 1;
+    }
+
+    for (int y = 0; y < mystique->dwgreg.length; y++) {
+        blit_trap_row(mystique, mystique->dwgreg.ydst, mystique->dwgreg.ydst_lin);
+
+        while ((err_l < 0) && mystique->dwgreg.ar[0]) {
+            err_l += mystique->dwgreg.ar[0];
+            mystique->dwgreg.fxleft += (mystique->dwgreg.sgn.sdxl ? -1 : 1);
+        }
+        err_l += mystique->dwgreg.ar[2];
+
+        while ((err_r < 0) && mystique->dwgreg.ar[6]) {
+            err_r += mystique->dwgreg.ar[6];
+            mystique->dwgreg.fxright += (mystique->dwgreg.sgn.sdxr ? -1 : 1);
+        }
+        err_r += mystique->dwgreg.ar[5];
+
+        mystique->dwgreg.ydst++;
+        mystique->dwgreg.ydst &= 0x7fffff;
+        mystique->dwgreg.ydst_lin += (mystique->dwgreg.pitch & PITCH_MASK);
+
+        mystique->dwgreg.selline = (mystique->dwgreg.selline + 1) & 7;
+    }
+
+    return 1;
+}
+
+/*Copies one row of a screen to screen blit. src is the pixel offset of the
+  source for the first pixel the engine visits.*/
+static void
+blit_bitblt_row(mystique_t *mystique, uint32_t ydst_lin, uint32_t src)
+{
+    int     x_dir   = mystique->dwgreg.sgn.scanleft ? -1 : 1;
+    int16_t x_first = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxright : mystique->dwgreg.fxleft;
+    int     x_start = MIN(mystique->dwgreg.fxleft, mystique->dwgreg.fxright);
+    int     x_end   = MAX(mystique->dwgreg.fxleft, mystique->dwgreg.fxright);
+
+    if ((ydst_lin < mystique->dwgreg.ytop) || (ydst_lin > mystique->dwgreg.ybot))
+        return;
+
+    if (x_start < mystique->dwgreg.cxleft)
+        x_start = mystique->dwgreg.cxleft;
+    if (x_end > mystique->dwgreg.cxright)
+        x_end = mystique->dwgreg.cxright;
+    if (x_end < x_start)
+        return;
+
+    mystique_copy_span(mystique, ydst_lin + x_start, src + (x_start - x_first), (x_end - x_start) + 1, x_dir, mystique->blit_rop);
+}
+
+static uint32_t
+blit_bitblt_ydst_lin(mystique_t *mystique, int y)
+{
+    if (mystique->dwgreg.sgn.sdy)
+        return mystique->dwgreg.ydst_lin - (y * (mystique->dwgreg.pitch & PITCH_MASK));
+
+    return mystique->dwgreg.ydst_lin + (y * (mystique->dwgreg.pitch & PITCH_MASK));
+}
+
+static void
+blit_bitblt_band(void *priv, int start, int end)
+{
+    mystique_t *mystique = (mystique_t *) priv;
+
+    for (int y = start; y < end; y++)
+        blit_bitblt_row(mystique, blit_bitblt_ydst_lin(mystique, y), mystique->dwgreg.ar[3] + (y * mystique->dwgreg.ar[5]));
+}
+
+/*Opaque screen to screen copies, whose source rows are as wide as the
+  destination, go through the span kernels. Returns 0 if the caller has to
+  copy this one a pixel at a time.*/
+static int
+blit_bitblt_spans(mystique_t *mystique, int rop)
+{
+    int16_t x_first = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxright : mystique->dwgreg.fxleft;
+    int16_t x_last  = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxleft : mystique->dwgreg.fxright;
+    int     x_dir   = mystique->dwgreg.sgn.scanleft ? -1 : 1;
+    int     length  = mystique->dwgreg.length;
+    int64_t pixels;
+    int64_t src_lo;
+    int64_t src_hi;
+    int64_t dst_lo;
+    int64_t dst_hi;
+
+    if (!mystique_bpp(mystique) || !length || ((int32_t) (mystique->dwgreg.ar[0] - mystique->dwgreg.ar[3]) != (x_last - x_first)) ||
+        (((x_last - x_first) * x_dir) < 0))
+        return 0;
+
+    mystique->blit_rop = rop;
+
+    /*Rows may only go in parallel if the source and destination rectangles
+      are apart and neither wraps around VRAM.*/
+    pixels = (mystique->vram_mask + 1) / mystique_bpp(mystique);
+    src_lo = MIN((int64_t) mystique->dwgreg.ar[3], (int64_t) mystique->dwgreg.ar[3] + ((int64_t) (length - 1) * (int32_t) mystique->dwgreg.ar[5]));
+    src_hi = MAX((int64_t) mystique->dwgreg.ar[3], (int64_t) mystique->dwgreg.ar[3] + ((int64_t) (length - 1) * (int32_t) mystique->dwgreg.ar[5]));
+    src_lo += MIN(x_last - x_first, 0);
+    src_hi += MAX(x_last - x_first, 0);
+    dst_lo = MIN((int64_t) mystique->dwgreg.ydst_lin, (int64_t) blit_bitblt_ydst_lin(mystique, length - 1)) + MIN(x_first, x_last);
+    dst_hi = MAX((int64_t) mystique->dwgreg.ydst_lin, (int64_t) blit_bitblt_ydst_lin(mystique, length - 1)) + MAX(x_first, x_last);
+
+    if ((src_lo >= 0) && (src_hi < pixels) && (dst_lo >= 0) && (dst_hi < pixels) && ((src_hi < dst_lo) || (dst_hi < src_lo)) &&
+        blit_rows_apart(mystique, MIN(mystique->dwgreg.ydst_lin, blit_bitblt_ydst_lin(mystique, length - 1)), MIN(x_first, x_last), abs(x_last - x_first) + 1))
+        blit_bands_run(mystique->bands, length, blit_bitblt_band, mystique);
+    else
+        blit_bitblt_band(mystique, 0, length);
+
+    mystique->dwgreg.ar[0] += length * mystique->dwgreg.ar[5];
+    mystique->dwgreg.ar[3] += length * mystique->dwgreg.ar[5];
+    mystique->dwgreg.ydst_lin = blit_bitblt_ydst_lin(mystique, length);
+
+    return 1;
+}
+
 static void
 blit_fbitblt(mystique_t *mystique)
 {
@@ -3519,6 +3804,11 @@ blit_fbitblt(mystique_t *mystique)
     int16_t  x_start = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxright : mystique->dwgreg.fxleft;
     int16_t  x_end   = mystique->dwgreg.sgn.scanleft ? mystique->dwgreg.fxleft : mystique->dwgreg.fxright;
 
+    if (blit_bitblt_spans(mystique, BLIT_ROP_SRC)) {
+        mystique->blitter_complete_refcount++;
+        return;
+    }
+
     src_addr = mystique->dwgreg.ar[3];
 
     for (uint16_t y = 0; y < mystique->dwgreg.length; y++) {
@@ -4685,6 +4975,11 @@ blit_trap(mystique_t *mystique)
     int       err_r = (int32_t)mystique->dwgreg.ar[4];
     const int trans_sel = (mystique->dwgreg.dwgctrl_running & DWGCTRL_TRANS_MASK) >> DWGCTRL_TRANS_SHIFT;
 
+    if (blit_trap_spans(mystique)) {
+        mystique->blitter_complete_refcount++;
+        return;
+    }
+
     switch (mystique->dwgreg.dwgctrl_running & DWGCTRL_ATYPE_MASK) {
         case DWGCTRL_ATYPE_BLK:
         case DWGCTRL_ATYPE_RPL:
@@ -5604,6 +5899,12 @@ blit_bitblt(mystique_t *mystique)
                 break;
             }
         case DWGCTRL_ATYPE_RSTR:
+            if (!(mystique->dwgreg.dwgctrl_running & (DWGCTRL_TRANS_MASK | DWGCTRL_PATTERN | DWGCTRL_TRANSC)) &&
+                (((mystique->dwgreg.dwgctrl_running & DWGCTRL_BLTMOD_MASK) == DWGCTRL_BLTMOD_BFCOL) ||
+                 ((mystique->dwgreg.dwgctrl_running & DWGCTRL_BLTMOD_MASK) == DWGCTRL_BLTMOD_BU32RGB)) &&
+                blit_bitblt_spans(mystique, (mystique->dwgreg.dwgctrl_running & DWGCTRL_BOP_MASK) >> 16))
+                break;
+
             switch (mystique->dwgreg.dwgctrl_running & DWGCTRL_BLTMOD_MASK) {
                 /* TODO: This isn't exactly perfect. */
                 case DWGCTRL_BLTMOD_BPLAN:
@@ -6756,6 +7057,7 @@ mystique_init(const device_t *info)
     mystique->thread_run          = 1;
     mystique->fifo_thread         = thread_create(fifo_thread, mystique);
     mystique->dma.lock            = thread_create_mutex();
+    mystique->bands               = blit_bands_init(device_get_config_int("blit_threads"));
 
     timer_add(&mystique->wake_timer, mystique_wake_timer, (void *) mystique, 0);
     timer_add(&mystique->softrap_pending_timer, mystique_softrap_pending_timer, (void *) mystique, 1);
@@ -6787,6 +7089,7 @@ mystique_close(void *priv)
     thread_destroy_event(mystique->wake_fifo_thread);
     thread_destroy_event(mystique->fifo_not_full_event);
     thread_close_mutex(mystique->dma.lock);
+    blit_bands_close(mystique->bands);
 
     svga_close(&mystique->svga);
 
@@ -6868,6 +7171,35 @@ static const device_config_t mystique_config[] = {
         },
         .default_int = 8
     },
+    {
+        .name = "blit_threads",
+        .description = "Blitter threads",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            { .description = "" }
+        },
+        .default_int = 1
+    },
     { .type = CONFIG_END }
   // clang-format on
 };
@@ -6895,6 +7227,35 @@ static const device_config_t millennium_ii_config[] = {
         },
         .default_int = 8
     },
+    {
+        .name = "blit_threads",
+        .description = "Blitter threads",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            { .description = "" }
+        },
+        .default_int = 1
+    },
     { .type = CONFIG_END }
   // clang-format on
 };
@@ -50,7 +50,8 @@
     #undef CLAMP
 #endif
 
-static uint64_t virge_time = 0;
+/* Time spent in the FIFO and render threads, added to by all of them. */
+static atomic_uint_fast64_t virge_time = 0;
 
 static int dither[4][4] = {
     {0, 4, 1, 5},
@@ -74,9 +75,18 @@ static int dither[4][4] = {
 #define RB_SIZE 256
 #define RB_MASK (RB_SIZE - 1)
 
-#define RB_ENTRIES (virge->s3d_write_idx - virge->s3d_read_idx)
-#define RB_FULL (RB_ENTRIES == RB_SIZE)
-#define RB_EMPTY (!RB_ENTRIES)
+#define RB_ENTRIES(t) (virge->s3d_write_idx - (t)->read_idx)
+#define RB_EMPTY(t) (!RB_ENTRIES(t))
+
+/*Render threads each own a set of horizontal tiles, VIRGE_TILE_HEIGHT lines
+  high, dealt out round-robin. Every thread walks the whole triangle ring in
+  order and only draws the lines it owns, so depth and colour ordering within
+  a tile is the same as with a single thread.*/
+#define VIRGE_MAX_RENDER_THREADS 8
+#define VIRGE_TILE_SHIFT         3
+#define VIRGE_TILE_HEIGHT        (1 << VIRGE_TILE_SHIFT)
+#define VIRGE_TILE_ROWS          (2048 >> VIRGE_TILE_SHIFT)
+#define VIRGE_TILE_OWNER(y)      (virge->tile_owner[((y) >> VIRGE_TILE_SHIFT) & (VIRGE_TILE_ROWS - 1)])
 
 #define FIFO_SIZE 65536
 #define FIFO_MASK (FIFO_SIZE - 1)
@@ -188,6 +198,15 @@ typedef struct s3d_t {
     uint8_t       fog_b;
 } s3d_t;
 
+typedef struct virge_render_thread_t {
+    struct virge_t *virge;
+    int             index;
+    thread_t *      thread;
+    event_t *       wake;
+    atomic_int      read_idx;
+    atomic_int      busy;
+} virge_render_thread_t;
+
 typedef struct virge_t {
     mem_mapping_t linear_mapping;
     mem_mapping_t mmio_mapping;
@@ -217,13 +236,14 @@ typedef struct virge_t {
     int           dithering_enabled;
     int           memory_size;
 
-    int           pixel_count;
+    atomic_int    pixel_count;
     int           tri_count;
 
-    thread_t *    render_thread;
-    event_t *     wake_render_thread;
-    event_t *     wake_main_thread;
-    event_t *     not_full_event;
+    int                   render_threads;
+    virge_render_thread_t render_thread_data[VIRGE_MAX_RENDER_THREADS];
+    uint8_t               tile_owner[VIRGE_TILE_ROWS];
+    event_t *             wake_main_thread;
+    event_t *             not_full_event;
 
     uint32_t      hwc_fg_col;
     uint32_t      hwc_bg_col;
@@ -288,9 +308,7 @@ typedef struct virge_t {
     s3d_t        s3d_tri;
 
     s3d_t        s3d_buffer[RB_SIZE];
-    atomic_int   s3d_read_idx;
     atomic_int   s3d_write_idx;
-    atomic_int   s3d_busy;
 
     struct {
         uint32_t pri_ctrl;
@@ -383,6 +401,19 @@ wake_fifo_thread(virge_t *virge) {
     thread_set_event(virge->wake_fifo_thread);
 }
 
+/* The 3D engine is busy while any render thread still has triangles to
+   draw. */
+static __inline int
+s3_virge_3d_busy(virge_t *virge)
+{
+    for (int c = 0; c < virge->render_threads; c++) {
+        if (virge->render_thread_data[c].busy || !RB_EMPTY(&virge->render_thread_data[c]))
+            return 1;
+    }
+
+    return 0;
+}
+
 static virge_t         *reset_state = NULL;
 
 static video_timings_t timing_diamond_stealth3d_2000_pci = { .type = VIDEO_PCI, .write_b = 2, .write_w = 2, .write_l = 3, .read_b = 28, .read_w = 28, .read_l = 45 };
@@ -1128,7 +1159,7 @@ s3_virge_mmio_read(uint32_t addr, void *priv)
             return ret;
         case 0x8505:
             ret = 0xc0;
-            if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+            if (s3_virge_3d_busy(virge) || virge->virge_busy || !FIFO_EMPTY)
                 ret |= 0x10;
             else
                 ret |= 0x30;
@@ -1173,7 +1204,7 @@ s3_virge_mmio_read_w(uint32_t addr, void *priv)
     switch (addr & 0xfffe) {
         case 0x8504:
             ret = 0xc000;
-            if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+            if (s3_virge_3d_busy(virge) || virge->virge_busy || !FIFO_EMPTY)
                 ret |= 0x1000;
             else
                 ret |= 0x3000;
@@ -1272,7 +1303,7 @@ s3_virge_mmio_read_l(uint32_t addr, void *priv) {
 
         case 0x8504:
             ret = 0x0000c000;
-            if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+            if (s3_virge_3d_busy(virge) || virge->virge_busy || !FIFO_EMPTY)
                 ret |= 0x00001000;
             else
                 ret |= 0x00003000;
@@ -1788,7 +1819,7 @@ fifo_thread(void *param)
                  thread_set_event(virge->fifo_not_full_event);
 
              end_time = plat_timer_read();
-             virge_time += end_time - start_time;
+             atomic_fetch_add_explicit(&virge_time, end_time - start_time, memory_order_relaxed);
          }
          virge->virge_busy = 0;
          virge->subsys_stat |= (INT_FIFO_EMP | INT_3DF_EMP);
@@ -2578,9 +2609,9 @@ skip_line:
         g = (val & 0xff00) >> 8;                            \
         r = (val & 0xff0000) >> 16
 
-#define RGB15(r, g, b, dest)                                \
+#define RGB15(r, g, b, dest, dither_x, dither_y)            \
         if (virge->dithering_enabled) {                     \
-                int add = dither[_y & 3][_x & 3];           \
+                int add = dither[(dither_y) & 3][(dither_x) & 3]; \
                 int _r = (r > 248) ? 248 : r + add;         \
                 int _g = (g > 248) ? 248 : g + add;         \
                 int _b = (b > 248) ? 248 : b + add;         \
@@ -2598,6 +2629,8 @@ typedef struct rgba_t {
     int r, g, b, a;
 } rgba_t;
 
+struct s3d_texture_state_t;
+
 typedef struct s3d_state_t {
     int32_t   r;
     int32_t   g;
@@ -2635,6 +2668,12 @@ typedef struct s3d_state_t {
     int       y;
 
     rgba_t    dest_rgba;
+
+    /*Picked per triangle; kept here rather than in globals so that several
+      render threads can draw at once.*/
+    void (*tex_read)(struct s3d_state_t *state, struct s3d_texture_state_t *texture_state, rgba_t *out);
+    void (*tex_sample)(struct s3d_state_t *state);
+    void (*dest_pixel)(struct s3d_state_t *state);
 } s3d_state_t;
 
 typedef struct s3d_texture_state_t {
@@ -2645,16 +2684,9 @@ typedef struct s3d_texture_state_t {
     int32_t   v;
 } s3d_texture_state_t;
 
-static void (*tex_read)(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out);
-static void (*tex_sample)(s3d_state_t *state);
-static void (*dest_pixel)(s3d_state_t *state);
-
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-static int _x;
-static int _y;
-
 static void
 tex_ARGB1555(s3d_state_t *state, s3d_texture_state_t *texture_state, rgba_t *out) {
     int offset = ((texture_state->u & 0x7fc0000) >> texture_state->texture_shift) +
@@ -2745,7 +2777,7 @@ tex_sample_normal(s3d_state_t *state) {
     texture_state.u = state->u + state->tbu;
     texture_state.v = state->v + state->tbv;
 
-    tex_read(state, &texture_state, &state->dest_rgba);
+    state->tex_read(state, &texture_state, &state->dest_rgba);
 }
 
 static void
@@ -2763,21 +2795,21 @@ tex_sample_normal_filter(s3d_state_t *state) {
 
     texture_state.u = state->u + state->tbu;
     texture_state.v = state->v + state->tbv;
-    tex_read(state, &texture_state, &tex_samples[0]);
+    state->tex_read(state, &texture_state, &tex_samples[0]);
     du = (texture_state.u >> (texture_state.texture_shift - 8)) & 0xff;
     dv = (texture_state.v >> (texture_state.texture_shift - 8)) & 0xff;
 
     texture_state.u = state->u + state->tbu + tex_offset;
     texture_state.v = state->v + state->tbv;
-    tex_read(state, &texture_state, &tex_samples[1]);
+    state->tex_read(state, &texture_state, &tex_samples[1]);
 
     texture_state.u = state->u + state->tbu;
     texture_state.v = state->v + state->tbv + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[2]);
+    state->tex_read(state, &texture_state, &tex_samples[2]);
 
     texture_state.u = state->u + state->tbu + tex_offset;
     texture_state.v = state->v + state->tbv + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[3]);
+    state->tex_read(state, &texture_state, &tex_samples[3]);
 
     d[0] = (256 - du) * (256 - dv);
     d[1] = du * (256 - dv);
@@ -2805,7 +2837,7 @@ tex_sample_mipmap(s3d_state_t *state) {
     texture_state.u = state->u + state->tbu;
     texture_state.v = state->v + state->tbv;
 
-    tex_read(state, &texture_state, &state->dest_rgba);
+    state->tex_read(state, &texture_state, &state->dest_rgba);
 }
 
 static void
@@ -2825,21 +2857,21 @@ tex_sample_mipmap_filter(s3d_state_t *state) {
 
     texture_state.u = state->u + state->tbu;
     texture_state.v = state->v + state->tbv;
-    tex_read(state, &texture_state, &tex_samples[0]);
+    state->tex_read(state, &texture_state, &tex_samples[0]);
     du = (texture_state.u >> (texture_state.texture_shift - 8)) & 0xff;
     dv = (texture_state.v >> (texture_state.texture_shift - 8)) & 0xff;
 
     texture_state.u = state->u + state->tbu + tex_offset;
     texture_state.v = state->v + state->tbv;
-    tex_read(state, &texture_state, &tex_samples[1]);
+    state->tex_read(state, &texture_state, &tex_samples[1]);
 
     texture_state.u = state->u + state->tbu;
     texture_state.v = state->v + state->tbv + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[2]);
+    state->tex_read(state, &texture_state, &tex_samples[2]);
 
     texture_state.u = state->u + state->tbu + tex_offset;
     texture_state.v = state->v + state->tbv + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[3]);
+    state->tex_read(state, &texture_state, &tex_samples[3]);
 
     d[0] = (256 - du) * (256 - dv);
     d[1] = du * (256 - dv);
@@ -2869,7 +2901,7 @@ tex_sample_persp_normal(s3d_state_t *state) {
     texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (12 + state->max_d)) + state->tbu;
     texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (12 + state->max_d)) + state->tbv;
 
-    tex_read(state, &texture_state, &state->dest_rgba);
+    state->tex_read(state, &texture_state, &state->dest_rgba);
 }
 
 static void
@@ -2896,21 +2928,21 @@ tex_sample_persp_normal_filter(s3d_state_t *state) {
 
     texture_state.u = u;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[0]);
+    state->tex_read(state, &texture_state, &tex_samples[0]);
     du = (u >> (texture_state.texture_shift - 8)) & 0xff;
     dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
 
     texture_state.u = u + tex_offset;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[1]);
+    state->tex_read(state, &texture_state, &tex_samples[1]);
 
     texture_state.u = u;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[2]);
+    state->tex_read(state, &texture_state, &tex_samples[2]);
 
     texture_state.u = u + tex_offset;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[3]);
+    state->tex_read(state, &texture_state, &tex_samples[3]);
 
     d[0] = (256 - du) * (256 - dv);
     d[1] = du * (256 - dv);
@@ -2940,7 +2972,7 @@ tex_sample_persp_normal_375(s3d_state_t *state) {
     texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (8 + state->max_d)) + state->tbu;
     texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (8 + state->max_d)) + state->tbv;
 
-    tex_read(state, &texture_state, &state->dest_rgba);
+    state->tex_read(state, &texture_state, &state->dest_rgba);
 }
 
 static void
@@ -2967,21 +2999,21 @@ tex_sample_persp_normal_filter_375(s3d_state_t *state) {
 
     texture_state.u = u;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[0]);
+    state->tex_read(state, &texture_state, &tex_samples[0]);
     du = (u >> (texture_state.texture_shift - 8)) & 0xff;
     dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
 
     texture_state.u = u + tex_offset;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[1]);
+    state->tex_read(state, &texture_state, &tex_samples[1]);
 
     texture_state.u = u;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[2]);
+    state->tex_read(state, &texture_state, &tex_samples[2]);
 
     texture_state.u = u + tex_offset;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[3]);
+    state->tex_read(state, &texture_state, &tex_samples[3]);
 
     d[0] = (256 - du) * (256 - dv);
     d[1] = du * (256 - dv);
@@ -3013,7 +3045,7 @@ tex_sample_persp_mipmap(s3d_state_t *state) {
     texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (12 + state->max_d)) + state->tbu;
     texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (12 + state->max_d)) + state->tbv;
 
-    tex_read(state, &texture_state, &state->dest_rgba);
+    state->tex_read(state, &texture_state, &state->dest_rgba);
 }
 
 static void
@@ -3042,21 +3074,21 @@ tex_sample_persp_mipmap_filter(s3d_state_t *state) {
 
     texture_state.u = u;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[0]);
+    state->tex_read(state, &texture_state, &tex_samples[0]);
     du = (u >> (texture_state.texture_shift - 8)) & 0xff;
     dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
 
     texture_state.u = u + tex_offset;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[1]);
+    state->tex_read(state, &texture_state, &tex_samples[1]);
 
     texture_state.u = u;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[2]);
+    state->tex_read(state, &texture_state, &tex_samples[2]);
 
     texture_state.u = u + tex_offset;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[3]);
+    state->tex_read(state, &texture_state, &tex_samples[3]);
 
     d[0] = (256 - du) * (256 - dv);
     d[1] = du * (256 - dv);
@@ -3088,7 +3120,7 @@ tex_sample_persp_mipmap_375(s3d_state_t *state) {
     texture_state.u = (int32_t)(((int64_t)state->u * (int64_t)w) >> (8 + state->max_d)) + state->tbu;
     texture_state.v = (int32_t)(((int64_t)state->v * (int64_t)w) >> (8 + state->max_d)) + state->tbv;
 
-    tex_read(state, &texture_state, &state->dest_rgba);
+    state->tex_read(state, &texture_state, &state->dest_rgba);
 }
 
 static void
@@ -3117,21 +3149,21 @@ tex_sample_persp_mipmap_filter_375(s3d_state_t *state) {
 
     texture_state.u = u;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[0]);
+    state->tex_read(state, &texture_state, &tex_samples[0]);
     du = (u >> (texture_state.texture_shift - 8)) & 0xff;
     dv = (v >> (texture_state.texture_shift - 8)) & 0xff;
 
     texture_state.u = u + tex_offset;
     texture_state.v = v;
-    tex_read(state, &texture_state, &tex_samples[1]);
+    state->tex_read(state, &texture_state, &tex_samples[1]);
 
     texture_state.u = u;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[2]);
+    state->tex_read(state, &texture_state, &tex_samples[2]);
 
     texture_state.u = u + tex_offset;
     texture_state.v = v + tex_offset;
-    tex_read(state, &texture_state, &tex_samples[3]);
+    state->tex_read(state, &texture_state, &tex_samples[3]);
 
     d[0] = (256 - du) * (256 - dv);
     d[1] = du * (256 - dv);
@@ -3197,7 +3229,7 @@ dest_pixel_gouraud_shaded_triangle(s3d_state_t *state) {
 
 static void
 dest_pixel_unlit_texture_triangle(s3d_state_t *state) {
-    tex_sample(state);
+    state->tex_sample(state);
 
     if (state->cmd_set & CMD_SET_ABC_SRC)
         state->dest_rgba.a = state->a >> 7;
@@ -3205,7 +3237,7 @@ dest_pixel_unlit_texture_triangle(s3d_state_t *state) {
 
 static void
 dest_pixel_lit_texture_decal(s3d_state_t *state) {
-    tex_sample(state);
+    state->tex_sample(state);
 
     if (state->cmd_set & CMD_SET_ABC_SRC)
         state->dest_rgba.a = state->a >> 7;
@@ -3213,7 +3245,7 @@ dest_pixel_lit_texture_decal(s3d_state_t *state) {
 
 static void
 dest_pixel_lit_texture_reflection(s3d_state_t *state) {
-    tex_sample(state);
+    state->tex_sample(state);
 
     state->dest_rgba.r += (state->r >> 7);
     state->dest_rgba.g += (state->g >> 7);
@@ -3231,7 +3263,7 @@ dest_pixel_lit_texture_modulate(s3d_state_t *state) {
     int b = state->b >> 7;
     int a = state->a >> 7;
 
-    tex_sample(state);
+    state->tex_sample(state);
 
     CLAMP_RGBA(r, g, b, a);
 
@@ -3243,11 +3275,156 @@ dest_pixel_lit_texture_modulate(s3d_state_t *state) {
         state->dest_rgba.a = a;
 }
 
+#if defined(_MSC_VER)
+#    define VIRGE_SPAN_INLINE __forceinline
+#else
+#    define VIRGE_SPAN_INLINE __attribute__((always_inline)) inline
+#endif
+
+typedef int (*tri_span_t)(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, int x_dir,
+                          uint32_t dest_addr, uint32_t z_addr, uint32_t z);
+
+/*Draws one span and returns the number of pixels stepped over. Every span
+  function below instantiates this with constant bpp, Z, fog and blend
+  arguments, so the per-pixel tests on them are compiled out.*/
+static VIRGE_SPAN_INLINE int
+tri_span(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int x, int xe, int x_dir,
+         uint32_t dest_addr, uint32_t z_addr, uint32_t z,
+         const int bpp, const int use_z, const int fog, const int blend)
+{
+    uint8_t *vram      = virge->svga.vram;
+    int      x_offset  = x_dir * (bpp + 1);
+    int      xz_offset = x_dir << 1;
+    int      count     = 0;
+
+    for (; x != xe; x = (x + x_dir) & 0xfff) {
+        int      update = 1;
+        uint16_t src_z  = 0;
+
+        if (use_z) {
+            src_z = Z_READ(z_addr);
+            Z_CLIP(src_z, z >> 16);
+        }
+
+        if (update) {
+            uint32_t dest_col;
+
+            state->dest_pixel(state);
+
+            if (fog) {
+                int a              = state->a >> 7;
+                state->dest_rgba.r = ((state->dest_rgba.r * a) + (s3d_tri->fog_r * (255 - a))) / 255;
+                state->dest_rgba.g = ((state->dest_rgba.g * a) + (s3d_tri->fog_g * (255 - a))) / 255;
+                state->dest_rgba.b = ((state->dest_rgba.b * a) + (s3d_tri->fog_b * (255 - a))) / 255;
+            }
+
+            if (blend) {
+                uint32_t src_col;
+                int      src_r = 0;
+                uint32_t src_g = 0;
+                uint32_t src_b = 0;
+
+                switch (bpp) {
+                    case 0: /*8 bpp*/
+                        /*Not implemented yet*/
+                        break;
+                    case 1: /*16 bpp*/
+                        src_col = *(uint16_t *)&vram[dest_addr & virge->vram_mask];
+                        RGB15_TO_24(src_col, src_r, src_g, src_b);
+                        break;
+                    case 2: /*24 bpp*/
+                        src_col = (*(uint32_t *)&vram[dest_addr & virge->vram_mask]) & 0xffffff;
+                        RGB24_TO_24(src_col, src_r, src_g, src_b);
+                        break;
+                }
+
+                state->dest_rgba.r = ((state->dest_rgba.r * state->dest_rgba.a) +
+                                      (src_r * (255 - state->dest_rgba.a))) / 255;
+                state->dest_rgba.g = ((state->dest_rgba.g * state->dest_rgba.a) +
+                                      (src_g * (255 - state->dest_rgba.a))) / 255;
+                state->dest_rgba.b = ((state->dest_rgba.b * state->dest_rgba.a) +
+                                      (src_b * (255 - state->dest_rgba.a))) / 255;
+            }
+
+            switch (bpp) {
+                case 0: /*8 bpp*/
+                    /*Not implemented yet*/
+                    break;
+                case 1: /*16 bpp*/
+                    RGB15(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, dest_col, x, state->y);
+                    *(uint16_t *)&vram[dest_addr] = dest_col;
+                    break;
+                case 2: /*24 bpp*/
+                    dest_col = RGB24(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b);
+                    *(uint8_t *)&vram[dest_addr] = dest_col & 0xff;
+                    *(uint8_t *)&vram[dest_addr + 1] = (dest_col >> 8) & 0xff;
+                    *(uint8_t *)&vram[dest_addr + 2] = (dest_col >> 16) & 0xff;
+                    break;
+            }
+
+            if (use_z && (s3d_tri->cmd_set & CMD_SET_ZUP))
+                Z_WRITE(z_addr, src_z);
+        }
+
+        z         += s3d_tri->TdZdX;
+        state->u  += s3d_tri->TdUdX;
+        state->v  += s3d_tri->TdVdX;
+        state->r  += s3d_tri->TdRdX;
+        state->g  += s3d_tri->TdGdX;
+        state->b  += s3d_tri->TdBdX;
+        state->a  += s3d_tri->TdAdX;
+        state->d  += s3d_tri->TdDdX;
+        state->w  += s3d_tri->TdWdX;
+        dest_addr += x_offset;
+        z_addr    += xz_offset;
+        count++;
+    }
+
+    return count;
+}
+
+#define TRI_SPAN(bpp, use_z, fog, blend)                                                                     \
+    static int                                                                                               \
+    tri_span_##bpp##_##use_z##_##fog##_##blend(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state,           \
+                                               int x, int xe, int x_dir,                                     \
+                                               uint32_t dest_addr, uint32_t z_addr, uint32_t z)              \
+    {                                                                                                        \
+        return tri_span(virge, s3d_tri, state, x, xe, x_dir, dest_addr, z_addr, z, bpp, use_z, fog, blend); \
+    }
+
+#define TRI_SPANS(bpp)         \
+    TRI_SPAN(bpp, 0, 0, 0)     \
+    TRI_SPAN(bpp, 0, 0, 1)     \
+    TRI_SPAN(bpp, 0, 1, 0)     \
+    TRI_SPAN(bpp, 0, 1, 1)     \
+    TRI_SPAN(bpp, 1, 0, 0)     \
+    TRI_SPAN(bpp, 1, 0, 1)     \
+    TRI_SPAN(bpp, 1, 1, 0)     \
+    TRI_SPAN(bpp, 1, 1, 1)
+
+TRI_SPANS(0)
+TRI_SPANS(1)
+TRI_SPANS(2)
+
+#define TRI_SPAN_TABLE(bpp)                                                  \
+    {                                                                        \
+        { { tri_span_##bpp##_0_0_0, tri_span_##bpp##_0_0_1 },               \
+          { tri_span_##bpp##_0_1_0, tri_span_##bpp##_0_1_1 } },             \
+        { { tri_span_##bpp##_1_0_0, tri_span_##bpp##_1_0_1 },               \
+          { tri_span_##bpp##_1_1_0, tri_span_##bpp##_1_1_1 } }              \
+    }
+
+/*Indexed by [bpp][Z buffer][fog][alpha blend].*/
+static const tri_span_t tri_spans[3][2][2][2] = {
+    TRI_SPAN_TABLE(0),
+    TRI_SPAN_TABLE(1),
+    TRI_SPAN_TABLE(2)
+};
+
 static void
-tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int32_t dx1, int32_t dx2) {
-    uint8_t  *vram    = virge->svga.vram;
+tri(virge_t *virge, virge_render_thread_t *thread, s3d_t *s3d_tri, s3d_state_t *state, tri_span_t span,
+    int yc, int32_t dx1, int32_t dx2) {
     int       x_dir   = s3d_tri->tlr ? 1 : -1;
-    int       use_z   = !(s3d_tri->cmd_set & CMD_SET_ZB_MODE);
     int       y_count = yc;
     int       bpp     = (s3d_tri->cmd_set >> 2) & 7;
     uint32_t  dest_offset;
@@ -3286,9 +3463,16 @@ tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int32_t dx1, int
     }
 
     for (; y_count > 0; y_count--) {
-         int      x  = (state->x1 + ((1 << 20) - 1)) >> 20;
-         int      xe = (state->x2 + ((1 << 20) - 1)) >> 20;
-         uint32_t z  = (state->base_z > 0) ? (state->base_z << 1) : 0;
+         int      x;
+         int      xe;
+         uint32_t z;
+
+         if (VIRGE_TILE_OWNER(state->y) != thread->index)
+             goto tri_skip_line;
+
+         x  = (state->x1 + ((1 << 20) - 1)) >> 20;
+         xe = (state->x2 + ((1 << 20) - 1)) >> 20;
+         z  = (state->base_z > 0) ? (state->base_z << 1) : 0;
 
          if (x_dir < 0) {
              x--;
@@ -3300,8 +3484,6 @@ tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int32_t dx1, int
              uint32_t z_addr;
              int      dx        = (x_dir > 0) ? ((31 - ((state->x1 - 1) >> 15)) & 0x1f) :
                                                 (((state->x1 - 1) >> 15) & 0x1f);
-             int      x_offset  = x_dir * (bpp + 1);
-             int      xz_offset = x_dir << 1;
 
              if (x_dir > 0)
                  dx += 1;
@@ -3372,92 +3554,7 @@ tri(virge_t *virge, s3d_t *s3d_tri, s3d_state_t *state, int yc, int32_t dx1, int
              x &= 0xfff;
              xe &= 0xfff;
 
-             for (; x != xe; x = (x + x_dir) & 0xfff) {
-                  int      update = 1;
-                  uint16_t src_z  = 0;
-
-                  _x = x;
-                  _y = state->y;
-
-                  if (use_z) {
-                      src_z = Z_READ(z_addr);
-                      Z_CLIP(src_z, z >> 16);
-                  }
-
-                  if (update) {
-                      uint32_t dest_col;
-
-                      dest_pixel(state);
-
-                      if (s3d_tri->cmd_set & CMD_SET_FE) {
-                          int a              = state->a >> 7;
-                          state->dest_rgba.r = ((state->dest_rgba.r * a) + (s3d_tri->fog_r * (255 - a))) / 255;
-                          state->dest_rgba.g = ((state->dest_rgba.g * a) + (s3d_tri->fog_g * (255 - a))) / 255;
-                          state->dest_rgba.b = ((state->dest_rgba.b * a) + (s3d_tri->fog_b * (255 - a))) / 255;
-                      }
-
-                      if (s3d_tri->cmd_set & CMD_SET_ABC_ENABLE) {
-                          uint32_t src_col;
-                          int      src_r = 0;
-                          uint32_t src_g = 0;
-                          uint32_t src_b = 0;
-
-
-                          switch (bpp) {
-                              case 0: /*8 bpp*/
-                                  /*Not implemented yet*/
-                                  break;
-                              case 1: /*16 bpp*/
-                                  src_col = *(uint16_t *)&vram[dest_addr & virge->vram_mask];
-                                  RGB15_TO_24(src_col, src_r, src_g, src_b);
-                                  break;
-                              case 2: /*24 bpp*/
-                                  src_col = (*(uint32_t *)&vram[dest_addr & virge->vram_mask]) & 0xffffff;
-                                  RGB24_TO_24(src_col, src_r, src_g, src_b);
-                                  break;
-                          }
-
-                          state->dest_rgba.r = ((state->dest_rgba.r * state->dest_rgba.a) +
-                                                (src_r * (255 - state->dest_rgba.a))) / 255;
-                          state->dest_rgba.g = ((state->dest_rgba.g * state->dest_rgba.a) +
-                                                (src_g * (255 - state->dest_rgba.a))) / 255;
-                          state->dest_rgba.b = ((state->dest_rgba.b * state->dest_rgba.a) +
-                                                (src_b * (255 - state->dest_rgba.a))) / 255;
-                      }
-
-                      switch (bpp) {
-                          case 0: /*8 bpp*/
-                              /*Not implemented yet*/
-                              break;
-                          case 1: /*16 bpp*/
-                              RGB15(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b, dest_col);
-                              *(uint16_t *)&vram[dest_addr] = dest_col;
-                              break;
-                          case 2: /*24 bpp*/
-                              dest_col = RGB24(state->dest_rgba.r, state->dest_rgba.g, state->dest_rgba.b);
-                              *(uint8_t *)&vram[dest_addr] = dest_col & 0xff;
-                              *(uint8_t *)&vram[dest_addr + 1] = (dest_col >> 8) & 0xff;
-                              *(uint8_t *)&vram[dest_addr + 2] = (dest_col >> 16) & 0xff;
-                              break;
-                      }
-
-                      if (use_z && (s3d_tri->cmd_set & CMD_SET_ZUP))
-                          Z_WRITE(z_addr, src_z);
-                  }
-
-                  z         += s3d_tri->TdZdX;
-                  state->u  += s3d_tri->TdUdX;
-                  state->v  += s3d_tri->TdVdX;
-                  state->r  += s3d_tri->TdRdX;
-                  state->g  += s3d_tri->TdGdX;
-                  state->b  += s3d_tri->TdBdX;
-                  state->a  += s3d_tri->TdAdX;
-                  state->d  += s3d_tri->TdDdX;
-                  state->w  += s3d_tri->TdWdX;
-                  dest_addr += x_offset;
-                  z_addr    += xz_offset;
-                  virge->pixel_count++;
-              }
+             virge->pixel_count += span(virge, s3d_tri, state, x, xe, x_dir, dest_addr, z_addr, z);
         }
 
 tri_skip_line:
@@ -3480,9 +3577,28 @@ tri_skip_line:
 
 static int tex_size[8] = {4 * 2, 2 * 2, 2 * 2, 1 * 2, 2 / 1, 2 / 1, 1 * 2, 1 * 2};
 
+/*Whether a render thread owns any of the lines a triangle covers.*/
+static int
+s3_virge_triangle_visible(virge_t *virge, virge_render_thread_t *thread, s3d_t *s3d_tri) {
+    int top    = s3d_tri->tys;
+    int bottom = top - (s3d_tri->ty01 + s3d_tri->ty12) + 1;
+
+    if ((virge->render_threads == 1) || ((top - bottom) >= (virge->render_threads * VIRGE_TILE_HEIGHT)))
+        return 1;
+
+    for (int y = bottom & ~(VIRGE_TILE_HEIGHT - 1); y <= top; y += VIRGE_TILE_HEIGHT) {
+        if (VIRGE_TILE_OWNER(y) == thread->index)
+            return 1;
+    }
+
+    return 0;
+}
+
 static void
-s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
+s3_virge_triangle(virge_t *virge, virge_render_thread_t *thread, s3d_t *s3d_tri) {
     s3d_state_t state;
+    tri_span_t  span;
+    int         bpp;
 
     uint32_t    tex_base;
     int         c;
@@ -3490,6 +3606,14 @@ s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
     uint64_t     start_time = plat_timer_read();
     uint64_t     end_time;
 
+    /*Every thread sees every triangle, so only the first one counts it,
+      whether or not any of its lines are visible to that thread.*/
+    if (thread->index == 0)
+        virge->tri_count++;
+
+    if (!s3_virge_triangle_visible(virge, thread, s3d_tri))
+        return;
+
     state.tbu = s3d_tri->tbu << 11;
     state.tbv = s3d_tri->tbv << 11;
 
@@ -3518,19 +3642,19 @@ s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
 
     switch ((s3d_tri->cmd_set >> 27) & 0xf) {
         case 0:
-            dest_pixel = dest_pixel_gouraud_shaded_triangle;
+            state.dest_pixel = dest_pixel_gouraud_shaded_triangle;
             break;
         case 1:
         case 5:
             switch ((s3d_tri->cmd_set >> 15) & 0x3) {
                 case 0:
-                    dest_pixel = dest_pixel_lit_texture_reflection;
+                    state.dest_pixel = dest_pixel_lit_texture_reflection;
                     break;
                 case 1:
-                    dest_pixel = dest_pixel_lit_texture_modulate;
+                    state.dest_pixel = dest_pixel_lit_texture_modulate;
                     break;
                 case 2:
-                    dest_pixel = dest_pixel_lit_texture_decal;
+                    state.dest_pixel = dest_pixel_lit_texture_decal;
                     break;
                 default:
                     return;
@@ -3538,7 +3662,7 @@ s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
             break;
         case 2:
         case 6:
-            dest_pixel = dest_pixel_unlit_texture_triangle;
+            state.dest_pixel = dest_pixel_unlit_texture_triangle;
             break;
         default:
             return;
@@ -3547,117 +3671,139 @@ s3_virge_triangle(virge_t *virge, s3d_t *s3d_tri) {
     switch (((s3d_tri->cmd_set >> 12) & 7) | ((s3d_tri->cmd_set & (1 << 29)) ? 8 : 0)) {
         case 0:
         case 1:
-            tex_sample = tex_sample_mipmap;
+            state.tex_sample = tex_sample_mipmap;
             break;
         case 2:
         case 3:
-            tex_sample = virge->bilinear_enabled ? tex_sample_mipmap_filter : tex_sample_mipmap;
+            state.tex_sample = virge->bilinear_enabled ? tex_sample_mipmap_filter : tex_sample_mipmap;
             break;
         case 4:
         case 5:
-            tex_sample = tex_sample_normal;
+            state.tex_sample = tex_sample_normal;
             break;
         case 6:
         case 7:
-            tex_sample = virge->bilinear_enabled ? tex_sample_normal_filter : tex_sample_normal;
+            state.tex_sample = virge->bilinear_enabled ? tex_sample_normal_filter : tex_sample_normal;
             break;
         case (0 | 8):
         case (1 | 8):
             if ((virge->chip == S3_VIRGEDX) || (virge->chip >= S3_VIRGEGX2))
-                tex_sample = tex_sample_persp_mipmap_375;
+                state.tex_sample = tex_sample_persp_mipmap_375;
             else
-                tex_sample = tex_sample_persp_mipmap;
+                state.tex_sample = tex_sample_persp_mipmap;
             break;
         case (2 | 8):
         case (3 | 8):
             if ((virge->chip == S3_VIRGEDX) || (virge->chip >= S3_VIRGEGX2))
-                tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter_375 :
-                                                       tex_sample_persp_mipmap_375;
+                state.tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter_375 :
+                                                             tex_sample_persp_mipmap_375;
             else
-                tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter :
-                                                       tex_sample_persp_mipmap;
+                state.tex_sample = virge->bilinear_enabled ? tex_sample_persp_mipmap_filter :
+                                                             tex_sample_persp_mipmap;
             break;
         case (4 | 8):
         case (5 | 8):
             if ((virge->chip == S3_VIRGEDX) || (virge->chip >= S3_VIRGEGX2))
-                tex_sample = tex_sample_persp_normal_375;
+                state.tex_sample = tex_sample_persp_normal_375;
             else
-                tex_sample = tex_sample_persp_normal;
+                state.tex_sample = tex_sample_persp_normal;
             break;
         case (6 | 8):
         case (7 | 8):
             if ((virge->chip == S3_VIRGEDX) || (virge->chip >= S3_VIRGEGX2))
-                tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter_375 :
-                                                       tex_sample_persp_normal_375;
+                state.tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter_375 :
+                                                             tex_sample_persp_normal_375;
             else
-                tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter :
-                                                       tex_sample_persp_normal;
+                state.tex_sample = virge->bilinear_enabled ? tex_sample_persp_normal_filter :
+                                                             tex_sample_persp_normal;
             break;
     }
 
     switch ((s3d_tri->cmd_set >> 5) & 7) {
         case 0:
-            tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB8888 : tex_ARGB8888_nowrap;
+            state.tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB8888 : tex_ARGB8888_nowrap;
             break;
         case 1:
-            tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB4444 : tex_ARGB4444_nowrap;
+            state.tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB4444 : tex_ARGB4444_nowrap;
             break;
         case 2:
-            tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
+            state.tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
             break;
         default:
-            tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
+            state.tex_read = (s3d_tri->cmd_set & CMD_SET_TWE) ? tex_ARGB1555 : tex_ARGB1555_nowrap;
             break;
     }
 
+    bpp  = (s3d_tri->cmd_set >> 2) & 7;
+    span = tri_spans[(bpp > 2) ? 0 : bpp][!(s3d_tri->cmd_set & CMD_SET_ZB_MODE)]
+                    [!!(s3d_tri->cmd_set & CMD_SET_FE)][!!(s3d_tri->cmd_set & CMD_SET_ABC_ENABLE)];
+
     state.y  = s3d_tri->tys;
     state.x1 = s3d_tri->txs;
     state.x2 = s3d_tri->txend01;
-    tri(virge, s3d_tri, &state, s3d_tri->ty01, s3d_tri->TdXdY02, s3d_tri->TdXdY01);
+    tri(virge, thread, s3d_tri, &state, span, s3d_tri->ty01, s3d_tri->TdXdY02, s3d_tri->TdXdY01);
     state.x2 = s3d_tri->txend12;
-    tri(virge, s3d_tri, &state, s3d_tri->ty12, s3d_tri->TdXdY02, s3d_tri->TdXdY12);
-
-    virge->tri_count++;
+    tri(virge, thread, s3d_tri, &state, span, s3d_tri->ty12, s3d_tri->TdXdY02, s3d_tri->TdXdY12);
 
     end_time = plat_timer_read();
 
-    virge_time += end_time - start_time;
+    atomic_fetch_add_explicit(&virge_time, end_time - start_time, memory_order_relaxed);
 }
 
 static void
 render_thread(void *param)
 {
-    virge_t *virge = (virge_t *)param;
+    virge_render_thread_t *thread = (virge_render_thread_t *)param;
+    virge_t               *virge  = thread->virge;
 
     while (virge->render_thread_run) {
-        thread_wait_event(virge->wake_render_thread, -1);
-        thread_reset_event(virge->wake_render_thread);
-        virge->s3d_busy = 1;
-        while (!RB_EMPTY) {
-            s3_virge_triangle(virge, &virge->s3d_buffer[virge->s3d_read_idx & RB_MASK]);
-            virge->s3d_read_idx++;
-
-            if (RB_ENTRIES == RB_MASK)
+        thread_wait_event(thread->wake, -1);
+        thread_reset_event(thread->wake);
+        thread->busy = 1;
+        while (!RB_EMPTY(thread)) {
+            s3_virge_triangle(virge, thread, &virge->s3d_buffer[thread->read_idx & RB_MASK]);
+            thread->read_idx++;
+
+            if (RB_ENTRIES(thread) == RB_MASK)
                 thread_set_event(virge->not_full_event);
         }
-        virge->s3d_busy = 0;
-        virge->subsys_stat |= INT_S3D_DONE;
-        s3_virge_update_irqs(virge);
+        thread->busy = 0;
+
+        /*The last thread to go idle signals completion.*/
+        if (!s3_virge_3d_busy(virge)) {
+            virge->subsys_stat |= INT_S3D_DONE;
+            s3_virge_update_irqs(virge);
+        }
+    }
+}
+
+/*The ring is full while the slowest render thread still has every slot to
+  draw.*/
+static int
+s3_virge_rb_full(virge_t *virge)
+{
+    for (int c = 0; c < virge->render_threads; c++) {
+        if (RB_ENTRIES(&virge->render_thread_data[c]) == RB_SIZE)
+            return 1;
     }
+
+    return 0;
 }
 
 static void
 queue_triangle(virge_t *virge)
 {
-    if (RB_FULL) {
+    while (s3_virge_rb_full(virge)) {
         thread_reset_event(virge->not_full_event);
-        if (RB_FULL)
+        if (s3_virge_rb_full(virge))
             thread_wait_event(virge->not_full_event, -1); /*Wait for room in ringbuffer*/
     }
     virge->s3d_buffer[virge->s3d_write_idx & RB_MASK] = virge->s3d_tri;
     virge->s3d_write_idx++;
-    if (!virge->s3d_busy)
-        thread_set_event(virge->wake_render_thread); /*Wake up render thread if moving from idle*/
+    for (int c = 0; c < virge->render_threads; c++) {
+        if (!virge->render_thread_data[c].busy)
+            thread_set_event(virge->render_thread_data[c].wake); /*Wake up render thread if moving from idle*/
+    }
 }
 
 static void
@@ -4324,9 +4470,11 @@ s3_virge_reset(void *priv)
         dev->virge_busy = 0;
         dev->fifo_write_idx = 0;
         dev->fifo_read_idx = 0;
-        dev->s3d_busy = 0;
         dev->s3d_write_idx = 0;
-        dev->s3d_read_idx = 0;
+        for (int c = 0; c < dev->render_threads; c++) {
+            dev->render_thread_data[c].busy = 0;
+            dev->render_thread_data[c].read_idx = 0;
+        }
         reset_state->pci_slot = dev->pci_slot;
 
         *dev = *reset_state;
@@ -4572,11 +4720,27 @@ s3_virge_init(const device_t *info)
 
     virge->svga.force_old_addr = 1;
 
+    virge->render_threads = device_get_config_int("render_threads");
+    if (virge->render_threads <= 0)
+        virge->render_threads = plat_get_cpu_count() - 1;
+    if (virge->render_threads < 1)
+        virge->render_threads = 1;
+    if (virge->render_threads > VIRGE_MAX_RENDER_THREADS)
+        virge->render_threads = VIRGE_MAX_RENDER_THREADS;
+
+    for (int c = 0; c < VIRGE_TILE_ROWS; c++)
+        virge->tile_owner[c] = c % virge->render_threads;
+
     virge->render_thread_run = 1;
-    virge->wake_render_thread = thread_create_event();
     virge->wake_main_thread = thread_create_event();
     virge->not_full_event = thread_create_event();
-    virge->render_thread = thread_create(render_thread, virge);
+    for (int c = 0; c < virge->render_threads; c++) {
+        virge->render_thread_data[c].virge = virge;
+        virge->render_thread_data[c].index = c;
+        virge->render_thread_data[c].wake  = thread_create_event();
+    }
+    for (int c = 0; c < virge->render_threads; c++)
+        virge->render_thread_data[c].thread = thread_create(render_thread, &virge->render_thread_data[c]);
 
     virge->fifo_thread_run = 1;
     virge->wake_fifo_thread = thread_create_event();
@@ -4596,11 +4760,14 @@ s3_virge_close(void *priv)
     virge_t *virge = (virge_t *) priv;
 
     virge->render_thread_run = 0;
-    thread_set_event(virge->wake_render_thread);
-    thread_wait(virge->render_thread);
+    for (int c = 0; c < virge->render_threads; c++) {
+        thread_set_event(virge->render_thread_data[c].wake);
+        thread_wait(virge->render_thread_data[c].thread);
+    }
+    for (int c = 0; c < virge->render_threads; c++)
+        thread_destroy_event(virge->render_thread_data[c].wake);
     thread_destroy_event(virge->not_full_event);
     thread_destroy_event(virge->wake_main_thread);
-    thread_destroy_event(virge->wake_render_thread);
 
     virge->fifo_thread_run = 0;
     thread_set_event(virge->wake_fifo_thread);
@@ -4734,6 +4901,37 @@ static const device_config_t s3_virge_config[] = {
         .type = CONFIG_BINARY,
         .default_int = 1
     },
+    {
+        .name = "render_threads",
+        .description = "Render threads",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = ""
+            }
+        },
+        .default_int = 1
+    },
     {
         .type = CONFIG_END
     }
@@ -4777,6 +4975,37 @@ static const device_config_t s3_virge_stb_config[] = {
         .type = CONFIG_BINARY,
         .default_int = 1
     },
+    {
+        .name = "render_threads",
+        .description = "Render threads",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = ""
+            }
+        },
+        .default_int = 1
+    },
     {
         .type = CONFIG_END
     }
@@ -4797,6 +5026,37 @@ static const device_config_t s3_virge_357_config[] = {
         .type = CONFIG_BINARY,
         .default_int = 1
     },
+    {
+        .name = "render_threads",
+        .description = "Render threads",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = ""
+            }
+        },
+        .default_int = 1
+    },
     {
         .type = CONFIG_END
     }
@@ -4836,6 +5096,37 @@ static const device_config_t s3_trio3d2x_config[] = {
         .type = CONFIG_BINARY,
         .default_int = 1
     },
+    {
+        .name = "render_threads",
+        .description = "Render threads",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
+            {
+                .description = "1",
+                .value = 1
+            },
+            {
+                .description = "2",
+                .value = 2
+            },
+            {
+                .description = "4",
+                .value = 4
+            },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = ""
+            }
+        },
+        .default_int = 1
+    },
     {
         .type = CONFIG_END
     }
@@ -48,6 +48,8 @@
 void svga_doblit(int wx, int wy, svga_t *svga);
 void svga_poll(void *priv);
 
+static void svga_doblit_common(int wx, int wy, svga_t *svga, int dirty_tracked);
+
 svga_t *svga_8514;
 
 extern int     cyc_total;
@@ -1016,9 +1018,13 @@ svga_recalctimings(svga_t *svga)
         video_force_resize_set_monitor(1, svga->monitor_index);
 }
 
+/* Every renderer records the line in lastline_draw when it actually writes
+   it, which is what the dirty row tracking for the blit keys off. */
 static void
-svga_do_render(svga_t *svga)
+svga_do_render_line(svga_t *svga)
 {
+    int line;
+
     /* Always render a blank screen and nothing else while in DPMS mode. */
     if (svga->dpms) {
         svga_render_blank(svga);
@@ -1035,24 +1041,32 @@ svga_do_render(svga_t *svga)
     }
 
     if (svga->overlay_on) {
-        if (!svga->override && svga->overlay_draw)
+        if (!svga->override && svga->overlay_draw) {
             svga->overlay_draw(svga, svga->displine + svga->y_add);
+            video_mark_dirty_monitor(svga->displine + svga->y_add, 1, svga->monitor_index);
+        }
         svga->overlay_on--;
         if (svga->overlay_on && svga->interlace)
             svga->overlay_on--;
     }
 
     if (svga->dac_hwcursor_on) {
-        if (!svga->override && svga->dac_hwcursor_draw)
-            svga->dac_hwcursor_draw(svga, (svga->displine + svga->y_add + ((svga->dac_hwcursor_latch.y >= 0) ? 0 : svga->dac_hwcursor_latch.y)) & 2047);
+        if (!svga->override && svga->dac_hwcursor_draw) {
+            line = (svga->displine + svga->y_add + ((svga->dac_hwcursor_latch.y >= 0) ? 0 : svga->dac_hwcursor_latch.y)) & 2047;
+            svga->dac_hwcursor_draw(svga, line);
+            video_mark_dirty_monitor(line, 1, svga->monitor_index);
+        }
         svga->dac_hwcursor_on--;
         if (svga->dac_hwcursor_on && svga->interlace)
             svga->dac_hwcursor_on--;
     }
 
     if (svga->hwcursor_on) {
-        if (!svga->override && svga->hwcursor_draw)
-            svga->hwcursor_draw(svga, (svga->displine + svga->y_add + ((svga->hwcursor_latch.y >= 0) ? 0 : svga->hwcursor_latch.y)) & 2047);
+        if (!svga->override && svga->hwcursor_draw) {
+            line = (svga->displine + svga->y_add + ((svga->hwcursor_latch.y >= 0) ? 0 : svga->hwcursor_latch.y)) & 2047;
+            svga->hwcursor_draw(svga, line);
+            video_mark_dirty_monitor(line, 1, svga->monitor_index);
+        }
 
         svga->hwcursor_on--;
         if (svga->hwcursor_on && svga->interlace)
@@ -1060,6 +1074,22 @@ svga_do_render(svga_t *svga)
     }
 }
 
+static void
+svga_do_render(svga_t *svga)
+{
+    int lastline_draw = svga->lastline_draw;
+
+    svga->lastline_draw = -1;
+
+    svga_do_render_line(svga);
+
+    if (svga->lastline_draw >= 0) {
+        if ((svga->displine + svga->y_add) >= 0)
+            video_mark_dirty_monitor(svga->displine + svga->y_add, 1, svga->monitor_index);
+    } else
+        svga->lastline_draw = lastline_draw;
+}
+
 void
 svga_poll(void *priv)
 {
@@ -1265,11 +1295,11 @@ svga_poll(void *priv)
                 if (svga->vertical_linedbl) {
                     wy = (svga->lastline - svga->firstline) << 1;
                     svga->vdisp = wy + 1;
-                    svga_doblit(wx, wy, svga);
+                    svga_doblit_common(wx, wy, svga, 1);
                 } else {
                     wy = svga->lastline - svga->firstline;
                     svga->vdisp = wy + 1;
-                    svga_doblit(wx, wy, svga);
+                    svga_doblit_common(wx, wy, svga, 1);
                 }
             }
 
@@ -1359,6 +1389,8 @@ svga_init(const device_t *info, svga_t *svga, void *priv, int memsize,
 {
     int e;
 
+    svga_line_conv_init();
+
     svga->priv          = priv;
     svga->monitor_index = monitor_index_global;
     svga->monitor       = &monitors[svga->monitor_index];
@@ -1793,8 +1825,8 @@ svga_read_linear(uint32_t addr, void *priv)
     return svga_read_common(addr, 1, priv);
 }
 
-void
-svga_doblit(int wx, int wy, svga_t *svga)
+static void
+svga_doblit_common(int wx, int wy, svga_t *svga, int dirty_tracked)
 {
     int       y_add;
     int       x_add;
@@ -1806,6 +1838,8 @@ svga_doblit(int wx, int wy, svga_t *svga)
     int       j;
     int       xs_temp;
     int       ys_temp;
+    int       resized = 0;
+    uint32_t  overscan_color;
 
     y_add   = enable_overscan ? svga->monitor->mon_overscan_y : 0;
     x_add   = enable_overscan ? svga->monitor->mon_overscan_x : 0;
@@ -1838,6 +1872,7 @@ svga_doblit(int wx, int wy, svga_t *svga)
         /* Screen res has changed.. fix up, and let them know. */
         svga->monitor->mon_xsize = xs_temp;
         svga->monitor->mon_ysize = ys_temp;
+        resized                  = 1;
 
         if ((svga->monitor->mon_xsize > 1984) || (svga->monitor->mon_ysize > 2016)) {
             /* 2048x2048 is the biggest safe render texture, to account for overscan,
@@ -1857,29 +1892,50 @@ svga_doblit(int wx, int wy, svga_t *svga)
             video_force_resize_set_monitor(0, svga->monitor_index);
     }
 
+    overscan_color = svga->dpms ? 0 : svga->overscan_color;
+
     if ((wx >= 160) && ((wy + 1) >= 120)) {
         /* Draw (overscan_size - scroll size) lines of overscan on top and bottom. */
         for (i = 0; i < svga->y_add; i++) {
             p = &svga->monitor->target_buffer->line[i & 0x7ff][0];
 
             for (j = 0; j < (svga->monitor->mon_xsize + x_add); j++)
-                p[j] = svga->dpms ? 0 : svga->overscan_color;
+                p[j] = overscan_color;
         }
 
         for (i = 0; i < bottom; i++) {
             p = &svga->monitor->target_buffer->line[(svga->monitor->mon_ysize + svga->y_add + i) & 0x7ff][0];
 
             for (j = 0; j < (svga->monitor->mon_xsize + x_add); j++)
-                p[j] = svga->dpms ? 0 : svga->overscan_color;
+                p[j] = overscan_color;
         }
     }
 
-    video_blit_memtoscreen_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
+    if (dirty_tracked) {
+        /* The overscan border is redrawn on every line without being tracked,
+           and a shifted or resized picture moves every row, so any of those
+           changing invalidates the whole frame. */
+        if (resized || (overscan_color != svga->blit_overscan_color) || (svga->x_add != svga->blit_x_add) || (svga->y_add != svga->blit_y_add))
+            video_mark_dirty_monitor(0, 2048, svga->monitor_index);
+
+        svga->blit_overscan_color = overscan_color;
+        svga->blit_x_add          = svga->x_add;
+        svga->blit_y_add          = svga->y_add;
+
+        video_blit_memtoscreen_dirty_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
+    } else
+        video_blit_memtoscreen_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
 
     if (svga->vertical_linedbl)
         svga->vertical_linedbl >>= 1;
 }
 
+void
+svga_doblit(int wx, int wy, svga_t *svga)
+{
+    svga_doblit_common(wx, wy, svga, 0);
+}
+
 void
 svga_writeb_linear(uint32_t addr, uint8_t val, void *priv)
 {
@@ -44,6 +44,28 @@ svga_lookup_lut_ram(svga_t* svga, uint32_t val)
 
 #define lookup_lut(val) svga_lookup_lut_ram(svga, val)
 
+/* Number of pixels a renderer loop stepping by 'step' writes for this line. */
+static __inline int
+svga_line_count(svga_t *svga, int step)
+{
+    int last = svga->hdisp + svga->scrollcache;
+
+    if (last < 0)
+        return 0;
+
+    return ((last / step) + 1) * step;
+}
+
+/* Whether 'len' bytes from the current address can be converted in one go,
+   without wrapping around the display mask. */
+static __inline int
+svga_line_fits(svga_t *svga, uint32_t len)
+{
+    uint32_t start = svga->ma & svga->vram_display_mask;
+
+    return (len == 0) || ((len - 1) <= (svga->vram_display_mask - start));
+}
+
 void
 svga_render_null(svga_t *svga)
 {
@@ -747,6 +769,23 @@ svga_render_indexed_gfx(svga_t *svga, bool highres, bool combine8bits)
         svga->firstline_draw = svga->displine;
     svga->lastline_draw = svga->displine;
 
+    /*
+       Packed 8bpp with every plane enabled, no blinking and a plain linear
+       address is a straight palette lookup per byte, so hand it over to
+       the line converter in one go.
+     */
+    if (highres8bpp && !svga->packed_4bpp && !svga->ati_4color && !svga->force_old_addr && !svga->remap_required &&
+        (incevery == 1) && (loadevery == 1) && (planemask == 0xffffffff) && !blinkmask) {
+        const int count = svga_line_count(svga, charwidth);
+
+        if (svga_line_fits(svga, count)) {
+            svga_line_conv.conv_8to32(p, &svga->vram[svga->ma & svga->vram_display_mask], svga->map8, svga->dac_mask, count);
+            svga->ma += count;
+            svga->ma &= svga->vram_display_mask;
+            return;
+        }
+    }
+
     uint32_t incr_counter = 0;
     uint32_t load_counter = 0;
     uint32_t edat         = 0;
@@ -1328,6 +1367,7 @@ void
 svga_render_15bpp_highres(svga_t *svga)
 {
     int       x;
+    int       count;
     uint32_t *p;
     uint32_t  dat;
     uint32_t  changed_addr;
@@ -1374,7 +1414,12 @@ svga_render_15bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            count = svga_line_count(svga, 8);
+
+            if (!svga->remap_required && (svga->conv_16to32 == svga_conv_16to32) && svga_line_fits(svga, count << 1)) {
+                svga_line_conv.conv_15to32(p, &svga->vram[svga->ma & svga->vram_display_mask], count);
+                svga->ma += count << 1;
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
                     dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
                     *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
@@ -1560,6 +1605,7 @@ void
 svga_render_16bpp_highres(svga_t *svga)
 {
     int       x;
+    int       count;
     uint32_t *p;
     uint32_t  dat;
     uint32_t  changed_addr;
@@ -1606,7 +1652,12 @@ svga_render_16bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            count = svga_line_count(svga, 8);
+
+            if (!svga->remap_required && (svga->conv_16to32 == svga_conv_16to32) && svga_line_fits(svga, count << 1)) {
+                svga_line_conv.conv_16to32(p, &svga->vram[svga->ma & svga->vram_display_mask], count);
+                svga->ma += count << 1;
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
                     dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
                     *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
@@ -1721,6 +1772,7 @@ void
 svga_render_24bpp_highres(svga_t *svga)
 {
     int       x;
+    int       count;
     uint32_t *p;
     uint32_t  changed_addr;
     uint8_t   addr;
@@ -1767,7 +1819,12 @@ svga_render_24bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            count = svga_line_count(svga, 4);
+
+            if (!svga->remap_required && !svga->lut_map && svga_line_fits(svga, count * 3)) {
+                svga_line_conv.conv_24to32(p, &svga->vram[svga->ma & svga->vram_display_mask], count);
+                svga->ma += count * 3;
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
                     dat0 = *(uint32_t *) (&svga->vram[svga->ma & svga->vram_display_mask]);
                     dat1 = *(uint32_t *) (&svga->vram[(svga->ma + 4) & svga->vram_display_mask]);
@@ -1862,6 +1919,7 @@ void
 svga_render_32bpp_highres(svga_t *svga)
 {
     int       x;
+    int       count;
     uint32_t *p;
     uint32_t  dat;
     uint32_t  changed_addr;
@@ -1895,7 +1953,12 @@ svga_render_32bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            if (!svga->remap_required) {
+            count = svga_line_count(svga, 1);
+
+            if (!svga->remap_required && !svga->lut_map && svga_line_fits(svga, count << 2)) {
+                svga_line_conv.conv_32to32(p, &svga->vram[svga->ma & svga->vram_display_mask], count);
+                svga->ma += count << 2;
+            } else if (!svga->remap_required) {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
                     dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
                     *p++ = lookup_lut(dat & 0xffffff);
@@ -1919,6 +1982,7 @@ void
 svga_render_ABGR8888_highres(svga_t *svga)
 {
     int       x;
+    int       count;
     uint32_t *p;
     uint32_t  dat;
     uint32_t  changed_addr;
@@ -1936,7 +2000,12 @@ svga_render_ABGR8888_highres(svga_t *svga)
             svga->firstline_draw = svga->displine;
         svga->lastline_draw = svga->displine;
 
-        if (!svga->remap_required) {
+        count = svga_line_count(svga, 1);
+
+        if (!svga->remap_required && !svga->lut_map && svga_line_fits(svga, count << 2)) {
+            svga_line_conv.conv_abgr8888(p, &svga->vram[svga->ma & svga->vram_display_mask], count);
+            svga->ma += count << 2;
+        } else if (!svga->remap_required) {
             for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
                 dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
                 *p++ = lookup_lut(((dat & 0xff0000) >> 16) | (dat & 0x00ff00) | ((dat & 0x0000ff) << 16));
@@ -1959,6 +2028,7 @@ void
 svga_render_RGBA8888_highres(svga_t *svga)
 {
     int       x;
+    int       count;
     uint32_t *p;
     uint32_t  dat;
     uint32_t  changed_addr;
@@ -1976,7 +2046,12 @@ svga_render_RGBA8888_highres(svga_t *svga)
             svga->firstline_draw = svga->displine;
         svga->lastline_draw = svga->displine;
 
-        if (!svga->remap_required) {
+        count = svga_line_count(svga, 1);
+
+        if (!svga->remap_required && !svga->lut_map && svga_line_fits(svga, count << 2)) {
+            svga_line_conv.conv_rgba8888(p, &svga->vram[svga->ma & svga->vram_display_mask], count);
+            svga->ma += count << 2;
+        } else if (!svga->remap_required) {
             for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
                 dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
                 *p++ = lookup_lut(dat >> 8);
@@ -0,0 +1,564 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          SVGA scanline format converters.
+ *
+ *          The SVGA renderers hand contiguous, unremapped runs of VRAM to
+ *          these kernels. The C versions are the reference; SSE2, AVX2 and
+ *          NEON versions are picked at startup according to the host CPU
+ *          and must produce bit-identical output.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define SVGA_RENDER_SSE2
+#    include <emmintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define SVGA_RENDER_AVX2
+#        define SVGA_TARGET_AVX2 __attribute__((target("avx2")))
+#        include <immintrin.h>
+#    elif defined(_MSC_VER)
+#        define SVGA_RENDER_AVX2
+#        define SVGA_TARGET_AVX2
+#        include <intrin.h>
+#        include <immintrin.h>
+#    endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define SVGA_RENDER_NEON
+#    include <arm_neon.h>
+#endif
+
+/*
+   The 15/16bpp tables scale each channel with floor(c * 255 / max). The
+   vector kernels use these multiply-shift pairs instead, which give the
+   same result for every 5-bit and 6-bit channel value:
+   - 5-bit: (c * 2106) >> 8
+   - 6-bit: ((c * 85) * 3121) >> 16
+ */
+#define CONV_5BIT_MUL   2106
+#define CONV_5BIT_SHIFT 8
+#define CONV_6BIT_PRE   85
+#define CONV_6BIT_MUL   3121
+
+static void
+svga_conv_8to32_c(uint32_t *dst, const uint8_t *src, const uint32_t *pal, uint32_t mask, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = pal[src[x] & mask];
+}
+
+static void
+svga_conv_15to32_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = video_15to32[*(const uint16_t *) &src[x << 1]];
+}
+
+static void
+svga_conv_16to32_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = video_16to32[*(const uint16_t *) &src[x << 1]];
+}
+
+static void
+svga_conv_24to32_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = src[x * 3] | (src[(x * 3) + 1] << 8) | (src[(x * 3) + 2] << 16);
+}
+
+static void
+svga_conv_32to32_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = *(const uint32_t *) &src[x << 2] & 0xffffff;
+}
+
+static void
+svga_conv_abgr8888_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    uint32_t dat;
+
+    for (int x = 0; x < count; x++) {
+        dat    = *(const uint32_t *) &src[x << 2];
+        dst[x] = ((dat & 0xff0000) >> 16) | (dat & 0x00ff00) | ((dat & 0x0000ff) << 16);
+    }
+}
+
+static void
+svga_conv_rgba8888_c(uint32_t *dst, const uint8_t *src, int count)
+{
+    for (int x = 0; x < count; x++)
+        dst[x] = *(const uint32_t *) &src[x << 2] >> 8;
+}
+
+const svga_line_conv_t svga_line_conv_c = {
+    .name          = "C",
+    .conv_8to32    = svga_conv_8to32_c,
+    .conv_15to32   = svga_conv_15to32_c,
+    .conv_16to32   = svga_conv_16to32_c,
+    .conv_24to32   = svga_conv_24to32_c,
+    .conv_32to32   = svga_conv_32to32_c,
+    .conv_abgr8888 = svga_conv_abgr8888_c,
+    .conv_rgba8888 = svga_conv_rgba8888_c
+};
+
+svga_line_conv_t svga_line_conv = {
+    .name          = "C",
+    .conv_8to32    = svga_conv_8to32_c,
+    .conv_15to32   = svga_conv_15to32_c,
+    .conv_16to32   = svga_conv_16to32_c,
+    .conv_24to32   = svga_conv_24to32_c,
+    .conv_32to32   = svga_conv_32to32_c,
+    .conv_abgr8888 = svga_conv_abgr8888_c,
+    .conv_rgba8888 = svga_conv_rgba8888_c
+};
+
+#ifdef SVGA_RENDER_SSE2
+/* Expand 8 pixels of 5:5:5 or 5:6:5 into two vectors of 32-bit pixels. */
+static __inline void
+svga_conv_16bit_sse2(__m128i dat, int is_565, __m128i *lo, __m128i *hi)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    __m128i       b;
+    __m128i       g;
+    __m128i       r;
+
+    b = _mm_and_si128(dat, mask5);
+    if (is_565) {
+        g = _mm_and_si128(_mm_srli_epi16(dat, 5), _mm_set1_epi16(0x3f));
+        r = _mm_and_si128(_mm_srli_epi16(dat, 11), mask5);
+        g = _mm_mulhi_epu16(_mm_mullo_epi16(g, _mm_set1_epi16(CONV_6BIT_PRE)), _mm_set1_epi16(CONV_6BIT_MUL));
+    } else {
+        g = _mm_and_si128(_mm_srli_epi16(dat, 5), mask5);
+        r = _mm_and_si128(_mm_srli_epi16(dat, 10), mask5);
+        g = _mm_srli_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(CONV_5BIT_MUL)), CONV_5BIT_SHIFT);
+    }
+    b = _mm_srli_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(CONV_5BIT_MUL)), CONV_5BIT_SHIFT);
+    r = _mm_srli_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(CONV_5BIT_MUL)), CONV_5BIT_SHIFT);
+
+    b   = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    *lo = _mm_unpacklo_epi16(b, r);
+    *hi = _mm_unpackhi_epi16(b, r);
+}
+
+static void
+svga_conv_15to32_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    __m128i lo;
+    __m128i hi;
+    int     x = 0;
+
+    for (; x <= (count - 8); x += 8) {
+        svga_conv_16bit_sse2(_mm_loadu_si128((const __m128i *) &src[x << 1]), 0, &lo, &hi);
+        _mm_storeu_si128((__m128i *) &dst[x], lo);
+        _mm_storeu_si128((__m128i *) &dst[x + 4], hi);
+    }
+
+    svga_conv_15to32_c(&dst[x], &src[x << 1], count - x);
+}
+
+static void
+svga_conv_16to32_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    __m128i lo;
+    __m128i hi;
+    int     x = 0;
+
+    for (; x <= (count - 8); x += 8) {
+        svga_conv_16bit_sse2(_mm_loadu_si128((const __m128i *) &src[x << 1]), 1, &lo, &hi);
+        _mm_storeu_si128((__m128i *) &dst[x], lo);
+        _mm_storeu_si128((__m128i *) &dst[x + 4], hi);
+    }
+
+    svga_conv_16to32_c(&dst[x], &src[x << 1], count - x);
+}
+
+/* SSE2 has no byte shuffle, so pull the four packed pixels of each 12-byte
+   group down with byte shifts and interleave them back together. */
+static void
+svga_conv_24to32_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m128i mask = _mm_set1_epi32(0xffffff);
+    __m128i       dat;
+    __m128i       p01;
+    __m128i       p23;
+    int           x = 0;
+
+    /* Each group loads 16 bytes but consumes 12, so stop short of the end. */
+    for (; x <= (count - 6); x += 4) {
+        dat = _mm_loadu_si128((const __m128i *) &src[x * 3]);
+        p01 = _mm_unpacklo_epi32(dat, _mm_srli_si128(dat, 3));
+        p23 = _mm_unpacklo_epi32(_mm_srli_si128(dat, 6), _mm_srli_si128(dat, 9));
+        _mm_storeu_si128((__m128i *) &dst[x], _mm_and_si128(_mm_unpacklo_epi64(p01, p23), mask));
+    }
+
+    svga_conv_24to32_c(&dst[x], &src[x * 3], count - x);
+}
+
+static void
+svga_conv_32to32_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m128i mask = _mm_set1_epi32(0xffffff);
+    int           x    = 0;
+
+    for (; x <= (count - 4); x += 4)
+        _mm_storeu_si128((__m128i *) &dst[x], _mm_and_si128(_mm_loadu_si128((const __m128i *) &src[x << 2]), mask));
+
+    svga_conv_32to32_c(&dst[x], &src[x << 2], count - x);
+}
+
+static void
+svga_conv_abgr8888_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m128i mask_b = _mm_set1_epi32(0x0000ff);
+    const __m128i mask_g = _mm_set1_epi32(0x00ff00);
+    __m128i       dat;
+    int           x = 0;
+
+    for (; x <= (count - 4); x += 4) {
+        dat = _mm_loadu_si128((const __m128i *) &src[x << 2]);
+        dat = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(dat, 16), mask_b), _mm_and_si128(dat, mask_g)),
+                           _mm_slli_epi32(_mm_and_si128(dat, mask_b), 16));
+        _mm_storeu_si128((__m128i *) &dst[x], dat);
+    }
+
+    svga_conv_abgr8888_c(&dst[x], &src[x << 2], count - x);
+}
+
+static void
+svga_conv_rgba8888_sse2(uint32_t *dst, const uint8_t *src, int count)
+{
+    int x = 0;
+
+    for (; x <= (count - 4); x += 4)
+        _mm_storeu_si128((__m128i *) &dst[x], _mm_srli_epi32(_mm_loadu_si128((const __m128i *) &src[x << 2]), 8));
+
+    svga_conv_rgba8888_c(&dst[x], &src[x << 2], count - x);
+}
+
+static const svga_line_conv_t svga_line_conv_sse2 = {
+    .name          = "SSE2",
+    .conv_8to32    = svga_conv_8to32_c,
+    .conv_15to32   = svga_conv_15to32_sse2,
+    .conv_16to32   = svga_conv_16to32_sse2,
+    .conv_24to32   = svga_conv_24to32_sse2,
+    .conv_32to32   = svga_conv_32to32_sse2,
+    .conv_abgr8888 = svga_conv_abgr8888_sse2,
+    .conv_rgba8888 = svga_conv_rgba8888_sse2
+};
+#endif
+
+#ifdef SVGA_RENDER_AVX2
+SVGA_TARGET_AVX2 static void
+svga_conv_8to32_avx2(uint32_t *dst, const uint8_t *src, const uint32_t *pal, uint32_t mask, int count)
+{
+    const __m256i vmask = _mm256_set1_epi32(mask & 0xff);
+    __m256i       idx;
+    int           x = 0;
+
+    for (; x <= (count - 8); x += 8) {
+        idx = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) &src[x])), vmask);
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_i32gather_epi32((const int *) pal, idx, 4));
+    }
+
+    svga_conv_8to32_c(&dst[x], &src[x], pal, mask, count - x);
+}
+
+SVGA_TARGET_AVX2 static void
+svga_conv_16bit_avx2(uint32_t *dst, const uint8_t *src, int count, int is_565)
+{
+    const __m256i mask5 = _mm256_set1_epi16(0x1f);
+    __m256i       dat;
+    __m256i       b;
+    __m256i       g;
+    __m256i       r;
+    __m256i       lo;
+    __m256i       hi;
+    int           x = 0;
+
+    for (; x <= (count - 16); x += 16) {
+        dat = _mm256_loadu_si256((const __m256i *) &src[x << 1]);
+        b   = _mm256_and_si256(dat, mask5);
+        if (is_565) {
+            g = _mm256_and_si256(_mm256_srli_epi16(dat, 5), _mm256_set1_epi16(0x3f));
+            r = _mm256_and_si256(_mm256_srli_epi16(dat, 11), mask5);
+            g = _mm256_mulhi_epu16(_mm256_mullo_epi16(g, _mm256_set1_epi16(CONV_6BIT_PRE)), _mm256_set1_epi16(CONV_6BIT_MUL));
+        } else {
+            g = _mm256_and_si256(_mm256_srli_epi16(dat, 5), mask5);
+            r = _mm256_and_si256(_mm256_srli_epi16(dat, 10), mask5);
+            g = _mm256_srli_epi16(_mm256_mullo_epi16(g, _mm256_set1_epi16(CONV_5BIT_MUL)), CONV_5BIT_SHIFT);
+        }
+        b = _mm256_srli_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(CONV_5BIT_MUL)), CONV_5BIT_SHIFT);
+        r = _mm256_srli_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(CONV_5BIT_MUL)), CONV_5BIT_SHIFT);
+
+        /* The unpacks work per 128-bit lane, so put the halves back in order. */
+        b  = _mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+        lo = _mm256_unpacklo_epi16(b, r);
+        hi = _mm256_unpackhi_epi16(b, r);
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *) &dst[x + 8], _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    if (is_565)
+        svga_conv_16to32_c(&dst[x], &src[x << 1], count - x);
+    else
+        svga_conv_15to32_c(&dst[x], &src[x << 1], count - x);
+}
+
+SVGA_TARGET_AVX2 static void
+svga_conv_15to32_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_16bit_avx2(dst, src, count, 0);
+}
+
+SVGA_TARGET_AVX2 static void
+svga_conv_16to32_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_16bit_avx2(dst, src, count, 1);
+}
+
+SVGA_TARGET_AVX2 static void
+svga_conv_24to32_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m256i shuf = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                          0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i       dat;
+    int           x = 0;
+
+    /* Each lane loads 16 bytes for 12, so the last group stops short. */
+    for (; x <= (count - 10); x += 8) {
+        dat = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) &src[x * 3])),
+                                      _mm_loadu_si128((const __m128i *) &src[(x * 3) + 12]), 1);
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_shuffle_epi8(dat, shuf));
+    }
+
+    svga_conv_24to32_c(&dst[x], &src[x * 3], count - x);
+}
+
+SVGA_TARGET_AVX2 static void
+svga_conv_32to32_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m256i mask = _mm256_set1_epi32(0xffffff);
+    int           x    = 0;
+
+    for (; x <= (count - 8); x += 8)
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_and_si256(_mm256_loadu_si256((const __m256i *) &src[x << 2]), mask));
+
+    svga_conv_32to32_c(&dst[x], &src[x << 2], count - x);
+}
+
+SVGA_TARGET_AVX2 static void
+svga_conv_abgr8888_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    const __m256i shuf = _mm256_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1,
+                                          2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1);
+    int           x    = 0;
+
+    for (; x <= (count - 8); x += 8)
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) &src[x << 2]), shuf));
+
+    svga_conv_abgr8888_c(&dst[x], &src[x << 2], count - x);
+}
+
+SVGA_TARGET_AVX2 static void
+svga_conv_rgba8888_avx2(uint32_t *dst, const uint8_t *src, int count)
+{
+    int x = 0;
+
+    for (; x <= (count - 8); x += 8)
+        _mm256_storeu_si256((__m256i *) &dst[x], _mm256_srli_epi32(_mm256_loadu_si256((const __m256i *) &src[x << 2]), 8));
+
+    svga_conv_rgba8888_c(&dst[x], &src[x << 2], count - x);
+}
+
+static const svga_line_conv_t svga_line_conv_avx2 = {
+    .name          = "AVX2",
+    .conv_8to32    = svga_conv_8to32_avx2,
+    .conv_15to32   = svga_conv_15to32_avx2,
+    .conv_16to32   = svga_conv_16to32_avx2,
+    .conv_24to32   = svga_conv_24to32_avx2,
+    .conv_32to32   = svga_conv_32to32_avx2,
+    .conv_abgr8888 = svga_conv_abgr8888_avx2,
+    .conv_rgba8888 = svga_conv_rgba8888_avx2
+};
+
+static int
+svga_host_has_avx2(void)
+{
+#    if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return 0;
+
+    /* The OS has to save the YMM state as well. */
+    __cpuid(regs, 1);
+    if (!(regs[2] & (1 << 27)) || ((_xgetbv(0) & 6) != 6))
+        return 0;
+
+    __cpuidex(regs, 7, 0);
+    return !!(regs[1] & (1 << 5));
+#    else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#    endif
+}
+#endif
+
+#ifdef SVGA_RENDER_NEON
+static __inline uint8x8_t
+svga_conv_5bit_neon(uint16x8_t c)
+{
+    return vmovn_u16(vshrq_n_u16(vmulq_n_u16(c, CONV_5BIT_MUL), CONV_5BIT_SHIFT));
+}
+
+static void
+svga_conv_16bit_neon(uint32_t *dst, const uint8_t *src, int count, int is_565)
+{
+    const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+    uint16x8_t       dat;
+    uint16x8_t       g;
+    uint8x8x4_t      out;
+    int              x = 0;
+
+    out.val[3] = vdup_n_u8(0);
+
+    for (; x <= (count - 8); x += 8) {
+        dat        = vld1q_u16((const uint16_t *) &src[x << 1]);
+        out.val[0] = svga_conv_5bit_neon(vandq_u16(dat, mask5));
+        if (is_565) {
+            g          = vmulq_n_u16(vandq_u16(vshrq_n_u16(dat, 5), vdupq_n_u16(0x3f)), CONV_6BIT_PRE);
+            out.val[1] = vmovn_u16(vcombine_u16(vshrn_n_u32(vmull_n_u16(vget_low_u16(g), CONV_6BIT_MUL), 16),
+                                                vshrn_n_u32(vmull_n_u16(vget_high_u16(g), CONV_6BIT_MUL), 16)));
+            out.val[2] = svga_conv_5bit_neon(vandq_u16(vshrq_n_u16(dat, 11), mask5));
+        } else {
+            out.val[1] = svga_conv_5bit_neon(vandq_u16(vshrq_n_u16(dat, 5), mask5));
+            out.val[2] = svga_conv_5bit_neon(vandq_u16(vshrq_n_u16(dat, 10), mask5));
+        }
+        vst4_u8((uint8_t *) &dst[x], out);
+    }
+
+    if (is_565)
+        svga_conv_16to32_c(&dst[x], &src[x << 1], count - x);
+    else
+        svga_conv_15to32_c(&dst[x], &src[x << 1], count - x);
+}
+
+static void
+svga_conv_15to32_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_16bit_neon(dst, src, count, 0);
+}
+
+static void
+svga_conv_16to32_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    svga_conv_16bit_neon(dst, src, count, 1);
+}
+
+static void
+svga_conv_24to32_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    uint8x16x3_t in;
+    uint8x16x4_t out;
+    int          x = 0;
+
+    out.val[3] = vdupq_n_u8(0);
+
+    for (; x <= (count - 16); x += 16) {
+        in         = vld3q_u8(&src[x * 3]);
+        out.val[0] = in.val[0];
+        out.val[1] = in.val[1];
+        out.val[2] = in.val[2];
+        vst4q_u8((uint8_t *) &dst[x], out);
+    }
+
+    svga_conv_24to32_c(&dst[x], &src[x * 3], count - x);
+}
+
+static void
+svga_conv_32to32_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    const uint32x4_t mask = vdupq_n_u32(0xffffff);
+    int              x    = 0;
+
+    for (; x <= (count - 4); x += 4)
+        vst1q_u32(&dst[x], vandq_u32(vld1q_u32((const uint32_t *) &src[x << 2]), mask));
+
+    svga_conv_32to32_c(&dst[x], &src[x << 2], count - x);
+}
+
+static void
+svga_conv_abgr8888_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    uint8x16x4_t dat;
+    uint8x16_t   tmp;
+    int          x = 0;
+
+    for (; x <= (count - 16); x += 16) {
+        dat        = vld4q_u8(&src[x << 2]);
+        tmp        = dat.val[0];
+        dat.val[0] = dat.val[2];
+        dat.val[2] = tmp;
+        dat.val[3] = vdupq_n_u8(0);
+        vst4q_u8((uint8_t *) &dst[x], dat);
+    }
+
+    svga_conv_abgr8888_c(&dst[x], &src[x << 2], count - x);
+}
+
+static void
+svga_conv_rgba8888_neon(uint32_t *dst, const uint8_t *src, int count)
+{
+    int x = 0;
+
+    for (; x <= (count - 4); x += 4)
+        vst1q_u32(&dst[x], vshrq_n_u32(vld1q_u32((const uint32_t *) &src[x << 2]), 8));
+
+    svga_conv_rgba8888_c(&dst[x], &src[x << 2], count - x);
+}
+
+static const svga_line_conv_t svga_line_conv_neon = {
+    .name          = "NEON",
+    .conv_8to32    = svga_conv_8to32_c,
+    .conv_15to32   = svga_conv_15to32_neon,
+    .conv_16to32   = svga_conv_16to32_neon,
+    .conv_24to32   = svga_conv_24to32_neon,
+    .conv_32to32   = svga_conv_32to32_neon,
+    .conv_abgr8888 = svga_conv_abgr8888_neon,
+    .conv_rgba8888 = svga_conv_rgba8888_neon
+};
+#endif
+
+void
+svga_line_conv_init(void)
+{
+#if defined(SVGA_RENDER_AVX2)
+    if (svga_host_has_avx2())
+        svga_line_conv = svga_line_conv_avx2;
+    else
+        svga_line_conv = svga_line_conv_sse2;
+#elif defined(SVGA_RENDER_SSE2)
+    svga_line_conv = svga_line_conv_sse2;
+#elif defined(SVGA_RENDER_NEON)
+    svga_line_conv = svga_line_conv_neon;
+#endif
+}
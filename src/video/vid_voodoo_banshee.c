@@ -1095,7 +1095,7 @@ banshee_status(banshee_t *banshee)
     int           fifo_entries = FIFO_ENTRIES;
     int           swap_count   = voodoo->swap_count;
     int           written      = voodoo->cmd_written + voodoo->cmd_written_fifo;
-    int           busy         = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) || (voodoo->cmdfifo_depth_rd_2 != voodoo->cmdfifo_depth_wr_2) || voodoo->render_voodoo_busy[0] || voodoo->render_voodoo_busy[1] || voodoo->render_voodoo_busy[2] || voodoo->render_voodoo_busy[3] || voodoo->voodoo_busy;
+    int           busy         = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) || (voodoo->cmdfifo_depth_rd_2 != voodoo->cmdfifo_depth_wr_2) || voodoo_render_threads_busy(voodoo) || voodoo->voodoo_busy;
     uint32_t      ret          = 0;
 
     if (fifo_entries < 0x20)
@@ -3202,6 +3202,10 @@ static const device_config_t banshee_sgram_config[] = {
         .description = "Render threads",
         .type = CONFIG_SELECTION,
         .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
             {
                 .description = "1",
                 .value = 1
@@ -3214,11 +3218,46 @@ static const device_config_t banshee_sgram_config[] = {
                 .description = "4",
                 .value = 4
             },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = "16",
+                .value = 16
+            },
+            {
+                .description = ""
+            }
+        },
+        .default_int = 0
+    },
+    {
+        .name = "texture_cache",
+        .description = "Texture cache entries",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "64",
+                .value = 64
+            },
+            {
+                .description = "128",
+                .value = 128
+            },
+            {
+                .description = "256",
+                .value = 256
+            },
+            {
+                .description = "512",
+                .value = 512
+            },
             {
                 .description = ""
             }
         },
-        .default_int = 2
+        .default_int = TEX_CACHE_DEFAULT
     },
 #ifndef NO_CODEGEN
     {
@@ -3257,6 +3296,10 @@ static const device_config_t banshee_sgram_16mbonly_config[] = {
         .description = "Render threads",
         .type = CONFIG_SELECTION,
         .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
             {
                 .description = "1",
                 .value = 1
@@ -3269,11 +3312,46 @@ static const device_config_t banshee_sgram_16mbonly_config[] = {
                 .description = "4",
                 .value = 4
             },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = "16",
+                .value = 16
+            },
             {
                 .description = ""
             }
         },
-        .default_int = 2
+        .default_int = 0
+    },
+    {
+        .name = "texture_cache",
+        .description = "Texture cache entries",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "64",
+                .value = 64
+            },
+            {
+                .description = "128",
+                .value = 128
+            },
+            {
+                .description = "256",
+                .value = 256
+            },
+            {
+                .description = "512",
+                .value = 512
+            },
+            {
+                .description = ""
+            }
+        },
+        .default_int = TEX_CACHE_DEFAULT
     },
 #ifndef NO_CODEGEN
     {
@@ -3312,6 +3390,10 @@ static const device_config_t banshee_sdram_config[] = {
         .description = "Render threads",
         .type = CONFIG_SELECTION,
         .selection = {
+            {
+                .description = "Auto",
+                .value = 0
+            },
             {
                 .description = "1",
                 .value = 1
@@ -3324,11 +3406,46 @@ static const device_config_t banshee_sdram_config[] = {
                 .description = "4",
                 .value = 4
             },
+            {
+                .description = "8",
+                .value = 8
+            },
+            {
+                .description = "16",
+                .value = 16
+            },
+            {
+                .description = ""
+            }
+        },
+        .default_int = 0
+    },
+    {
+        .name = "texture_cache",
+        .description = "Texture cache entries",
+        .type = CONFIG_SELECTION,
+        .selection = {
+            {
+                .description = "64",
+                .value = 64
+            },
+            {
+                .description = "128",
+                .value = 128
+            },
+            {
+                .description = "256",
+                .value = 256
+            },
+            {
+                .description = "512",
+                .value = 512
+            },
             {
                 .description = ""
             }
         },
-        .default_int = 2
+        .default_int = TEX_CACHE_DEFAULT
     },
 #ifndef NO_CODEGEN
     {
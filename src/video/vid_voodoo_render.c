@@ -14,6 +14,7 @@
  *
  *          Copyright 2008-2020 Sarah Walker.
  */
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -660,6 +661,8 @@ voodoo_tmu_fetch_and_blend(voodoo_t *voodoo, voodoo_params_t *params, voodoo_sta
 #    include <86box/vid_voodoo_codegen_x86.h>
 #elif (defined __amd64__ || defined _M_X64)
 #    include <86box/vid_voodoo_codegen_x86-64.h>
+#elif (defined __aarch64__ || defined _M_ARM64)
+#    include <86box/vid_voodoo_codegen_arm64.h>
 #else
 int voodoo_recomp = 0;
 #endif
@@ -831,10 +834,10 @@ voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *
             real_y >>= 4;
 
         if (SLI_ENABLED) {
-            if (((real_y >> 1) & voodoo->odd_even_mask) != odd_even)
+            if (VOODOO_TILE_OWNER(real_y >> 1) != odd_even)
                 goto next_line;
         } else {
-            if ((real_y & voodoo->odd_even_mask) != odd_even)
+            if (VOODOO_TILE_OWNER(real_y) != odd_even)
                 goto next_line;
         }
 
@@ -1415,8 +1418,6 @@ voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even)
 
     state.dx1 = state.dx2 = 0;
 
-    voodoo->tri_count++;
-
     dx = 8 - (params->vertexAx & 0xf);
     if ((params->vertexAx & 0xf) > 8)
         dx += 16;
@@ -1546,10 +1547,62 @@ voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even)
     voodoo_half_triangle(voodoo, params, &state, vertexAy_adjusted, vertexCy_adjusted, odd_even);
 }
 
+/*Returns non-zero if the triangle covers any of the tiles owned by this render
+  thread. Conservative; only used to skip triangle setup on threads that
+  would not draw anything.*/
+static int
+voodoo_triangle_in_tiles(voodoo_t *voodoo, voodoo_params_t *params, int odd_even)
+{
+    int ystart = ((int16_t) params->vertexAy + 7) >> 4;
+    int yend   = ((int16_t) params->vertexCy + 7) >> 4;
+    int first;
+    int last;
+
+    if (voodoo->render_threads == 1)
+        return 1;
+
+    if (params->fbzMode & 1) {
+        if (ystart < params->clipLowY)
+            ystart = params->clipLowY;
+        if (yend >= params->clipHighY)
+            yend = params->clipHighY;
+    }
+    if (ystart >= yend)
+        return 0;
+
+    if (params->fbzMode & (1 << 17)) {
+        int y_origin = (voodoo->type >= VOODOO_BANSHEE) ? voodoo->y_origin_swap : (voodoo->v_disp - 1);
+
+        first = y_origin - (yend - 1);
+        last  = y_origin - ystart;
+    } else {
+        first = ystart;
+        last  = yend - 1;
+    }
+    if (SLI_ENABLED) {
+        first >>= 1;
+        last >>= 1;
+    }
+    first >>= VOODOO_TILE_SHIFT;
+    last >>= VOODOO_TILE_SHIFT;
+
+    if ((last - first) >= VOODOO_TILE_ROWS)
+        return 1;
+
+    for (int tile = first; tile <= last; tile++) {
+        if (voodoo->tile_owner[tile & (VOODOO_TILE_ROWS - 1)] == odd_even)
+            return 1;
+    }
+
+    return 0;
+}
+
 static void
-render_thread(void *param, int odd_even)
+voodoo_render_thread(void *param)
 {
-    voodoo_t *voodoo = (voodoo_t *) param;
+    voodoo_render_thread_t *thread   = (voodoo_render_thread_t *) param;
+    voodoo_t               *voodoo   = thread->voodoo;
+    int                     odd_even = thread->odd_even;
 
     while (voodoo->render_thread_run[odd_even]) {
         thread_set_event(voodoo->render_not_full_event[odd_even]);
@@ -1562,7 +1615,13 @@ render_thread(void *param, int odd_even)
             uint64_t         end_time;
             voodoo_params_t *params = &voodoo->params_buffer[voodoo->params_read_idx[odd_even] & PARAM_MASK];
 
-            voodoo_triangle(voodoo, params, odd_even);
+            if (voodoo_triangle_in_tiles(voodoo, params, odd_even))
+                voodoo_triangle(voodoo, params, odd_even);
+            else {
+                /*Nothing to draw here, but the texture reference still has to be released*/
+                voodoo->texture_cache[0][params->tex_entry[0]].refcount_r[odd_even]++;
+                voodoo->texture_cache[1][params->tex_entry[1]].refcount_r[odd_even]++;
+            }
 
             voodoo->params_read_idx[odd_even]++;
 
@@ -1577,25 +1636,47 @@ render_thread(void *param, int odd_even)
     }
 }
 
+/*A render_threads of 0 sizes the pool to the host, leaving one core for the
+  emulated CPU.*/
 void
-voodoo_render_thread_1(void *param)
-{
-    render_thread(param, 0);
-}
-void
-voodoo_render_thread_2(void *param)
-{
-    render_thread(param, 1);
-}
-void
-voodoo_render_thread_3(void *param)
+voodoo_render_threads_init(voodoo_t *voodoo, int render_threads)
 {
-    render_thread(param, 2);
+    if (render_threads <= 0)
+        render_threads = plat_get_cpu_count() - 1;
+    if (render_threads < 1)
+        render_threads = 1;
+    if (render_threads > VOODOO_MAX_RENDER_THREADS)
+        render_threads = VOODOO_MAX_RENDER_THREADS;
+
+    voodoo->render_threads = render_threads;
+
+    for (int c = 0; c < VOODOO_TILE_ROWS; c++)
+        voodoo->tile_owner[c] = c % render_threads;
+
+    for (int c = 0; c < render_threads; c++) {
+        voodoo->wake_render_thread[c]    = thread_create_event();
+        voodoo->render_not_full_event[c] = thread_create_event();
+    }
+    for (int c = 0; c < render_threads; c++) {
+        voodoo->render_thread_data[c].voodoo   = voodoo;
+        voodoo->render_thread_data[c].odd_even = c;
+        voodoo->render_thread_run[c]           = 1;
+        voodoo->render_thread[c]               = thread_create(voodoo_render_thread, &voodoo->render_thread_data[c]);
+    }
 }
+
 void
-voodoo_render_thread_4(void *param)
+voodoo_render_threads_close(voodoo_t *voodoo)
 {
-    render_thread(param, 3);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo->render_thread_run[c] = 0;
+        thread_set_event(voodoo->wake_render_thread[c]);
+        thread_wait(voodoo->render_thread[c]);
+    }
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        thread_destroy_event(voodoo->wake_render_thread[c]);
+        thread_destroy_event(voodoo->render_not_full_event[c]);
+    }
 }
 
 void
@@ -1603,22 +1684,12 @@ voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 {
     voodoo_params_t *params_new = &voodoo->params_buffer[voodoo->params_write_idx & PARAM_MASK];
 
-    while (PARAM_FULL(0) || (voodoo->render_threads >= 2 && PARAM_FULL(1)) || (voodoo->render_threads == 4 && (PARAM_FULL(2) || PARAM_FULL(3)))) {
-        thread_reset_event(voodoo->render_not_full_event[0]);
-        if (voodoo->render_threads >= 2)
-            thread_reset_event(voodoo->render_not_full_event[1]);
-        if (voodoo->render_threads == 4) {
-            thread_reset_event(voodoo->render_not_full_event[2]);
-            thread_reset_event(voodoo->render_not_full_event[3]);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        while (PARAM_FULL(c)) {
+            thread_reset_event(voodoo->render_not_full_event[c]);
+            if (PARAM_FULL(c))
+                thread_wait_event(voodoo->render_not_full_event[c], -1); /*Wait for room in ringbuffer*/
         }
-        if (PARAM_FULL(0))
-            thread_wait_event(voodoo->render_not_full_event[0], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads >= 2 && PARAM_FULL(1))
-            thread_wait_event(voodoo->render_not_full_event[1], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(2))
-            thread_wait_event(voodoo->render_not_full_event[2], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(3))
-            thread_wait_event(voodoo->render_not_full_event[3], -1); /*Wait for room in ringbuffer*/
     }
 
     voodoo_use_texture(voodoo, params, 0);
@@ -1627,8 +1698,15 @@ voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 
     memcpy(params_new, params, sizeof(voodoo_params_t));
 
+    /*Counted here rather than by the render threads, which each skip the triangles outside their tiles*/
+    voodoo->tri_count++;
+
     voodoo->params_write_idx++;
 
-    if (PARAM_ENTRIES(0) < 4 || (voodoo->render_threads >= 2 && PARAM_ENTRIES(1) < 4) || (voodoo->render_threads == 4 && (PARAM_ENTRIES(2) < 4 || PARAM_ENTRIES(3) < 4)))
-        voodoo_wake_render_thread(voodoo);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (PARAM_ENTRIES(c) < 4) {
+            voodoo_wake_render_thread(voodoo);
+            break;
+        }
+    }
 }
@@ -22,6 +22,10 @@
 #include <stddef.h>
 #include <wchar.h>
 #include <math.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    include <emmintrin.h>
+#    define VOODOO_TEXTURE_SSE2
+#endif
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include "cpu.h"
@@ -58,6 +62,19 @@ voodoo_texture_log(const char *fmt, ...)
 #    define voodoo_texture_log(fmt, ...)
 #endif
 
+/*Returns non-zero if any render thread has yet to draw a queued triangle
+  using this texture.*/
+static int
+voodoo_texture_in_use(voodoo_t *voodoo, texture_t *texture)
+{
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (texture->refcount != texture->refcount_r[c])
+            return 1;
+    }
+
+    return 0;
+}
+
 void
 voodoo_recalc_tex12(voodoo_t *voodoo, int tmu)
 {
@@ -239,357 +256,466 @@ voodoo_recalc_tex3(voodoo_t *voodoo, int tmu)
 
 #define makergba(r, g, b, a) ((b) | ((g) << 8) | ((r) << 16) | ((a) << 24))
 
+#define TEX_DATA_SIZE ((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4)
+
 void
-voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+voodoo_texture_cache_init(voodoo_t *voodoo, int size)
 {
-    int      c;
-    int      lod_min;
-    int      lod_max;
-    uint32_t addr = 0;
-    uint32_t addr_end;
-    uint32_t palette_checksum;
+    /*Replacement walks the cache with a mask, so the size must be a power of two*/
+    if ((size <= 0) || (size & (size - 1)))
+        size = TEX_CACHE_DEFAULT;
+
+    voodoo->texture_cache_size = size;
+
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        voodoo->texture_cache[tmu] = calloc(size, sizeof(texture_t));
+        for (int c = 0; c < size; c++)
+            voodoo->texture_cache[tmu][c].base = -1; /*invalid*/
+        for (int c = 0; c < TEX_HASH_SIZE; c++)
+            voodoo->texture_hash[tmu][c] = -1;
+    }
+}
 
-    lod_min = (params->tLOD[tmu] >> 2) & 15;
-    lod_max = (params->tLOD[tmu] >> 8) & 15;
+void
+voodoo_texture_cache_close(voodoo_t *voodoo)
+{
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        for (int c = 0; c < voodoo->texture_cache_size; c++)
+            free(voodoo->texture_cache[tmu][c].data);
+        free(voodoo->texture_cache[tmu]);
+        voodoo->texture_cache[tmu] = NULL;
+    }
+}
 
-    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88) {
-        if (voodoo->palette_dirty[tmu]) {
-            palette_checksum = 0;
+static __inline int
+voodoo_texture_hash(uint32_t base, uint32_t tLOD, uint32_t palette_checksum)
+{
+    uint32_t hash = (base ^ (tLOD << 5) ^ palette_checksum) * 0x9e3779b1;
 
-            for (c = 0; c < 256; c++)
-                palette_checksum ^= voodoo->palette[tmu][c].u;
+    return hash >> (32 - TEX_HASH_SHIFT);
+}
 
-            voodoo->palette_checksum[tmu] = palette_checksum;
-            voodoo->palette_dirty[tmu]    = 0;
-        } else
-            palette_checksum = voodoo->palette_checksum[tmu];
-    } else
-        palette_checksum = 0;
+/*Returns the number of pages covered by one LOD of a texture, starting at
+  *start. Like the texel fetches, the range wraps around the end of texture
+  memory.*/
+static int
+voodoo_texture_lod_pages(voodoo_t *voodoo, texture_t *texture, int lod, int *start)
+{
+    int page_mask = voodoo->texture_mask >> TEX_DIRTY_SHIFT;
+    int end;
 
-    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-        addr = params->texBaseAddr1[tmu];
-    else
-        addr = params->texBaseAddr[tmu];
+    *start = (texture->addr_start[lod] & voodoo->texture_mask) >> TEX_DIRTY_SHIFT;
+    if ((texture->addr_end[lod] - texture->addr_start[lod]) > voodoo->texture_mask)
+        return page_mask + 1;
 
-    /*Try to find texture in cache*/
-    for (c = 0; c < TEX_CACHE_MAX; c++) {
-        if (voodoo->texture_cache[tmu][c].base == addr && voodoo->texture_cache[tmu][c].tLOD == (params->tLOD[tmu] & 0xf00fff) && voodoo->texture_cache[tmu][c].palette_checksum == palette_checksum) {
-            params->tex_entry[tmu] = c;
-            voodoo->texture_cache[tmu][c].refcount++;
-            return;
+    end = ((texture->addr_end[lod] - 1) & voodoo->texture_mask) >> TEX_DIRTY_SHIFT;
+
+    return ((end - *start) & page_mask) + 1;
+}
+
+/*Adds delta to the texture_present count of every page holding the given
+  LODs of a texture.*/
+static void
+voodoo_texture_mark_present(voodoo_t *voodoo, int tmu, texture_t *texture, uint32_t lods, int delta)
+{
+    int page_mask = voodoo->texture_mask >> TEX_DIRTY_SHIFT;
+
+    for (uint8_t lod = 0; lod <= LOD_MAX; lod++) {
+        if (lods & (1 << lod)) {
+            int start;
+            int pages = voodoo_texture_lod_pages(voodoo, texture, lod, &start);
+
+            for (int page = 0; page < pages; page++)
+                voodoo->texture_present[tmu][(start + page) & page_mask] += delta;
         }
     }
+}
 
-    /*Texture not found, search for unused texture*/
-    do {
-        for (c = 0; c < TEX_CACHE_MAX; c++) {
-            voodoo->texture_last_removed++;
-            voodoo->texture_last_removed &= (TEX_CACHE_MAX - 1);
-            if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] && (voodoo->render_threads == 1 || voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
-                break;
-        }
-        if (c == TEX_CACHE_MAX)
-            voodoo_wait_for_render_thread_idle(voodoo);
-    } while (c == TEX_CACHE_MAX);
-    if (c == TEX_CACHE_MAX)
-        fatal("Texture cache full!\n");
+/*Returns the LODs of a texture that overlap the given page.*/
+static uint32_t
+voodoo_texture_lods_in_page(voodoo_t *voodoo, texture_t *texture, int page)
+{
+    int      page_mask = voodoo->texture_mask >> TEX_DIRTY_SHIFT;
+    uint32_t lods      = 0;
 
-    c = voodoo->texture_last_removed;
+    for (uint8_t lod = 0; lod <= LOD_MAX; lod++) {
+        if (texture->lod_valid & (1 << lod)) {
+            int start;
+            int pages = voodoo_texture_lod_pages(voodoo, texture, lod, &start);
 
-    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr1[tmu];
-    else
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr[tmu];
-    voodoo->texture_cache[tmu][c].tLOD = params->tLOD[tmu] & 0xf00fff;
+            if (((page - start) & page_mask) < pages)
+                lods |= (1 << lod);
+        }
+    }
 
-    lod_min = (params->tLOD[tmu] >> 2) & 15;
-    lod_max = (params->tLOD[tmu] >> 8) & 15;
-#if 0
-    voodoo_texture_log("  add new texture to %i tformat=%i %08x LOD=%i-%i tmu=%i\n", c, voodoo->params.tformat[tmu], params->texBaseAddr[tmu], lod_min, lod_max, tmu);
-#endif
-    lod_min = MIN(lod_min, 8);
-    lod_max = MIN(lod_max, 8);
-    for (int lod = lod_min; lod <= lod_max; lod++) {
-        uint32_t     *base     = &voodoo->texture_cache[tmu][c].data[texture_offset[lod]];
-        uint32_t      tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
-        int           x;
-        int           y;
-        int           shift = 8 - params->tex_lod[tmu][lod];
-        const rgba_u *pal;
+    return lods;
+}
 
-#if 0
-        voodoo_texture_log("  LOD %i : %08x - %08x %i %i,%i\n", lod, params->tex_base[tmu][lod] & voodoo->texture_mask, addr, voodoo->params.tformat[tmu], voodoo->params.tex_w_mask[tmu][lod],voodoo->params.tex_h_mask[tmu][lod]);
-#endif
+static void
+voodoo_texture_evict(voodoo_t *voodoo, int tmu, int c)
+{
+    texture_t *texture = &voodoo->texture_cache[tmu][c];
+    int       *link;
 
-        switch (params->tformat[tmu]) {
-            case TEX_RGB332:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+    if (texture->base == -1)
+        return;
 
-                        base[x] = makergba(rgb332[dat].r, rgb332[dat].g, rgb332[dat].b, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
-                }
-                break;
+    link = &voodoo->texture_hash[tmu][texture->hash];
+    while (*link != c)
+        link = &voodoo->texture_cache[tmu][*link].hash_next;
+    *link = texture->hash_next;
 
-            case TEX_Y4I2Q2:
-                pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+    voodoo_texture_mark_present(voodoo, tmu, texture, texture->lod_valid, -1);
+    texture->lod_valid = 0;
+    texture->base      = -1;
+}
 
-                        base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
-                }
-                break;
+/*Expands the colour of an 8-bit texel, or of the low byte of an 8-bit
+  colour/8-bit alpha texel, for every possible value.*/
+static void
+voodoo_texture_lookup8(voodoo_t *voodoo, voodoo_params_t *params, int tmu, uint32_t *lookup)
+{
+    const rgba_u *pal;
+
+    switch (params->tformat[tmu]) {
+        case TEX_RGB332:
+        case TEX_ARGB8332:
+            for (int c = 0; c < 256; c++)
+                lookup[c] = makergba(rgb332[c].r, rgb332[c].g, rgb332[c].b, 0xff);
+            break;
+
+        case TEX_Y4I2Q2:
+        case TEX_A8Y4I2Q2:
+            pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
+            for (int c = 0; c < 256; c++)
+                lookup[c] = makergba(pal[c].rgba.r, pal[c].rgba.g, pal[c].rgba.b, 0xff);
+            break;
+
+        case TEX_A8:
+            for (int c = 0; c < 256; c++)
+                lookup[c] = makergba(c, c, c, c);
+            break;
+
+        case TEX_I8:
+        case TEX_A8I8:
+            for (int c = 0; c < 256; c++)
+                lookup[c] = makergba(c, c, c, 0xff);
+            break;
+
+        case TEX_AI8:
+            for (int c = 0; c < 256; c++)
+                lookup[c] = makergba((c & 0x0f) | ((c << 4) & 0xf0), (c & 0x0f) | ((c << 4) & 0xf0), (c & 0x0f) | ((c << 4) & 0xf0), (c & 0xf0) | ((c >> 4) & 0x0f));
+            break;
+
+        case TEX_PAL8:
+        case TEX_APAL88:
+            pal = voodoo->palette[tmu];
+            for (int c = 0; c < 256; c++)
+                lookup[c] = makergba(pal[c].rgba.r, pal[c].rgba.g, pal[c].rgba.b, 0xff);
+            break;
+
+        case TEX_APAL8:
+            pal = voodoo->palette[tmu];
+            for (int c = 0; c < 256; c++) {
+                int r = ((pal[c].rgba.r & 3) << 6) | ((pal[c].rgba.g & 0xf0) >> 2) | (pal[c].rgba.r & 3);
+                int g = ((pal[c].rgba.g & 0xf) << 4) | ((pal[c].rgba.b & 0xc0) >> 4) | ((pal[c].rgba.g & 0xf) >> 2);
+                int b = ((pal[c].rgba.b & 0x3f) << 2) | ((pal[c].rgba.b & 0x30) >> 4);
+                int a = (pal[c].rgba.r & 0xfc) | ((pal[c].rgba.r & 0xc0) >> 6);
+
+                lookup[c] = makergba(r, g, b, a);
+            }
+            break;
 
-            case TEX_A8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_R5G6B5:
+        case TEX_ARGB1555:
+        case TEX_ARGB4444:
+            break;
 
-                        base[x] = makergba(dat, dat, dat, dat);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
-                }
-                break;
+        default:
+            fatal("Unknown texture format %i\n", params->tformat[tmu]);
+    }
+}
+
+#ifdef VOODOO_TEXTURE_SSE2
+/*Decodes 8 texels at a time of the formats that have no lookup table.
+  Returns the number of texels done.*/
+static int
+voodoo_texture_row16_sse2(uint32_t *base, const uint16_t *src, int w, int tformat)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int           x    = 0;
+
+    switch (tformat) {
+        case TEX_R5G6B5:
+            for (; (x + 8) <= w; x += 8) {
+                __m128i v  = _mm_loadu_si128((const __m128i *) &src[x]);
+                __m128i r  = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 8), _mm_set1_epi16(0xf8)), _mm_srli_epi16(v, 13));
+                __m128i g  = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 3), _mm_set1_epi16(0xfc)), _mm_and_si128(_mm_srli_epi16(v, 9), _mm_set1_epi16(3)));
+                __m128i b  = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 3), _mm_set1_epi16(0xf8)), _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi16(7)));
+                __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+                __m128i ra = _mm_or_si128(r, _mm_set1_epi16((int16_t) 0xff00));
+
+                _mm_storeu_si128((__m128i *) &base[x], _mm_unpacklo_epi16(bg, ra));
+                _mm_storeu_si128((__m128i *) &base[x + 4], _mm_unpackhi_epi16(bg, ra));
+            }
+            break;
+
+        case TEX_ARGB1555:
+            for (; (x + 8) <= w; x += 8) {
+                __m128i v  = _mm_loadu_si128((const __m128i *) &src[x]);
+                __m128i r  = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 7), _mm_set1_epi16(0xf8)), _mm_and_si128(_mm_srli_epi16(v, 12), _mm_set1_epi16(7)));
+                __m128i g  = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi16(0xf8)), _mm_and_si128(_mm_srli_epi16(v, 7), _mm_set1_epi16(7)));
+                __m128i b  = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 3), _mm_set1_epi16(0xf8)), _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi16(7)));
+                __m128i a  = _mm_and_si128(_mm_srai_epi16(v, 15), _mm_set1_epi16((int16_t) 0xff00));
+                __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+                __m128i ra = _mm_or_si128(r, a);
+
+                _mm_storeu_si128((__m128i *) &base[x], _mm_unpacklo_epi16(bg, ra));
+                _mm_storeu_si128((__m128i *) &base[x + 4], _mm_unpackhi_epi16(bg, ra));
+            }
+            break;
 
-            case TEX_I8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_ARGB4444:
+            for (; (x + 8) <= w; x += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i *) &src[x]);
 
-                        base[x] = makergba(dat, dat, dat, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
-                }
-                break;
+                for (uint8_t half = 0; half < 2; half++) {
+                    __m128i n = half ? _mm_unpackhi_epi16(v, zero) : _mm_unpacklo_epi16(v, zero);
 
-            case TEX_AI8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+                    /*Spread the four nibbles into the low halves of the four bytes, then copy them up*/
+                    n = _mm_or_si128(_mm_or_si128(_mm_and_si128(n, _mm_set1_epi32(0x000f)), _mm_slli_epi32(_mm_and_si128(n, _mm_set1_epi32(0x00f0)), 4)),
+                                     _mm_or_si128(_mm_slli_epi32(_mm_and_si128(n, _mm_set1_epi32(0x0f00)), 8), _mm_slli_epi32(_mm_and_si128(n, _mm_set1_epi32(0xf000)), 12)));
+                    n = _mm_or_si128(n, _mm_slli_epi32(n, 4));
 
-                        base[x] = makergba((dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0xf0) | ((dat >> 4) & 0x0f));
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    _mm_storeu_si128((__m128i *) &base[x + half * 4], n);
                 }
-                break;
+            }
+            break;
 
-            case TEX_PAL8:
-                pal = voodoo->palette[tmu];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        default:
+            break;
+    }
 
-                        base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
-                }
-                break;
+    return x;
+}
+#endif
 
-            case TEX_APAL8:
-                pal = voodoo->palette[tmu];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+static void
+voodoo_texture_decode_row16(voodoo_t *voodoo, int tmu, int tformat, uint32_t *base, uint32_t tex_addr, int w, const uint32_t *lookup)
+{
+    const uint8_t *tex_mem = voodoo->tex_mem[tmu];
+    int            x       = 0;
 
-                        int r = ((pal[dat].rgba.r & 3) << 6) | ((pal[dat].rgba.g & 0xf0) >> 2) | (pal[dat].rgba.r & 3);
-                        int g = ((pal[dat].rgba.g & 0xf) << 4) | ((pal[dat].rgba.b & 0xc0) >> 4) | ((pal[dat].rgba.g & 0xf) >> 2);
-                        int b = ((pal[dat].rgba.b & 0x3f) << 2) | ((pal[dat].rgba.b & 0x30) >> 4);
-                        int a = (pal[dat].rgba.r & 0xfc) | ((pal[dat].rgba.r & 0xc0) >> 6);
+    tex_addr &= voodoo->texture_mask;
 
-                        base[x] = makergba(r, g, b, a);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
-                }
-                break;
+#ifdef VOODOO_TEXTURE_SSE2
+    if ((tex_addr + (w << 1)) <= (voodoo->texture_mask + 1))
+        x = voodoo_texture_row16_sse2(base, (const uint16_t *) &tex_mem[tex_addr], w, tformat);
+#endif
 
-            case TEX_ARGB8332:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+    switch (tformat) {
+        case TEX_R5G6B5:
+            for (; x < w; x++) {
+                uint16_t dat = *(uint16_t *) &tex_mem[(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(rgb332[dat & 0xff].r, rgb332[dat & 0xff].g, rgb332[dat & 0xff].b, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
-                }
-                break;
+                base[x] = makergba(rgb565[dat].r, rgb565[dat].g, rgb565[dat].b, 0xff);
+            }
+            break;
 
-            case TEX_A8Y4I2Q2:
-                pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_ARGB1555:
+            for (; x < w; x++) {
+                uint16_t dat = *(uint16_t *) &tex_mem[(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
-                }
-                break;
+                base[x] = makergba(argb1555[dat].r, argb1555[dat].g, argb1555[dat].b, argb1555[dat].a);
+            }
+            break;
 
-            case TEX_R5G6B5:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_ARGB4444:
+            for (; x < w; x++) {
+                uint16_t dat = *(uint16_t *) &tex_mem[(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(rgb565[dat].r, rgb565[dat].g, rgb565[dat].b, 0xff);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
-                }
-                break;
+                base[x] = makergba(argb4444[dat].r, argb4444[dat].g, argb4444[dat].b, argb4444[dat].a);
+            }
+            break;
 
-            case TEX_ARGB1555:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        default: /*Colour from the low byte, alpha from the high byte*/
+            for (; x < w; x++) {
+                uint16_t dat = *(uint16_t *) &tex_mem[(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(argb1555[dat].r, argb1555[dat].g, argb1555[dat].b, argb1555[dat].a);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
-                }
-                break;
+                base[x] = (lookup[dat & 0xff] & 0x00ffffff) | ((uint32_t) (dat >> 8) << 24);
+            }
+            break;
+    }
+}
 
-            case TEX_ARGB4444:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+/*Decodes the given LODs of a texture into 32-bit ARGB.*/
+static void
+voodoo_texture_decode(voodoo_t *voodoo, voodoo_params_t *params, int tmu, texture_t *texture, uint32_t lods)
+{
+    uint32_t lookup[256];
 
-                        base[x] = makergba(argb4444[dat].r, argb4444[dat].g, argb4444[dat].b, argb4444[dat].a);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
-                }
-                break;
+    voodoo_texture_lookup8(voodoo, params, tmu, lookup);
 
-            case TEX_A8I8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+    for (uint8_t lod = 0; lod <= LOD_MAX; lod++) {
+        uint32_t *base;
+        uint32_t  tex_addr;
+        int       w;
+        int       h;
+        int       shift;
 
-                        base[x] = makergba(dat & 0xff, dat & 0xff, dat & 0xff, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
-                }
-                break;
+        if (!(lods & (1 << lod)))
+            continue;
 
-            case TEX_APAL88:
-                pal = voodoo->palette[tmu];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        base     = &texture->data[texture_offset[lod]];
+        tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
+        w        = voodoo->params.tex_w_mask[tmu][lod] + 1;
+        h        = voodoo->params.tex_h_mask[tmu][lod] + 1;
+        shift    = 8 - params->tex_lod[tmu][lod];
 
-                        base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
-                }
-                break;
+#if 0
+        voodoo_texture_log("  LOD %i : %08x - %08x %i %i,%i\n", lod, params->tex_base[tmu][lod] & voodoo->texture_mask, addr, voodoo->params.tformat[tmu], voodoo->params.tex_w_mask[tmu][lod],voodoo->params.tex_h_mask[tmu][lod]);
+#endif
 
-            default:
-                fatal("Unknown texture format %i\n", params->tformat[tmu]);
+        if (params->tformat[tmu] & 8) {
+            for (int y = 0; y < h; y++) {
+                voodoo_texture_decode_row16(voodoo, tmu, params->tformat[tmu], base, tex_addr, w, lookup);
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+        } else {
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++)
+                    base[x] = lookup[voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask]];
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
         }
+
+        texture->addr_start[lod] = params->tex_base[tmu][lod];
+        texture->addr_end[lod]   = params->tex_end[tmu][lod];
     }
 
-    voodoo->texture_cache[tmu][c].is16 = voodoo->params.tformat[tmu] & 8;
+    texture->is16 = voodoo->params.tformat[tmu] & 8;
 
-    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
-        voodoo->texture_cache[tmu][c].palette_checksum = palette_checksum;
-    else
-        voodoo->texture_cache[tmu][c].palette_checksum = 0;
+    voodoo_texture_mark_present(voodoo, tmu, texture, lods, 1);
+    texture->lod_valid |= lods;
+}
 
-    if (lod_min == 0) {
-        voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->params.tex_base[tmu][0];
-        voodoo->texture_cache[tmu][c].addr_end[0]   = voodoo->params.tex_end[tmu][0];
-    } else
-        voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->texture_cache[tmu][c].addr_end[0] = 0;
+void
+voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+{
+    texture_t *texture = NULL;
+    int        c;
+    int        hash;
+    int        lod_min;
+    int        lod_max;
+    uint32_t   lods = 0;
+    uint32_t   addr = 0;
+    uint32_t   tLOD;
+    uint32_t   palette_checksum;
 
-    if (lod_min <= 1 && lod_max >= 1) {
-        voodoo->texture_cache[tmu][c].addr_start[1] = voodoo->params.tex_base[tmu][1];
-        voodoo->texture_cache[tmu][c].addr_end[1]   = voodoo->params.tex_end[tmu][1];
-    } else
-        voodoo->texture_cache[tmu][c].addr_start[1] = voodoo->texture_cache[tmu][c].addr_end[1] = 0;
+    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88) {
+        if (voodoo->palette_dirty[tmu]) {
+            palette_checksum = 0;
 
-    if (lod_min <= 2 && lod_max >= 2) {
-        voodoo->texture_cache[tmu][c].addr_start[2] = voodoo->params.tex_base[tmu][2];
-        voodoo->texture_cache[tmu][c].addr_end[2]   = voodoo->params.tex_end[tmu][2];
-    } else
-        voodoo->texture_cache[tmu][c].addr_start[2] = voodoo->texture_cache[tmu][c].addr_end[2] = 0;
+            for (c = 0; c < 256; c++)
+                palette_checksum ^= voodoo->palette[tmu][c].u;
 
-    if (lod_max >= 3) {
-        voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->params.tex_base[tmu][(lod_min > 3) ? lod_min : 3];
-        voodoo->texture_cache[tmu][c].addr_end[3]   = voodoo->params.tex_end[tmu][(lod_max < 8) ? lod_max : 8];
+            voodoo->palette_checksum[tmu] = palette_checksum;
+            voodoo->palette_dirty[tmu]    = 0;
+        } else
+            palette_checksum = voodoo->palette_checksum[tmu];
     } else
-        voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->texture_cache[tmu][c].addr_end[3] = 0;
+        palette_checksum = 0;
+
+    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
+        addr = params->texBaseAddr1[tmu];
+    else
+        addr = params->texBaseAddr[tmu];
+    tLOD = params->tLOD[tmu] & 0xf00fff;
 
-    for (uint8_t d = 0; d < 4; d++) {
-        addr     = voodoo->texture_cache[tmu][c].addr_start[d];
-        addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
+    lod_min = MIN((params->tLOD[tmu] >> 2) & 15, 8);
+    lod_max = MIN((params->tLOD[tmu] >> 8) & 15, 8);
+    for (int lod = lod_min; lod <= lod_max; lod++)
+        lods |= (1 << lod);
 
-        if (addr_end != 0) {
-            for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT))
-                voodoo->texture_present[tmu][(addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-        }
+    /*Try to find texture in cache*/
+    hash = voodoo_texture_hash(addr, tLOD, palette_checksum);
+    for (c = voodoo->texture_hash[tmu][hash]; c != -1; c = texture->hash_next) {
+        texture = &voodoo->texture_cache[tmu][c];
+        if (texture->base == addr && texture->tLOD == tLOD && texture->palette_checksum == palette_checksum)
+            break;
     }
 
+    if (c == -1) {
+        /*Texture not found, search for unused texture*/
+        do {
+            for (c = 0; c < voodoo->texture_cache_size; c++) {
+                voodoo->texture_last_removed++;
+                voodoo->texture_last_removed &= (voodoo->texture_cache_size - 1);
+                if (!voodoo_texture_in_use(voodoo, &voodoo->texture_cache[tmu][voodoo->texture_last_removed]))
+                    break;
+            }
+            if (c == voodoo->texture_cache_size)
+                voodoo_wait_for_render_thread_idle(voodoo);
+        } while (c == voodoo->texture_cache_size);
+
+        c       = voodoo->texture_last_removed;
+        texture = &voodoo->texture_cache[tmu][c];
+#if 0
+        voodoo_texture_log("  add new texture to %i tformat=%i %08x LOD=%i-%i tmu=%i\n", c, voodoo->params.tformat[tmu], params->texBaseAddr[tmu], lod_min, lod_max, tmu);
+#endif
+        voodoo_texture_evict(voodoo, tmu, c);
+
+        texture->base             = addr;
+        texture->tLOD             = tLOD;
+        texture->palette_checksum = palette_checksum;
+        texture->hash             = hash;
+        texture->hash_next        = voodoo->texture_hash[tmu][hash];
+
+        voodoo->texture_hash[tmu][hash] = c;
+
+        if (!texture->data)
+            texture->data = malloc(TEX_DATA_SIZE);
+    } else if ((texture->lod_valid & lods) != lods && voodoo_texture_in_use(voodoo, texture)) {
+        /*Queued triangles still need the old texels*/
+        voodoo_wait_for_render_thread_idle(voodoo);
+    }
+
+    /*Only decode the LODs that are missing or have been written to since*/
+    if ((texture->lod_valid & lods) != lods)
+        voodoo_texture_decode(voodoo, params, tmu, texture, lods & ~texture->lod_valid);
+
     params->tex_entry[tmu] = c;
-    voodoo->texture_cache[tmu][c].refcount++;
+    texture->refcount++;
 }
 
 void
 flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 {
-    int wait_for_idle = 0;
+    int page = dirty_addr >> TEX_DIRTY_SHIFT;
 
-    memset(voodoo->texture_present[tmu], 0, sizeof(voodoo->texture_present[0]));
 #if 0
     voodoo_texture_log("Evict %08x %i\n", dirty_addr, sizeof(voodoo->texture_present));
 #endif
-    for (uint8_t c = 0; c < TEX_CACHE_MAX; c++) {
-        if (voodoo->texture_cache[tmu][c].base != -1) {
-            for (uint8_t d = 0; d < 4; d++) {
-                int addr_start = voodoo->texture_cache[tmu][c].addr_start[d];
-                int addr_end   = voodoo->texture_cache[tmu][c].addr_end[d];
-
-                if (addr_end != 0) {
-                    int addr_start_masked = addr_start & voodoo->texture_mask & ~0x3ff;
-                    int addr_end_masked   = ((addr_end & voodoo->texture_mask) + 0x3ff) & ~0x3ff;
-
-                    if (addr_end_masked < addr_start_masked)
-                        addr_end_masked = voodoo->texture_mask + 1;
-                    if (dirty_addr >= addr_start_masked && dirty_addr < addr_end_masked) {
-#if 0
-                        voodoo_texture_log("  Evict texture %i %08x\n", c, voodoo->texture_cache[tmu][c].base);
-#endif
+    /*Drop only the LODs that live in the written page. Decoded data is left
+      alone until the texture is next used, so queued triangles are unaffected.*/
+    for (int c = 0; c < voodoo->texture_cache_size; c++) {
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
+        uint32_t   lods;
 
-                        if (voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[0] || (voodoo->render_threads == 2 && voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[1]))
-                            wait_for_idle = 1;
+        if (!texture->lod_valid)
+            continue;
 
-                        voodoo->texture_cache[tmu][c].base = -1;
-                    } else {
-                        for (; addr_start <= addr_end; addr_start += (1 << TEX_DIRTY_SHIFT))
-                            voodoo->texture_present[tmu][(addr_start & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-                    }
-                }
-            }
+        lods = voodoo_texture_lods_in_page(voodoo, texture, page);
+        if (lods) {
+#if 0
+            voodoo_texture_log("  Evict texture %i %08x LODs %03x\n", c, texture->base, lods);
+#endif
+            voodoo_texture_mark_present(voodoo, tmu, texture, lods, -1);
+            texture->lod_valid &= ~lods;
         }
     }
-    if (wait_for_idle)
-        voodoo_wait_for_render_thread_idle(voodoo);
 }
 
 void
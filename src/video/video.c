@@ -50,7 +50,6 @@
  */
 #include <stdatomic.h>
 #define PNG_DEBUG 0
-#include <png.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -234,6 +233,31 @@ const uint32_t shade[5][256] = {
     }
 };
 
+/* Frames go from the emulation to the blit thread through three buffers:
+   the emulation draws into the back one, the blit thread presents the
+   front one, and the newest finished frame waits in the ready one. Both
+   sides only ever swap their own buffer with the ready one, so neither
+   waits for the other; a ready frame that is replaced before the blit
+   thread gets to it is simply dropped. */
+#define BLIT_FRAMES    3
+#define BLIT_FRAME_NEW 0x04
+
+typedef struct blit_frame_t {
+    bitmap_t *buffer;
+    int       x, y, w, h;
+    uint32_t  refresh_mhz; /* Guest frame rate in millihertz, 0 if unknown. */
+
+    /* Rows that changed since the frame the blit thread may have presented
+       last, set by the emulation before the frame is published. */
+    uint32_t dirty_lines[2048 / 32];
+    int      dirty_full;
+
+    /* Rows of this buffer that are older than the newest published frame;
+       only touched by the emulation. */
+    uint32_t stale_lines[2048 / 32];
+    int      stale_full;
+} blit_frame_t;
+
 typedef struct blit_data_struct {
     int x, y, w, h;
     int busy;
@@ -241,6 +265,31 @@ typedef struct blit_data_struct {
     int thread_run;
     int monitor_index;
 
+    uint32_t last_blit_ticks;
+
+    /* Emulated time between published frames, averaged over a few frames;
+       only touched by the emulation. */
+    uint64_t last_frame_tsc;
+    double   frame_us;
+
+    /* Rows written since the last blit, and the spans handed to the
+       current one. */
+    uint32_t     dirty_lines[2048 / 32];
+    int          dirty_full;
+    int          dirty_count;
+    video_span_t dirty[VIDEO_DIRTY_SPANS];
+
+    /* Rows of every frame published since the last one known to have been
+       taken by the blit thread. */
+    uint32_t pending_lines[2048 / 32];
+    int      pending_full;
+
+    blit_frame_t frames[BLIT_FRAMES];
+    int          back;
+    int          front;
+    int          newest;
+    atomic_int   ready;
+
     thread_t *blit_thread;
     event_t  *wake_blit_thread;
     event_t  *blit_complete;
@@ -294,100 +343,20 @@ video_wait_for_blit_monitor(int monitor_index)
     thread_reset_event(blit_data_ptr->blit_complete);
 }
 
+/* The emulation always draws into a buffer of its own, so there is nothing
+   to wait for before starting a new frame. */
 void
-video_wait_for_buffer_monitor(int monitor_index)
-{
-    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
-
-    while (blit_data_ptr->buffer_in_use)
-        thread_wait_event(blit_data_ptr->buffer_not_in_use, -1);
-    thread_reset_event(blit_data_ptr->buffer_not_in_use);
-}
-
-static png_structp png_ptr[MONITORS_NUM];
-static png_infop   info_ptr[MONITORS_NUM];
-
-static void
-video_take_screenshot_monitor(const char *fn, uint32_t *buf, int start_x, int start_y, int row_len, int monitor_index)
+video_wait_for_buffer_monitor(UNUSED(int monitor_index))
 {
-    png_bytep         *b_rgb         = NULL;
-    FILE              *fp            = NULL;
-    uint32_t           temp          = 0x00000000;
-    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
-
-    /* create file */
-    fp = plat_fopen(fn, (const char *) "wb");
-    if (!fp) {
-        video_log("[video_take_screenshot] File %s could not be opened for writing", fn);
-        return;
-    }
-
-    /* initialize stuff */
-    png_ptr[monitor_index] = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-
-    if (!png_ptr[monitor_index]) {
-        video_log("[video_take_screenshot] png_create_write_struct failed");
-        fclose(fp);
-        return;
-    }
-
-    info_ptr[monitor_index] = png_create_info_struct(png_ptr[monitor_index]);
-    if (!info_ptr[monitor_index]) {
-        video_log("[video_take_screenshot] png_create_info_struct failed");
-        fclose(fp);
-        return;
-    }
-
-    png_init_io(png_ptr[monitor_index], fp);
-
-    png_set_IHDR(png_ptr[monitor_index], info_ptr[monitor_index], blit_data_ptr->w, blit_data_ptr->h,
-                 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
-                 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-
-    b_rgb = (png_bytep *) malloc(sizeof(png_bytep) * blit_data_ptr->h);
-    if (b_rgb == NULL) {
-        video_log("[video_take_screenshot] Unable to Allocate RGB Bitmap Memory");
-        fclose(fp);
-        return;
-    }
-
-    for (int y = 0; y < blit_data_ptr->h; ++y) {
-        b_rgb[y] = (png_byte *) malloc(png_get_rowbytes(png_ptr[monitor_index], info_ptr[monitor_index]));
-        for (int x = 0; x < blit_data_ptr->w; ++x) {
-            if (buf == NULL)
-                memset(&(b_rgb[y][x * 3]), 0x00, 3);
-            else {
-                temp                  = buf[((start_y + y) * row_len) + start_x + x];
-                b_rgb[y][x * 3]       = (temp >> 16) & 0xff;
-                b_rgb[y][(x * 3) + 1] = (temp >> 8) & 0xff;
-                b_rgb[y][(x * 3) + 2] = temp & 0xff;
-            }
-        }
-    }
-
-    png_write_info(png_ptr[monitor_index], info_ptr[monitor_index]);
-
-    png_write_image(png_ptr[monitor_index], b_rgb);
-
-    png_write_end(png_ptr[monitor_index], NULL);
-
-    /* cleanup heap allocation */
-    for (int i = 0; i < blit_data_ptr->h; i++)
-        if (b_rgb[i])
-            free(b_rgb[i]);
-
-    if (b_rgb)
-        free(b_rgb);
-
-    if (fp)
-        fclose(fp);
+    //
 }
 
 void
 video_screenshot_monitor(uint32_t *buf, int start_x, int start_y, int row_len, int monitor_index)
 {
-    char path[1024];
-    char fn[256];
+    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+    char               path[1024];
+    char               fn[256];
 
     memset(fn, 0, sizeof(fn));
     memset(path, 0, sizeof(path));
@@ -406,8 +375,9 @@ video_screenshot_monitor(uint32_t *buf, int start_x, int start_y, int row_len, i
 
     video_log("taking screenshot to: %s\n", path);
 
-    video_take_screenshot_monitor((const char *) path, buf, start_x, start_y, row_len, monitor_index);
-    png_destroy_write_struct(&png_ptr[monitor_index], &info_ptr[monitor_index]);
+    /* Only the copy happens here, the PNG is written by the capture thread. */
+    video_capture_screenshot((const char *) path, buf, start_x, start_y, row_len,
+                             blit_data_ptr->w, blit_data_ptr->h, monitor_index);
 
     atomic_fetch_sub(&monitors[monitor_index].mon_screenshots, 1);
 }
@@ -441,46 +411,241 @@ video_transform_copy(void *__restrict _Dst, const void *__restrict _Src, size_t
     return _Dst;
 }
 
+static void video_collect_dirty(blit_data_t *data, const blit_frame_t *frame);
+
 static void
 blit_thread(void *param)
 {
-    blit_data_t *data = param;
+    blit_data_t  *data = param;
+    monitor_t    *mon  = &monitors[data->monitor_index];
+    blit_frame_t *frame;
+
     while (data->thread_run) {
         thread_wait_event(data->wake_blit_thread, -1);
         thread_reset_event(data->wake_blit_thread);
-        MTR_BEGIN("video", "blit_thread");
 
-        if (blit_func)
-            blit_func(data->x, data->y, data->w, data->h, data->monitor_index);
+        /* Only the emulation sets the new flag, so once it is seen the
+           exchange is guaranteed to hand over a fresh frame. */
+        while (data->thread_run && (atomic_load(&data->ready) & BLIT_FRAME_NEW)) {
+            MTR_BEGIN("video", "blit_thread");
+
+            data->busy  = 1;
+            data->front = atomic_exchange(&data->ready, data->front) & ~BLIT_FRAME_NEW;
+            frame       = &data->frames[data->front];
+
+            mon->front_buffer = frame->buffer;
+            data->x           = frame->x;
+            data->y           = frame->y;
+            data->w           = frame->w;
+            data->h           = frame->h;
+            video_collect_dirty(data, frame);
+
+            if (video_capture_stream_active())
+                video_capture_frame(frame->buffer->dat, data->x, data->y, frame->buffer->w,
+                                    data->w, data->h, frame->refresh_mhz, data->monitor_index);
 
-        data->busy = 0;
+            data->buffer_in_use = 1;
+            if (blit_func)
+                blit_func(data->x, data->y, data->w, data->h, data->monitor_index);
 
-        MTR_END("video", "blit_thread");
-        thread_set_event(data->blit_complete);
+            /* The front buffer stays with the renderer until it says it is
+               done reading it. */
+            while (data->buffer_in_use && data->thread_run)
+                thread_wait_event(data->buffer_not_in_use, 100);
+            thread_reset_event(data->buffer_not_in_use);
+
+            data->busy = 0;
+
+            MTR_END("video", "blit_thread");
+            thread_set_event(data->blit_complete);
+        }
     }
 }
 
 void
-video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
+video_mark_dirty_monitor(int y, int h, int monitor_index)
 {
+    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    for (int i = y; i < (y + h); i++)
+        blit_data_ptr->dirty_lines[(i & 0x7ff) >> 5] |= (1U << (i & 31));
+}
+
+/* Only valid from within the blit function; a count of zero means nothing
+   in the blitted rectangle has changed since the previous blit. */
+int
+video_get_dirty_spans_monitor(const video_span_t **spans, int monitor_index)
+{
+    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    *spans = blit_data_ptr->dirty;
+    return blit_data_ptr->dirty_count;
+}
+
+/* Turn the rows a frame reports as changed into spans clipped to the
+   blitted rectangle, merging the tail once the span list is full. */
+static void
+video_collect_dirty(blit_data_t *data, const blit_frame_t *frame)
+{
+    int start = -1;
+    int dirty;
+    int y     = frame->y;
+    int h     = frame->h;
+
+    data->dirty_count = 0;
+
+    if (frame->dirty_full) {
+        data->dirty[0].y  = y;
+        data->dirty[0].h  = h;
+        data->dirty_count = 1;
+    } else {
+        for (int i = y; i <= (y + h); i++) {
+            dirty = (i < (y + h)) && (frame->dirty_lines[(i & 0x7ff) >> 5] & (1U << (i & 31)));
+
+            if (dirty && (start < 0))
+                start = i;
+            else if (!dirty && (start >= 0)) {
+                if (data->dirty_count == VIDEO_DIRTY_SPANS)
+                    data->dirty[VIDEO_DIRTY_SPANS - 1].h = i - data->dirty[VIDEO_DIRTY_SPANS - 1].y;
+                else {
+                    data->dirty[data->dirty_count].y = start;
+                    data->dirty[data->dirty_count].h = i - start;
+                    data->dirty_count++;
+                }
+                start = -1;
+            }
+        }
+    }
+}
+
+/* Bring the new back buffer up to date with the frame just published, so
+   that renderers which only redraw changed lines keep working. */
+static void
+video_sync_back(blit_frame_t *back, const blit_frame_t *newest)
+{
+    size_t len = newest->w * sizeof(uint32_t);
+
+    for (int i = newest->y; i < (newest->y + newest->h); i++) {
+        if (back->stale_full || (back->stale_lines[(i & 0x7ff) >> 5] & (1U << (i & 31))))
+            memcpy(&back->buffer->line[i][newest->x], &newest->buffer->line[i][newest->x], len);
+    }
+
+    memset(back->stale_lines, 0, sizeof(back->stale_lines));
+    back->stale_full = 0;
+}
+
+/* Hand the back buffer over as the ready frame and take whichever buffer
+   was ready in its place; this never waits for the blit thread. */
+static void
+video_publish(blit_data_t *data, int x, int y, int w, int h, int monitor_index)
+{
+    blit_frame_t       *frame  = &data->frames[data->back];
+    const blit_frame_t *newest = &data->frames[data->newest];
+    blit_frame_t       *other;
+    int                 old;
+
+    if ((x != newest->x) || (y != newest->y) || (w != newest->w) || (h != newest->h))
+        data->dirty_full = 1;
+
+    frame->x           = x;
+    frame->y           = y;
+    frame->w           = w;
+    frame->h           = h;
+    frame->refresh_mhz = (data->frame_us > 0.0) ? (uint32_t) (1000000000.0 / data->frame_us + 0.5) : 0;
+    frame->dirty_full  = data->pending_full | data->dirty_full;
+    for (uint8_t i = 0; i < (2048 / 32); i++)
+        frame->dirty_lines[i] = data->pending_lines[i] | data->dirty_lines[i];
+
+    for (uint8_t f = 0; f < BLIT_FRAMES; f++) {
+        if (f == data->back)
+            continue;
+        other = &data->frames[f];
+        other->stale_full |= data->dirty_full;
+        for (uint8_t i = 0; i < (2048 / 32); i++)
+            other->stale_lines[i] |= data->dirty_lines[i];
+    }
+
+    old = atomic_exchange(&data->ready, data->back | BLIT_FRAME_NEW);
+
+    /* If the frame that was ready got taken, the blit thread has seen
+       everything before this one; if it was dropped, its changes have to
+       be carried along until a frame does get taken. */
+    if (old & BLIT_FRAME_NEW) {
+        data->pending_full = frame->dirty_full;
+        memcpy(data->pending_lines, frame->dirty_lines, sizeof(data->pending_lines));
+    } else {
+        data->pending_full = data->dirty_full;
+        memcpy(data->pending_lines, data->dirty_lines, sizeof(data->pending_lines));
+    }
+
+    memset(data->dirty_lines, 0, sizeof(data->dirty_lines));
+    data->dirty_full = 0;
+
+    data->newest = data->back;
+    data->back   = old & ~BLIT_FRAME_NEW;
+    video_sync_back(&data->frames[data->back], frame);
+    monitors[monitor_index].target_buffer = data->frames[data->back].buffer;
+}
+
+static void
+video_blit_start(int x, int y, int w, int h, int dirty_tracked, int monitor_index)
+{
+    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    /* A caller that does not track rows may have touched any of them, so
+       the next blit that does go out has to present the whole rectangle. */
+    if (!dirty_tracked)
+        blit_data_ptr->dirty_full = 1;
+
+    /* In turbo mode the guest produces frames faster than real time, so only
+       present them at the requested host frame rate. */
+    if (turbo_mode && (turbo_fps > 0)) {
+        uint32_t ticks = plat_get_ticks();
+
+        if ((ticks - blit_data_ptr->last_blit_ticks) < (uint32_t) (1000 / turbo_fps))
+            return;
+
+        blit_data_ptr->last_blit_ticks = ticks;
+    }
+
     MTR_BEGIN("video", "video_blit_memtoscreen");
 
     if ((w <= 0) || (h <= 0))
         return;
 
-    video_wait_for_blit_monitor(monitor_index);
+    /* Measure the guest frame rate in emulated time, so that captured
+       streams play back at the speed the guest ran at. */
+    if (blit_data_ptr->last_frame_tsc && (tsc > blit_data_ptr->last_frame_tsc)) {
+        double us = ((double) (tsc - blit_data_ptr->last_frame_tsc) * 4294967296.0) / (double) TIMER_USEC;
+
+        if (blit_data_ptr->frame_us > 0.0)
+            blit_data_ptr->frame_us += (us - blit_data_ptr->frame_us) / 8.0;
+        else
+            blit_data_ptr->frame_us = us;
+    }
+    blit_data_ptr->last_frame_tsc = tsc;
 
-    monitors[monitor_index].mon_blit_data_ptr->busy          = 1;
-    monitors[monitor_index].mon_blit_data_ptr->buffer_in_use = 1;
-    monitors[monitor_index].mon_blit_data_ptr->x             = x;
-    monitors[monitor_index].mon_blit_data_ptr->y             = y;
-    monitors[monitor_index].mon_blit_data_ptr->w             = w;
-    monitors[monitor_index].mon_blit_data_ptr->h             = h;
+    video_publish(blit_data_ptr, x, y, w, h, monitor_index);
 
-    thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    thread_set_event(blit_data_ptr->wake_blit_thread);
     MTR_END("video", "video_blit_memtoscreen");
 }
 
+void
+video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
+{
+    video_blit_start(x, y, w, h, 0, monitor_index);
+}
+
+/* Like video_blit_memtoscreen_monitor(), but only the rows marked with
+   video_mark_dirty_monitor() since the previous blit are reported as
+   changed to the blit function. */
+void
+video_blit_memtoscreen_dirty_monitor(int x, int y, int w, int h, int monitor_index)
+{
+    video_blit_start(x, y, w, h, 1, monitor_index);
+}
+
 uint8_t
 pixels8(uint32_t *pixels)
 {
@@ -857,13 +1022,21 @@ video_monitor_init(int index)
     monitors[index].mon_unscaled_size_y                  = 480;
     monitors[index].mon_bpp                              = 8;
     monitors[index].mon_changeframecount                 = 2;
-    monitors[index].target_buffer                        = create_bitmap(2048, 2048);
     monitors[index].mon_blit_data_ptr                    = calloc(1, sizeof(blit_data_t));
+    for (uint8_t i = 0; i < BLIT_FRAMES; i++)
+        monitors[index].mon_blit_data_ptr->frames[i].buffer = create_bitmap(2048, 2048);
+    monitors[index].mon_blit_data_ptr->back              = 0;
+    monitors[index].mon_blit_data_ptr->front             = 2;
+    monitors[index].mon_blit_data_ptr->newest            = 1;
+    atomic_init(&monitors[index].mon_blit_data_ptr->ready, 1);
+    monitors[index].target_buffer                        = monitors[index].mon_blit_data_ptr->frames[0].buffer;
+    monitors[index].front_buffer                         = monitors[index].mon_blit_data_ptr->frames[2].buffer;
     monitors[index].mon_blit_data_ptr->wake_blit_thread  = thread_create_event();
     monitors[index].mon_blit_data_ptr->blit_complete     = thread_create_event();
     monitors[index].mon_blit_data_ptr->buffer_not_in_use = thread_create_event();
     monitors[index].mon_blit_data_ptr->thread_run        = 1;
     monitors[index].mon_blit_data_ptr->monitor_index     = index;
+    monitors[index].mon_blit_data_ptr->dirty_full        = 1;
     monitors[index].mon_pal_lookup                       = calloc(sizeof(uint32_t), 256);
     monitors[index].mon_cga_palette                      = calloc(1, sizeof(int));
     monitors[index].mon_force_resize                     = 1;
@@ -889,13 +1062,15 @@ video_monitor_close(int monitor_index)
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->buffer_not_in_use);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->blit_complete);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    for (uint8_t i = 0; i < BLIT_FRAMES; i++)
+        destroy_bitmap(monitors[monitor_index].mon_blit_data_ptr->frames[i].buffer);
     free(monitors[monitor_index].mon_blit_data_ptr);
     if (!monitors[monitor_index].mon_pal_lookup_static)
         free(monitors[monitor_index].mon_pal_lookup);
     if (!monitors[monitor_index].mon_cga_palette_static)
         free(monitors[monitor_index].mon_cga_palette);
-    destroy_bitmap(monitors[monitor_index].target_buffer);
     monitors[monitor_index].target_buffer = NULL;
+    monitors[monitor_index].front_buffer  = NULL;
     memset(&monitors[monitor_index], 0, sizeof(monitor_t));
 }
 
@@ -947,6 +1122,22 @@ video_init(void)
             egaremap2bpp[c] |= 0x08;
     }
 
+    video_init_tables();
+
+    memset(monitors, 0, sizeof(monitors));
+    video_monitor_init(0);
+
+    video_capture_init();
+}
+
+/* Builds the colour conversion tables, which the renderers and the scanline
+   converter check both need. */
+void
+video_init_tables(void)
+{
+    if (video_6to8 != NULL)
+        return;
+
     video_6to8 = malloc(4 * 256);
     for (uint16_t c = 0; c < 256; c++)
         video_6to8[c] = calc_6to8(c);
@@ -966,9 +1157,6 @@ video_init(void)
     video_16to32 = malloc(4 * 65536);
     for (uint32_t c = 0; c < 65536; c++)
         video_16to32[c] = calc_16to32(c);
-
-    memset(monitors, 0, sizeof(monitors));
-    video_monitor_init(0);
 }
 
 void
@@ -976,11 +1164,18 @@ video_close(void)
 {
     video_monitor_close(0);
 
+    video_capture_close();
+
     free(video_16to32);
     free(video_15to32);
     free(video_8to32);
     free(video_8togs);
     free(video_6to8);
+    video_16to32 = NULL;
+    video_15to32 = NULL;
+    video_8to32  = NULL;
+    video_8togs  = NULL;
+    video_6to8   = NULL;
 
     if (fontdatksc5601) {
         free(fontdatksc5601);
@@ -176,21 +176,64 @@ vnc_display(rfbClientPtr cl)
 static void
 vnc_blit(int x, int y, int w, int h, int monitor_index)
 {
-    if (monitor_index || (x < 0) || (y < 0) || (w < VNC_MIN_X) || (h < VNC_MIN_Y) || (w > VNC_MAX_X) || (h > VNC_MAX_Y) || (buffer32 == NULL)) {
+    static int          last_x = -1;
+    static int          last_y = -1;
+    static int          last_w = -1;
+    static int          last_h = -1;
+    static int          mark_all = 1;
+    const video_span_t *spans;
+    video_span_t        full;
+    int                 count;
+    int                 top;
+    int                 bottom;
+
+    if (monitor_index || (x < 0) || (y < 0) || (w < VNC_MIN_X) || (h < VNC_MIN_Y) || (w > VNC_MAX_X) || (h > VNC_MAX_Y) || (monitors[monitor_index].front_buffer == NULL)) {
+        last_w = -1;
         video_blit_complete_monitor(monitor_index);
         return;
     }
 
-    for (int row = 0; row < h; ++row)
-        video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(buffer32->line[y + row][x]), w * sizeof(uint32_t));
+    /* The frame buffer keeps whatever was last blitted, so only the rows
+       that changed need copying unless the rectangle itself moved. */
+    if ((x != last_x) || (y != last_y) || (w != last_w) || (h != last_h)) {
+        full.y   = y;
+        full.h   = h;
+        spans    = &full;
+        count    = 1;
+        last_x   = x;
+        last_y   = y;
+        last_w   = w;
+        last_h   = h;
+        mark_all = 1;
+    } else
+        count = video_get_dirty_spans_monitor(&spans, monitor_index);
+
+    for (int i = 0; i < count; i++) {
+        for (int row = spans[i].y - y; row < (spans[i].y - y + spans[i].h); ++row)
+            video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(monitors[monitor_index].front_buffer->line[y + row][x]), w * sizeof(uint32_t));
+    }
 
     if (screenshots)
         video_screenshot((uint32_t *) rfb->frameBuffer, 0, 0, VNC_MAX_X);
 
     video_blit_complete_monitor(monitor_index);
 
-    if (!updatingSize)
+    if (updatingSize)
+        mark_all = 1;
+    else if (mark_all) {
         rfbMarkRectAsModified(rfb, 0, 0, allowedX, allowedY);
+        mark_all = 0;
+    } else {
+        /* Only hand the changed rows to the encoder. */
+        for (int i = 0; i < count; i++) {
+            top    = spans[i].y - y;
+            bottom = top + spans[i].h;
+            if (bottom > allowedY)
+                bottom = allowedY;
+            if (top < bottom)
+                rfbMarkRectAsModified(rfb, 0, top, allowedX, bottom);
+        }
+    }
 }
 
 /* Initialize VNC for operation. */